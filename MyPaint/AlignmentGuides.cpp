@@ -0,0 +1,129 @@
+#include "AlignmentGuides.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+// 一个矩形在某个方向上的三个对齐坐标：起点、中点、终点
+static void features(int start, int length, int result[3])
+{
+    result[0] = start;
+    result[1] = start + length / 2;
+    result[2] = start + length;
+}
+
+void AlignmentGuides::clear()
+{
+    m_vertical.clear();
+    m_horizontal.clear();
+}
+
+void AlignmentGuides::rebuild(const std::vector<std::unique_ptr<ShapeBase>> &shapes, const std::vector<int> &exclude)
+{
+    clear();
+    m_vertical.reserve(shapes.size() * 3);
+    m_horizontal.reserve(shapes.size() * 3);
+
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        if (std::binary_search(exclude.begin(), exclude.end(), static_cast<int>(i)))
+            continue;
+
+        QRect rect = alignmentRect(*shapes[i]);
+        int xs[3];
+        int ys[3];
+        features(rect.left(), rect.width(), xs);
+        features(rect.top(), rect.height(), ys);
+        for (int k = 0; k < 3; ++k)
+        {
+            m_vertical.push_back({xs[k], ys[0], ys[2]});
+            m_horizontal.push_back({ys[k], xs[0], xs[2]});
+        }
+    }
+
+    auto byValue = [](const Edge &a, const Edge &b) { return a.value < b.value; };
+    std::sort(m_vertical.begin(), m_vertical.end(), byValue);
+    std::sort(m_horizontal.begin(), m_horizontal.end(), byValue);
+}
+
+AlignmentGuides::Result AlignmentGuides::snap(const QRect &moving, int tolerance) const
+{
+    Result result;
+    int xs[3];
+    int ys[3];
+    features(moving.left(), moving.width(), xs);
+    features(moving.top(), moving.height(), ys);
+
+    int dx = 0;
+    int dy = 0;
+    bool snapX = nearest(m_vertical, xs, tolerance, dx);
+    bool snapY = nearest(m_horizontal, ys, tolerance, dy);
+    result.offset = QPoint(dx, dy);
+
+    // 吸附后重新计算坐标，与其他图形的边完全重合的才画参考线
+    QRect snapped = moving.translated(result.offset);
+    features(snapped.left(), snapped.width(), xs);
+    features(snapped.top(), snapped.height(), ys);
+    if (snapX)
+        addLines(m_vertical, xs, ys[0], ys[2], true, result.lines);
+    if (snapY)
+        addLines(m_horizontal, ys, xs[0], xs[2], false, result.lines);
+    return result;
+}
+
+QRect AlignmentGuides::alignmentRect(const ShapeBase &shape)
+{
+    if (shape.getRotation() == 0.0)
+        return shape.boundingRect();
+    return shape.sceneOutline().boundingRect().toAlignedRect();
+}
+
+bool AlignmentGuides::nearest(const std::vector<Edge> &edges, const int features[3], int tolerance, int &offset)
+{
+    auto valueLess = [](const Edge &edge, int value) { return edge.value < value; };
+    int best = INT_MAX;
+    for (int k = 0; k < 3; ++k)
+    {
+        // 最近的坐标只可能是第一个不小于它的，或者它前面的一个
+        auto it = std::lower_bound(edges.begin(), edges.end(), features[k], valueLess);
+        if (it != edges.end() && it->value - features[k] < std::abs(best))
+            best = it->value - features[k];
+        if (it != edges.begin() && features[k] - (it - 1)->value < std::abs(best))
+            best = (it - 1)->value - features[k];
+    }
+
+    if (std::abs(best) > tolerance)
+        return false;
+    offset = best;
+    return true;
+}
+
+void AlignmentGuides::addLines(const std::vector<Edge> &edges, const int features[3], int from, int to,
+                               bool vertical, std::vector<QLine> &lines)
+{
+    auto valueLess = [](const Edge &edge, int value) { return edge.value < value; };
+    for (int k = 0; k < 3; ++k)
+    {
+        // 同一坐标上可能有很多图形，参考线只连到离拖动的图形最近的一个
+        const Edge *closest = nullptr;
+        int closestGap = INT_MAX;
+        auto it = std::lower_bound(edges.begin(), edges.end(), features[k], valueLess);
+        for (; it != edges.end() && it->value == features[k]; ++it)
+        {
+            int gap = std::max(0, std::max(it->from - to, from - it->to));
+            if (gap < closestGap)
+            {
+                closest = &*it;
+                closestGap = gap;
+            }
+        }
+        if (!closest)
+            continue;
+
+        int lineFrom = std::min(from, closest->from);
+        int lineTo = std::max(to, closest->to);
+        if (vertical)
+            lines.emplace_back(features[k], lineFrom, features[k], lineTo);
+        else
+            lines.emplace_back(lineFrom, features[k], lineTo, features[k]);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef ALIGNMENTGUIDES_H
+#define ALIGNMENTGUIDES_H
+
+#include "ShapeBase.h"
+#include <QLine>
+#include <QPoint>
+#include <QRect>
+#include <memory>
+#include <vector>
+
+// 拖动时的对齐参考线。其他图形的左/中/右和上/中/下坐标分别按值排序存放，
+// 每次移动只在容差范围内二分查找最近的坐标，不需要扫描所有图形。
+// 索引在拖动开始时建立一次，拖动中的图形不参与对齐。
+class AlignmentGuides
+{
+public:
+  static const int kSnapPixels = 6; // 屏幕上的吸附距离，换算到文档坐标时除以缩放因子
+
+  // 吸附结果
+  struct Result
+  {
+    QPoint offset;            // 对齐需要追加的偏移
+    std::vector<QLine> lines; // 需要绘制的参考线（文档坐标）
+  };
+
+  void clear();
+  // 重新建立索引，exclude（升序）中的图形不参与对齐
+  void rebuild(const std::vector<std::unique_ptr<ShapeBase>> &shapes, const std::vector<int> &exclude);
+  // moving 是拖动中图形的对齐矩形，tolerance 是文档坐标中的吸附距离。
+  // 参考线只画在对齐的边上，从拖动的图形延伸到与它对齐的最近的图形为止
+  Result snap(const QRect &moving, int tolerance) const;
+
+  // 参与对齐的矩形：未旋转时是外接矩形，旋转后是轮廓的外接矩形
+  static QRect alignmentRect(const ShapeBase &shape);
+
+private:
+  struct Edge
+  {
+    int value; // 对齐方向上的坐标
+    int from;  // 图形在另一方向上的范围，用于确定参考线的长度
+    int to;
+  };
+
+  static bool nearest(const std::vector<Edge> &edges, const int features[3], int tolerance, int &offset);
+  static void addLines(const std::vector<Edge> &edges, const int features[3], int from, int to,
+                       bool vertical, std::vector<QLine> &lines);
+
+  std::vector<Edge> m_vertical;   // 左、中、右，按x排序
+  std::vector<Edge> m_horizontal; // 上、中、下，按y排序
+};
+
+#endif // ALIGNMENTGUIDES_H
@@ -0,0 +1,303 @@
+#include "ConnectorRouter.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <queue>
+
+namespace
+{
+    // 方向：0向右，1向下，2向左，3向上；4表示还没有方向（没有连接的起点）
+    const int kDirections = 5;
+    const int kNoDirection = 4;
+
+    // 端点离图形哪条边最近就从哪条边垂直引出
+    int exitDirection(const QPoint &pos, const QRect &shape)
+    {
+        const int distances[4] = {std::abs(pos.x() - (shape.right() + 1)), std::abs(pos.y() - (shape.bottom() + 1)),
+                                  std::abs(pos.x() - shape.left()), std::abs(pos.y() - shape.top())};
+        return static_cast<int>(std::min_element(distances, distances + 4) - distances);
+    }
+
+    // 从图形引出kMargin后的点，正好落在扩大后的障碍物边线上
+    QPoint stubPoint(const QPoint &pos, const QRect &shape, int direction)
+    {
+        switch (direction)
+        {
+        case 0:
+            return QPoint(shape.right() + 1 + ConnectorRouter::kMargin, pos.y());
+        case 1:
+            return QPoint(pos.x(), shape.bottom() + 1 + ConnectorRouter::kMargin);
+        case 2:
+            return QPoint(shape.left() - ConnectorRouter::kMargin, pos.y());
+        default:
+            return QPoint(pos.x(), shape.top() - ConnectorRouter::kMargin);
+        }
+    }
+
+    // 去掉重复的点和共线的中间点
+    void simplify(std::vector<QPoint> &points)
+    {
+        std::vector<QPoint> result;
+        result.reserve(points.size());
+        for (const QPoint &pt : points)
+        {
+            if (!result.empty() && result.back() == pt)
+                continue;
+            if (result.size() >= 2)
+            {
+                const QPoint &a = result[result.size() - 2];
+                const QPoint &b = result.back();
+                if ((a.x() == b.x() && b.x() == pt.x()) || (a.y() == b.y() && b.y() == pt.y()))
+                    result.pop_back();
+            }
+            result.push_back(pt);
+        }
+        points.swap(result);
+    }
+
+    // 一行（或一列）上被障碍物内部挡住的开区间(begin, end)，端点本身不被挡住
+    struct Span
+    {
+        int begin;
+        int end;
+    };
+    using SpanList = std::vector<Span>;
+
+    // 按begin排好序的区间中相互重叠的合并；只是相接的不合并，相接的点仍然可以通过
+    void mergeSpans(SpanList &spans)
+    {
+        size_t count = 0;
+        for (const Span &span : spans)
+        {
+            if (count > 0 && span.begin < spans[count - 1].end)
+                spans[count - 1].end = std::max(spans[count - 1].end, span.end);
+            else
+                spans[count++] = span;
+        }
+        spans.resize(count);
+    }
+
+    // 合并后的区间互不重叠，只有begin < value的最后一个区间可能包含value
+    const Span *lastBefore(const SpanList &spans, int value)
+    {
+        auto it = std::lower_bound(spans.begin(), spans.end(), value,
+                                   [](const Span &span, int v) { return span.begin < v; });
+        return it == spans.begin() ? nullptr : &*(it - 1);
+    }
+
+    bool pointBlocked(const SpanList &spans, int value)
+    {
+        const Span *span = lastBefore(spans, value);
+        return span && value < span->end;
+    }
+
+    // 线段[low, high]是否经过某个区间的内部
+    bool rangeBlocked(const SpanList &spans, int low, int high)
+    {
+        const Span *span = lastBefore(spans, high);
+        return span && span->end > low;
+    }
+}
+
+ConnectorRouter::Route ConnectorRouter::route(const Endpoint &start, const Endpoint &end, const ObstacleQuery &query)
+{
+    // 连接在图形上的一端先垂直引出一小段，另一端最后垂直进入图形
+    int startDir = kNoDirection;
+    QPoint from = start.pos;
+    if (!start.shape.isNull())
+    {
+        startDir = exitDirection(start.pos, start.shape);
+        from = stubPoint(start.pos, start.shape, startDir);
+    }
+    int arriveDir = kNoDirection;
+    QPoint to = end.pos;
+    if (!end.shape.isNull())
+    {
+        int endDir = exitDirection(end.pos, end.shape);
+        to = stubPoint(end.pos, end.shape, endDir);
+        arriveDir = (endDir + 2) % 4;
+    }
+
+    // 先在较窄的走廊中搜索，被挡住时再放宽一次
+    Route result;
+    QRect span = QRect(from, to).normalized();
+    std::vector<QRect> rects;
+    std::vector<Obstacle> obstacles;
+    for (int margin = kCorridorMargin; margin <= kCorridorMargin * 4; margin *= 4)
+    {
+        result.corridor = span.adjusted(-margin, -margin, margin, margin);
+        rects.clear();
+        query(result.corridor, rects);
+        obstacles.clear();
+        for (const QRect &rect : rects)
+        {
+            obstacles.push_back({rect.left() - kMargin, rect.top() - kMargin,
+                                 rect.right() + 1 + kMargin, rect.bottom() + 1 + kMargin});
+        }
+
+        std::vector<QPoint> path;
+        if (search(from, startDir, to, arriveDir, result.corridor, obstacles, path))
+        {
+            result.points.reserve(path.size() + 2);
+            result.points.push_back(start.pos);
+            result.points.insert(result.points.end(), path.begin(), path.end());
+            result.points.push_back(end.pos);
+            simplify(result.points);
+            return result;
+        }
+    }
+    return result;
+}
+
+bool ConnectorRouter::search(const QPoint &from, int fromDir, const QPoint &to, int toDir,
+                             const QRect &area, const std::vector<Obstacle> &obstacles,
+                             std::vector<QPoint> &path)
+{
+    // 可见图的节点是候选x坐标与候选y坐标的交点：两端的坐标和障碍物的边线
+    std::vector<int> xs = {area.left(), area.right(), from.x(), to.x()};
+    std::vector<int> ys = {area.top(), area.bottom(), from.y(), to.y()};
+    for (const Obstacle &o : obstacles)
+    {
+        if (o.left > area.left() && o.left < area.right())
+            xs.push_back(o.left);
+        if (o.right > area.left() && o.right < area.right())
+            xs.push_back(o.right);
+        if (o.top > area.top() && o.top < area.bottom())
+            ys.push_back(o.top);
+        if (o.bottom > area.top() && o.bottom < area.bottom())
+            ys.push_back(o.bottom);
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    const int nx = static_cast<int>(xs.size());
+    const int ny = static_cast<int>(ys.size());
+    if (static_cast<long long>(nx) * ny > kMaxNodes)
+        return false;
+
+    auto column = [&](int x) { return static_cast<int>(std::lower_bound(xs.begin(), xs.end(), x) - xs.begin()); };
+    auto row = [&](int y) { return static_cast<int>(std::lower_bound(ys.begin(), ys.end(), y) - ys.begin()); };
+    const int source = row(from.y()) * nx + column(from.x());
+    const int target = row(to.y()) * nx + column(to.x());
+
+    // 每一行（列）上被障碍物挡住的区间：障碍物按左（上）边排序后依次加入它跨过的各行（列），
+    // 各行（列）的区间自然有序。之后节点和线段的检查都只在所在的行（列）中二分查找
+    std::vector<SpanList> rowSpans(ny), columnSpans(nx);
+    std::vector<const Obstacle *> sorted;
+    sorted.reserve(obstacles.size());
+    for (const Obstacle &o : obstacles)
+        sorted.push_back(&o);
+    std::sort(sorted.begin(), sorted.end(), [](const Obstacle *a, const Obstacle *b) { return a->left < b->left; });
+    for (const Obstacle *o : sorted)
+    {
+        int end = row(o->bottom);
+        for (int iy = static_cast<int>(std::upper_bound(ys.begin(), ys.end(), o->top) - ys.begin()); iy < end; ++iy)
+            rowSpans[iy].push_back({o->left, o->right});
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Obstacle *a, const Obstacle *b) { return a->top < b->top; });
+    for (const Obstacle *o : sorted)
+    {
+        int end = column(o->right);
+        for (int ix = static_cast<int>(std::upper_bound(xs.begin(), xs.end(), o->left) - xs.begin()); ix < end; ++ix)
+            columnSpans[ix].push_back({o->top, o->bottom});
+    }
+    for (SpanList &spans : rowSpans)
+        mergeSpans(spans);
+    for (SpanList &spans : columnSpans)
+        mergeSpans(spans);
+
+    // 落在障碍物内部的节点不能经过；两端总是可用的，图形重叠时也能出发
+    std::vector<char> open(static_cast<size_t>(nx) * ny, 1);
+    for (int iy = 0; iy < ny; ++iy)
+    {
+        if (rowSpans[iy].empty())
+            continue;
+        for (int ix = 0; ix < nx; ++ix)
+        {
+            if (pointBlocked(rowSpans[iy], xs[ix]))
+                open[iy * nx + ix] = 0;
+        }
+    }
+    open[source] = 1;
+    open[target] = 1;
+
+    // 相邻节点之间的线段是否穿过障碍物内部
+    auto segmentOpen = [&](int ix, int iy, int jx, int jy)
+    {
+        if (iy == jy)
+            return !rangeBlocked(rowSpans[iy], std::min(xs[ix], xs[jx]), std::max(xs[ix], xs[jx]));
+        return !rangeBlocked(columnSpans[ix], std::min(ys[iy], ys[jy]), std::max(ys[iy], ys[jy]));
+    };
+
+    // 状态是节点加上到达时的方向，这样才能计算拐弯的代价
+    const int stepX[4] = {1, 0, -1, 0};
+    const int stepY[4] = {0, 1, 0, -1};
+    std::vector<int> cost(open.size() * kDirections, INT_MAX);
+    std::vector<int> parent(open.size() * kDirections, -1);
+    auto estimate = [&](int node)
+    { return std::abs(xs[node % nx] - to.x()) + std::abs(ys[node / nx] - to.y()); };
+
+    using Entry = std::pair<int, int>; // 估计总代价，状态
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    int first = source * kDirections + fromDir;
+    cost[first] = 0;
+    queue.push({estimate(source), first});
+
+    int reached = -1;
+    while (!queue.empty())
+    {
+        Entry entry = queue.top();
+        queue.pop();
+        int state = entry.second;
+        int node = state / kDirections;
+        int dir = state % kDirections;
+        if (entry.first != cost[state] + estimate(node))
+            continue; // 已经有更短的路径
+        if (node == target)
+        {
+            reached = state;
+            break;
+        }
+
+        int ix = node % nx;
+        int iy = node / nx;
+        for (int next = 0; next < 4; ++next)
+        {
+            if (dir != kNoDirection && next == (dir + 2) % 4)
+                continue; // 不走回头路
+            int jx = ix + stepX[next];
+            int jy = iy + stepY[next];
+            if (jx < 0 || jx >= nx || jy < 0 || jy >= ny)
+                continue;
+            int neighbor = jy * nx + jx;
+            if (!open[neighbor] || !segmentOpen(ix, iy, jx, jy))
+                continue;
+
+            int step = std::abs(xs[jx] - xs[ix]) + std::abs(ys[jy] - ys[iy]);
+            if (dir != kNoDirection && dir != next)
+                step += kBendPenalty;
+            if (neighbor == target && toDir != kNoDirection && next != toDir)
+                step += kBendPenalty; // 最后还要拐一次弯才能进入图形
+            int nextState = neighbor * kDirections + next;
+            if (cost[state] + step < cost[nextState])
+            {
+                cost[nextState] = cost[state] + step;
+                parent[nextState] = state;
+                queue.push({cost[nextState] + estimate(neighbor), nextState});
+            }
+        }
+    }
+    if (reached == -1)
+        return false;
+
+    path.clear();
+    for (int state = reached; state != -1; state = parent[state])
+    {
+        int node = state / kDirections;
+        path.emplace_back(xs[node % nx], ys[node / nx]);
+    }
+    std::reverse(path.begin(), path.end());
+    return true;
+}
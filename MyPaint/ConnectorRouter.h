@@ -0,0 +1,51 @@
+#ifndef CONNECTORROUTER_H
+#define CONNECTORROUTER_H
+
+#include <QPoint>
+#include <QRect>
+#include <functional>
+#include <vector>
+
+// 连接线的正交布线。只用障碍物（图形外接矩形向外扩kMargin）的边线和两端的坐标
+// 组成稀疏的正交可见图，在上面用A*搜索长度加拐弯代价最小的路径。
+// 搜索限制在两端附近的走廊内，走廊外的图形不会影响结果，
+// 所以只有走廊内的图形变化时才需要重新布线。
+class ConnectorRouter
+{
+public:
+  static const int kMargin = 12;          // 连接线与图形之间保持的距离
+  static const int kBendPenalty = 40;     // 每个拐弯相当于多走的距离
+  static const int kCorridorMargin = 80;  // 走廊在两端外接矩形外扩的距离
+  static const int kMaxNodes = 40000;     // 可见图最多的节点数，超过时放弃搜索
+
+  // 连接线的一端
+  struct Endpoint
+  {
+    QPoint pos;
+    QRect shape;           // 连接的图形的外接矩形，没有连接时为空
+  };
+
+  struct Route
+  {
+    std::vector<QPoint> points; // 包括两端的折线，搜索失败时为空
+    QRect corridor;             // 搜索用到的范围，其中的图形变化时需要重新布线
+  };
+
+  // 返回area中的障碍物矩形（不要包括连接线本身）
+  using ObstacleQuery = std::function<void(const QRect &area, std::vector<QRect> &obstacles)>;
+
+  static Route route(const Endpoint &start, const Endpoint &end, const ObstacleQuery &query);
+
+private:
+  // 障碍物向外扩kMargin后的范围，只有内部（不含边线）不能通过
+  struct Obstacle
+  {
+    int left, top, right, bottom;
+  };
+
+  static bool search(const QPoint &from, int fromDir, const QPoint &to, int toDir,
+                     const QRect &area, const std::vector<Obstacle> &obstacles,
+                     std::vector<QPoint> &path);
+};
+
+#endif // CONNECTORROUTER_H
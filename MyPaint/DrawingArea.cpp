@@ -1,6 +1,11 @@
 #include "DrawingArea.h"
+#include "LayeredLayout.h"
+#include "TreeLayout.h"
 #include "ShapeFactory.h"
+#include "ShapeRegistry.h"
 #include <QDataStream>
+#include <QGuiApplication>
+#include <QScreen>
 #include <QSvgGenerator>
 #include <QJsonDocument>
 #include <QJsonArray>
@@ -12,21 +17,75 @@
 #include <QMouseEvent>
 #include <QPainter>
 #include <QPen>
-#include <QSvgGenerator>
+#include <QPointer>
+#include <QResizeEvent>
+#include <QScrollBar>
+#include <QSet>
+#include <QTransform>
 #include <QWheelEvent> // 添加对滚轮事件的支持
+#include <QWindow>
+#include <QtMath>
 #include <algorithm>
+#include <cmath>
+#include <iterator>
+
+// 页面四周留出的空白（屏幕像素）
+static const int kPageMargin = 40;
+
+// 交互停止多久之后开始用完整质量重绘（毫秒）
+static const int kRefineDelayMs = 200;
+
+// 渲染帧在视口四周多画的范围，小幅平移时不用等待新的帧
+static const int kFrameMargin = TileCache::kTileSize / 2;
 
-DrawingArea::DrawingArea(QWidget *parent) : QWidget(parent)
+DrawingArea::DrawingArea(QWidget *parent) : QAbstractScrollArea(parent)
 {
     setObjectName("drawingArea");
     setFocusPolicy(Qt::StrongFocus); // 允许接收键盘事件
     setAcceptDrops(true);            // 允许接收拖拽
-    setMouseTracking(true);
+    viewport()->setAcceptDrops(true);
+    viewport()->setMouseTracking(true);
+    // 视口内容全部由paintEvent绘制，不需要系统先擦除背景
+    viewport()->setAttribute(Qt::WA_OpaquePaintEvent);
+    horizontalScrollBar()->setSingleStep(20);
+    verticalScrollBar()->setSingleStep(20);
     createContextMenu(); // 创建右键菜单
+
+    // 帧节拍定时器：把高频的鼠标移动合并为每帧一次几何更新
+    m_frameTimer = new QTimer(this);
+    m_frameTimer->setSingleShot(true);
+    m_frameTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_frameTimer, &QTimer::timeout, this, &DrawingArea::flushPendingMove);
+
+    // 空闲定时器：交互停止后把草稿图块替换为完整质量
+    m_idleTimer = new QTimer(this);
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(kRefineDelayMs);
+    connect(m_idleTimer, &QTimer::timeout, this, &DrawingArea::onInteractionIdle);
+
+    // 渲染线程：新的一帧发布后回到GUI线程贴图
+    m_renderWorker = new RenderWorker(this);
+    connect(m_renderWorker, &RenderWorker::frameReady, this, [this]()
+    {
+        viewport()->update();
+    });
+    m_renderWorker->start();
+
+    // 自动布局线程：计算完成后回到GUI线程应用结果
+    m_layoutWorker = new LayoutWorker(this);
+    connect(m_layoutWorker, &LayoutWorker::layoutFinished, this, &DrawingArea::onLayoutFinished);
+
+    // 力导向布局按帧推进
+    m_forceTimer = new QTimer(this);
+    connect(m_forceTimer, &QTimer::timeout, this, &DrawingArea::forceTick);
 }
 
 DrawingArea::~DrawingArea()
 {
+    // 先停止渲染线程，避免它在图形销毁过程中发布新的帧
+    m_renderWorker->stop();
+    m_layoutWorker->cancel();
+
     // 清理资源
     if (m_textEdit)
     {
@@ -48,20 +107,60 @@ bool DrawingArea::saveToFile(const QString &fileName)
         return false;
     }
 
+    // 分组表：只保存还有图形的组，组号按出现的先后重新编排
+    const ShapeGroupTree &groups = groupTree();
+    std::vector<int> groupIndices(groups.groupCount(), -1);
+    std::vector<int> savedGroups;
+    for (const auto &shape : shapes)
+    {
+        for (int id = shape->groupId(); groups.isValid(id) && groupIndices[id] < 0; id = groups.group(id).parent)
+        {
+            groupIndices[id] = static_cast<int>(savedGroups.size());
+            savedGroups.push_back(id);
+        }
+    }
+    QJsonArray groupsArray;
+    for (int id : savedGroups)
+    {
+        const ShapeGroupTree::Group &group = groups.group(id);
+        QJsonObject groupObj;
+        groupObj["parent"] = groups.isValid(group.parent) ? groupIndices[group.parent] : -1;
+        if (group.cacheImage)
+            groupObj["cacheImage"] = true;
+        groupsArray.append(groupObj);
+    }
+
+    // 样式表只写一次，图形只保存样式在表中的序号
+    QJsonArray stylesArray;
+    QHash<const ShapeStyleEntry *, int> styleIndices;
     QJsonArray shapesArray;
     for (const auto &shape : shapes)
     {
+        const ShapeStyleEntry *style = shape->styleHandle().get();
+        auto it = styleIndices.find(style);
+        if (it == styleIndices.end())
+        {
+            it = styleIndices.insert(style, stylesArray.size());
+            stylesArray.append(style->style.toJson());
+        }
+
         QJsonObject shapeObj = shape->toJson();
+        shapeObj["style"] = it.value();
+        if (groups.isValid(shape->groupId()))
+            shapeObj["group"] = groupIndices[shape->groupId()];
         shapesArray.append(shapeObj);
     }
 
     QJsonObject rootObj;
+    rootObj["styles"] = stylesArray;
     rootObj["shapes"] = shapesArray;
+    rootObj["groups"] = groupsArray;
     rootObj["backgroundColor"] = m_bgColor.name();
     rootObj["gridSize"] = m_gridSize;
+    rootObj["infiniteCanvas"] = m_infiniteCanvas;
     rootObj["size"] = QJsonObject{
-        {"width", width()},
-        {"height", height()}};
+        {"width", m_pageSize.width()},
+        {"height", m_pageSize.height()}};
 
     // 保存箭头连接信息
     QJsonArray connectionsArray;
@@ -72,6 +171,8 @@ bool DrawingArea::saveToFile(const QString &fileName)
         connObj["shapeIndex"] = conn.shapeIndex;
         connObj["handleIndex"] = conn.handleIndex;
         connObj["isStartPoint"] = conn.isStartPoint;
+        if (conn.perimeter >= 0.0)
+            connObj["perimeter"] = conn.perimeter;
         connectionsArray.append(connObj);
     }
     rootObj["connections"] = connectionsArray;
@@ -108,54 +209,48 @@ bool DrawingArea::loadFromFile(const QString &fileName)
     // 恢复画布大小
     QJsonObject sizeObj = rootObj["size"].toObject();
     setPageSize(QSize(sizeObj["width"].toInt(), sizeObj["height"].toInt()));
+    setInfiniteCanvas(rootObj["infiniteCanvas"].toBool());
+
+    // 恢复样式表（旧文件没有样式表，样式保存在各个图形中）
+    std::vector<ShapeStyleHandle> styles;
+    for (const QJsonValue &styleVal : rootObj["styles"].toArray())
+    {
+        ShapeStyle style;
+        style.readJson(styleVal.toObject());
+        styles.push_back(ShapeStyleTable::instance().intern(style));
+    }
 
     // 恢复所有图形
+    ShapeAllocator::Scope arena(m_arena);
     QJsonArray shapesArray = rootObj["shapes"].toArray();
     for (const QJsonValue &shapeVal : shapesArray)
     {
         QJsonObject shapeObj = shapeVal.toObject();
-        QString type = shapeObj["type"].toString();
-
-        std::unique_ptr<ShapeBase> shape;
-        if (type == "rect")
-        {
-            shape = ShapeFactory::createRect(QRect());
-        }
-        else if (type == "ellipse")
-        {
-            shape = ShapeFactory::createEllipse(QRect());
-        }
-        else if (type == "arrow")
-        {
-            shape = ShapeFactory::createArrow(QLine());
-        }
-        else if (type == "pentagon")
-        {
-            shape = ShapeFactory::createPentagon(QRect());
-        }
-        else if (type == "triangle")
-        {
-            shape = ShapeFactory::createTriangle(QRect());
-        }
-        else if (type == "diamond")
-        {
-            shape = ShapeFactory::createDiamond(QRect());
-        }
-        else if (type == "roundedrect")
-        {
-            shape = ShapeFactory::createRoundedRect(QRect());
-        }
-        // else if (shapeType == "polygon") {
-        //     // 待实现
-        // }
-
+        std::unique_ptr<ShapeBase> shape = ShapeRegistry::instance().fromJson(shapeObj);
         if (shape)
         {
-            shape->fromJson(shapeObj);
+            int styleIndex = shapeObj["style"].toInt(-1);
+            if (styleIndex >= 0 && styleIndex < static_cast<int>(styles.size()))
+                shape->setStyle(styles[styleIndex]);
+            shape->setGroupId(shapeObj["group"].toInt(ShapeGroupTree::kNoGroup));
             shapes.push_back(std::move(shape));
         }
     }
 
+    // 恢复分组表，组号就是在表中的序号
+    QJsonArray groupsArray = rootObj["groups"].toArray();
+    ShapeGroupTree &groups = mutableGroups();
+    for (int k = 0; k < groupsArray.size(); ++k)
+        groups.createGroup();
+    for (int k = 0; k < groupsArray.size(); ++k)
+    {
+        QJsonObject groupObj = groupsArray[k].toObject();
+        int parent = groupObj["parent"].toInt(ShapeGroupTree::kNoGroup);
+        groups.setParent(k, groups.isValid(parent) ? parent : ShapeGroupTree::kNoGroup);
+        groups.setCacheImage(k, groupObj["cacheImage"].toBool());
+    }
+    m_groupsDirty = true;
+
     // 恢复箭头连接
     QJsonArray connectionsArray = rootObj["connections"].toArray();
     for (const QJsonValue &connVal : connectionsArray)
@@ -166,45 +261,61 @@ bool DrawingArea::loadFromFile(const QString &fileName)
         conn.shapeIndex = connObj["shapeIndex"].toInt();
         conn.handleIndex = connObj["handleIndex"].toInt();
         conn.isStartPoint = connObj["isStartPoint"].toBool();
+        conn.perimeter = connObj["perimeter"].toDouble(-1.0);
         arrowConnections.push_back(conn);
     }
+    invalidateConnectionIndex();
 
-    update();
+    // 文件中不保存路径，折线连接线在这里布线一次
+    rerouteAffected({}, {});
+    invalidateScene();
     return true;
 }
 
 void DrawingArea::clear()
 {
+    stopForceLayout();
+    cancelPendingMove();
+    dragging = false;
+    resizing = false;
     shapes.clear();
     arrowConnections.clear();
-    selectedIndex = -1;
+    invalidateConnectionIndex();
+    mutableGroups().clear();
+    m_groupsDirty = true;
+    selectShape(-1);
+    m_marquee = Marquee();
+    m_guideLines.clear();
+    m_alignment.clear();
+    m_alignmentReady = false;
     snappedHandle = SnapInfo();
 
-    // 清空撤销重做栈
-    while (!m_undoStack.empty())
-    {
-        m_undoStack.pop();
-    }
-    while (!m_redoStack.empty())
-    {
-        m_redoStack.pop();
-    }
+    // 清空撤销重做栈（整体释放，不逐条弹出）
+    decltype(m_undoStack)().swap(m_undoStack);
+    decltype(m_redoStack)().swap(m_redoStack);
+    decltype(m_historyBatch)().swap(m_historyBatch);
     emit canUndoChanged(false);
     emit canRedoChanged(false);
 
-    update();
+    invalidateScene();
+
+    // 图形和历史记录都已释放，文档的内存池一次归还全部大块
+    m_arena.release();
 }
 
 bool DrawingArea::exportToPNG(const QString &fileName)
 {
-    QImage image(size(), QImage::Format_ARGB32);
+    // 按导出范围导出（文档坐标，与当前缩放和滚动位置无关）
+    QRect sourceRect = exportRect();
+    QImage image(sourceRect.size(), QImage::Format_ARGB32);
     image.fill(Qt::transparent);
 
     QPainter painter(&image);
     painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-sourceRect.topLeft());
 
     // 绘制背景
-    painter.fillRect(rect(), m_bgColor);
+    painter.fillRect(sourceRect, m_bgColor);
 
     // 绘制所有图形
     for (const auto &shape : shapes)
@@ -219,8 +330,9 @@ bool DrawingArea::exportToSVG(const QString &fileName)
 {
     QSvgGenerator generator;
     generator.setFileName(fileName);
-    generator.setSize(size());
-    generator.setViewBox(rect());
+    QRect sourceRect = exportRect();
+    generator.setSize(sourceRect.size());
+    generator.setViewBox(sourceRect);
     generator.setTitle("Flow Chart");
     generator.setDescription("Generated by Flow Chart Editor");
 
@@ -229,7 +341,7 @@ bool DrawingArea::exportToSVG(const QString &fileName)
     painter.setRenderHint(QPainter::Antialiasing);
 
     // 绘制背景
-    painter.fillRect(rect(), m_bgColor);
+    painter.fillRect(sourceRect, m_bgColor);
 
     // 绘制所有图形
     for (const auto &shape : shapes)
@@ -247,7 +359,7 @@ void DrawingArea::setGridSize(int size)
     {
         m_gridSize = size;
         emit gridSizeChanged(size);
-        update(); // 更新显示
+        invalidateScene(); // 更新显示
     }
 }
 
@@ -256,8 +368,9 @@ void DrawingArea::setPageSize(const QSize &size)
     if (size != m_pageSize && size.width() > 0 && size.height() > 0)
     {
         m_pageSize = size;
+        updateScrollBars();
         emit pageSizeChanged(size);
-        update(); // 更新显示
+        invalidateScene(); // 更新显示
     }
 }
 
@@ -267,90 +380,146 @@ void DrawingArea::setGridVisible(bool visible)
     {
         m_gridVisible = visible;
         emit gridVisibilityChanged(visible);
-        update(); // 更新显示
+        invalidateScene(); // 更新显示
     }
 }
 
-void DrawingArea::paintEvent(QPaintEvent *event)
+void DrawingArea::setSnapToGrid(bool snap)
 {
-    QPainter painter(this);
-    // 填充工作区背景（页面外区域）为浅灰色，更容易区分页面和工作区
-    painter.fillRect(rect(), QColor(240, 240, 240));
+    // 吸附只影响之后的拖动，画面不变，不需要重绘
+    if (snap != m_snapToGrid)
+    {
+        m_snapToGrid = snap;
+        emit snapToGridChanged(snap);
+    }
+}
 
-    painter.setRenderHint(QPainter::Antialiasing); // 抗锯齿
+void DrawingArea::setInfiniteCanvas(bool infinite)
+{
+    if (infinite != m_infiniteCanvas)
+    {
+        m_infiniteCanvas = infinite;
+        emit infiniteCanvasChanged(infinite);
+        invalidateScene();
+        updateScrollBars();
+    }
+}
 
-    // 首先绘制页面边界
-    QRect pageRect(0, 0, m_pageSize.width(), m_pageSize.height());
-    QRect scaledPageRect = docToScreen(pageRect);
+// 所有图形绘制范围的并集
+QRect DrawingArea::contentBounds() const
+{
+    return geometryTable().unitedBounds();
+}
 
-    // 绘制页面背景
-    painter.fillRect(scaledPageRect, m_bgColor); // 使用设置的背景颜色
+// 可滚动的文档范围：固定页面模式下就是页面，无限画布模式下随内容扩展
+QRect DrawingArea::sceneRect() const
+{
+    QRect rect(QPoint(0, 0), m_pageSize);
+    if (!m_infiniteCanvas)
+        return rect;
 
-    // 绘制页面边框，便于识别页面边界
-    QPen pageBorderPen(QColor(180, 180, 180), 1);
-    painter.setPen(pageBorderPen);
-    painter.drawRect(scaledPageRect);
+    // 内容周围留出一屏的空白，方便继续向外绘制；当前视口也包含在内，避免视图跳动
+    QRect content = contentBounds();
+    if (!content.isEmpty())
+    {
+        int padX = qCeil(viewport()->width() / m_zoomFactor);
+        int padY = qCeil(viewport()->height() / m_zoomFactor);
+        rect |= content.adjusted(-padX, -padY, padX, padY);
+    }
+    return rect | visibleDocRect();
+}
 
-    // 应用缩放变换，用于绘制网格和内容
-    painter.scale(m_zoomFactor, m_zoomFactor);
+// 导出范围：固定页面模式导出页面，无限画布模式导出全部内容
+QRect DrawingArea::exportRect() const
+{
+    if (m_infiniteCanvas && !shapes.empty())
+        return contentBounds().adjusted(-10, -10, 10, 10);
+    return QRect(QPoint(0, 0), m_pageSize);
+}
 
-    // 画网格，但只在页面区域内绘制
-    if (m_gridVisible)
-    {                                                           // 只在网格可见时绘制
-        int gridSize = m_gridSize;                              // 网格间距
-        int majorGridStep = 5;                                  // 每5格一条粗线
-        QPen thinPen(QColor(200, 200, 200), 1 / m_zoomFactor);  // 细线浅灰色，保持线宽不变
-        QPen thickPen(QColor(120, 120, 120), 2 / m_zoomFactor); // 粗线深灰色，保持线宽不变
-
-        // 页面区域就是网格绘制的范围
-        QRect pageDocRect(0, 0, m_pageSize.width(), m_pageSize.height());
-
-        // 第一步：绘制细的竖线
-        int startX = 0;                // 从页面左边开始
-        int endX = m_pageSize.width(); // 到页面右边结束
-        for (int x = startX, idx = startX / gridSize; x <= endX; x += gridSize, ++idx)
-        {
-            if (idx % majorGridStep != 0) // 只绘制细线
-            {
-                painter.setPen(thinPen);
-                painter.drawLine(x, 0, x, m_pageSize.height()); // 从页面顶部到底部
-            }
-        }
+// 场景内容变化后调用：丢弃所有图块和图形副本并重绘
+void DrawingArea::invalidateScene()
+{
+    ++m_sceneRevision;
+    m_pendingInvalidateAll = true;
+    m_pendingDirtyRects.clear();
+    m_snapshotReset = true; // 不知道哪些图形被修改过，全部重新复制
+    m_snapshotDirty.clear();
+    m_styleSnapshots.clear();
+    m_geometryDirty = true;
+    if (m_infiniteCanvas)
+        updateScrollBars(); // 内容范围可能变化
+    viewport()->update();
+}
 
-        // 第二步：绘制所有横线（粗细都绘制）
-        int startY = 0;                 // 从页面顶部开始
-        int endY = m_pageSize.height(); // 到页面底部结束
-        for (int y = startY, idx = startY / gridSize; y <= endY; y += gridSize, ++idx)
-        {
-            if (idx % majorGridStep == 0)
-            {
-                painter.setPen(thickPen);
-            }
-            else
-            {
-                painter.setPen(thinPen);
-            }
-            painter.drawLine(0, y, m_pageSize.width(), y); // 从页面左边到右边
-        }
+// 只重绘文档中的一块区域
+void DrawingArea::invalidateDocRect(const QRect &docRect)
+{
+    if (docRect.isEmpty())
+        return;
 
-        // 第三步：绘制粗的竖线
-        for (int x = startX, idx = startX / gridSize; x <= endX; x += gridSize, ++idx)
-        {
-            if (idx % majorGridStep == 0) // 只绘制粗线
-            {
-                painter.setPen(thickPen);
-                painter.drawLine(x, 0, x, m_pageSize.height()); // 从页面顶部到底部
-            }
-        }
+    // 图块由渲染线程在处理下一次请求时标记失效
+    ++m_sceneRevision;
+    if (!m_pendingInvalidateAll)
+        m_pendingDirtyRects.push_back(docRect);
+    viewport()->update(docToScreen(docRect).adjusted(-2, -2, 2, 2));
+}
+
+void DrawingArea::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    // 只重绘需要更新的区域（滚动时只有新露出的部分）
+    QRect exposedRect = event->rect();
+    painter.setClipRect(exposedRect);
+
+    // 1. 贴上渲染线程最近完成的一帧；缩放或平移后新的帧还没完成时，先把旧的帧按比例拉伸显示
+    const RenderedFrame &frame = m_renderWorker->frontFrame();
+    QRectF frameTarget;
+    if (!frame.image.isNull())
+    {
+        double scale = m_zoomFactor / frame.info.zoomFactor;
+        frameTarget = QRectF(QPointF(frame.info.contentRect.topLeft()) * scale - QPointF(m_viewOrigin),
+                             QSizeF(frame.info.contentRect.size()) * scale);
+    }
+    if (!frameTarget.contains(QRectF(exposedRect)))
+        painter.fillRect(exposedRect, QColor(240, 240, 240));
+    if (!frame.image.isNull())
+    {
+        if (frame.info.zoomFactor == m_zoomFactor)
+            painter.drawImage(frameTarget.topLeft().toPoint(), frame.image);
+        else
+            painter.drawImage(frameTarget, frame.image, QRectF(frame.image.rect()));
     }
 
-    // 画图形
-    for (int i = 0; i < shapes.size(); ++i)
+    // 显示的帧已经过期，而且还没有提交能替代它的请求时，提交新的请求
+    FrameInfo wanted = wantedFrame();
+    if (!frame.info.satisfies(wanted) && !m_requestedFrame.satisfies(wanted))
+        requestFrame(wanted);
+
+    // 2. 在图块之上叠加选中状态，选中框和锚点不进入缓存
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-m_viewOrigin);
+    painter.scale(m_zoomFactor, m_zoomFactor);
+    // 只有单选时才画锚点，多选的图形和框选预览中的图形只画虚线框
+    // 只访问选中的、框中的和吸附的图形，按z序从下到上
+    const bool multiple = m_selection.size() > 1;
+    std::vector<int> overlay;
+    overlay.reserve(m_selection.size() + m_marquee.hits.size() + 1);
+    std::set_union(m_selection.begin(), m_selection.end(), m_marquee.hits.begin(), m_marquee.hits.end(),
+                   std::back_inserter(overlay));
+    if (snappedHandle.shapeIndex >= 0 &&
+        !std::binary_search(overlay.begin(), overlay.end(), snappedHandle.shapeIndex))
+        overlay.insert(std::lower_bound(overlay.begin(), overlay.end(), snappedHandle.shapeIndex),
+                       snappedHandle.shapeIndex);
+    for (int i : overlay)
     {
+        if (i < 0 || i >= static_cast<int>(shapes.size()))
+            continue;
         bool showHandles = false;
+        bool showFrame = false;
         if (i == snappedHandle.shapeIndex)
             showHandles = true;
-        if (i == selectedIndex)
+        if (i == selectedIndex && !multiple)
         {
             auto *arrow = dynamic_cast<ShapeArrow *>(shapes[i].get());
             if (arrow && shapes[i]->isHandleSelected())
@@ -358,18 +527,52 @@ void DrawingArea::paintEvent(QPaintEvent *event)
             else
                 showHandles = true;
         }
-        shapes[i]->paint(&painter, showHandles);
+        else if (isSelected(i) || std::binary_search(m_marquee.hits.begin(), m_marquee.hits.end(), i))
+        {
+            showFrame = true;
+        }
+        if (showHandles)
+            shapes[i]->paintSelection(&painter);
+        else if (showFrame)
+            shapes[i]->paintSelection(&painter, false);
+    }
+
+    // 3. 框选的橡皮筋矩形或套索（细线，不随缩放变粗）
+    const QColor marqueeColor(0, 120, 215);
+    if (m_marquee.shape == MarqueeShape::Rect && !m_marquee.rect.isNull())
+    {
+        // 从右向左拖动（相交即选中）时用虚线
+        Qt::PenStyle style = marqueeMode() == SelectionMode::Contained ? Qt::SolidLine : Qt::DashLine;
+        painter.setPen(QPen(marqueeColor, 0, style));
+        painter.setBrush(QColor(marqueeColor.red(), marqueeColor.green(), marqueeColor.blue(), 40));
+        painter.drawRect(m_marquee.rect);
+    }
+    else if (m_marquee.shape == MarqueeShape::Lasso)
+    {
+        painter.setPen(QPen(marqueeColor, 0, Qt::DashLine));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawPolyline(m_marquee.lasso);
     }
 
-    QWidget::paintEvent(event); // 调用父类paintEvent
+    // 4. 对齐参考线
+    if (!m_guideLines.empty())
+    {
+        painter.setPen(QPen(QColor(255, 0, 255), 0));
+        for (const QLine &line : m_guideLines)
+            painter.drawLine(line);
+    }
 }
 
 void DrawingArea::mousePressEvent(QMouseEvent *event)
 {
+    // 开始新的操作前停止力导向布局，丢弃上一次拖动残留的鼠标位置
+    stopForceLayout();
+    cancelPendingMove();
+
     // 转换屏幕坐标到文档坐标
     QPoint docPos = screenToDoc(event->pos());
 
-    if (selectedIndex != -1)
+    if (selectedIndex != -1 && m_selection.size() == 1)
     {
         // 检查是否点击了锚点
         const auto &handles = shapes[selectedIndex]->getHandles();
@@ -395,6 +598,7 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
 
                             // 创建新箭头，起点在ArrowAnchor锚点位置，终点跟随鼠标
                             QLine arrowLine(anchorPos, docPos);
+                            ShapeAllocator::Scope arena(m_arena);
                             std::unique_ptr<ShapeBase> arrow = ShapeFactory::createArrow(arrowLine);
 
                             // 存储当前选中图形的索引(创建新箭头前)
@@ -402,7 +606,7 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
 
                             // 添加到图形列表并选中新箭头
                             shapes.push_back(std::move(arrow));
-                            selectedIndex = shapes.size() - 1;
+                            selectShape(static_cast<int>(shapes.size()) - 1);
 
                             // 记录添加图形到历史
                             recordAddShape(selectedIndex);
@@ -423,6 +627,7 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
                                 connection.handleIndex = arrowAnchorIndex;
                                 connection.isStartPoint = true; // 箭头的起点
                                 arrowConnections.push_back(connection);
+                                invalidateConnectionIndex();
 
                                 // 确保起点锚点正确
                                 const auto &anchors = shapes[originalSelectedIndex]->getArrowAnchors();
@@ -437,7 +642,7 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
 
                             dragging = true;
                             lastMousePos = docPos;
-                            update();
+                            invalidateScene();
                             return;
                         }
                     }
@@ -452,33 +657,71 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
                     {
                         resizing = true;
                         originalRect = shapes[selectedIndex]->getRect();
+                        m_moveStartPos = docPos; // 缩放从按下时的矩形计算，不逐次累加
                     }
 
                     lastMousePos = docPos; // 保存文档坐标
                     dragging = true;
-                    update();
+                    viewport()->update();
                     return;
                 }
             }
         }
     }
 
-    // 检查是否点击了某个图形（原有逻辑）
+    // 检查是否点击了某个图形：先在几何副表中批量判断，表中无法精确判断的图形再从上往下调用contains()
     int oldSelectedIndex = selectedIndex;
-    selectedIndex = -1;
-    for (int i = shapes.size() - 1; i >= 0; --i)
+    const bool toggle = event->modifiers() & (Qt::ShiftModifier | Qt::ControlModifier);
+    std::vector<ShapeGeometryTable::HitCandidate> candidates;
+    groupTree().hitCandidates(docPos, geometryTable(), candidates);
+    for (auto it = candidates.rbegin(); it != candidates.rend(); ++it)
     {
-        // 直接在文档坐标系中检查
-        if (shapes[i]->contains(docPos))
+        int i = it->index;
+        if (it->exact || shapes[i]->contains(docPos))
         {
-            selectedIndex = i;
+            // 图形在组中时，选择的单位是整个最外层组
+            const std::vector<int> members = expandToGroups(std::vector<int>(1, i));
+            if (toggle)
+            {
+                // Shift/Ctrl点击：把图形加入或移出选择，不开始拖动
+                bool remove = isSelected(i);
+                for (int m : members)
+                {
+                    if (isSelected(m) == remove)
+                        toggleSelection(m);
+                }
+                if (!remove)
+                    selectedIndex = i;
+                emitSelectionChanged(oldSelectedIndex);
+                viewport()->update();
+                return;
+            }
+
+            // 点中已选中的图形时保留整个选择，一起拖动
+            if (isSelected(i))
+            {
+                selectedIndex = i;
+            }
+            else
+            {
+                selectShape(i);
+                m_selection = members;
+            }
+            m_dragGeometry.clear();
+            if (m_selection.size() > 1)
+                m_dragGeometry = captureGeometry(transformTargets(m_selection));
+            m_dragBounds = QRect();
+            for (int index : m_selection)
+                m_dragBounds |= AlignmentGuides::alignmentRect(*shapes[index]);
+            m_dragOffset = QPoint();
+            m_alignmentReady = false;
             lastMousePos = docPos; // 保存文档坐标
 
             // 记录按下时的起始位置，用于计算总移动距离
             m_moveStartPos = docPos;
             dragging = true;
 
-            update();
+            viewport()->update();
 
             // 发出选中图形信号
             if (oldSelectedIndex != selectedIndex)
@@ -489,28 +732,166 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
         }
     }
 
-    // 如果之前有选中的图形，现在取消了，发出信号
-    if (oldSelectedIndex != -1)
+    // 点在空白处开始框选；没有按住Shift/Ctrl时先取消原有的选择
+    if (!toggle)
     {
-        emit selectionCleared();
+        selectShape(-1);
+        emitSelectionChanged(oldSelectedIndex);
     }
+    beginMarquee(docPos, event->modifiers());
 
-    update();
+    viewport()->update();
 }
 
 void DrawingArea::mouseMoveEvent(QMouseEvent *event)
 {
-    // 转换屏幕坐标到文档坐标
-    QPoint docPos = screenToDoc(event->pos());
+    if (m_marquee.shape == MarqueeShape::None && (!dragging || selectedIndex == -1))
+        return;
+
+    // 只记录最新的鼠标位置，几何更新交给帧节拍统一处理
+    schedulePointerMove(screenToDoc(event->pos()));
+}
+
+void DrawingArea::schedulePointerMove(const QPoint &docPos)
+{
+    // 框选不修改场景，不需要切换到草稿质量
+    if (m_marquee.shape == MarqueeShape::None)
+        beginInteraction();
+    ++m_interactionStats.inputEvents;
+    if (m_hasPendingMove)
+    {
+        // 上一个位置还没来得及处理，直接被新位置覆盖
+        ++m_interactionStats.mergedEvents;
+    }
+    m_pendingMousePos = docPos;
+    m_hasPendingMove = true;
+
+    if (m_frameTimer->isActive())
+        return;
+
+    // 距离上一帧已经超过一个帧间隔则立即处理，否则等到下一个帧节拍
+    int interval = frameIntervalMs();
+    qint64 sinceLastFrame = m_lastFrameClock.isValid() ? m_lastFrameClock.elapsed() : interval;
+    if (sinceLastFrame >= interval)
+    {
+        flushPendingMove();
+    }
+    else
+    {
+        m_frameTimer->start(interval - static_cast<int>(sinceLastFrame));
+    }
+}
+
+void DrawingArea::flushPendingMove()
+{
+    m_frameTimer->stop();
+    if (!m_hasPendingMove)
+        return;
+
+    m_hasPendingMove = false;
+    m_lastFrameClock.restart();
+
+    QElapsedTimer frameCost;
+    frameCost.start();
+
+    if (m_marquee.shape != MarqueeShape::None)
+    {
+        updateMarquee(m_pendingMousePos);
+    }
+    else if (dragging && m_selection.size() > 1)
+    {
+        // 多选拖动由批量变换提交重绘区域，不需要逐个比较所有图形
+        processPointerMove(m_pendingMousePos);
+    }
+    else
+    {
+        // 单选时只有选中的图形和连接在它上面的箭头会变化，更新后只比较这些图形
+        std::vector<int> targets = transformTargets({selectedIndex});
+        std::vector<QRect> boundsBefore = snapshotPaintBounds(targets);
+        processPointerMove(m_pendingMousePos);
+        invalidateChangedShapes(targets, boundsBefore);
+    }
+    ++m_interactionStats.processedFrames;
+    m_interactionStats.lastFrameCostUs = frameCost.nsecsElapsed() / 1000;
+}
+
+std::vector<QRect> DrawingArea::snapshotPaintBounds(const std::vector<int> &indices) const
+{
+    const ShapeGeometryTable &geometry = geometryTable();
+    std::vector<QRect> bounds;
+    bounds.reserve(indices.size());
+    for (int i : indices)
+        bounds.push_back(geometry.bounds(i));
+    return bounds;
+}
+
+void DrawingArea::invalidateChangedShapes(const std::vector<int> &indices, const std::vector<QRect> &boundsBefore)
+{
+    std::vector<int> changed;
+    std::vector<QRect> regions;
+    for (size_t k = 0; k < indices.size() && k < boundsBefore.size(); ++k)
+    {
+        int i = indices[k];
+        if (i >= static_cast<int>(shapes.size()))
+            continue;
 
-    if (dragging && selectedIndex != -1)
+        // 旋转不一定改变绘制范围，正在操作的图形总是重绘
+        QRect boundsAfter = shapes[i]->paintBounds();
+        if (boundsAfter != boundsBefore[k] || i == selectedIndex)
+        {
+            m_snapshotDirty.push_back(i); // 下一次快照时重新复制
+            updateGeometry(i);
+            invalidateDocRect(boundsBefore[k]);
+            invalidateDocRect(boundsAfter);
+
+            changed.push_back(i);
+            if (shapes[i]->kind() != ShapeBase::Kind::Arrow && boundsAfter != boundsBefore[k])
+            {
+                regions.push_back(boundsBefore[k]);
+                regions.push_back(boundsAfter);
+            }
+        }
+    }
+    rerouteAffected(changed, regions);
+}
+
+void DrawingArea::cancelPendingMove()
+{
+    m_frameTimer->stop();
+    m_hasPendingMove = false;
+}
+
+int DrawingArea::frameIntervalMs() const
+{
+    // 优先使用窗口所在屏幕的刷新率，拿不到时按60Hz计算
+    QScreen *screen = nullptr;
+    if (window() && window()->windowHandle())
+        screen = window()->windowHandle()->screen();
+    if (!screen)
+        screen = QGuiApplication::primaryScreen();
+
+    qreal refreshRate = screen ? screen->refreshRate() : 60.0;
+    if (refreshRate < 1.0)
+        refreshRate = 60.0;
+    return qMax(1, qRound(1000.0 / refreshRate));
+}
+
+void DrawingArea::processPointerMove(const QPoint &docPos)
+{
+    if (dragging && selectedIndex != -1 && selectedIndex < static_cast<int>(shapes.size()))
     {
         if (shapes[selectedIndex]->isHandleSelected())
         {
             if (auto *arrow = dynamic_cast<ShapeArrow *>(shapes[selectedIndex].get()))
             {
                 int handleIndex = arrow->getSelectedHandleIndex();
-                if (handleIndex != -1) // 0表示起点，1表示终点
+                if (handleIndex >= ShapeArrow::kFirstControlHandle)
+                {
+                    // 拖动曲线的控制点，不吸附
+                    arrow->setControlPoint(handleIndex - ShapeArrow::kFirstControlHandle, docPos);
+                    viewport()->update();
+                }
+                else if (handleIndex != -1) // 0表示起点，1表示终点
                 {
                     QPoint mousePos = docPos; // 使用文档坐标
                     QPoint otherPos;
@@ -525,50 +906,19 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
                         otherPos = arrow->getLine().p1();
                     }
 
-                    const int snapDistance = 10 / m_zoomFactor; // 缩放调整吸附距离
-                    bool foundSnap = false;
+                    // 预览释放时会连接的位置：附近的锚点或鼠标下图形的轮廓
+                    ArrowConnection glue;
                     QPoint snapTarget;
-                    int snapShapeIndex = -1;
-                    int snapHandleIndex = -1;
-
-                    // 检查所有图形的锚点
-                    for (size_t i = 0; i < shapes.size(); ++i)
-                    {
-                        if (i == selectedIndex)
-                            continue;
-                        if (dynamic_cast<ShapeArrow *>(shapes[i].get()))
-                            continue;
-                        const auto &arrowAnchors = shapes[i]->getArrowAnchors();
-                        for (size_t j = 0; j < arrowAnchors.size(); ++j)
-                        {
-                            if (arrowAnchors[j].type != ShapeBase::Handle::ArrowAnchor)
-                                continue;
-                            QPoint target = arrowAnchors[j].rect.center();
-                            if (target == otherPos)
-                                continue;
-                            if ((mousePos - target).manhattanLength() <= snapDistance)
-                            {
-                                snapTarget = target;
-                                snapShapeIndex = i;
-                                snapHandleIndex = j;
-                                foundSnap = true;
-                                break;
-                            }
-                        }
-                        if (foundSnap)
-                            break;
-                    }
-
-                    if (foundSnap)
+                    if (findGlueTarget(selectedIndex, mousePos, otherPos, glue, snapTarget))
                     {
-                        // 锁定端点到找到的锚点
+                        // 锁定端点到找到的位置
                         if (handleIndex == 0)
                             arrow->setP1(snapTarget);
                         else
                             arrow->setP2(snapTarget);
 
-                        // 更新临时吸附信息
-                        snappedHandle = {snapShapeIndex, snapHandleIndex, snapTarget};
+                        // 更新临时吸附信息，粘附在轮廓上时没有锚点
+                        snappedHandle = {glue.shapeIndex, glue.handleIndex, snapTarget};
                     }
                     else
                     {
@@ -581,7 +931,7 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
                         // 清除吸附信息
                         snappedHandle = {-1, -1, QPoint()};
                     }
-                    update();
+                    viewport()->update();
                 }
             }
             else
@@ -604,24 +954,43 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
                     }
                 }
 
-                // 处理锚点交互（缩放或旋转）
-                shapes[selectedIndex]->handleAnchorInteraction(docPos, lastMousePos);
+                // 处理锚点交互（缩放或旋转）。缩放按总位移从原始矩形计算，
+                // 吸附网格时不会因为每次取整而漂移；旋转后的边不与网格平行，不吸附
+                if (resizing && !isRotating)
+                {
+                    ShapeBase *shape = shapes[selectedIndex].get();
+                    int step = shape->getRotation() == 0.0 ? gridSnapStep() : 0;
+                    shape->resizeFrom(originalRect, docPos - m_moveStartPos, step);
+                }
+                else
+                {
+                    shapes[selectedIndex]->handleAnchorInteraction(docPos, lastMousePos);
+                }
 
                 // 无论是缩放还是旋转，都需要更新连接的箭头
                 // 对于旋转，delta无意义，因为我们会在updateConnectedArrows中通过锚点直接更新
                 updateConnectedArrows(selectedIndex, delta);
 
                 lastMousePos = docPos; // 更新为当前文档坐标
-                update();
+                viewport()->update();
             }
         }
         else
         {
-            // 图形整体拖动
-            QPoint delta = docPos - lastMousePos; // 使用文档坐标计算偏移
+            // 图形整体拖动，按住Alt时不吸附；单独的箭头不能整体移动，也不吸附
+            bool movable = m_selection.size() > 1 || !dynamic_cast<ShapeArrow *>(shapes[selectedIndex].get());
+            bool snap = movable && !(QGuiApplication::keyboardModifiers() & Qt::AltModifier);
+            QPoint delta = dragDelta(docPos, snap);
 
+            if (m_selection.size() > 1)
+            {
+                // 多选时一起平移所有选中的图形，由批量变换统一更新箭头和重绘范围
+                ShapeTransform move;
+                move.translation = delta;
+                applyTransform(m_selection, move);
+            }
             // 检查当前选中的是否是箭头
-            if (!dynamic_cast<ShapeArrow *>(shapes[selectedIndex].get()))
+            else if (!dynamic_cast<ShapeArrow *>(shapes[selectedIndex].get()))
             {
                 // 如果不是箭头，直接移动并更新连接
                 shapes[selectedIndex]->moveBy(delta);
@@ -633,156 +1002,55 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
             }
 
             lastMousePos = docPos; // 无论是否移动都更新鼠标位置
-            update();
+            viewport()->update();
         }
     }
 }
 
 void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
 {
+    // 先把尚未处理的鼠标位置应用上，保证释放时的几何状态是最新的
+    flushPendingMove();
+
+    if (m_marquee.shape != MarqueeShape::None)
+    {
+        finishMarquee();
+        return;
+    }
+
+    // 释放时可能吸附箭头端点，只重绘发生变化的图形
+    std::vector<int> targets = transformTargets({selectedIndex});
+    std::vector<QRect> boundsBefore = snapshotPaintBounds(targets);
+
     // 转换屏幕坐标到文档坐标
     QPoint docPos = screenToDoc(event->pos());
 
     if (selectedIndex != -1)
     {
-        if (auto *arrow = dynamic_cast<ShapeArrow *>(shapes[selectedIndex].get()))
+        if (m_selection.size() > 1)
         {
-            // 处理箭头终点的连接情况
-            if (arrow->getSelectedHandleIndex() == 1) // 如果是终点被选中
+            if (dragging && m_dragOffset.manhattanLength() > 0)
             {
-                // 查找是否有目标图形的箭头锚点可以连接
-                int bestShapeIndex = -1;
-                int bestHandleIndex = -1;
-                QPoint bestPoint;
-                const int snapDistance = 10 / m_zoomFactor; // 缩放调整吸附距离
-
-                // 检查所有图形的锚点
-                for (size_t i = 0; i < shapes.size(); ++i)
-                {
-                    if (i == selectedIndex)
-                        continue;
-                    if (dynamic_cast<ShapeArrow *>(shapes[i].get()))
-                        continue;
-
-                    const auto &arrowAnchors = shapes[i]->getArrowAnchors();
-                    for (size_t j = 0; j < arrowAnchors.size(); ++j)
-                    {
-                        if (arrowAnchors[j].type != ShapeBase::Handle::ArrowAnchor)
-                            continue;
-
-                        QPoint target = arrowAnchors[j].rect.center();
-                        // 排除已经连接到的起点
-                        QPoint startPoint = arrow->getLine().p1();
-                        if (target == startPoint)
-                            continue;
-
-                        if ((docPos - target).manhattanLength() <= snapDistance)
-                        {
-                            bestShapeIndex = i;
-                            bestHandleIndex = j;
-                            bestPoint = target;
-                            break;
-                        }
-                    }
-                    if (bestShapeIndex != -1)
-                        break;
-                }
-
-                // 找到可连接的目标
-                // 找到可连接的目标
-                if (bestShapeIndex != -1)
-                {
-                    // 设置箭头终点位置
-                    arrow->setP2(bestPoint);
-
-                    // 清除终点的已有连接
-                    arrowConnections.erase(
-                        std::remove_if(arrowConnections.begin(), arrowConnections.end(),
-                                       [this](const ArrowConnection &conn)
-                                       {
-                                           return conn.arrowIndex == selectedIndex && !conn.isStartPoint;
-                                       }),
-                        arrowConnections.end());
-
-                    // 添加新的终点连接
-                    ArrowConnection connection;
-                    connection.arrowIndex = selectedIndex;
-                    connection.shapeIndex = bestShapeIndex;
-                    connection.handleIndex = bestHandleIndex;
-                    connection.isStartPoint = false;
-                    arrowConnections.push_back(connection);
-
-                    // 确保连接点正确
-                    updateConnectedArrows(bestShapeIndex, QPoint());
-                }
+                // 整个选择的移动记录为一步
+                std::vector<int> targets;
+                for (const auto &state : m_dragGeometry)
+                    targets.push_back(state.index);
+                recordTransform(std::move(m_dragGeometry), captureGeometry(targets));
             }
-            else if (arrow->getSelectedHandleIndex() == 0) // 如果是起点被选中
+            else if (dragging)
             {
-                // 查找是否有目标图形的箭头锚点可以连接
-                int bestShapeIndex = -1;
-                int bestHandleIndex = -1;
-                QPoint bestPoint;
-                const int snapDistance = 10 / m_zoomFactor; // 缩放调整吸附距离
-
-                // 检查所有图形的锚点
-                for (size_t i = 0; i < shapes.size(); ++i)
-                {
-                    if (i == selectedIndex)
-                        continue;
-                    if (dynamic_cast<ShapeArrow *>(shapes[i].get()))
-                        continue;
-
-                    const auto &arrowAnchors = shapes[i]->getArrowAnchors();
-                    for (size_t j = 0; j < arrowAnchors.size(); ++j)
-                    {
-                        if (arrowAnchors[j].type != ShapeBase::Handle::ArrowAnchor)
-                            continue;
-
-                        QPoint target = arrowAnchors[j].rect.center();
-                        // 排除已经连接到的终点
-                        QPoint endPoint = arrow->getLine().p2();
-                        if (target == endPoint)
-                            continue;
-
-                        if ((docPos - target).manhattanLength() <= snapDistance)
-                        {
-                            bestShapeIndex = i;
-                            bestHandleIndex = j;
-                            bestPoint = target;
-                            break;
-                        }
-                    }
-                    if (bestShapeIndex != -1)
-                        break;
-                }
-
-                // 找到可连接的目标
-                if (bestShapeIndex != -1)
-                {
-                    // 设置箭头起点位置
-                    arrow->setP1(bestPoint);
-
-                    // 清除起点的已有连接
-                    arrowConnections.erase(
-                        std::remove_if(arrowConnections.begin(), arrowConnections.end(),
-                                       [this](const ArrowConnection &conn)
-                                       {
-                                           return conn.arrowIndex == selectedIndex && conn.isStartPoint;
-                                       }),
-                        arrowConnections.end());
-
-                    // 添加新的起点连接
-                    ArrowConnection connection;
-                    connection.arrowIndex = selectedIndex;
-                    connection.shapeIndex = bestShapeIndex;
-                    connection.handleIndex = bestHandleIndex;
-                    connection.isStartPoint = true;
-                    arrowConnections.push_back(connection);
-
-                    // 确保连接点正确
-                    updateConnectedArrows(bestShapeIndex, QPoint());
-                }
+                // 在选择中单击而没有拖动时只保留这一个图形
+                selectShape(selectedIndex);
             }
+            m_dragGeometry.clear();
+            emit shapeSelected(shapes[selectedIndex].get());
+        }
+        else if (auto *arrow = dynamic_cast<ShapeArrow *>(shapes[selectedIndex].get()))
+        {
+            // 处理箭头端点的连接情况：0表示起点，1表示终点
+            int handleIndex = arrow->getSelectedHandleIndex();
+            if (handleIndex == 0 || handleIndex == 1)
+                glueArrowEnd(selectedIndex, handleIndex == 0, docPos);
 
             // 清除箭头的选中状态
             arrow->clearHandleSelection();
@@ -798,14 +1066,11 @@ void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
             // 如果拖拽结束，且是移动操作（非调整大小）
             if (dragging && !shapes[selectedIndex]->isHandleSelected())
             {
-                // 计算从按下鼠标时到释放的总移动距离
-                QPoint totalDelta = docPos - m_moveStartPos;
-
-                // 只有当真实移动了一定距离时才记录移动操作
-                if (totalDelta.manhattanLength() > 0)
+                // 只有当真实移动了一定距离时才记录移动操作（总移动距离包含对齐吸附的偏移）
+                if (m_dragOffset.manhattanLength() > 0)
                 {
                     // 记录移动操作
-                    recordMoveShape(selectedIndex, totalDelta);
+                    recordMoveShape(selectedIndex, m_dragOffset);
                 }
             }
             // 如果是调整大小操作结束
@@ -828,55 +1093,383 @@ void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
     }
     snappedHandle = {-1, -1, QPoint()};
     dragging = false;
-    update();
+    m_dragOffset = QPoint();
+    m_alignmentReady = false;
+    m_alignment.clear();
+    setGuideLines({});
+    invalidateChangedShapes(targets, boundsBefore);
+    if (m_infiniteCanvas)
+        updateScrollBars(); // 图形可能被拖到了原来的范围之外
+    viewport()->update();
 }
 
-void DrawingArea::mouseDoubleClickEvent(QMouseEvent *event)
+int DrawingArea::gridSnapStep() const
 {
-    // 转换屏幕坐标到文档坐标
-    QPoint docPos = screenToDoc(event->pos());
-
-    // 查找点击的图形
-    for (int i = shapes.size() - 1; i >= 0; --i)
-    {
-        // 直接在文档坐标系中检查
-        if (shapes[i]->contains(docPos))
-        {
-            // 检查图形是否支持文本编辑
-            if (shapes[i]->isTextEditable())
-            {
-                startTextEditing(i);
-                return;
-            }
-        }
-    }
+    Qt::KeyboardModifiers modifiers = QGuiApplication::keyboardModifiers();
+    if (!m_snapToGrid || (modifiers & Qt::AltModifier))
+        return 0;
+    if (modifiers & Qt::ShiftModifier)
+        return qMax(1, m_gridSize / kSubGridDivisions);
+    return m_gridSize;
 }
 
-void DrawingArea::startTextEditing(int shapeIndex)
+QPoint DrawingArea::dragDelta(const QPoint &docPos, bool snap)
 {
-    // 如果已经在编辑其他图形，先完成编辑
-    if (m_textEdit)
+    QPoint total = docPos - m_moveStartPos;
+    int step = snap ? gridSnapStep() : 0;
+    if (step > 0)
     {
-        finishTextEditing();
+        // 每次都从拖动开始时的位置计算，选择的左上角落在网格上
+        QPoint origin = m_dragBounds.topLeft();
+        QPoint target = origin + total;
+        total = QPoint(ShapeBase::snapToStep(target.x(), step), ShapeBase::snapToStep(target.y(), step)) - origin;
+        setGuideLines({});
     }
-
-    // 根据图形类型创建不同的文本编辑控件
-    if (dynamic_cast<ShapeEllipse *>(shapes[shapeIndex].get()))
+    else if (snap)
     {
-        m_textEdit = new EllipseTextEdit(this);
+        // 索引只在第一次需要时建立，单击不拖动时不必付出排序的代价
+        if (!m_alignmentReady)
+        {
+            m_alignment.rebuild(shapes, transformTargets(m_selection));
+            m_alignmentReady = true;
+        }
+        // 吸附距离在屏幕上保持不变，缩小视图时文档中的容差相应变大
+        int tolerance = qMax(1, qRound(AlignmentGuides::kSnapPixels / m_zoomFactor));
+        AlignmentGuides::Result result = m_alignment.snap(m_dragBounds.translated(total), tolerance);
+        total += result.offset;
+        setGuideLines(std::move(result.lines));
     }
     else
     {
-        m_textEdit = new QLineEdit(this);
+        setGuideLines({});
     }
 
-    // 设置文本编辑控件的基本属性，考虑缩放因子
-    QRect docRect = shapes[shapeIndex]->boundingRect().adjusted(5, 5, -5, -5);
-    QRect screenRect = docToScreen(docRect);
-    m_textEdit->setGeometry(screenRect);
-    if (auto *lineEdit = qobject_cast<QLineEdit *>(m_textEdit))
-    {
-        lineEdit->setText(shapes[shapeIndex]->getText());
+    QPoint delta = total - m_dragOffset;
+    m_dragOffset = total;
+    return delta;
+}
+
+void DrawingArea::setGuideLines(std::vector<QLine> lines)
+{
+    if (lines == m_guideLines)
+        return;
+
+    // 只重绘新旧参考线经过的区域
+    auto invalidateLines = [this](const std::vector<QLine> &guides)
+    {
+        for (const QLine &line : guides)
+            viewport()->update(docToScreen(QRect(line.p1(), line.p2()).normalized()).adjusted(-2, -2, 2, 2));
+    };
+    invalidateLines(m_guideLines);
+    invalidateLines(lines);
+    m_guideLines = std::move(lines);
+}
+
+bool DrawingArea::isSelected(int index) const
+{
+    return std::binary_search(m_selection.begin(), m_selection.end(), index);
+}
+
+void DrawingArea::selectShape(int index)
+{
+    m_selection.clear();
+    if (index >= 0)
+        m_selection.push_back(index);
+    selectedIndex = index;
+}
+
+void DrawingArea::toggleSelection(int index)
+{
+    auto it = std::lower_bound(m_selection.begin(), m_selection.end(), index);
+    if (it != m_selection.end() && *it == index)
+    {
+        m_selection.erase(it);
+        if (selectedIndex == index)
+            selectedIndex = m_selection.empty() ? -1 : m_selection.back();
+    }
+    else
+    {
+        m_selection.insert(it, index);
+        selectedIndex = index;
+    }
+}
+
+void DrawingArea::selectionInserted(int index)
+{
+    for (auto it = std::lower_bound(m_selection.begin(), m_selection.end(), index); it != m_selection.end(); ++it)
+        ++*it;
+    if (selectedIndex >= index)
+        selectedIndex++;
+}
+
+void DrawingArea::selectionRemoved(int index)
+{
+    auto it = std::lower_bound(m_selection.begin(), m_selection.end(), index);
+    if (it != m_selection.end() && *it == index)
+        it = m_selection.erase(it);
+    for (; it != m_selection.end(); ++it)
+        --*it;
+
+    if (selectedIndex == index)
+    {
+        // 主选图形被删除时改由选择中的其余图形接替
+        selectedIndex = m_selection.empty() ? -1 : m_selection.back();
+        if (selectedIndex == -1)
+            emit selectionCleared();
+        else
+            emit shapeSelected(shapes[selectedIndex].get());
+    }
+    else if (selectedIndex > index)
+    {
+        selectedIndex--;
+    }
+}
+
+void DrawingArea::emitSelectionChanged(int oldIndex)
+{
+    if (selectedIndex == oldIndex)
+        return;
+    if (selectedIndex == -1)
+        emit selectionCleared();
+    else
+        emit shapeSelected(shapes[selectedIndex].get());
+}
+
+void DrawingArea::selectAll()
+{
+    if (shapes.empty())
+        return;
+
+    int oldSelectedIndex = selectedIndex;
+    m_selection.resize(shapes.size());
+    for (size_t i = 0; i < m_selection.size(); ++i)
+        m_selection[i] = static_cast<int>(i);
+    if (selectedIndex == -1)
+        selectedIndex = m_selection.back();
+    emitSelectionChanged(oldSelectedIndex);
+    viewport()->update();
+}
+
+void DrawingArea::clearSelection()
+{
+    int oldSelectedIndex = selectedIndex;
+    selectShape(-1);
+    emitSelectionChanged(oldSelectedIndex);
+    viewport()->update();
+}
+
+void DrawingArea::beginMarquee(const QPoint &docPos, Qt::KeyboardModifiers modifiers)
+{
+    m_marquee = Marquee();
+    m_marquee.shape = (modifiers & Qt::AltModifier) ? MarqueeShape::Lasso : MarqueeShape::Rect;
+    m_marquee.origin = docPos;
+    m_marquee.additive = modifiers & (Qt::ShiftModifier | Qt::ControlModifier);
+    if (m_marquee.shape == MarqueeShape::Lasso)
+        m_marquee.lasso << docPos;
+}
+
+void DrawingArea::updateMarquee(const QPoint &docPos)
+{
+    if (m_marquee.shape == MarqueeShape::Rect)
+    {
+        // 只重绘新旧矩形的边框，以及半透明填充覆盖范围发生变化的部分
+        QRect oldRect = m_marquee.rect;
+        m_marquee.rect = QRect(m_marquee.origin, docPos).normalized();
+        if (m_marquee.rect == oldRect)
+            return;
+
+        QRegion dirty = marqueeEdgeRegion(oldRect);
+        dirty += marqueeEdgeRegion(m_marquee.rect);
+        QRegion oldFill = oldRect.isNull() ? QRegion() : QRegion(docToScreen(oldRect));
+        dirty += oldFill.xored(QRegion(docToScreen(m_marquee.rect)));
+        viewport()->update(dirty);
+    }
+    else
+    {
+        // 套索只画成折线，只需要重绘新增的一段
+        QPoint last = m_marquee.lasso.last();
+        if (last == docPos)
+            return;
+        m_marquee.lasso << docPos;
+        viewport()->update(docToScreen(QRect(last, docPos).normalized()).adjusted(-3, -3, 3, 3));
+    }
+
+    std::vector<int> hits = m_marquee.shape == MarqueeShape::Rect
+                                ? shapesInRect(m_marquee.rect, marqueeMode())
+                                : shapesInArea(m_marquee.lasso, marqueeMode());
+    invalidatePreview(m_marquee.hits, hits);
+    m_marquee.hits.swap(hits);
+}
+
+void DrawingArea::finishMarquee()
+{
+    // 框选的矩形和预览都会随整个视口重绘一起擦掉
+    // 组中的图形按整个组选择，要求完全包含时整个组都在范围内才选中
+    std::vector<int> hits = expandToGroups(m_marquee.hits, marqueeMode() == SelectionMode::Contained);
+    bool additive = m_marquee.additive;
+    m_marquee = Marquee();
+
+    int oldSelectedIndex = selectedIndex;
+    if (additive)
+    {
+        std::vector<int> selection;
+        std::set_union(m_selection.begin(), m_selection.end(), hits.begin(), hits.end(),
+                       std::back_inserter(selection));
+        m_selection.swap(selection);
+    }
+    else
+    {
+        m_selection.swap(hits);
+    }
+    if (selectedIndex == -1 || !isSelected(selectedIndex))
+        selectedIndex = m_selection.empty() ? -1 : m_selection.back();
+
+    emitSelectionChanged(oldSelectedIndex);
+    viewport()->update();
+}
+
+DrawingArea::SelectionMode DrawingArea::marqueeMode() const
+{
+    // 套索要求完全包含；矩形从左向右拖动要求完全包含，从右向左拖动只需相交
+    if (m_marquee.shape == MarqueeShape::Rect && m_marquee.rect.left() < m_marquee.origin.x())
+        return SelectionMode::Intersecting;
+    return SelectionMode::Contained;
+}
+
+QRegion DrawingArea::marqueeEdgeRegion(const QRect &docRect) const
+{
+    if (docRect.isNull())
+        return QRegion();
+
+    QRect screenRect = docToScreen(docRect);
+    QRegion edge(screenRect.adjusted(-3, -3, 3, 3));
+    return edge.subtracted(QRegion(screenRect.adjusted(3, 3, -3, -3)));
+}
+
+void DrawingArea::invalidatePreview(const std::vector<int> &before, const std::vector<int> &after)
+{
+    // 只重绘预览状态发生变化的图形的虚线框
+    std::vector<int> changed;
+    std::set_symmetric_difference(before.begin(), before.end(), after.begin(), after.end(),
+                                  std::back_inserter(changed));
+    const ShapeGeometryTable &geometry = geometryTable();
+    for (int i : changed)
+    {
+        if (i < geometry.size())
+            viewport()->update(docToScreen(geometry.bounds(i)).adjusted(-2, -2, 2, 2));
+    }
+}
+
+std::vector<int> DrawingArea::shapesInRect(const QRect &rect, SelectionMode mode) const
+{
+    std::vector<int> result;
+    if (rect.isEmpty())
+        return result;
+
+    const ShapeGeometryTable &geometry = geometryTable();
+    std::vector<int> candidates;
+    std::vector<int> inside;
+    groupTree().intersecting(rect, geometry, candidates);
+    geometry.contained(rect, inside);
+
+    // 绘制范围完全在矩形内的图形两种方式都满足，其余相交的图形再按轮廓精确判断
+    QPainterPath area;
+    area.addRect(rect);
+    auto insideIt = inside.begin();
+    for (int i : candidates)
+    {
+        if (insideIt != inside.end() && *insideIt == i)
+        {
+            ++insideIt;
+            result.push_back(i);
+        }
+        else if (shapeInArea(i, area, mode))
+        {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+std::vector<int> DrawingArea::shapesInArea(const QPolygon &area, SelectionMode mode) const
+{
+    std::vector<int> result;
+    if (area.size() < 3)
+        return result;
+
+    std::vector<int> candidates;
+    groupTree().intersecting(area.boundingRect(), geometryTable(), candidates);
+
+    QPainterPath path;
+    path.addPolygon(QPolygonF(area));
+    path.closeSubpath();
+    for (int i : candidates)
+    {
+        if (shapeInArea(i, path, mode))
+            result.push_back(i);
+    }
+    return result;
+}
+
+bool DrawingArea::shapeInArea(int index, const QPainterPath &area, SelectionMode mode) const
+{
+    QPolygonF outline = shapes[index]->sceneOutline();
+    if (outline.isEmpty())
+        return false;
+
+    QPainterPath path;
+    path.addPolygon(outline);
+    return mode == SelectionMode::Contained ? area.contains(path) : area.intersects(path);
+}
+
+void DrawingArea::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    // 转换屏幕坐标到文档坐标
+    QPoint docPos = screenToDoc(event->pos());
+
+    // 查找点击的图形（先在几何副表中筛选）
+    std::vector<ShapeGeometryTable::HitCandidate> candidates;
+    groupTree().hitCandidates(docPos, geometryTable(), candidates);
+    for (auto it = candidates.rbegin(); it != candidates.rend(); ++it)
+    {
+        int i = it->index;
+        if (it->exact || shapes[i]->contains(docPos))
+        {
+            // 检查图形是否支持文本编辑
+            if (shapes[i]->isTextEditable())
+            {
+                startTextEditing(i);
+                return;
+            }
+        }
+    }
+}
+
+void DrawingArea::startTextEditing(int shapeIndex)
+{
+    // 如果已经在编辑其他图形，先完成编辑
+    if (m_textEdit)
+    {
+        finishTextEditing();
+    }
+
+    // 根据图形类型创建不同的文本编辑控件
+    if (dynamic_cast<ShapeEllipse *>(shapes[shapeIndex].get()))
+    {
+        m_textEdit = new EllipseTextEdit(viewport());
+    }
+    else
+    {
+        m_textEdit = new QLineEdit(viewport());
+    }
+
+    // 设置文本编辑控件的基本属性，考虑缩放因子
+    QRect docRect = shapes[shapeIndex]->boundingRect().adjusted(5, 5, -5, -5);
+    QRect screenRect = docToScreen(docRect);
+    m_textEdit->setGeometry(screenRect);
+    if (auto *lineEdit = qobject_cast<QLineEdit *>(m_textEdit))
+    {
+        lineEdit->setText(shapes[shapeIndex]->getText());
         lineEdit->setAlignment(Qt::AlignCenter);
         lineEdit->show();
         lineEdit->setFocus();
@@ -888,7 +1481,7 @@ void DrawingArea::startTextEditing(int shapeIndex)
 
     // 设置图形为编辑状态
     shapes[shapeIndex]->setEditing(true);
-    selectedIndex = shapeIndex;
+    selectShape(shapeIndex);
 }
 
 void DrawingArea::finishTextEditing()
@@ -910,7 +1503,7 @@ void DrawingArea::finishTextEditing()
     m_textEdit = nullptr;
 
     // 更新显示
-    update();
+    invalidateScene();
 }
 
 void DrawingArea::keyPressEvent(QKeyEvent *event)
@@ -918,7 +1511,7 @@ void DrawingArea::keyPressEvent(QKeyEvent *event)
     if (m_textEdit && m_textEdit->hasFocus())
     {
         // 如果正在编辑文本，让文本编辑控件处理键盘事件
-        QWidget::keyPressEvent(event);
+        QAbstractScrollArea::keyPressEvent(event);
         return;
     }
 
@@ -939,31 +1532,57 @@ void DrawingArea::keyPressEvent(QKeyEvent *event)
         }
     }
 
-    if (selectedIndex != -1 &&
+    if ((event->modifiers() & Qt::ControlModifier) && event->key() == Qt::Key_A)
+    {
+        selectAll();
+        event->accept();
+        return;
+    }
+
+    // 方向键微调选中的图形，按住Shift时每次移动一个网格
+    if (!m_selection.empty() && !dragging &&
+        (event->key() == Qt::Key_Left || event->key() == Qt::Key_Right ||
+         event->key() == Qt::Key_Up || event->key() == Qt::Key_Down))
+    {
+        stopForceLayout();
+        int step = (event->modifiers() & Qt::ShiftModifier) ? m_gridSize : 1;
+        ShapeTransform nudge;
+        if (event->key() == Qt::Key_Left)
+            nudge.translation = QPointF(-step, 0);
+        else if (event->key() == Qt::Key_Right)
+            nudge.translation = QPointF(step, 0);
+        else if (event->key() == Qt::Key_Up)
+            nudge.translation = QPointF(0, -step);
+        else
+            nudge.translation = QPointF(0, step);
+        transformSelection(nudge);
+        event->accept();
+        return;
+    }
+
+    if (!m_selection.empty() &&
         (event->key() == Qt::Key_Delete || event->key() == Qt::Key_Backspace))
     {
-        // 记录删除操作到历史
-        recordRemoveShape(selectedIndex);
-
-        // 删除相关的箭头连接
-        arrowConnections.erase(
-            std::remove_if(arrowConnections.begin(), arrowConnections.end(),
-                           [this](const ArrowConnection &conn)
-                           {
-                               return conn.shapeIndex == selectedIndex ||
-                                      conn.arrowIndex == selectedIndex;
-                           }),
-            arrowConnections.end());
-
-        shapes.erase(shapes.begin() + selectedIndex);
-        selectedIndex = -1;
-        emit selectionCleared();
-        update();
+        deleteSelectedShape();
+        event->accept();
+        return;
+    }
+
+    if (event->key() == Qt::Key_Escape && isForceLayoutRunning())
+    {
+        stopForceLayout();
+        event->accept();
+        return;
+    }
+
+    if (event->key() == Qt::Key_Escape && isLayoutRunning())
+    {
+        cancelLayout();
         event->accept();
         return;
     }
 
-    QWidget::keyPressEvent(event);
+    QAbstractScrollArea::keyPressEvent(event);
 }
 
 void DrawingArea::dragEnterEvent(QDragEnterEvent *event)
@@ -981,40 +1600,9 @@ void DrawingArea::dropEvent(QDropEvent *event)
         QByteArray shapeTypeData =
             event->mimeData()->data("application/x-shape-type");
         QString shapeType = QString::fromUtf8(shapeTypeData);
-        QPoint pos = event->pos();
-        std::unique_ptr<ShapeBase> shape;
-        QRect defaultRect(pos.x() - 40, pos.y() - 30, 80, 60);
-
-        // 暂时只处理矩形和椭圆
-        if (shapeType == "rect")
-        {
-            shape = ShapeFactory::createRect(defaultRect);
-        }
-        else if (shapeType == "ellipse")
-        {
-            shape = ShapeFactory::createEllipse(defaultRect);
-        }
-        else if (shapeType == "pentagon")
-        {
-            shape = ShapeFactory::createPentagon(defaultRect);
-        }
-        else if (shapeType == "triangle")
-        {
-            shape = ShapeFactory::createTriangle(defaultRect);
-        }
-        else if (shapeType == "diamond")
-        {
-            shape = ShapeFactory::createDiamond(defaultRect);
-        }
-        else if (shapeType == "arrow")
-        {
-            QLine line(pos.x() - 40, pos.y(), pos.x() + 40, pos.y());
-            shape = ShapeFactory::createArrow(line);
-        }
-        else if (shapeType == "roundedrect")
-        {
-            shape = ShapeFactory::createRoundedRect(defaultRect);
-        }
+        QPoint pos = screenToDoc(event->pos());
+        ShapeAllocator::Scope arena(m_arena);
+        std::unique_ptr<ShapeBase> shape = ShapeRegistry::instance().createDefault(shapeType, pos);
 
         if (shape)
         {
@@ -1023,144 +1611,231 @@ void DrawingArea::dropEvent(QDropEvent *event)
 
             // 添加到图形列表
             shapes.push_back(std::move(shape));
-            selectedIndex = shapes.size() - 1;
+            selectShape(static_cast<int>(shapes.size()) - 1);
 
             // 记录添加图形到历史
             recordAddShape(selectedIndex);
 
-            update();
+            // 新图形可能挡住已有的连接线
+            rerouteAffected(std::vector<int>(1, selectedIndex), {shapes[selectedIndex]->paintBounds()});
+            invalidateScene();
         }
         event->acceptProposedAction();
     }
 }
 
-void DrawingArea::updateConnectedArrows(int shapeIndex, const QPoint &delta)
+const std::vector<int> &DrawingArea::connectionsOf(int index) const
 {
-    if (shapeIndex < 0 || shapeIndex >= shapes.size())
-        return;
+    if (m_connectionIndexDirty || m_connectionIndex.size() != shapes.size())
+    {
+        // 每个连接同时记在图形和箭头下面
+        m_connectionIndex.assign(shapes.size(), std::vector<int>());
+        const int count = static_cast<int>(shapes.size());
+        for (size_t k = 0; k < arrowConnections.size(); ++k)
+        {
+            const auto &conn = arrowConnections[k];
+            if (conn.shapeIndex >= 0 && conn.shapeIndex < count)
+                m_connectionIndex[conn.shapeIndex].push_back(static_cast<int>(k));
+            if (conn.arrowIndex >= 0 && conn.arrowIndex < count && conn.arrowIndex != conn.shapeIndex)
+                m_connectionIndex[conn.arrowIndex].push_back(static_cast<int>(k));
+        }
+        m_connectionIndexDirty = false;
+    }
+
+    static const std::vector<int> none;
+    if (index < 0 || index >= static_cast<int>(m_connectionIndex.size()))
+        return none;
+    return m_connectionIndex[index];
+}
+
+bool DrawingArea::connectionPoint(const ArrowConnection &conn, QPoint &pos) const
+{
+    if (conn.shapeIndex < 0 || conn.shapeIndex >= static_cast<int>(shapes.size()))
+        return false;
+
+    const ShapeBase &shape = *shapes[conn.shapeIndex];
+    if (conn.perimeter >= 0.0)
+    {
+        pos = shape.outlinePoint(conn.perimeter);
+        return true;
+    }
+
+    const auto &anchors = shape.getArrowAnchors();
+    if (conn.handleIndex < 0 || conn.handleIndex >= static_cast<int>(anchors.size()))
+        return false;
+    pos = anchors[conn.handleIndex].rect.center();
+    return true;
+}
 
-    // 获取当前图形的所有箭头锚点的最新位置
-    const auto &arrowAnchors = shapes[shapeIndex]->getArrowAnchors();
+bool DrawingArea::findGlueTarget(int arrowIndex, const QPoint &docPos, const QPoint &otherEnd,
+                                 ArrowConnection &conn, QPoint &pos) const
+{
+    const int snapDistance = 10 / m_zoomFactor; // 缩放调整吸附距离
+    std::vector<int> candidates = shapesNear(docPos, snapDistance);
 
-    // 遍历所有箭头连接
-    for (auto it = arrowConnections.begin(); it != arrowConnections.end(); ++it)
+    // 附近有固定锚点时优先吸附到锚点
+    for (int i : candidates)
     {
-        const auto &conn = *it;
-        // 如果连接的是当前移动的图形
-        if (conn.shapeIndex == shapeIndex)
+        if (i == arrowIndex || geometryTable().kind(i) == ShapeBase::Kind::Arrow)
+            continue;
+
+        const auto &arrowAnchors = shapes[i]->getArrowAnchors();
+        for (size_t j = 0; j < arrowAnchors.size(); ++j)
         {
-            // 找到对应的箭头
-            if (conn.arrowIndex >= 0 && conn.arrowIndex < shapes.size())
+            if (arrowAnchors[j].type != ShapeBase::Handle::ArrowAnchor)
+                continue;
+            QPoint target = arrowAnchors[j].rect.center();
+            // 排除另一端已经连接的锚点
+            if (target == otherEnd)
+                continue;
+            if ((docPos - target).manhattanLength() <= snapDistance)
             {
-                // 检查是否是箭头类型
-                auto *arrow = dynamic_cast<ShapeArrow *>(shapes[conn.arrowIndex].get());
-                if (arrow)
-                {
-                    // 更新箭头连接点位置
-                    if (conn.handleIndex >= 0 && conn.handleIndex < arrowAnchors.size())
-                    {
-                        // 使用图形上的锚点的实时位置，而不仅仅是添加delta
-                        QPoint anchorPos = arrowAnchors[conn.handleIndex].rect.center();
-                        if (conn.isStartPoint)
-                        {
-                            arrow->setP1(anchorPos);
-                        }
-                        else
-                        {
-                            arrow->setP2(anchorPos);
-                        }
-                    }
-                    else
-                    {
-                        // 如果找不到锚点，就使用delta进行相对移动
-                        arrow->updateConnection(conn.isStartPoint, delta);
-                    }
-                }
+                conn.shapeIndex = i;
+                conn.handleIndex = static_cast<int>(j);
+                conn.perimeter = -1.0;
+                pos = target;
+                return true;
             }
         }
-        // 处理该图形就是箭头自身的情况
-        if (conn.arrowIndex == shapeIndex)
+    }
+
+    // 否则粘附到鼠标下（或轮廓就在附近）最上层图形的轮廓上
+    for (auto it = candidates.rbegin(); it != candidates.rend(); ++it)
+    {
+        int i = *it;
+        if (i == arrowIndex || geometryTable().kind(i) == ShapeBase::Kind::Arrow)
+            continue;
+
+        const ShapeBase &shape = *shapes[i];
+        double parameter = shape.outlineParameter(docPos);
+        QPoint target = shape.outlinePoint(parameter);
+        if (target == otherEnd)
+            continue;
+        if (shape.contains(docPos) || (docPos - target).manhattanLength() <= snapDistance)
         {
-            continue; // 箭头自身移动不需要处理
+            conn.shapeIndex = i;
+            conn.handleIndex = -1;
+            conn.perimeter = parameter;
+            pos = target;
+            return true;
         }
     }
+    return false;
+}
+
+void DrawingArea::glueArrowEnd(int arrowIndex, bool isStartPoint, const QPoint &docPos)
+{
+    auto *arrow = dynamic_cast<ShapeArrow *>(shapes[arrowIndex].get());
+    if (!arrow)
+        return;
+
+    // 清除这一端的已有连接
+    arrowConnections.erase(
+        std::remove_if(arrowConnections.begin(), arrowConnections.end(),
+                       [arrowIndex, isStartPoint](const ArrowConnection &conn)
+                       {
+                           return conn.arrowIndex == arrowIndex && conn.isStartPoint == isStartPoint;
+                       }),
+        arrowConnections.end());
+    invalidateConnectionIndex();
+
+    QPoint otherEnd = isStartPoint ? arrow->getLine().p2() : arrow->getLine().p1();
+    ArrowConnection connection;
+    QPoint pos;
+    if (!findGlueTarget(arrowIndex, docPos, otherEnd, connection, pos))
+        return;
+
+    // 添加新的连接并把端点放到连接位置
+    connection.arrowIndex = arrowIndex;
+    connection.isStartPoint = isStartPoint;
+    arrowConnections.push_back(connection);
+    invalidateConnectionIndex();
+    if (isStartPoint)
+        arrow->setP1(pos);
+    else
+        arrow->setP2(pos);
+}
+
+void DrawingArea::updateConnectedArrows(int shapeIndex, const QPoint &delta)
+{
+    if (shapeIndex < 0 || shapeIndex >= shapes.size())
+        return;
 
-    // 第二遍检查：查找未记录的连接
-    for (size_t i = 0; i < shapes.size(); ++i)
+    // 只遍历与该图形相关的连接，代价与连接的箭头数成正比
+    for (int k : connectionsOf(shapeIndex))
     {
-        auto *arrow = dynamic_cast<ShapeArrow *>(shapes[i].get());
-        if (!arrow || i == shapeIndex)
+        const auto &conn = arrowConnections[k];
+        // 该图形就是箭头自身时不需要处理
+        if (conn.shapeIndex != shapeIndex)
+            continue;
+        if (conn.arrowIndex < 0 || conn.arrowIndex >= shapes.size())
+            continue;
+        auto *arrow = dynamic_cast<ShapeArrow *>(shapes[conn.arrowIndex].get());
+        if (!arrow)
             continue;
 
-        // 获取箭头的端点
-        QPoint p1 = arrow->getLine().p1();
-        QPoint p2 = arrow->getLine().p2();
+        // 使用图形上连接位置的实时坐标，而不仅仅是添加delta
+        QPoint pos;
+        if (!connectionPoint(conn, pos))
+            arrow->updateConnection(conn.isStartPoint, delta); // 找不到锚点时使用delta相对移动
+        else if (conn.isStartPoint)
+            arrow->setP1(pos);
+        else
+            arrow->setP2(pos);
+    }
 
-        // 获取当前移动图形的箭头锚点
-        const auto &anchors = shapes[shapeIndex]->getArrowAnchors();
-        const int snapDistance = 5;
+    // 第二遍检查：查找未记录的连接，只需要检查绘制范围在该图形附近的箭头
+    const auto &anchors = shapes[shapeIndex]->getArrowAnchors();
+    const int snapDistance = 5;
+    std::vector<int> nearby;
+    geometryTable().intersecting(
+        shapes[shapeIndex]->paintBounds().adjusted(-snapDistance, -snapDistance, snapDistance, snapDistance), nearby);
 
-        // 检查是否已有连接记录
-        bool startPointConnected = false;
-        bool endPointConnected = false;
+    std::vector<ArrowConnection> found;
+    for (int i : nearby)
+    {
+        if (i == shapeIndex || geometryTable().kind(i) != ShapeBase::Kind::Arrow)
+            continue;
+        auto *arrow = static_cast<ShapeArrow *>(shapes[i].get());
 
-        for (const auto &conn : arrowConnections)
+        // 已经连接的端点不再检查
+        bool connected[2] = {false, false};
+        for (int k : connectionsOf(i))
         {
-            if (conn.arrowIndex == i && conn.shapeIndex == shapeIndex)
-            {
-                if (conn.isStartPoint)
-                    startPointConnected = true;
-                else
-                    endPointConnected = true;
-
-                // 更新已有连接的位置
-                QPoint newAnchorPos = anchors[conn.handleIndex].rect.center();
-                if (conn.isStartPoint)
-                    arrow->setP1(newAnchorPos);
-                else
-                    arrow->setP2(newAnchorPos);
-            }
+            if (arrowConnections[k].arrowIndex == i)
+                connected[arrowConnections[k].isStartPoint ? 0 : 1] = true;
         }
 
-        // 检查未记录的起点连接
-        if (!startPointConnected)
+        for (int end = 0; end < 2; ++end)
         {
+            if (connected[end])
+                continue;
+            QPoint endpoint = end == 0 ? arrow->getLine().p1() : arrow->getLine().p2();
             for (size_t j = 0; j < anchors.size(); ++j)
             {
                 QPoint anchorPos = anchors[j].rect.center();
-                if ((p1 - anchorPos).manhattanLength() <= snapDistance)
+                if ((endpoint - anchorPos).manhattanLength() <= snapDistance)
                 {
                     ArrowConnection newConn;
                     newConn.arrowIndex = i;
                     newConn.shapeIndex = shapeIndex;
                     newConn.handleIndex = j;
-                    newConn.isStartPoint = true;
-                    arrowConnections.push_back(newConn);
-                    arrow->setP1(anchorPos);
+                    newConn.isStartPoint = end == 0;
+                    found.push_back(newConn);
+                    if (end == 0)
+                        arrow->setP1(anchorPos);
+                    else
+                        arrow->setP2(anchorPos);
                     break;
                 }
             }
         }
+    }
 
-        // 检查未记录的终点连接
-        if (!endPointConnected)
-        {
-            for (size_t j = 0; j < anchors.size(); ++j)
-            {
-                QPoint anchorPos = anchors[j].rect.center();
-                if ((p2 - anchorPos).manhattanLength() <= snapDistance)
-                {
-                    ArrowConnection newConn;
-                    newConn.arrowIndex = i;
-                    newConn.shapeIndex = shapeIndex;
-                    newConn.handleIndex = j;
-                    newConn.isStartPoint = false;
-                    arrowConnections.push_back(newConn);
-                    arrow->setP2(anchorPos);
-                    break;
-                }
-            }
-        }
+    if (!found.empty())
+    {
+        arrowConnections.insert(arrowConnections.end(), found.begin(), found.end());
+        invalidateConnectionIndex();
     }
 }
 
@@ -1173,12 +1848,17 @@ void DrawingArea::createContextMenu()
     QAction *pasteAction = m_contextMenu->addAction(tr("Paste"));
     m_contextMenu->addSeparator();
     QAction *deleteAction = m_contextMenu->addAction(tr("Delete"));
+    m_contextMenu->addSeparator();
+    QAction *pinAction = m_contextMenu->addAction(tr("Pin Position"));
+    pinAction->setCheckable(true);
+    QAction *cacheAction = m_contextMenu->addAction(tr("Cache Group as Image"));
+    cacheAction->setCheckable(true);
 
     // 根据是否有选中图形来设置菜单项的可用状态
-    copyAction->setEnabled(selectedIndex != -1);
-    cutAction->setEnabled(selectedIndex != -1);
-    deleteAction->setEnabled(selectedIndex != -1);
-    pasteAction->setEnabled(m_clipboardShape != nullptr);
+    copyAction->setEnabled(!m_selection.empty());
+    cutAction->setEnabled(!m_selection.empty());
+    deleteAction->setEnabled(!m_selection.empty());
+    pasteAction->setEnabled(!m_clipboardShapes.empty());
 
     connect(copyAction, &QAction::triggered, this,
             &DrawingArea::copySelectedShape);
@@ -1186,6 +1866,8 @@ void DrawingArea::createContextMenu()
     connect(pasteAction, &QAction::triggered, this, &DrawingArea::pasteShape);
     connect(deleteAction, &QAction::triggered, this,
             &DrawingArea::deleteSelectedShape);
+    connect(pinAction, &QAction::toggled, this, &DrawingArea::setSelectionPinned);
+    connect(cacheAction, &QAction::toggled, this, &DrawingArea::setSelectionCachedAsImage);
 }
 
 void DrawingArea::contextMenuEvent(QContextMenuEvent *event)
@@ -1198,11 +1880,31 @@ void DrawingArea::contextMenuEvent(QContextMenuEvent *event)
             if (action->text() == tr("Copy") || action->text() == tr("Cut") ||
                 action->text() == tr("Delete"))
             {
-                action->setEnabled(selectedIndex != -1);
+                action->setEnabled(!m_selection.empty());
             }
             else if (action->text() == tr("Paste"))
             {
-                action->setEnabled(m_clipboardShape != nullptr);
+                action->setEnabled(!m_clipboardShapes.empty());
+            }
+            else if (action->text() == tr("Pin Position"))
+            {
+                // 选中的图形都已固定时显示为勾选；更新状态时不触发toggled
+                bool pinned = !m_selection.empty();
+                for (int i : m_selection)
+                    pinned = pinned && (shapes[i]->kind() == ShapeBase::Kind::Arrow || shapes[i]->isPinned());
+                QSignalBlocker blocker(action);
+                action->setEnabled(!m_selection.empty());
+                action->setChecked(pinned);
+            }
+            else if (action->text() == tr("Cache Group as Image"))
+            {
+                std::vector<int> groups = selectedTopGroups();
+                bool cached = !groups.empty();
+                for (int id : groups)
+                    cached = cached && groupTree().group(id).cacheImage;
+                QSignalBlocker blocker(action);
+                action->setEnabled(!groups.empty());
+                action->setChecked(cached);
             }
         }
     }
@@ -1213,15 +1915,19 @@ void DrawingArea::contextMenuEvent(QContextMenuEvent *event)
 
 void DrawingArea::copySelectedShape()
 {
-    if (selectedIndex != -1 && selectedIndex < shapes.size())
-    {
-        m_clipboardShape = shapes[selectedIndex]->clone();
-    }
+    if (m_selection.empty())
+        return;
+
+    // 剪贴板不属于文档，清空文档后仍然可以粘贴
+    ShapeAllocator::Scope pool(ShapeAllocator::defaultPool());
+    m_clipboardShapes.clear();
+    for (int i : m_selection)
+        m_clipboardShapes.push_back(shapes[i]->clone());
 }
 
 void DrawingArea::cutSelectedShape()
 {
-    if (selectedIndex != -1 && selectedIndex < shapes.size())
+    if (!m_selection.empty())
     {
         copySelectedShape();
         deleteSelectedShape();
@@ -1230,150 +1936,1178 @@ void DrawingArea::cutSelectedShape()
 
 void DrawingArea::pasteShape()
 {
-    if (m_clipboardShape)
-    {
-        std::unique_ptr<ShapeBase> newShape = m_clipboardShape->clone();
-        // 将新图形放在鼠标当前位置
-        QPoint pos = mapFromGlobal(QCursor::pos());
-        QRect rect = newShape->getRect();
-        int width = rect.width();
-        int height = rect.height();
-        rect.setTopLeft(pos);
-        rect.setWidth(width);
-        rect.setHeight(height);
-        newShape->setRect(rect);
-
-        // 添加到图形列表
-        int newIndex = shapes.size();
+    if (m_clipboardShapes.empty())
+        return;
+
+    // 将复制的图形整体放在鼠标当前位置，保持相互之间的位置关系
+    QPoint pos = screenToDoc(viewport()->mapFromGlobal(QCursor::pos()));
+    QRect united;
+    for (const auto &shape : m_clipboardShapes)
+        united = united.united(shape->getRect());
+    QPoint delta = pos - united.topLeft();
+
+    // 粘贴的图形作为一步添加，并成为新的选择
+    int oldSelectedIndex = selectedIndex;
+    int firstIndex = static_cast<int>(shapes.size());
+    ShapeAllocator::Scope arena(m_arena);
+    beginHistoryBatch();
+    for (const auto &shape : m_clipboardShapes)
+    {
+        std::unique_ptr<ShapeBase> newShape = shape->clone();
+        newShape->moveBy(delta);
+        newShape->setGroupId(ShapeGroupTree::kNoGroup); // 粘贴的图形不加入原来的组
         shapes.push_back(std::move(newShape));
-        selectedIndex = shapes.size() - 1;
+        recordAddShape(static_cast<int>(shapes.size()) - 1);
+    }
+    endHistoryBatch();
+
+    m_selection.clear();
+    std::vector<QRect> regions;
+    for (int i = firstIndex; i < static_cast<int>(shapes.size()); ++i)
+    {
+        m_selection.push_back(i);
+        if (shapes[i]->kind() != ShapeBase::Kind::Arrow)
+            regions.push_back(shapes[i]->paintBounds());
+    }
+    selectedIndex = m_selection.back();
+    emitSelectionChanged(oldSelectedIndex);
+    // 粘贴的连接线和被粘贴的图形挡住的连接线重新布线
+    rerouteAffected(m_selection, regions);
+    invalidateScene();
+}
+
+void DrawingArea::deleteSelectedShape()
+{
+    if (m_selection.empty())
+        return;
+    stopForceLayout(); // 删除后布局中的下标失效
+
+    // 从后往前删除，前面图形的下标不受影响；整个选择的删除记录为一步
+    std::vector<int> indices;
+    indices.swap(m_selection);
+    selectedIndex = -1;
+    std::vector<QRect> regions;
+    beginHistoryBatch();
+    for (auto it = indices.rbegin(); it != indices.rend(); ++it)
+    {
+        int index = *it;
+        if (shapes[index]->kind() != ShapeBase::Kind::Arrow)
+            regions.push_back(shapes[index]->paintBounds());
+
+        // 记录删除操作到历史
+        recordRemoveShape(index);
+
+        // 删除图形和相关的箭头连接
+        eraseShape(index);
+    }
+    endHistoryBatch();
+
+    snappedHandle = SnapInfo();
+    emit selectionCleared();
+    rerouteAffected({}, regions); // 删除的图形让出的位置可能有更短的路径
+    invalidateScene();
+}
+
+// 选中的图形各自上移一层，已经在最顶层或上面紧挨着选中图形的保持不动
+void DrawingArea::moveShapeUp()
+{
+    std::vector<int> order(shapes.size());
+    for (size_t k = 0; k < order.size(); ++k)
+        order[k] = static_cast<int>(k);
+
+    bool changed = false;
+    for (auto it = m_selection.rbegin(); it != m_selection.rend(); ++it)
+    {
+        int k = *it;
+        if (k + 1 < static_cast<int>(order.size()) && !isSelected(order[k + 1]))
+        {
+            std::swap(order[k], order[k + 1]);
+            changed = true;
+        }
+    }
+    if (changed)
+        reorderShapes(order);
+}
+
+// 选中的图形各自下移一层
+void DrawingArea::moveShapeDown()
+{
+    std::vector<int> order(shapes.size());
+    for (size_t k = 0; k < order.size(); ++k)
+        order[k] = static_cast<int>(k);
+
+    bool changed = false;
+    for (int k : m_selection)
+    {
+        if (k > 0 && !isSelected(order[k - 1]))
+        {
+            std::swap(order[k], order[k - 1]);
+            changed = true;
+        }
+    }
+    if (changed)
+        reorderShapes(order);
+}
+
+// 选中的图形保持相互之间的顺序，整体移到最顶层
+void DrawingArea::moveShapeToTop()
+{
+    if (m_selection.empty())
+        return;
+
+    std::vector<int> order;
+    order.reserve(shapes.size());
+    for (int i = 0; i < static_cast<int>(shapes.size()); ++i)
+    {
+        if (!isSelected(i))
+            order.push_back(i);
+    }
+    order.insert(order.end(), m_selection.begin(), m_selection.end());
+    reorderShapes(order);
+}
+
+// 选中的图形保持相互之间的顺序，整体移到最底层
+void DrawingArea::moveShapeToBottom()
+{
+    if (m_selection.empty())
+        return;
+
+    std::vector<int> order(m_selection.begin(), m_selection.end());
+    order.reserve(shapes.size());
+    for (int i = 0; i < static_cast<int>(shapes.size()); ++i)
+    {
+        if (!isSelected(i))
+            order.push_back(i);
+    }
+    reorderShapes(order);
+}
+
+void DrawingArea::reorderShapes(const std::vector<int> &order)
+{
+    bool identity = true;
+    for (size_t k = 0; k < order.size(); ++k)
+        identity = identity && order[k] == static_cast<int>(k);
+    if (identity)
+        return;
+    stopForceLayout(); // 调整顺序后布局中的下标失效
+
+    if (!m_ignoreHistoryActions)
+    {
+        ShapeAllocator::Scope arena(m_arena);
+        HistoryAction action(OperationType::Reorder, -1);
+        action.order.assign(order.begin(), order.end());
+        pushHistory(std::move(action));
+    }
+
+    applyOrder(order);
+    invalidateScene();
+}
+
+void DrawingArea::applyOrder(const std::vector<int> &order)
+{
+    if (order.size() != shapes.size())
+        return;
+
+    // newIndex[原下标] = 调整后的下标
+    std::vector<int> newIndex(order.size());
+    std::vector<std::unique_ptr<ShapeBase>> reordered;
+    reordered.reserve(shapes.size());
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        newIndex[order[k]] = static_cast<int>(k);
+        reordered.push_back(std::move(shapes[order[k]]));
+    }
+    shapes.swap(reordered);
+
+    auto remap = [&newIndex](int index)
+    {
+        return index >= 0 && index < static_cast<int>(newIndex.size()) ? newIndex[index] : index;
+    };
+    for (auto &conn : arrowConnections)
+    {
+        conn.arrowIndex = remap(conn.arrowIndex);
+        conn.shapeIndex = remap(conn.shapeIndex);
+    }
+    invalidateConnectionIndex();
+    for (int &index : m_selection)
+        index = remap(index);
+    std::sort(m_selection.begin(), m_selection.end());
+    selectedIndex = remap(selectedIndex);
+    snappedHandle = SnapInfo();
+}
+
+// 删除一个图形和它的连接，后面图形的下标减一，连接中的下标随之调整
+void DrawingArea::eraseShape(int index)
+{
+    arrowConnections.erase(std::remove_if(arrowConnections.begin(), arrowConnections.end(),
+                                          [index](const ArrowConnection &conn)
+                                          {
+                                              return conn.arrowIndex == index || conn.shapeIndex == index;
+                                          }),
+                           arrowConnections.end());
+    for (auto &conn : arrowConnections)
+    {
+        if (conn.arrowIndex > index)
+            --conn.arrowIndex;
+        if (conn.shapeIndex > index)
+            --conn.shapeIndex;
+    }
+    invalidateConnectionIndex();
+    shapes.erase(shapes.begin() + index);
+}
+
+// 在index处插入图形，原来在index及之后的图形下标加一，连接中的下标随之调整
+void DrawingArea::insertShape(int index, std::unique_ptr<ShapeBase> shape)
+{
+    for (auto &conn : arrowConnections)
+    {
+        if (conn.arrowIndex >= index)
+            ++conn.arrowIndex;
+        if (conn.shapeIndex >= index)
+            ++conn.shapeIndex;
+    }
+    invalidateConnectionIndex();
+    shapes.insert(shapes.begin() + index, std::move(shape));
+}
+
+void DrawingArea::setSelectedShapeLineColor(const QColor &color)
+{
+    // 所有选中图形的修改记录为一步
+    beginHistoryBatch();
+    bool changed = false;
+    for (int i : m_selection)
+    {
+        // 如果颜色没有变化，不需要记录
+        if (shapes[i]->getLineColor() == color)
+            continue;
+
+        // 记录属性变更
+        ShapeProperties before = captureProperties(i);
+        shapes[i]->setLineColor(color);
+        recordPropertyChange(i, before);
+        changed = true;
+    }
+    endHistoryBatch();
+
+    if (changed)
+        invalidateScene();
+}
+
+void DrawingArea::setSelectedShapeLineWidth(int width)
+{
+    beginHistoryBatch();
+    bool changed = false;
+    for (int i : m_selection)
+    {
+        // 如果宽度没有变化，不需要记录
+        if (shapes[i]->getLineWidth() == width)
+            continue;
+
+        // 记录属性变更
+        ShapeProperties before = captureProperties(i);
+        shapes[i]->setLineWidth(width);
+        recordPropertyChange(i, before);
+        changed = true;
+    }
+    endHistoryBatch();
+
+    if (changed)
+        invalidateScene();
+}
+
+void DrawingArea::applyToSelection(const std::function<void(ShapeBase *)> &edit)
+{
+    // 所有选中图形的修改记录为一步，样式没有变化的图形不记录
+    beginHistoryBatch();
+    bool changed = false;
+    for (int i : m_selection)
+    {
+        ShapeProperties before = captureProperties(i);
+        edit(shapes[i].get());
+        if (shapes[i]->style() == before.style)
+            continue;
+        recordPropertyChange(i, before);
+        changed = true;
+    }
+    endHistoryBatch();
+
+    if (changed)
+        invalidateScene();
+}
+
+void DrawingArea::transformShapes(const std::vector<int> &indices, const ShapeTransform &transform)
+{
+    std::vector<int> targets = transformTargets(indices);
+    if (targets.empty())
+        return;
+
+    std::vector<ShapeGeometryState> before = captureGeometry(targets);
+    applyTransform(indices, transform);
+    recordTransform(std::move(before), captureGeometry(targets));
+    if (m_infiniteCanvas)
+        updateScrollBars(); // 图形可能被移到了原来的范围之外
+}
+
+void DrawingArea::editSelectedGeometry(const std::function<void(ShapeBase *)> &edit)
+{
+    if (selectedIndex < 0 || selectedIndex >= static_cast<int>(shapes.size()))
+        return;
+
+    std::vector<int> targets = transformTargets({selectedIndex});
+    std::vector<ShapeGeometryState> before = captureGeometry(targets);
+    std::vector<QRect> boundsBefore;
+    boundsBefore.reserve(targets.size());
+    for (int i : targets)
+        boundsBefore.push_back(shapes[i]->paintBounds());
+
+    edit(shapes[selectedIndex].get());
+    resolveConnectedArrows({selectedIndex});
+    invalidateShapes(targets, boundsBefore);
+    recordTransform(std::move(before), captureGeometry(targets));
+    if (m_infiniteCanvas)
+        updateScrollBars(); // 图形可能被移到了原来的范围之外
+}
+
+std::vector<int> DrawingArea::transformTargets(const std::vector<int> &indices) const
+{
+    std::vector<int> targets;
+    targets.reserve(indices.size());
+    for (int i : indices)
+    {
+        if (i >= 0 && i < static_cast<int>(shapes.size()))
+            targets.push_back(i);
+    }
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+    // 连接在这些图形上的箭头端点也会变化
+    size_t count = targets.size();
+    for (size_t t = 0; t < count; ++t)
+    {
+        for (int k : connectionsOf(targets[t]))
+        {
+            const auto &conn = arrowConnections[k];
+            if (conn.shapeIndex == targets[t] && conn.arrowIndex >= 0 &&
+                conn.arrowIndex < static_cast<int>(shapes.size()))
+                targets.push_back(conn.arrowIndex);
+        }
+    }
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    return targets;
+}
+
+std::vector<DrawingArea::ShapeGeometryState> DrawingArea::captureGeometry(const std::vector<int> &indices) const
+{
+    std::vector<ShapeGeometryState> states;
+    states.reserve(indices.size());
+    for (int i : indices)
+    {
+        const ShapeBase *shape = shapes[i].get();
+        ShapeGeometryState state = {i, shape->getRect(), shape->getRotation(), QLine()};
+        if (shape->kind() == ShapeBase::Kind::Arrow)
+            state.line = static_cast<const ShapeArrow *>(shape)->getLine();
+        states.push_back(state);
+    }
+    return states;
+}
+
+void DrawingArea::restoreGeometry(const HistoryVector<ShapeGeometryState> &states)
+{
+    std::vector<int> indices;
+    std::vector<QRect> boundsBefore;
+    indices.reserve(states.size());
+    boundsBefore.reserve(states.size());
+    for (const auto &state : states)
+    {
+        if (state.index < 0 || state.index >= static_cast<int>(shapes.size()))
+            continue;
+
+        ShapeBase *shape = shapes[state.index].get();
+        indices.push_back(state.index);
+        boundsBefore.push_back(shape->paintBounds());
+        if (shape->kind() == ShapeBase::Kind::Arrow)
+        {
+            auto *arrow = static_cast<ShapeArrow *>(shape);
+            arrow->setP1(state.line.p1());
+            arrow->setP2(state.line.p2());
+        }
+        else
+        {
+            if (shape->getRect() != state.rect)
+                shape->setRect(state.rect);
+            shape->setRotation(state.rotation);
+        }
+    }
+    invalidateShapes(indices, boundsBefore);
+}
+
+void DrawingArea::applyTransform(const std::vector<int> &indices, const ShapeTransform &transform)
+{
+    std::vector<int> targets = transformTargets(indices);
+    if (targets.empty())
+        return;
+
+    std::vector<QRect> boundsBefore;
+    boundsBefore.reserve(targets.size());
+    for (int i : targets)
+        boundsBefore.push_back(shapes[i]->paintBounds());
+
+    // 点的变换：缩放、旋转都以pivot为中心，最后平移
+    QTransform matrix;
+    matrix.translate(transform.pivot.x() + transform.translation.x(),
+                     transform.pivot.y() + transform.translation.y());
+    matrix.rotateRadians(transform.rotation);
+    matrix.scale(transform.scaleX, transform.scaleY);
+    matrix.translate(-transform.pivot.x(), -transform.pivot.y());
+    const bool translateOnly = transform.scaleX == 1.0 && transform.scaleY == 1.0 && transform.rotation == 0.0;
+    const QPoint offset = transform.translation.toPoint();
+
+    std::vector<int> moved;
+    moved.reserve(indices.size());
+    for (int i : indices)
+    {
+        if (i < 0 || i >= static_cast<int>(shapes.size()))
+            continue;
+        moved.push_back(i);
+
+        ShapeBase *shape = shapes[i].get();
+        if (shape->kind() == ShapeBase::Kind::Arrow)
+        {
+            // 箭头变换两个端点，连接在图形上的端点稍后按锚点重新计算
+            auto *arrow = static_cast<ShapeArrow *>(shape);
+            QLine line = arrow->getLine();
+            arrow->setP1(matrix.map(QPointF(line.p1())).toPoint());
+            arrow->setP2(matrix.map(QPointF(line.p2())).toPoint());
+        }
+        else if (translateOnly)
+        {
+            // 纯平移直接整数移动，反复拖动也不会累积舍入误差
+            shape->moveBy(offset);
+        }
+        else
+        {
+            // 图形中心跟随变换，大小按缩放比例变化，旋转角度累加
+            QRectF rect(shape->getRect());
+            QPointF center = matrix.map(rect.center());
+            QSizeF size(rect.width() * std::abs(transform.scaleX), rect.height() * std::abs(transform.scaleY));
+            shape->setRect(QRectF(center - QPointF(size.width() / 2, size.height() / 2), size).toRect());
+            if (transform.rotation != 0.0)
+                shape->setRotation(shape->getRotation() + transform.rotation);
+        }
+    }
+
+    std::sort(moved.begin(), moved.end());
+    moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+    resolveConnectedArrows(moved);
+    invalidateShapes(targets, boundsBefore);
+}
+
+void DrawingArea::resolveConnectedArrows(const std::vector<int> &indices)
+{
+    // 只看这些图形相关的连接，每个箭头端点只设置一次
+    QSet<int> resolved;
+    for (int i : indices)
+    {
+        for (int k : connectionsOf(i))
+        {
+            const auto &conn = arrowConnections[k];
+            if (conn.arrowIndex < 0 || conn.arrowIndex >= static_cast<int>(shapes.size()) ||
+                shapes[conn.arrowIndex]->kind() != ShapeBase::Kind::Arrow)
+                continue;
+
+            int endpoint = conn.arrowIndex * 2 + (conn.isStartPoint ? 0 : 1);
+            if (resolved.contains(endpoint))
+                continue;
+
+            QPoint pos;
+            if (!connectionPoint(conn, pos))
+                continue;
+
+            auto *arrow = static_cast<ShapeArrow *>(shapes[conn.arrowIndex].get());
+            if (conn.isStartPoint)
+                arrow->setP1(pos);
+            else
+                arrow->setP2(pos);
+            resolved.insert(endpoint);
+        }
+    }
+}
+
+void DrawingArea::invalidateShapes(const std::vector<int> &indices, const std::vector<QRect> &boundsBefore)
+{
+    // 所有变化合并为一块重绘区域
+    QRect dirty;
+    std::vector<QRect> regions;
+    for (size_t k = 0; k < indices.size(); ++k)
+    {
+        int i = indices[k];
+        m_snapshotDirty.push_back(static_cast<int>(i)); // 下一次快照时重新复制
+        updateGeometry(i);
+        QRect boundsAfter = shapes[i]->paintBounds();
+        dirty = dirty.united(boundsBefore[k]).united(boundsAfter);
+        if (shapes[i]->kind() != ShapeBase::Kind::Arrow)
+        {
+            regions.push_back(boundsBefore[k]);
+            regions.push_back(boundsAfter);
+        }
+    }
+    invalidateDocRect(dirty);
+
+    std::vector<int> changed(indices);
+    std::sort(changed.begin(), changed.end());
+    rerouteAffected(changed, regions);
+}
+
+void DrawingArea::setSelectedArrowRouting(ShapeArrow::Routing routing)
+{
+    // 与其他属性一样，所有选中箭头的修改记录为一步
+    beginHistoryBatch();
+    bool changed = false;
+    std::vector<int> arrows;
+    for (int i : m_selection)
+    {
+        if (shapes[i]->kind() != ShapeBase::Kind::Arrow)
+            continue;
+        auto *arrow = static_cast<ShapeArrow *>(shapes[i].get());
+        if (arrow->routing() == routing)
+            continue;
+        ShapeProperties before = captureProperties(i);
+        arrow->setRouting(routing);
+        recordPropertyChange(i, before);
+        changed = true;
+        if (arrow->isRouted())
+            arrows.push_back(i);
+    }
+    endHistoryBatch();
+    if (!changed)
+        return;
+
+    rerouteArrows(arrows);
+    invalidateScene();
+}
+
+DrawingArea::ShapeProperties DrawingArea::captureProperties(int index) const
+{
+    ShapeProperties properties;
+    properties.style = shapes[index]->style();
+    properties.pinned = shapes[index]->isPinned();
+    if (shapes[index]->kind() == ShapeBase::Kind::Arrow)
+        properties.routing = static_cast<const ShapeArrow *>(shapes[index].get())->routing();
+    return properties;
+}
+
+void DrawingArea::restoreProperties(int index, const ShapeProperties &properties)
+{
+    // 线宽可能变化，变化前后的范围都可能影响布线；布线方式改变后路径过期，撤销结束时重新布线
+    addRouteRegion(*shapes[index]);
+    shapes[index]->setStyle(properties.style);
+    shapes[index]->setPinned(properties.pinned);
+    if (shapes[index]->kind() == ShapeBase::Kind::Arrow)
+        static_cast<ShapeArrow *>(shapes[index].get())->setRouting(properties.routing);
+    addRouteRegion(*shapes[index]);
+}
+
+void DrawingArea::addRouteRegion(const ShapeBase &shape)
+{
+    if (shape.kind() != ShapeBase::Kind::Arrow)
+        m_routeRegions.push_back(shape.paintBounds());
+}
+
+void DrawingArea::rerouteArrows(const std::vector<int> &arrows)
+{
+    if (arrows.empty())
+        return;
+
+    // 障碍物是走廊中除连接线以外的图形，用副表批量筛选
+    const ShapeGeometryTable &geometry = geometryTable();
+    auto query = [&geometry](const QRect &area, std::vector<QRect> &obstacles)
+    {
+        std::vector<int> candidates;
+        geometry.intersecting(area, candidates);
+        for (int i : candidates)
+        {
+            if (geometry.kind(i) != ShapeBase::Kind::Arrow)
+                obstacles.push_back(geometry.bounds(i));
+        }
+    };
+
+    for (int i : arrows)
+    {
+        auto *arrow = static_cast<ShapeArrow *>(shapes[i].get());
+        const QLine &line = arrow->getLine();
+        ConnectorRouter::Endpoint start = {line.p1(), QRect()};
+        ConnectorRouter::Endpoint end = {line.p2(), QRect()};
+        // 箭头两端连接的图形
+        for (int k : connectionsOf(i))
+        {
+            const auto &conn = arrowConnections[k];
+            if (conn.arrowIndex == i && conn.shapeIndex >= 0 && conn.shapeIndex < geometry.size())
+                (conn.isStartPoint ? start : end).shape = geometry.bounds(conn.shapeIndex);
+        }
+        ConnectorRouter::Route route = ConnectorRouter::route(start, end, query);
+        arrow->setRoute(std::move(route.points), route.corridor);
+    }
+}
+
+void DrawingArea::rerouteAffected(const std::vector<int> &changed, const std::vector<QRect> &regions)
+{
+    QRect united;
+    for (const QRect &region : regions)
+        united |= region;
+
+    // 端点移动了的连接线、路径已经过期的连接线，以及走廊与变化的图形相交的连接线
+    std::vector<int> arrows;
+    std::vector<QRect> boundsBefore;
+    const ShapeGeometryTable &geometry = geometryTable();
+    for (int i = 0; i < geometry.size(); ++i)
+    {
+        if (geometry.kind(i) != ShapeBase::Kind::Arrow)
+            continue;
+        const auto *arrow = static_cast<const ShapeArrow *>(shapes[i].get());
+        if (!arrow->isRouted())
+            continue;
+
+        bool affected = !arrow->routeValid() || std::binary_search(changed.begin(), changed.end(), i);
+        if (!affected && united.intersects(arrow->routeCorridor()))
+        {
+            affected = std::any_of(regions.begin(), regions.end(), [arrow](const QRect &region)
+                                   { return region.intersects(arrow->routeCorridor()); });
+        }
+        if (affected)
+        {
+            arrows.push_back(i);
+            boundsBefore.push_back(geometry.bounds(i));
+        }
+    }
+    if (arrows.empty())
+        return;
+
+    rerouteArrows(arrows);
+    for (size_t k = 0; k < arrows.size(); ++k)
+    {
+        int i = arrows[k];
+        m_snapshotDirty.push_back(i);
+        updateGeometry(i);
+        invalidateDocRect(boundsBefore[k]);
+        invalidateDocRect(shapes[i]->paintBounds());
+    }
+}
 
-        // 记录添加操作
-        recordAddShape(selectedIndex);
+void DrawingArea::recordTransform(std::vector<ShapeGeometryState> before, std::vector<ShapeGeometryState> after)
+{
+    if (m_ignoreHistoryActions || before.empty())
+        return;
 
-        update();
+    bool changed = false;
+    for (size_t k = 0; k < before.size() && !changed; ++k)
+    {
+        changed = before[k].rect != after[k].rect || before[k].rotation != after[k].rotation ||
+                  before[k].line != after[k].line;
+    }
+    if (!changed)
+        return;
+
+    ShapeAllocator::Scope arena(m_arena);
+    HistoryAction action(OperationType::Transform, -1);
+    action.geometryBefore.assign(before.begin(), before.end());
+    action.geometryAfter.assign(after.begin(), after.end());
+    pushHistory(std::move(action));
+}
+
+void DrawingArea::layoutLayered()
+{
+    std::vector<int> nodes;
+    LayoutGraph graph = layoutGraph(nodes);
+    startLayout(&LayeredLayout::run, std::move(nodes), std::move(graph));
+}
+
+void DrawingArea::layoutTree(TreeLayout::Orientation orientation)
+{
+    m_treeOrientation = orientation;
+    std::vector<int> nodes;
+    LayoutGraph graph = layoutGraph(nodes);
+    startLayout([orientation](const LayoutGraph &graph, const LayoutCancel &cancel, std::vector<QPoint> &positions)
+                { return TreeLayout::run(graph, orientation, cancel, positions); },
+                std::move(nodes), std::move(graph));
+}
+
+void DrawingArea::layoutSubtree()
+{
+    if (selectedIndex < 0 || shapes[selectedIndex]->kind() == ShapeBase::Kind::Arrow)
+        return;
+
+    // 只收集子树中的图形，代价与子树的大小成正比
+    TreeLayout::Orientation orientation = m_treeOrientation;
+    std::vector<int> nodes;
+    LayoutGraph graph = subtreeGraph(selectedIndex, nodes);
+    startLayout([orientation](const LayoutGraph &graph, const LayoutCancel &cancel, std::vector<QPoint> &positions)
+                { return TreeLayout::run(graph, orientation, cancel, positions); },
+                std::move(nodes), std::move(graph), 0);
+}
+
+void DrawingArea::cancelLayout()
+{
+    m_layoutWorker->cancel();
+    m_layoutNodes.clear();
+}
+
+LayoutGraph DrawingArea::layoutGraph(std::vector<int> &nodes) const
+{
+    // 箭头不参与布局，两端都连接在参与布局的图形上的箭头是一条边
+    const bool selectionOnly = m_selection.size() > 1;
+    nodes.clear();
+    for (int i = 0; i < static_cast<int>(shapes.size()); ++i)
+    {
+        if (shapes[i]->kind() != ShapeBase::Kind::Arrow && (!selectionOnly || isSelected(i)))
+            nodes.push_back(i);
+    }
+
+    LayoutGraph graph;
+    std::vector<int> nodeOf(shapes.size(), -1);
+    graph.sizes.reserve(nodes.size());
+    graph.positions.reserve(nodes.size());
+    for (size_t k = 0; k < nodes.size(); ++k)
+    {
+        QRect rect = shapes[nodes[k]]->boundingRect();
+        nodeOf[nodes[k]] = static_cast<int>(k);
+        graph.sizes.push_back(rect.size());
+        graph.positions.push_back(rect.topLeft());
+    }
+
+    for (int i = 0; i < static_cast<int>(shapes.size()); ++i)
+    {
+        if (shapes[i]->kind() != ShapeBase::Kind::Arrow)
+            continue;
+        int from = -1;
+        int to = -1;
+        for (int k : connectionsOf(i))
+        {
+            const auto &conn = arrowConnections[k];
+            if (conn.arrowIndex != i || conn.shapeIndex < 0 || conn.shapeIndex >= static_cast<int>(shapes.size()))
+                continue;
+            (conn.isStartPoint ? from : to) = nodeOf[conn.shapeIndex];
+        }
+        if (from >= 0 && to >= 0)
+            graph.edges.emplace_back(from, to);
+    }
+    return graph;
+}
+
+LayoutGraph DrawingArea::subtreeGraph(int root, std::vector<int> &nodes) const
+{
+    LayoutGraph graph;
+    QHash<int, int> nodeOf;
+    auto addNode = [&](int index)
+    {
+        QRect rect = shapes[index]->boundingRect();
+        nodeOf.insert(index, static_cast<int>(nodes.size()));
+        nodes.push_back(index);
+        graph.sizes.push_back(rect.size());
+        graph.positions.push_back(rect.topLeft());
+    };
+    nodes.clear();
+    addNode(root);
+
+    // 广度优先：从图形出发的箭头的终点是它的子节点
+    const int count = static_cast<int>(shapes.size());
+    for (size_t k = 0; k < nodes.size(); ++k)
+    {
+        int from = nodes[k];
+        for (int c : connectionsOf(from))
+        {
+            const auto &conn = arrowConnections[c];
+            if (conn.shapeIndex != from || !conn.isStartPoint || conn.arrowIndex < 0 || conn.arrowIndex >= count)
+                continue;
+            for (int e : connectionsOf(conn.arrowIndex))
+            {
+                const auto &end = arrowConnections[e];
+                if (end.arrowIndex != conn.arrowIndex || end.isStartPoint || end.shapeIndex < 0 ||
+                    end.shapeIndex >= count || shapes[end.shapeIndex]->kind() == ShapeBase::Kind::Arrow)
+                    continue;
+                if (!nodeOf.contains(end.shapeIndex))
+                    addNode(end.shapeIndex);
+                graph.edges.emplace_back(static_cast<int>(k), nodeOf.value(end.shapeIndex));
+            }
+        }
+    }
+    return graph;
+}
+
+void DrawingArea::startLayout(const LayoutFunction &layout, std::vector<int> nodes, LayoutGraph graph, int anchor)
+{
+    stopForceLayout();
+    if (nodes.size() < 2)
+        return;
+
+    if (anchor >= 0)
+    {
+        m_layoutOrigin = shapes[nodes[anchor]]->boundingRect().topLeft();
+    }
+    else
+    {
+        QRect bounds;
+        for (int i : nodes)
+            bounds |= shapes[i]->boundingRect();
+        m_layoutOrigin = bounds.topLeft();
+    }
+    m_layoutAnchor = anchor;
+    m_layoutNodes = std::move(nodes);
+    m_layoutRevision = m_sceneRevision;
+
+    // 线程中只使用复制的图，不访问图形
+    m_layoutWorker->runJob([graph = std::move(graph), layout](const LayoutCancel &cancel, std::vector<QPoint> &positions)
+                           { return layout(graph, cancel, positions); });
+}
+
+void DrawingArea::onLayoutFinished(quint64 generation, bool completed)
+{
+    if (generation != m_layoutWorker->generation())
+        return; // 之后又开始了新的布局
+
+    std::vector<QPoint> positions = m_layoutWorker->takeResult();
+    std::vector<int> nodes;
+    nodes.swap(m_layoutNodes);
+    if (!completed || m_sceneRevision != m_layoutRevision || positions.size() != nodes.size())
+        return;
+
+    // 布局结果的左上角在原点；有保持不动的节点时以它为准
+    QPoint offset = m_layoutOrigin;
+    if (m_layoutAnchor >= 0)
+        offset -= positions[m_layoutAnchor];
+    for (QPoint &pos : positions)
+        pos += offset;
+    moveShapesTo(nodes, positions);
+}
+
+void DrawingArea::moveShapesTo(const std::vector<int> &indices, const std::vector<QPoint> &topLefts)
+{
+    std::vector<int> targets = transformTargets(indices);
+    if (targets.empty())
+        return;
+
+    std::vector<ShapeGeometryState> before = captureGeometry(targets);
+    placeShapes(indices, topLefts, targets);
+    recordTransform(std::move(before), captureGeometry(targets));
+}
+
+void DrawingArea::placeShapes(const std::vector<int> &indices, const std::vector<QPoint> &topLefts,
+                              const std::vector<int> &targets)
+{
+    std::vector<QRect> boundsBefore;
+    boundsBefore.reserve(targets.size());
+    for (int i : targets)
+        boundsBefore.push_back(shapes[i]->paintBounds());
+
+    std::vector<int> moved;
+    moved.reserve(indices.size());
+    for (size_t k = 0; k < indices.size() && k < topLefts.size(); ++k)
+    {
+        int i = indices[k];
+        if (i < 0 || i >= static_cast<int>(shapes.size()))
+            continue;
+        shapes[i]->moveBy(topLefts[k] - shapes[i]->boundingRect().topLeft());
+        moved.push_back(i);
+    }
+
+    std::sort(moved.begin(), moved.end());
+    moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+    resolveConnectedArrows(moved);
+    invalidateShapes(targets, boundsBefore);
+    if (m_infiniteCanvas)
+        updateScrollBars(); // 图形可能被移到了原来的范围之外
+}
+
+void DrawingArea::startForceLayout()
+{
+    stopForceLayout();
+    cancelLayout();
+
+    std::vector<int> nodes;
+    LayoutGraph graph = layoutGraph(nodes);
+    if (nodes.size() < 2)
+        return;
+
+    std::vector<bool> pinned(nodes.size());
+    for (size_t k = 0; k < nodes.size(); ++k)
+        pinned[k] = shapes[nodes[k]]->isPinned();
+    m_force.reset(new ForceLayout(graph, pinned));
+    m_forceNodes = std::move(nodes);
+    m_forceTargets = transformTargets(m_forceNodes);
+    m_forceBefore = captureGeometry(m_forceTargets);
+    m_forceTimer->start(std::max(frameIntervalMs(), 33));
+}
+
+void DrawingArea::stopForceLayout()
+{
+    if (!m_force)
+        return;
+
+    // 先清空状态，记录历史时不会再次进入
+    m_forceTimer->stop();
+    m_force.reset();
+    std::vector<int> targets;
+    targets.swap(m_forceTargets);
+    m_forceNodes.clear();
+    recordTransform(std::move(m_forceBefore), captureGeometry(targets));
+    m_forceBefore.clear();
+}
+
+void DrawingArea::forceTick()
+{
+    if (!m_force)
+        return;
+
+    // 在时间预算内尽量多推进几步，至少一步；只把最后的位置显示出来
+    QElapsedTimer budget;
+    budget.start();
+    do
+    {
+        m_force->step();
+    } while (!m_force->isSettled() && budget.elapsed() < kForceStepBudgetMs);
+
+    std::vector<QPoint> positions(m_forceNodes.size());
+    for (size_t k = 0; k < m_forceNodes.size(); ++k)
+        positions[k] = m_force->position(static_cast<int>(k));
+    placeShapes(m_forceNodes, positions, m_forceTargets);
+
+    if (m_force->isSettled())
+        stopForceLayout();
+}
+
+void DrawingArea::setSelectionPinned(bool pinned)
+{
+    // 固定状态保存在文件中，与其他属性一样可以撤销
+    beginHistoryBatch();
+    for (int i : m_selection)
+    {
+        if (shapes[i]->kind() == ShapeBase::Kind::Arrow || shapes[i]->isPinned() == pinned)
+            continue;
+        ShapeProperties before = captureProperties(i);
+        shapes[i]->setPinned(pinned);
+        recordPropertyChange(i, before);
+    }
+    endHistoryBatch();
+}
+
+ShapeGroupTree &DrawingArea::mutableGroups() const
+{
+    // 渲染快照还持有这一份时写时复制，快照中的分组保持不变
+    if (m_groups.use_count() > 1)
+        m_groups = std::make_shared<ShapeGroupTree>(*m_groups);
+    return *m_groups;
+}
+
+const ShapeGroupTree &DrawingArea::groupTree() const
+{
+    const ShapeGeometryTable &geometry = geometryTable();
+    if (m_groupsDirty)
+    {
+        mutableGroups().rebuild(shapes, geometry);
+        m_groupsDirty = false;
+    }
+    else if (!m_groups->boundsValid())
+    {
+        mutableGroups().updateBounds(geometry);
     }
+    return *m_groups;
 }
 
-void DrawingArea::deleteSelectedShape()
+std::vector<int> DrawingArea::expandToGroups(const std::vector<int> &indices, bool wholeGroupsOnly) const
 {
-    if (selectedIndex != -1 && selectedIndex < shapes.size())
+    const ShapeGroupTree &groups = groupTree();
+    if (!groups.hasGroups())
+        return indices;
+
+    std::vector<int> sorted(indices);
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<int> result;
+    std::vector<int> visited;
+    for (int i : sorted)
     {
-        // 记录删除操作到历史
-        recordRemoveShape(selectedIndex);
-
-        // 删除相关的箭头连接
-        auto it = std::remove_if(arrowConnections.begin(), arrowConnections.end(),
-                                 [this](const ArrowConnection &conn)
-                                 {
-                                     return conn.arrowIndex == selectedIndex || conn.shapeIndex == selectedIndex;
-                                 });
-        arrowConnections.erase(it, arrowConnections.end());
-
-        // 删除选中的图形
-        shapes.erase(shapes.begin() + selectedIndex);
-        selectedIndex = -1;
-        emit selectionCleared();
-        update();
+        int top = groups.topLevelGroup(i);
+        if (top == ShapeGroupTree::kNoGroup)
+        {
+            result.push_back(i);
+            continue;
+        }
+        if (std::find(visited.begin(), visited.end(), top) != visited.end())
+            continue;
+        visited.push_back(top);
+
+        std::vector<int> members;
+        groups.members(top, members);
+        if (wholeGroupsOnly && !std::includes(sorted.begin(), sorted.end(), members.begin(), members.end()))
+            continue;
+        result.insert(result.end(), members.begin(), members.end());
     }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
 }
 
-void DrawingArea::moveShapeUp()
+std::vector<int> DrawingArea::selectedTopGroups() const
 {
-    if (selectedIndex < 0 || selectedIndex >= static_cast<int>(shapes.size()) - 1)
+    const ShapeGroupTree &groups = groupTree();
+    std::vector<int> result;
+    for (int i : m_selection)
     {
-        return;
+        int top = groups.topLevelGroup(i);
+        if (top != ShapeGroupTree::kNoGroup && std::find(result.begin(), result.end(), top) == result.end())
+            result.push_back(top);
     }
-
-    // 交换当前图形和上一个图形
-    std::swap(shapes[selectedIndex], shapes[selectedIndex + 1]);
-    selectedIndex++;
-    update();
+    return result;
 }
 
-void DrawingArea::moveShapeDown()
+void DrawingArea::applyGroupChanges(const HistoryVector<GroupChange> &changes, bool redo)
 {
-    if (selectedIndex <= 0 || selectedIndex >= static_cast<int>(shapes.size()))
+    for (const GroupChange &change : changes)
     {
-        return;
+        int id = redo ? change.after : change.before;
+        if (change.isGroup)
+            mutableGroups().setParent(change.index, id);
+        else if (change.index >= 0 && change.index < static_cast<int>(shapes.size()))
+            shapes[change.index]->setGroupId(id);
     }
-
-    // 交换当前图形和下一个图形
-    std::swap(shapes[selectedIndex], shapes[selectedIndex - 1]);
-    selectedIndex--;
-    update();
+    m_groupsDirty = true;
+    invalidateScene();
 }
 
-void DrawingArea::moveShapeToTop()
+void DrawingArea::groupSelection()
 {
-    if (selectedIndex < 0 || selectedIndex >= static_cast<int>(shapes.size()))
+    // 没有组的图形直接加入新组，已经在组中的图形以最外层组为单位成为新组的子组
+    ShapeAllocator::Scope arena(m_arena);
+    HistoryVector<GroupChange> changes;
+    std::vector<int> topGroups;
     {
-        return;
+        const ShapeGroupTree &groups = groupTree();
+        for (int i : m_selection)
+        {
+            int top = groups.topLevelGroup(i);
+            if (top == ShapeGroupTree::kNoGroup)
+                changes.push_back({i, false, shapes[i]->groupId(), ShapeGroupTree::kNoGroup});
+            else if (std::find(topGroups.begin(), topGroups.end(), top) == topGroups.end())
+                topGroups.push_back(top);
+        }
     }
+    if (changes.size() + topGroups.size() < 2)
+        return;
 
-    // 将选中的图形移到最顶层
-    auto shape = std::move(shapes[selectedIndex]);
-    shapes.erase(shapes.begin() + selectedIndex);
-    shapes.push_back(std::move(shape));
-    selectedIndex = shapes.size() - 1;
-    update();
-}
+    int id = mutableGroups().createGroup();
+    for (GroupChange &change : changes)
+        change.after = id;
+    for (int top : topGroups)
+        changes.push_back({top, true, ShapeGroupTree::kNoGroup, id});
 
-void DrawingArea::moveShapeToBottom()
-{
-    if (selectedIndex < 0 || selectedIndex >= static_cast<int>(shapes.size()))
+    beginHistoryBatch();
+    if (!m_ignoreHistoryActions)
     {
-        return;
+        HistoryAction action(OperationType::Regroup, -1);
+        action.groupChanges = changes;
+        pushHistory(std::move(action));
     }
+    applyGroupChanges(changes, true);
 
-    // 将选中的图形移到最底层
-    auto shape = std::move(shapes[selectedIndex]);
-    shapes.erase(shapes.begin() + selectedIndex);
-    shapes.insert(shapes.begin(), std::move(shape));
-    selectedIndex = 0;
-    update();
+    // 成员在z序上移到最上面的成员处连续排列，组才能整体用缓存的图像绘制
+    std::vector<int> members = expandToGroups(m_selection);
+    std::vector<int> order;
+    order.reserve(shapes.size());
+    for (int i = 0; i < members.back(); ++i)
+    {
+        if (!std::binary_search(members.begin(), members.end(), i))
+            order.push_back(i);
+    }
+    order.insert(order.end(), members.begin(), members.end());
+    for (int i = members.back() + 1; i < static_cast<int>(shapes.size()); ++i)
+        order.push_back(i);
+    m_selection = members;
+    reorderShapes(order);
+    endHistoryBatch();
+
+    viewport()->update();
 }
 
-void DrawingArea::setSelectedShapeLineColor(const QColor &color)
+void DrawingArea::ungroupSelection()
 {
-    if (selectedIndex >= 0 && selectedIndex < shapes.size())
-    {
-        QColor oldColor = shapes[selectedIndex]->getLineColor();
-        int oldWidth = shapes[selectedIndex]->getLineWidth();
-
-        // 如果颜色没有变化，不需要记录
-        if (oldColor == color)
-            return;
+    // 最外层组中直接包含的图形不再属于任何组，子组成为顶层组
+    std::vector<int> topGroups = selectedTopGroups();
+    if (topGroups.empty())
+        return;
 
-        // 记录属性变更
-        recordPropertyChange(selectedIndex, oldColor, color, oldWidth, oldWidth);
+    const ShapeGroupTree &groups = groupTree();
+    ShapeAllocator::Scope arena(m_arena);
+    HistoryVector<GroupChange> changes;
+    for (int i = 0; i < static_cast<int>(shapes.size()); ++i)
+    {
+        int id = shapes[i]->groupId();
+        if (std::find(topGroups.begin(), topGroups.end(), id) != topGroups.end())
+            changes.push_back({i, false, id, ShapeGroupTree::kNoGroup});
+    }
+    for (int top : topGroups)
+    {
+        for (int child : groups.group(top).groups)
+            changes.push_back({child, true, top, ShapeGroupTree::kNoGroup});
+    }
 
-        shapes[selectedIndex]->setLineColor(color);
-        update();
+    if (!m_ignoreHistoryActions)
+    {
+        HistoryAction action(OperationType::Regroup, -1);
+        action.groupChanges = changes;
+        pushHistory(std::move(action));
     }
+    applyGroupChanges(changes, true);
+    viewport()->update();
 }
 
-void DrawingArea::setSelectedShapeLineWidth(int width)
+void DrawingArea::setSelectionCachedAsImage(bool cached)
+{
+    // 只影响绘制方式，不记录撤销
+    std::vector<int> topGroups = selectedTopGroups();
+    for (int top : topGroups)
+        mutableGroups().setCacheImage(top, cached);
+    if (!topGroups.empty())
+        invalidateScene();
+}
+
+void DrawingArea::restyleShapes(const ShapeStyleHandle &handle, const ShapeStyle &style)
 {
-    if (selectedIndex >= 0 && selectedIndex < shapes.size())
+    if (!handle || handle->style == style)
+        return;
+
+    if (!m_ignoreHistoryActions)
     {
-        QColor oldColor = shapes[selectedIndex]->getLineColor();
-        int oldWidth = shapes[selectedIndex]->getLineWidth();
+        ShapeAllocator::Scope arena(m_arena);
+        HistoryAction action(OperationType::Restyle, -1);
+        action.styleHandle = handle;
+        action.oldStyle = handle->style;
+        action.newStyle = style;
+        pushHistory(std::move(action));
+    }
 
-        // 如果宽度没有变化，不需要记录
-        if (oldWidth == width)
-            return;
+    ShapeStyleTable::instance().restyle(handle, style);
+    invalidateScene(); // 线宽可能变化，绘制范围需要重新计算
+}
 
-        // 记录属性变更
-        recordPropertyChange(selectedIndex, oldColor, oldColor, oldWidth, width);
+void DrawingArea::restyleSelected(const std::function<void(ShapeBase *)> &edit)
+{
+    if (selectedIndex < 0 || selectedIndex >= static_cast<int>(shapes.size()))
+        return;
 
-        shapes[selectedIndex]->setLineWidth(width);
-        update();
-    }
+    // 在副本上执行修改得到新的样式，图形本身仍然引用原来的共享样式
+    const ShapeBase &shape = *shapes[selectedIndex];
+    std::unique_ptr<ShapeBase> probe = shape.clone();
+    edit(probe.get());
+    restyleShapes(shape.styleHandle(), probe->style());
 }
 
-// 设置缩放因子
+// 设置缩放因子，以视口中心为缩放中心
 void DrawingArea::setZoomFactor(double factor)
+{
+    setZoomFactor(factor, viewport()->rect().center());
+}
+
+// 设置缩放因子，缩放前后anchor点（视口坐标）下的文档位置保持不变
+void DrawingArea::setZoomFactor(double factor, const QPoint &anchor)
 {
     // 限制缩放范围，防止太小或太大
     if (factor < 0.1)
@@ -1383,19 +3117,22 @@ void DrawingArea::setZoomFactor(double factor)
 
     if (m_zoomFactor != factor)
     {
+        // 记录缩放中心对应的文档坐标
+        QPointF docAnchor((anchor.x() + m_viewOrigin.x()) / m_zoomFactor,
+                          (anchor.y() + m_viewOrigin.y()) / m_zoomFactor);
+
+        // 新的帧完成之前，paintEvent会把缩放前的帧拉伸显示
+        beginInteraction();
+
         m_zoomFactor = factor;
 
-        // 调整窗口大小以适应缩放后的页面，添加一些边距
-        QSize newSize = docToScreen(m_pageSize);
-        // 添加边距，使缩放后的页面周围有一些空间
-        int margin = 40; // 40像素的边距
-        newSize.setWidth(newSize.width() + margin * 2);
-        newSize.setHeight(newSize.height() + margin * 2);
-        setMinimumSize(newSize);
-        resize(newSize);
+        // 调整视口原点，使缩放中心仍在原来的屏幕位置
+        m_viewOrigin = QPoint(qRound(docAnchor.x() * m_zoomFactor) - anchor.x(),
+                              qRound(docAnchor.y() * m_zoomFactor) - anchor.y());
+        updateScrollBars();
 
         // 需要更新内容
-        update();
+        viewport()->update();
 
         // 如果有文本编辑框打开，需要调整其位置和大小
         if (m_textEdit && selectedIndex >= 0 && selectedIndex < static_cast<int>(shapes.size()))
@@ -1409,6 +3146,238 @@ void DrawingArea::setZoomFactor(double factor)
     }
 }
 
+// 可滚动范围在缩放后内容坐标中的矩形（包含四周的空白）
+QRect DrawingArea::sceneContentRect() const
+{
+    QRect rect = sceneRect();
+    QRect contentRect(qFloor(rect.x() * m_zoomFactor), qFloor(rect.y() * m_zoomFactor),
+                      qCeil(rect.width() * m_zoomFactor), qCeil(rect.height() * m_zoomFactor));
+    return contentRect.adjusted(-kPageMargin, -kPageMargin, kPageMargin, kPageMargin);
+}
+
+// 根据场景范围和缩放因子更新滚动条范围，尽量保持当前视口原点不变
+void DrawingArea::updateScrollBars()
+{
+    QRect contentRect = sceneContentRect();
+    QSize viewSize = viewport()->size();
+
+    m_updatingScrollBars = true;
+    horizontalScrollBar()->setPageStep(viewSize.width());
+    verticalScrollBar()->setPageStep(viewSize.height());
+    horizontalScrollBar()->setRange(0, qMax(0, contentRect.width() - viewSize.width()));
+    verticalScrollBar()->setRange(0, qMax(0, contentRect.height() - viewSize.height()));
+    horizontalScrollBar()->setValue(m_viewOrigin.x() - contentRect.left());
+    verticalScrollBar()->setValue(m_viewOrigin.y() - contentRect.top());
+    m_updatingScrollBars = false;
+
+    // 滚动条位置被限制在范围内时视口原点会变化，需要整体重绘
+    QPoint origin = scrollBarsToViewOrigin(contentRect);
+    if (origin != m_viewOrigin)
+    {
+        m_viewOrigin = origin;
+        viewport()->update();
+    }
+}
+
+// 由滚动条位置计算视口原点；内容比视口小时居中显示
+QPoint DrawingArea::scrollBarsToViewOrigin(const QRect &contentRect) const
+{
+    QSize viewSize = viewport()->size();
+
+    int x = contentRect.left() + horizontalScrollBar()->value();
+    if (contentRect.width() <= viewSize.width())
+        x = contentRect.left() - (viewSize.width() - contentRect.width()) / 2;
+
+    int y = contentRect.top() + verticalScrollBar()->value();
+    if (contentRect.height() <= viewSize.height())
+        y = contentRect.top() - (viewSize.height() - contentRect.height()) / 2;
+
+    return QPoint(x, y);
+}
+
+void DrawingArea::scrollContentsBy(int dx, int dy)
+{
+    if (m_updatingScrollBars)
+        return; // 由缩放或调整范围引起的变化，调用方会负责整体刷新
+
+    QPoint oldOrigin = m_viewOrigin;
+    m_viewOrigin = scrollBarsToViewOrigin(sceneContentRect());
+    QPoint delta = oldOrigin - m_viewOrigin;
+
+    // 直接平移已有的位图，只需要重绘新露出的区域（文本编辑框作为子控件会一起移动）
+    if (!delta.isNull())
+    {
+        beginInteraction();
+        viewport()->scroll(delta.x(), delta.y());
+    }
+}
+
+void DrawingArea::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+
+    // 图块缓存容量随视口大小调整，保留约三屏的图块供来回平移使用
+    int columns = viewport()->width() / TileCache::kTileSize + 2;
+    int rows = viewport()->height() / TileCache::kTileSize + 2;
+    m_renderWorker->setTileCapacity(qMax(64, columns * rows * 3));
+
+    updateScrollBars();
+    viewport()->update();
+}
+
+// 当前场景的不可变快照：图形副本数组是持久的，快照之间共享，只有变化过的图形才重新复制
+std::shared_ptr<const RenderScene> DrawingArea::snapshotScene()
+{
+    auto scene = std::make_shared<RenderScene>();
+    scene->backgroundColor = m_bgColor;
+    scene->gridSize = m_gridSize;
+    scene->gridVisible = m_gridVisible;
+    scene->pageSize = m_pageSize;
+    scene->infiniteCanvas = m_infiniteCanvas;
+    scene->zoomFactor = m_zoomFactor;
+
+    // 副本属于渲染线程，不放在文档的内存池中
+    ShapeAllocator::Scope pool(ShapeAllocator::defaultPool());
+    auto copyOf = [this](const ShapeBase &shape)
+    {
+        std::shared_ptr<ShapeBase> copy = shape.clone();
+        // 共享样式可能在界面线程中被整体修改，副本改用不会再被修改的样式
+        copy->setStyle(snapshotStyle(shape.styleHandle()));
+        return copy;
+    };
+
+    if (m_snapshotReset || m_sceneShapes.size() != shapes.size())
+    {
+        m_sceneShapes.clear();
+        m_sceneShapes.reserve(shapes.size());
+        for (const auto &shape : shapes)
+            m_sceneShapes.push_back(copyOf(*shape));
+        m_snapshotReset = false;
+    }
+    else
+    {
+        // 只替换变化过的图形，它们所在的块仍被之前的快照引用时才复制
+        std::sort(m_snapshotDirty.begin(), m_snapshotDirty.end());
+        m_snapshotDirty.erase(std::unique(m_snapshotDirty.begin(), m_snapshotDirty.end()), m_snapshotDirty.end());
+        for (int i : m_snapshotDirty)
+        {
+            if (i >= 0 && i < static_cast<int>(shapes.size()))
+                m_sceneShapes.replace(i, copyOf(*shapes[i]));
+        }
+    }
+    m_snapshotDirty.clear();
+    scene->shapes = m_sceneShapes;
+
+    // 几何副表与快照共享，之后画布修改副表时会先复制一份
+    geometryTable();
+    scene->geometry = m_geometry;
+    groupTree();
+    scene->groups = m_groups;
+    return scene;
+}
+
+// 几何副表：图形增删或整体变化后在下次使用时重建
+const ShapeGeometryTable &DrawingArea::geometryTable() const
+{
+    if (!m_geometry || m_geometryDirty || m_geometry->size() != static_cast<int>(shapes.size()))
+    {
+        // 旧副表可能还被渲染线程的快照引用，不能原地修改
+        if (!m_geometry || m_geometry.use_count() > 1)
+            m_geometry = std::make_shared<ShapeGeometryTable>();
+        m_geometry->rebuild(shapes);
+        m_geometryDirty = false;
+        m_groupsDirty = true; // 图形可能有增删，分组的成员列表也要重建
+    }
+    return *m_geometry;
+}
+
+// 同步单个图形的几何信息；副表需要整体重建时不用单独更新
+void DrawingArea::updateGeometry(int index)
+{
+    if (!m_geometry || m_geometryDirty || m_geometry->size() != static_cast<int>(shapes.size()))
+        return;
+    if (m_geometry.use_count() > 1)
+        m_geometry = std::make_shared<ShapeGeometryTable>(*m_geometry);
+    m_geometry->update(index, *shapes[index]);
+    if (!m_groupsDirty && m_groups->groupOf(index) != ShapeGroupTree::kNoGroup)
+        mutableGroups().shapeChanged(index); // 所在各组的范围下次使用时重新计算
+}
+
+// 绘制范围与pos周围distance以内的区域相交的图形（按z序从下到上）
+std::vector<int> DrawingArea::shapesNear(const QPoint &pos, int distance) const
+{
+    std::vector<int> result;
+    groupTree().intersecting(QRect(pos.x() - distance, pos.y() - distance, distance * 2 + 1, distance * 2 + 1),
+                             geometryTable(), result);
+    return result;
+}
+
+// 当前视口需要的帧：交互过程中草稿质量即可
+ShapeStyleHandle DrawingArea::snapshotStyle(const ShapeStyleHandle &style)
+{
+    auto it = m_styleSnapshots.find(style.get());
+    if (it != m_styleSnapshots.end())
+        return it.value().second;
+
+    ShapeStyleHandle copy = ShapeStyleTable::detached(style);
+    m_styleSnapshots.insert(style.get(), std::make_pair(style, copy));
+    return copy;
+}
+
+FrameInfo DrawingArea::wantedFrame() const
+{
+    FrameInfo info;
+    info.contentRect = viewport()->rect().translated(m_viewOrigin);
+    info.zoomFactor = m_zoomFactor;
+    info.devicePixelRatio = viewport()->devicePixelRatioF();
+    info.quality = m_interacting ? SceneRenderer::Quality::Draft : SceneRenderer::Quality::Full;
+    info.sceneRevision = m_sceneRevision;
+    return info;
+}
+
+void DrawingArea::requestFrame(const FrameInfo &wanted)
+{
+    if (wanted.contentRect.isEmpty())
+        return;
+
+    FrameRequest request;
+    request.info = wanted;
+    request.info.contentRect = wanted.contentRect.adjusted(-kFrameMargin, -kFrameMargin, kFrameMargin, kFrameMargin);
+    request.scene = snapshotScene();
+    request.invalidateAll = m_pendingInvalidateAll;
+    request.dirtyDocRects.swap(m_pendingDirtyRects);
+    m_pendingInvalidateAll = false;
+
+    m_requestedFrame = request.info;
+    m_renderWorker->requestFrame(std::move(request));
+}
+
+void DrawingArea::beginInteraction()
+{
+    m_interacting = true;
+    m_idleTimer->start();
+}
+
+void DrawingArea::onInteractionIdle()
+{
+    // 鼠标仍按着（例如停在原地拖动）时继续等待
+    if (dragging)
+    {
+        m_idleTimer->start();
+        return;
+    }
+
+    // 重绘时会发现显示的是草稿，从而请求完整质量的帧
+    m_interacting = false;
+    viewport()->update();
+}
+
+// 当前视口中可见的文档区域
+QRect DrawingArea::visibleDocRect() const
+{
+    return screenToDoc(viewport()->rect());
+}
+
 // 放大
 void DrawingArea::zoomIn()
 {
@@ -1435,70 +3404,70 @@ void DrawingArea::wheelEvent(QWheelEvent *event)
     {
         // 获取滚轮的垂直角度增量
         int delta = event->angleDelta().y();
+        // 以鼠标位置为缩放中心
+        QPoint anchor = event->position().toPoint();
 
         if (delta > 0)
         {
             // 向上滚动，放大
-            zoomIn();
+            setZoomFactor(m_zoomFactor * 1.2, anchor);
         }
         else if (delta < 0)
         {
             // 向下滚动，缩小
-            zoomOut();
+            setZoomFactor(m_zoomFactor / 1.2, anchor);
         }
 
         event->accept(); // 标记事件已处理
     }
     else
     {
-        // 如果没有按Ctrl，则交给基类处理（可能是滚动操作）
-        QWidget::wheelEvent(event);
+        // 如果没有按Ctrl，则交给基类处理（滚动视口）
+        QAbstractScrollArea::wheelEvent(event);
     }
 }
 
-// 屏幕坐标转文档坐标
+// 屏幕坐标（视口坐标）转文档坐标
 QPoint DrawingArea::screenToDoc(const QPoint &pos) const
 {
-    return QPoint(pos.x() / m_zoomFactor, pos.y() / m_zoomFactor);
+    return QPoint(qFloor((pos.x() + m_viewOrigin.x()) / m_zoomFactor),
+                  qFloor((pos.y() + m_viewOrigin.y()) / m_zoomFactor));
 }
 
-// 文档坐标转屏幕坐标
+// 文档坐标转屏幕坐标（视口坐标）
 QPoint DrawingArea::docToScreen(const QPoint &pos) const
 {
-    return QPoint(pos.x() * m_zoomFactor, pos.y() * m_zoomFactor);
+    return QPoint(qRound(pos.x() * m_zoomFactor) - m_viewOrigin.x(),
+                  qRound(pos.y() * m_zoomFactor) - m_viewOrigin.y());
 }
 
 // 屏幕矩形转文档矩形
 QRect DrawingArea::screenToDoc(const QRect &rect) const
 {
     return QRect(
-        rect.x() / m_zoomFactor,
-        rect.y() / m_zoomFactor,
-        rect.width() / m_zoomFactor,
-        rect.height() / m_zoomFactor);
+        screenToDoc(rect.topLeft()),
+        QSize(qCeil(rect.width() / m_zoomFactor), qCeil(rect.height() / m_zoomFactor)));
 }
 
 // 文档矩形转屏幕矩形
 QRect DrawingArea::docToScreen(const QRect &rect) const
 {
-    return QRect(
-        rect.x() * m_zoomFactor,
-        rect.y() * m_zoomFactor,
-        rect.width() * m_zoomFactor,
-        rect.height() * m_zoomFactor);
+    return QRect(docToScreen(rect.topLeft()), docToScreen(rect.size()));
 }
 
 // 文档大小转屏幕大小
 QSize DrawingArea::docToScreen(const QSize &size) const
 {
     return QSize(
-        size.width() * m_zoomFactor,
-        size.height() * m_zoomFactor);
+        qRound(size.width() * m_zoomFactor),
+        qRound(size.height() * m_zoomFactor));
 }
 
 // 撤销操作
 void DrawingArea::undo()
 {
+    // 正在运行的力导向布局先记录为一步
+    stopForceLayout();
     if (m_undoStack.empty())
     {
         return;
@@ -1506,11 +3475,31 @@ void DrawingArea::undo()
 
     // 设置标志避免再次记录本次操作
     m_ignoreHistoryActions = true;
+    ShapeAllocator::Scope arena(m_arena); // 恢复的图形和反向操作
 
     // 取出最近的操作
     HistoryAction action = std::move(m_undoStack.top());
     m_undoStack.pop();
 
+    std::vector<HistoryAction> redoActions;
+    revertAction(std::move(action), redoActions);
+    for (auto &inverseAction : redoActions)
+        m_redoStack.push(std::move(inverseAction));
+
+    // 恢复标志
+    m_ignoreHistoryActions = false;
+    std::vector<QRect> regions;
+    regions.swap(m_routeRegions);
+    rerouteAffected({}, regions);
+
+    // 发出信号通知状态变化
+    emit canUndoChanged(canUndo());
+    emit canRedoChanged(canRedo());
+}
+
+// 撤销一步操作，对应的重做操作追加到inverse中
+void DrawingArea::revertAction(HistoryAction action, std::vector<HistoryAction> &inverse)
+{
     // 根据操作类型执行相反的操作
     switch (action.type)
     {
@@ -1521,20 +3510,13 @@ void DrawingArea::undo()
             // 保存到重做栈中，确保shape所有权正确转移
             HistoryAction redoAction(OperationType::Add, action.shapeIndex);
             redoAction.shape = shapes[action.shapeIndex]->clone();
-            m_redoStack.push(std::move(redoAction));
+            inverse.push_back(std::move(redoAction));
 
             // 执行删除
-            shapes.erase(shapes.begin() + action.shapeIndex);
-            if (selectedIndex == action.shapeIndex)
-            {
-                selectedIndex = -1;
-                emit selectionCleared();
-            }
-            else if (selectedIndex > action.shapeIndex)
-            {
-                selectedIndex--;
-            }
-            update();
+            addRouteRegion(*shapes[action.shapeIndex]);
+            eraseShape(action.shapeIndex);
+            selectionRemoved(action.shapeIndex);
+            invalidateScene();
         }
         break;
 
@@ -1553,24 +3535,21 @@ void DrawingArea::undo()
             }
 
             // 保存到重做栈
-            m_redoStack.push(std::move(redoAction));
+            inverse.push_back(std::move(redoAction));
 
-            // 恢复箭头连接关系
+            // 在原来的位置插入图形，再恢复箭头连接关系（下标是插入后的）
+            int insertIndex = std::min(action.shapeIndex, (int)shapes.size());
+            insertShape(insertIndex, std::move(action.shape));
+            addRouteRegion(*shapes[insertIndex]);
             for (const auto &conn : action.connections)
             {
                 arrowConnections.push_back(conn);
             }
-
-            // 在原来的位置插入图形
-            int insertIndex = std::min(action.shapeIndex, (int)shapes.size());
-            shapes.insert(shapes.begin() + insertIndex, std::move(action.shape));
+            invalidateConnectionIndex();
 
             // 更新选择索引
-            if (selectedIndex >= insertIndex)
-            {
-                selectedIndex++;
-            }
-            update();
+            selectionInserted(insertIndex);
+            invalidateScene();
         }
         break;
 
@@ -1583,15 +3562,17 @@ void DrawingArea::undo()
             redoAction.moveDelta = action.moveDelta;
 
             // 保存到重做栈
-            m_redoStack.push(std::move(redoAction));
+            inverse.push_back(std::move(redoAction));
 
             // 执行反向移动
             QPoint delta = -action.moveDelta; // 反向移动
+            addRouteRegion(*shapes[action.shapeIndex]);
             shapes[action.shapeIndex]->moveBy(delta);
+            addRouteRegion(*shapes[action.shapeIndex]);
 
             // 更新连接的箭头位置
             updateConnectedArrows(action.shapeIndex, delta);
-            update();
+            invalidateScene();
         }
         break;
 
@@ -1600,11 +3581,13 @@ void DrawingArea::undo()
         if (action.shapeIndex >= 0 && action.shapeIndex < shapes.size())
         {
             // 保存到重做栈
-            m_redoStack.push(std::move(action));
+            inverse.push_back(std::move(action));
 
             // 恢复原来的尺寸
+            addRouteRegion(*shapes[action.shapeIndex]);
             shapes[action.shapeIndex]->setRect(action.oldRect);
-            update();
+            addRouteRegion(*shapes[action.shapeIndex]);
+            invalidateScene();
         }
         break;
 
@@ -1613,27 +3596,65 @@ void DrawingArea::undo()
         if (action.shapeIndex >= 0 && action.shapeIndex < shapes.size())
         {
             // 保存到重做栈
-            m_redoStack.push(std::move(action));
+            inverse.push_back(std::move(action));
 
-            // 恢复原来的线条颜色和粗细
-            shapes[action.shapeIndex]->setLineColor(action.oldLineColor);
-            shapes[action.shapeIndex]->setLineWidth(action.oldLineWidth);
-            update();
+            // 恢复原来的属性
+            restoreProperties(action.shapeIndex, action.oldProperties);
+            invalidateScene();
         }
         break;
-    }
 
-    // 恢复标志
-    m_ignoreHistoryActions = false;
+    case OperationType::Restyle:
+        // 共享样式修改的撤销：把这一项样式改回原来的内容
+        ShapeStyleTable::instance().restyle(action.styleHandle, action.oldStyle);
+        inverse.push_back(std::move(action));
+        invalidateScene();
+        break;
 
-    // 发出信号通知状态变化
-    emit canUndoChanged(canUndo());
-    emit canRedoChanged(canRedo());
+    case OperationType::Transform:
+        // 批量变换的撤销：恢复变换前的几何状态
+        restoreGeometry(action.geometryBefore);
+        inverse.push_back(std::move(action));
+        break;
+
+    case OperationType::Regroup:
+        // 分组的撤销：恢复原来所属的组
+        applyGroupChanges(action.groupChanges, false);
+        inverse.push_back(std::move(action));
+        break;
+
+    case OperationType::Reorder:
+    {
+        // 图层顺序的撤销：按逆排列恢复
+        std::vector<int> inverseOrder(action.order.size());
+        for (size_t k = 0; k < action.order.size(); ++k)
+            inverseOrder[action.order[k]] = static_cast<int>(k);
+        applyOrder(inverseOrder);
+        inverse.push_back(std::move(action));
+        invalidateScene();
+        break;
+    }
+
+    case OperationType::Batch:
+    {
+        // 组合操作的撤销：倒序撤销每一步，得到的重做步骤再按原顺序存放
+        std::vector<HistoryAction> redoSteps;
+        for (auto it = action.children.rbegin(); it != action.children.rend(); ++it)
+            revertAction(std::move(**it), redoSteps);
+        HistoryAction redoAction(OperationType::Batch, -1);
+        for (auto it = redoSteps.rbegin(); it != redoSteps.rend(); ++it)
+            redoAction.children.push_back(std::make_unique<HistoryAction>(std::move(*it)));
+        inverse.push_back(std::move(redoAction));
+        break;
+    }
+    }
 }
 
 // 重做操作
 void DrawingArea::redo()
 {
+    // 正在运行的力导向布局先记录为一步
+    stopForceLayout();
     if (m_redoStack.empty())
     {
         return;
@@ -1641,11 +3662,31 @@ void DrawingArea::redo()
 
     // 设置标志避免再次记录本次操作
     m_ignoreHistoryActions = true;
+    ShapeAllocator::Scope arena(m_arena); // 恢复的图形和反向操作
 
     // 取出最近的操作
     HistoryAction action = std::move(m_redoStack.top());
     m_redoStack.pop();
 
+    std::vector<HistoryAction> undoActions;
+    replayAction(std::move(action), undoActions);
+    for (auto &inverseAction : undoActions)
+        m_undoStack.push(std::move(inverseAction));
+
+    // 恢复标志
+    m_ignoreHistoryActions = false;
+    std::vector<QRect> regions;
+    regions.swap(m_routeRegions);
+    rerouteAffected({}, regions);
+
+    // 发出信号通知状态变化
+    emit canUndoChanged(canUndo());
+    emit canRedoChanged(canRedo());
+}
+
+// 重做一步操作，对应的撤销操作追加到inverse中
+void DrawingArea::replayAction(HistoryAction action, std::vector<HistoryAction> &inverse)
+{
     // 根据操作类型执行相应的操作
     switch (action.type)
     {
@@ -1656,18 +3697,16 @@ void DrawingArea::redo()
             // 确保有一个副本可供撤销操作使用
             HistoryAction undoAction(OperationType::Add, action.shapeIndex);
             undoAction.shape = action.shape->clone();
-            m_undoStack.push(std::move(undoAction));
+            inverse.push_back(std::move(undoAction));
 
             // 在原来的位置插入图形
             int insertIndex = std::min(action.shapeIndex, (int)shapes.size());
-            shapes.insert(shapes.begin() + insertIndex, std::move(action.shape));
+            insertShape(insertIndex, std::move(action.shape));
+            addRouteRegion(*shapes[insertIndex]);
 
             // 更新选择索引
-            if (selectedIndex >= insertIndex)
-            {
-                selectedIndex++;
-            }
-            update();
+            selectionInserted(insertIndex);
+            invalidateScene();
         }
         break;
 
@@ -1676,20 +3715,13 @@ void DrawingArea::redo()
         if (action.shapeIndex >= 0 && action.shapeIndex < shapes.size())
         {
             // 保存到撤销栈
-            m_undoStack.push(std::move(action));
+            inverse.push_back(std::move(action));
 
             // 执行删除
-            shapes.erase(shapes.begin() + action.shapeIndex);
-            if (selectedIndex == action.shapeIndex)
-            {
-                selectedIndex = -1;
-                emit selectionCleared();
-            }
-            else if (selectedIndex > action.shapeIndex)
-            {
-                selectedIndex--;
-            }
-            update();
+            addRouteRegion(*shapes[action.shapeIndex]);
+            eraseShape(action.shapeIndex);
+            selectionRemoved(action.shapeIndex);
+            invalidateScene();
         }
         break;
 
@@ -1698,14 +3730,16 @@ void DrawingArea::redo()
         if (action.shapeIndex >= 0 && action.shapeIndex < shapes.size())
         {
             // 保存到撤销栈
-            m_undoStack.push(std::move(action));
+            inverse.push_back(std::move(action));
 
             // 执行移动
+            addRouteRegion(*shapes[action.shapeIndex]);
             shapes[action.shapeIndex]->moveBy(action.moveDelta);
+            addRouteRegion(*shapes[action.shapeIndex]);
 
             // 更新连接的箭头位置
             updateConnectedArrows(action.shapeIndex, action.moveDelta);
-            update();
+            invalidateScene();
         }
         break;
 
@@ -1714,11 +3748,13 @@ void DrawingArea::redo()
         if (action.shapeIndex >= 0 && action.shapeIndex < shapes.size())
         {
             // 保存到撤销栈
-            m_undoStack.push(std::move(action));
+            inverse.push_back(std::move(action));
 
             // 设置新的尺寸
+            addRouteRegion(*shapes[action.shapeIndex]);
             shapes[action.shapeIndex]->setRect(action.newRect);
-            update();
+            addRouteRegion(*shapes[action.shapeIndex]);
+            invalidateScene();
         }
         break;
 
@@ -1727,24 +3763,101 @@ void DrawingArea::redo()
         if (action.shapeIndex >= 0 && action.shapeIndex < shapes.size())
         {
             // 保存到撤销栈
-            m_undoStack.push(std::move(action));
+            inverse.push_back(std::move(action));
 
-            // 设置新的线条颜色和粗细
-            shapes[action.shapeIndex]->setLineColor(action.newLineColor);
-            shapes[action.shapeIndex]->setLineWidth(action.newLineWidth);
-            update();
+            // 设置修改后的属性
+            restoreProperties(action.shapeIndex, action.newProperties);
+            invalidateScene();
         }
         break;
+
+    case OperationType::Restyle:
+        // 共享样式修改的重做
+        ShapeStyleTable::instance().restyle(action.styleHandle, action.newStyle);
+        inverse.push_back(std::move(action));
+        invalidateScene();
+        break;
+
+    case OperationType::Transform:
+        // 批量变换的重做：恢复变换后的几何状态
+        restoreGeometry(action.geometryAfter);
+        inverse.push_back(std::move(action));
+        break;
+
+    case OperationType::Regroup:
+        // 分组的重做
+        applyGroupChanges(action.groupChanges, true);
+        inverse.push_back(std::move(action));
+        break;
+
+    case OperationType::Reorder:
+        // 图层顺序的重做
+        applyOrder(std::vector<int>(action.order.begin(), action.order.end()));
+        inverse.push_back(std::move(action));
+        invalidateScene();
+        break;
+
+    case OperationType::Batch:
+    {
+        // 组合操作的重做：按原顺序重做每一步
+        std::vector<HistoryAction> undoSteps;
+        for (auto &child : action.children)
+            replayAction(std::move(*child), undoSteps);
+        HistoryAction undoAction(OperationType::Batch, -1);
+        for (auto &step : undoSteps)
+            undoAction.children.push_back(std::make_unique<HistoryAction>(std::move(step)));
+        inverse.push_back(std::move(undoAction));
+        break;
+    }
     }
+}
 
-    // 恢复标志
-    m_ignoreHistoryActions = false;
+// 把一步操作压入撤销栈；批量操作期间先收集起来，结束时合并为一步
+void DrawingArea::pushHistory(HistoryAction action)
+{
+    ShapeAllocator::Scope arena(m_arena);
+    if (m_historyBatchDepth > 0)
+    {
+        m_historyBatch.push_back(std::move(action));
+        return;
+    }
+
+    m_undoStack.push(std::move(action));
+    clearRedoStack();
 
-    // 发出信号通知状态变化
     emit canUndoChanged(canUndo());
     emit canRedoChanged(canRedo());
 }
 
+// 开始一组批量操作，可以嵌套，最外层结束时才合并
+void DrawingArea::beginHistoryBatch()
+{
+    ++m_historyBatchDepth;
+}
+
+void DrawingArea::endHistoryBatch()
+{
+    if (m_historyBatchDepth == 0 || --m_historyBatchDepth > 0)
+        return;
+
+    ShapeAllocator::Scope arena(m_arena);
+    HistoryVector<HistoryAction> actions;
+    actions.swap(m_historyBatch);
+    if (actions.empty())
+        return;
+    if (actions.size() == 1)
+    {
+        pushHistory(std::move(actions.front()));
+        return;
+    }
+
+    HistoryAction batch(OperationType::Batch, -1);
+    batch.children.reserve(actions.size());
+    for (auto &step : actions)
+        batch.children.push_back(std::make_unique<HistoryAction>(std::move(step)));
+    pushHistory(std::move(batch));
+}
+
 // 记录添加图形操作
 void DrawingArea::recordAddShape(int index)
 {
@@ -1756,16 +3869,13 @@ void DrawingArea::recordAddShape(int index)
         return;
     }
 
+    ShapeAllocator::Scope arena(m_arena);
     HistoryAction action(OperationType::Add, index);
 
     // 为添加操作保存图形的副本，确保正确克隆
     action.shape = shapes[index]->clone();
 
-    m_undoStack.push(std::move(action));
-    clearRedoStack();
-
-    emit canUndoChanged(canUndo());
-    emit canRedoChanged(canRedo());
+    pushHistory(std::move(action));
 }
 
 // 记录删除图形操作
@@ -1774,25 +3884,23 @@ void DrawingArea::recordRemoveShape(int index)
     if (m_ignoreHistoryActions || index < 0 || index >= shapes.size())
         return;
 
+    ShapeAllocator::Scope arena(m_arena);
     HistoryAction action(OperationType::Remove, index);
 
     // 克隆当前图形
     action.shape = shapes[index]->clone();
 
-    // 记录和该图形相关的箭头连接
-    for (const auto &conn : arrowConnections)
+    // 记录和该图形相关的箭头连接（图形是箭头时也包括它自己的连接）
+    for (int k : connectionsOf(index))
     {
-        if (conn.shapeIndex == index)
+        const auto &conn = arrowConnections[k];
+        if (conn.shapeIndex == index || conn.arrowIndex == index)
         {
             action.connections.push_back(conn);
         }
     }
 
-    m_undoStack.push(std::move(action));
-    clearRedoStack();
-
-    emit canUndoChanged(canUndo());
-    emit canRedoChanged(canRedo());
+    pushHistory(std::move(action));
 }
 
 // 记录移动图形操作
@@ -1804,11 +3912,7 @@ void DrawingArea::recordMoveShape(int index, const QPoint &delta)
     HistoryAction action(OperationType::Move, index);
     action.moveDelta = delta;
 
-    m_undoStack.push(std::move(action));
-    clearRedoStack();
-
-    emit canUndoChanged(canUndo());
-    emit canRedoChanged(canRedo());
+    pushHistory(std::move(action));
 }
 
 // 记录调整图形尺寸操作
@@ -1821,39 +3925,25 @@ void DrawingArea::recordResizeShape(int index, const QRect &oldRect, const QRect
     action.oldRect = oldRect;
     action.newRect = newRect;
 
-    m_undoStack.push(std::move(action));
-    clearRedoStack();
-
-    emit canUndoChanged(canUndo());
-    emit canRedoChanged(canRedo());
+    pushHistory(std::move(action));
 }
 
 // 记录图形属性变更操作
-void DrawingArea::recordPropertyChange(int index, const QColor &oldColor, const QColor &newColor,
-                                       int oldWidth, int newWidth)
+void DrawingArea::recordPropertyChange(int index, const ShapeProperties &before)
 {
     if (m_ignoreHistoryActions || index < 0 || index >= shapes.size())
         return;
 
     HistoryAction action(OperationType::Property, index);
-    action.oldLineColor = oldColor;
-    action.newLineColor = newColor;
-    action.oldLineWidth = oldWidth;
-    action.newLineWidth = newWidth;
-
-    m_undoStack.push(std::move(action));
-    clearRedoStack();
+    action.oldProperties = before;
+    action.newProperties = captureProperties(index);
 
-    emit canUndoChanged(canUndo());
-    emit canRedoChanged(canRedo());
+    pushHistory(std::move(action));
 }
 
 // 清空重做堆栈
 void DrawingArea::clearRedoStack()
 {
-    while (!m_redoStack.empty())
-    {
-        m_redoStack.pop();
-    }
+    decltype(m_redoStack)().swap(m_redoStack);
     emit canRedoChanged(false);
 }
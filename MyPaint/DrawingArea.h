@@ -1,14 +1,33 @@
 #ifndef DRAWINGAREA_H
 #define DRAWINGAREA_H
 
+#include "AlignmentGuides.h"
+#include "ConnectorRouter.h"
 #include "EllipseTextEdit.h"
+#include "ForceLayout.h"
+#include "LayoutWorker.h"
+#include "RenderWorker.h"
+#include "SceneRenderer.h"
+#include "ShapeAllocator.h"
+#include "ShapeArrow.h"
 #include "ShapeBase.h"
+#include "ShapeGeometryTable.h"
+#include "ShapeGroupTree.h"
+#include "ShapeStyle.h"
+#include "TreeLayout.h"
+#include <QAbstractScrollArea>
 #include <QClipboard>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QLineEdit>
 #include <QMenu>
 #include <QPoint>
+#include <QPointF>
+#include <QPolygon>
 #include <QRect>
-#include <QWidget>
+#include <QRegion>
+#include <QTimer>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <stack>
@@ -22,10 +41,15 @@ enum class OperationType {
   Remove,   // 删除图形
   Move,     // 移动图形
   Resize,   // 调整图形尺寸
-  Property  // 属性更改
+  Property, // 属性更改
+  Restyle,  // 修改共享样式
+  Reorder,  // 调整图层顺序
+  Transform, // 批量变换一组图形
+  Regroup,  // 修改分组
+  Batch     // 一组操作，作为一步撤销和重做
 };
 
-class DrawingArea : public QWidget
+class DrawingArea : public QAbstractScrollArea
 {
   Q_OBJECT
 public:
@@ -40,6 +64,8 @@ signals:
   void pageSizeChanged(QSize size);         // 当页面大小变化时发出信号
   void gridSizeChanged(int size);           // 当网格大小变化时发出信号
   void gridVisibilityChanged(bool visible); // 当网格显示状态变化时发出信号
+  void snapToGridChanged(bool snap);        // 当网格吸附开关变化时发出信号
+  void infiniteCanvasChanged(bool infinite); // 当无限画布模式变化时发出信号
   void canUndoChanged(bool canUndo);        // 当可撤销状态变化时发出信号
   void canRedoChanged(bool canRedo);        // 当可重做状态变化时发出信号
 
@@ -49,7 +75,7 @@ public:
     if (m_bgColor != color) {
       m_bgColor = color;
       emit backgroundColorChanged(color);
-      update();
+      invalidateScene();
     }
   }
   QColor getBackgroundColor() const { return m_bgColor; }
@@ -57,12 +83,31 @@ public:
   void setPageSize(const QSize &size);
   void setGridVisible(bool visible); // 设置网格显示/隐藏
 
+  // 网格吸附：移动和缩放时图形的位置和大小对齐到网格，按住Shift对齐到更细的子网格，按住Alt临时关闭
+  static const int kSubGridDivisions = 4; // 子网格把一格分成几份
+  void setSnapToGrid(bool snap);
+  bool isSnapToGrid() const { return m_snapToGrid; }
+
+  // 设置选中的箭头的走向（直线、折线、曲线）
+  void setSelectedArrowRouting(ShapeArrow::Routing routing);
+
+  // 无限画布：不再受页面大小限制，可滚动范围随内容扩展
+  void setInfiniteCanvas(bool infinite);
+  bool isInfiniteCanvas() const { return m_infiniteCanvas; }
+
+  // 图形在外部（如属性面板）被修改后调用，重绘整个场景
+  void invalidateScene();
+
   // 缩放功能
   void setZoomFactor(double factor);                    // 设置缩放因子
   void zoomIn();                                        // 放大
   void zoomOut();                                       // 缩小
   void resetZoom();                                     // 重置缩放
   double getZoomFactor() const { return m_zoomFactor; } // 获取当前缩放因子
+  void setZoomFactor(double factor, const QPoint &anchor); // 以视口中的anchor点为中心缩放
+
+  // 视口相关：画布只绘制视口内可见的文档区域
+  QRect visibleDocRect() const; // 当前视口中可见的文档区域（文档坐标）
 
   // 文件操作
   bool saveToFile(const QString &fileName);
@@ -82,6 +127,64 @@ public:
   // 设置选中图形的线条颜色和粗细
   void setSelectedShapeLineColor(const QColor &color);
   void setSelectedShapeLineWidth(int width);
+
+  // 修改一项共享样式：所有使用这项样式的图形一起改变，不需要逐个修改图形
+  void restyleShapes(const ShapeStyleHandle &handle, const ShapeStyle &style);
+  // 对主选图形的样式执行edit，结果作为它使用的共享样式的新内容（属性面板“应用到所有使用此样式的图形”）
+  void restyleSelected(const std::function<void(ShapeBase *)> &edit);
+
+  // 多选：选中的图形下标按升序存放，selectedIndex 是其中的主选图形（锚点和属性面板针对它）
+  const std::vector<int> &selection() const { return m_selection; }
+  void selectAll();
+  void clearSelection();
+  // 对所有选中的图形执行同一个样式修改，记录为一步撤销，最后只重绘一次
+  void applyToSelection(const std::function<void(ShapeBase *)> &edit);
+
+  // 批量变换：先以pivot为中心缩放，再绕pivot旋转rotation（弧度），最后平移translation
+  struct ShapeTransform
+  {
+    QPointF pivot;
+    qreal scaleX = 1.0;
+    qreal scaleY = 1.0;
+    qreal rotation = 0.0;
+    QPointF translation;
+  };
+  // 一次完成一组图形的变换：几何、连接的箭头端点和几何副表各更新一遍，
+  // 只提交一块重绘区域，记录为一步历史
+  void transformShapes(const std::vector<int> &indices, const ShapeTransform &transform);
+  void transformSelection(const ShapeTransform &transform) { transformShapes(m_selection, transform); }
+  // 属性面板直接修改选中图形的矩形或旋转角度：连接的箭头随之更新并重新布线，记录为一步
+  void editSelectedGeometry(const std::function<void(ShapeBase *)> &edit);
+
+  // 框选的判定方式
+  enum class SelectionMode
+  {
+    Contained,   // 图形完全落在区域内
+    Intersecting // 图形与区域相交
+  };
+  // 落在文档矩形rect或区域area（闭合多边形）中的图形，按z序从下到上返回
+  std::vector<int> shapesInRect(const QRect &rect, SelectionMode mode) const;
+  std::vector<int> shapesInArea(const QPolygon &area, SelectionMode mode) const;
+
+  // 自动布局：选中两个以上的图形时只排列选中的图形，否则排列所有图形，箭头作为图形之间的有向边。
+  // 布局在后台线程中计算，完成后所有图形的移动记录为一步；计算期间场景发生变化时放弃结果
+  void layoutLayered();   // 分层布局，适合流程图
+  void layoutTree(TreeLayout::Orientation orientation); // 树形布局，适合组织结构图
+  // 只重新排列选中图形沿箭头方向下面的子树，选中的图形保持不动，方向与上一次树形布局相同
+  void layoutSubtree();
+  void cancelLayout();    // 取消正在计算的布局（Esc）
+  bool isLayoutRunning() const { return m_layoutWorker->isRunning(); }
+  // 力导向布局，适合没有明显方向的网络图。在GUI线程中逐帧推进，图形移动的过程直接显示出来；
+  // 稳定、再次调用stopForceLayout或开始其他操作时停止，整个过程记录为一步
+  void startForceLayout();
+  void stopForceLayout();
+  bool isForceLayoutRunning() const { return m_force != nullptr; }
+  void setSelectionPinned(bool pinned); // 固定的图形在力导向布局中不动
+
+  // 分组：组可以嵌套。点中组中的图形时选中整个最外层组，移动、缩放等变换作为一步作用于组中所有图形
+  void groupSelection();   // 选中的图形和组组成一个新组，成员在z序上移到一起
+  void ungroupSelection(); // 拆开选中的最外层组，子组成为顶层组
+  void setSelectionCachedAsImage(bool cached); // 选中的组没有变化时用缓存的图像绘制
   
   // 撤销和重做功能
   void undo();  // 撤销上一步操作
@@ -89,6 +192,21 @@ public:
   bool canUndo() const { return !m_undoStack.empty(); } // 是否可以撤销
   bool canRedo() const { return !m_redoStack.empty(); } // 是否可以重做
 
+  // 交互统计：记录鼠标移动事件的合并情况，供性能分析使用
+  struct InteractionStats
+  {
+    quint64 inputEvents = 0;     // 收到的鼠标移动事件总数
+    quint64 mergedEvents = 0;    // 被后续事件覆盖、未单独处理的事件数
+    quint64 processedFrames = 0; // 实际执行几何更新的帧数
+    qint64 lastFrameCostUs = 0;  // 最近一帧几何更新的耗时（微秒）
+  };
+  const InteractionStats &interactionStats() const { return m_interactionStats; }
+  void resetInteractionStats() { m_interactionStats = InteractionStats(); }
+
+  // 本文档内存池的分配统计
+  ShapeAllocator::Stats allocationStats() const { return m_arena.stats(); }
+  void resetAllocationStats() { m_arena.resetCounters(); }
+
 protected:
   void paintEvent(QPaintEvent *event) override;
   void mousePressEvent(QMouseEvent *event) override;
@@ -100,6 +218,8 @@ protected:
   void dropEvent(QDropEvent *event) override;               // 拖拽释放事件
   void contextMenuEvent(QContextMenuEvent *event) override; // 右键菜单事件
   void wheelEvent(QWheelEvent *event) override;             // 滚轮事件用于缩放支持
+  void resizeEvent(QResizeEvent *event) override;           // 视口大小变化时更新滚动条
+  void scrollContentsBy(int dx, int dy) override;           // 滚动时平移视口内容
 
 public:
   // 记录箭头和图形之间的连接关系
@@ -109,16 +229,25 @@ public:
     int shapeIndex;    // 连接的图形索引
     int handleIndex;   // 连接的锚点索引
     bool isStartPoint; // 是否是箭头的起点
+    double perimeter = -1.0; // 粘附在轮廓上时的位置（占周长的比例），小于0时使用handleIndex的锚点
   };
 
 private:
+  // 本文档的内存池：图形、历史记录和其中的容器都从这里分配，清空文档时一次释放。
+  // 在图形之前声明，最后析构；创建这些对象的地方用 ShapeAllocator::Scope 把它设为当前内存池
+  ShapeAllocator m_arena;
+  template <typename T>
+  using HistoryVector = std::vector<T, ShapeAllocator::Allocator<T>>;
+
   QColor m_bgColor = Qt::white;
   int m_gridSize = 20;                            // 默认20
   bool m_gridVisible = true;                      // 控制网格显示/隐藏
+  bool m_snapToGrid = false;                      // 移动和缩放时是否吸附到网格
   double m_zoomFactor = 1.0;                      // 缩放因子
   QSize m_pageSize = QSize(1050, 1500);           // 默认页面大小(A4)
   std::vector<std::unique_ptr<ShapeBase>> shapes; // 存储所有形状的列表
-  int selectedIndex = -1;                         // 当前选中的图形索引
+  int selectedIndex = -1;                         // 当前选中的图形索引（多选时为主选图形）
+  std::vector<int> m_selection;                   // 所有选中的图形索引，升序
   int snappedShapeIndex = -1;                     // 记录被吸附的图形索引
   QPoint lastMousePos;                            // 上一次鼠标位置
   QPoint m_moveStartPos;                          // 开始移动时的鼠标位置，用于计算总移动量
@@ -126,12 +255,120 @@ private:
   bool resizing = false;                          // 是否正在调整尺寸
   QRect originalRect;                             // 记录开始调整尺寸前的原始矩形
 
-  // 坐标转换函数（考虑缩放因子）
+  // 帧节拍交互调度：每帧只处理最新的鼠标位置
+  QTimer *m_frameTimer = nullptr;     // 等待下一帧节拍的定时器
+  QElapsedTimer m_lastFrameClock;     // 距上一次几何更新的时间
+  QPoint m_pendingMousePos;           // 尚未处理的最新鼠标位置（文档坐标）
+  bool m_hasPendingMove = false;      // 是否有待处理的鼠标位置
+  InteractionStats m_interactionStats;
+  void schedulePointerMove(const QPoint &docPos); // 记录鼠标位置并安排处理
+  void flushPendingMove();                        // 立即处理挂起的鼠标位置
+  void cancelPendingMove();                       // 丢弃挂起的鼠标位置
+  void processPointerMove(const QPoint &docPos);  // 执行一次拖动/缩放/旋转的几何更新
+  int frameIntervalMs() const;                    // 当前屏幕的帧间隔
+
+  // 虚拟视口：m_viewOrigin 是视口左上角对应的缩放后内容坐标
+  QPoint m_viewOrigin;
+  bool m_updatingScrollBars = false; // 正在调整滚动条范围，此时不做位图平移
+  bool m_infiniteCanvas = false;     // 是否为无限画布模式
+  void updateScrollBars();           // 根据场景范围和缩放重新计算滚动条范围
+  QPoint scrollBarsToViewOrigin(const QRect &contentRect) const;
+  QRect contentBounds() const;    // 所有图形绘制范围的并集（文档坐标）
+  QRect sceneRect() const;        // 可滚动的文档范围
+  QRect sceneContentRect() const; // 可滚动范围在缩放后内容坐标中的矩形
+  QRect exportRect() const;       // 导出时使用的文档范围
+
+  // 选择集维护
+  bool isSelected(int index) const;
+  void selectShape(int index);             // 只选中一个图形，-1表示清空
+  void toggleSelection(int index);         // Shift/Ctrl点击时加入或移出选择
+  void selectionInserted(int index);       // 在index处插入图形后调整选中的下标
+  void selectionRemoved(int index);        // 删除index处的图形后调整选中的下标
+  void emitSelectionChanged(int oldIndex); // 主选图形变化时通知属性面板
+
+  // 框选：在空白处拖动为橡皮筋矩形（从左向右要求完全包含，从右向左只需相交），按住Alt为自由套索。
+  // 拖动过程中只重绘矩形边缘、套索新增的一段和预览状态发生变化的图形
+  enum class MarqueeShape
+  {
+    None,
+    Rect,
+    Lasso
+  };
+  struct Marquee
+  {
+    MarqueeShape shape = MarqueeShape::None;
+    QPoint origin;          // 按下的位置（文档坐标）
+    QRect rect;             // 橡皮筋矩形（文档坐标）
+    QPolygon lasso;         // 套索经过的点（文档坐标）
+    bool additive = false;  // 按住Shift/Ctrl时在原有选择上追加
+    std::vector<int> hits;  // 当前框中的图形，升序
+  };
+  Marquee m_marquee;
+  void beginMarquee(const QPoint &docPos, Qt::KeyboardModifiers modifiers);
+  void updateMarquee(const QPoint &docPos);
+  void finishMarquee();
+  QPolygon marqueeArea() const;
+  SelectionMode marqueeMode() const;
+  QRegion marqueeEdgeRegion(const QRect &docRect) const; // 橡皮筋矩形边框在视口中的区域
+  void invalidatePreview(const std::vector<int> &before, const std::vector<int> &after);
+  bool shapeInArea(int index, const QPainterPath &area, SelectionMode mode) const;
+
+  // 几何副表：图形的绘制范围、种类等按结构数组存放，扫描全部图形时使用。
+  // 渲染快照与画布共享同一份副表，修改前如果仍被快照引用就先复制一份
+  mutable std::shared_ptr<ShapeGeometryTable> m_geometry;
+  mutable bool m_geometryDirty = true;
+  const ShapeGeometryTable &geometryTable() const; // 需要时重建副表
+  void updateGeometry(int index);                  // 同步单个图形的几何信息
+  std::vector<int> shapesNear(const QPoint &pos, int distance) const; // 绘制范围在pos附近的图形
+
+  // 分组（见 ShapeGroupTree）：成员列表和范围与几何副表一起在需要时重建，渲染快照共享同一份
+  struct GroupChange // 一个图形所属的组，或一个组的父组
+  {
+    int index;    // 图形下标或组号
+    bool isGroup; // index是组号
+    int before;
+    int after;
+  };
+  mutable std::shared_ptr<ShapeGroupTree> m_groups = std::make_shared<ShapeGroupTree>();
+  mutable bool m_groupsDirty = true;
+  const ShapeGroupTree &groupTree() const; // 需要时重建成员列表、重新计算范围
+  ShapeGroupTree &mutableGroups() const;   // 仍被快照引用时先复制一份
+  // 加上这些图形所在的最外层组的其他成员，升序；wholeGroupsOnly为true时只保留全部成员都在indices中的组
+  std::vector<int> expandToGroups(const std::vector<int> &indices, bool wholeGroupsOnly = false) const;
+  std::vector<int> selectedTopGroups() const; // 选中图形所在的最外层组
+  void applyGroupChanges(const HistoryVector<GroupChange> &changes, bool redo);
+
+  // 渲染线程：GUI线程只生成场景快照并提交请求，绘制时直接贴上渲染好的帧，选中状态每次直接叠加绘制
+  RenderWorker *m_renderWorker = nullptr;
+  quint64 m_sceneRevision = 0;            // 场景内容每次变化都会增加
+  bool m_pendingInvalidateAll = false;    // 下一次请求时需要整体重绘
+  std::vector<QRect> m_pendingDirtyRects; // 下一次请求时需要重绘的文档区域
+  FrameInfo m_requestedFrame;             // 最近一次提交的请求
+  SceneShapes m_sceneShapes;        // 持久的快照图形数组，与shapes一一对应，未变化的部分在快照之间共享
+  std::vector<int> m_snapshotDirty; // 变化过的图形，下一次快照时只重新复制这些
+  bool m_snapshotReset = true;      // 下一次快照时全部重新复制
+  // 图形副本使用的样式副本（键为原样式），同一项样式的副本在快照之间共享；值中同时持有原样式，保证键不会被重用
+  QHash<const ShapeStyleEntry *, std::pair<ShapeStyleHandle, ShapeStyleHandle>> m_styleSnapshots;
+  ShapeStyleHandle snapshotStyle(const ShapeStyleHandle &style);
+  std::shared_ptr<const RenderScene> snapshotScene(); // 生成当前场景的不可变快照
+  FrameInfo wantedFrame() const;                     // 当前视口需要的帧
+  void requestFrame(const FrameInfo &wanted);        // 提交渲染请求
+  void invalidateDocRect(const QRect &docRect);      // 只重绘文档中的一块区域
+  std::vector<QRect> snapshotPaintBounds(const std::vector<int> &indices) const; // 这些图形当前的绘制范围（取自几何副表）
+  void invalidateChangedShapes(const std::vector<int> &indices, const std::vector<QRect> &boundsBefore); // 重绘其中范围变化的图形
+
+  // 渐进式渲染：平移、缩放、拖动时请求草稿质量的帧，空闲后再请求完整质量
+  bool m_interacting = false;    // 是否处于交互过程中
+  QTimer *m_idleTimer = nullptr; // 交互停止一段时间后请求完整质量
+  void beginInteraction();       // 进入交互状态，并重新开始空闲计时
+  void onInteractionIdle();      // 交互停止后调用
+
+  // 坐标转换函数（考虑缩放因子和视口偏移）
   QPoint screenToDoc(const QPoint &pos) const; // 屏幕坐标转文档坐标
   QPoint docToScreen(const QPoint &pos) const; // 文档坐标转屏幕坐标
   QRect screenToDoc(const QRect &rect) const;  // 屏幕矩形转文档矩形
   QRect docToScreen(const QRect &rect) const;  // 文档矩形转屏幕矩形
-  QSize docToScreen(const QSize &size) const;  // 文档大小转屏幕大小
+  QSize docToScreen(const QSize &size) const;  // 文档大小转屏幕大小（只缩放，不平移）
 
   // 文本编辑相关
   QWidget *m_textEdit =
@@ -150,6 +387,20 @@ private:
 
   std::vector<ArrowConnection> arrowConnections;
 
+  // 每个图形（或箭头）相关的连接在arrowConnections中的下标，连接变化后第一次使用时重建
+  mutable std::vector<std::vector<int>> m_connectionIndex;
+  mutable bool m_connectionIndexDirty = true;
+  void invalidateConnectionIndex() { m_connectionIndexDirty = true; }
+  const std::vector<int> &connectionsOf(int index) const;
+
+  // 连接的箭头端点现在应在的位置：粘附在轮廓上的按周长比例计算，否则取固定锚点
+  bool connectionPoint(const ArrowConnection &conn, QPoint &pos) const;
+  // 箭头端点在docPos处可以连接的位置：优先吸附到附近的锚点，其次粘附到鼠标下图形的轮廓
+  bool findGlueTarget(int arrowIndex, const QPoint &docPos, const QPoint &otherEnd,
+                      ArrowConnection &conn, QPoint &pos) const;
+  // 释放箭头端点时重新连接，没有可连接的位置时断开原有连接
+  void glueArrowEnd(int arrowIndex, bool isStartPoint, const QPoint &docPos);
+
   // 更新连接的箭头位置
   void updateConnectedArrows(int shapeIndex, const QPoint &delta);
 
@@ -160,11 +411,94 @@ private:
   void cutSelectedShape();
   void pasteShape();
   void deleteSelectedShape();
-  std::unique_ptr<ShapeBase> m_clipboardShape; // 用于存储复制的图形
+  std::vector<std::unique_ptr<ShapeBase>> m_clipboardShapes; // 用于存储复制的图形
+
+  // 批量变换的实现
+  struct ShapeGeometryState // 图形的几何状态，批量变换的撤销和重做直接恢复这些状态
+  {
+    int index;
+    QRect rect;
+    double rotation;
+    QLine line; // 箭头的端点
+  };
+  std::vector<ShapeGeometryState> m_dragGeometry;                        // 多选拖动开始时的几何状态
+
+  // 拖动时的对齐参考线
+  AlignmentGuides m_alignment;      // 其他图形的边索引，第一次需要吸附时建立
+  bool m_alignmentReady = false;    // 本次拖动是否已经建立了索引
+  QRect m_dragBounds;               // 拖动开始时选中图形的对齐矩形
+  QPoint m_dragOffset;              // 已经施加给选中图形的总偏移（含吸附）
+  std::vector<QLine> m_guideLines;  // 当前显示的参考线（文档坐标）
+
+  // 折线连接线的布线。路径缓存在箭头上，图形变化（包括增删和撤销）时只重新计算
+  // 端点移动了的、路径已经过期的、或者走廊与变化的图形相交的连接线
+  std::vector<QRect> m_routeRegions; // 撤销和重做过程中变化了的障碍物范围，结束后一起重新布线
+  void addRouteRegion(const ShapeBase &shape); // 非箭头图形当前的范围加入m_routeRegions
+  void rerouteArrows(const std::vector<int> &arrows);
+  // changed（升序）中的图形发生了变化，regions是其中非箭头图形变化前后的范围
+  void rerouteAffected(const std::vector<int> &changed, const std::vector<QRect> &regions);
+  // 鼠标移到docPos时选中图形这一次需要移动的距离，snap为true时吸附到网格或其他图形的边
+  QPoint dragDelta(const QPoint &docPos, bool snap);
+  // 当前的网格吸附步长，没有开启网格吸附或按住Alt时为0
+  int gridSnapStep() const;
+  void setGuideLines(std::vector<QLine> lines);
+  std::vector<int> transformTargets(const std::vector<int> &indices) const; // 加上连接的箭头，升序
+  std::vector<ShapeGeometryState> captureGeometry(const std::vector<int> &indices) const;
+  // 可以撤销的图形属性：样式、力导向布局中的固定状态和连接线的布线方式
+  struct ShapeProperties
+  {
+    ShapeStyle style;
+    bool pinned = false;
+    ShapeArrow::Routing routing = ShapeArrow::Routing::Straight; // 只用于箭头
+  };
+  ShapeProperties captureProperties(int index) const;
+  void restoreProperties(int index, const ShapeProperties &properties);
+  void restoreGeometry(const HistoryVector<ShapeGeometryState> &states);
+  void applyTransform(const std::vector<int> &indices, const ShapeTransform &transform); // 不记录历史
+  void resolveConnectedArrows(const std::vector<int> &indices); // 与这些图形相关的箭头端点各计算一次
+  void invalidateShapes(const std::vector<int> &indices, const std::vector<QRect> &boundsBefore);
+  void recordTransform(std::vector<ShapeGeometryState> before, std::vector<ShapeGeometryState> after);
+
+  // 自动布局的实现
+  using LayoutFunction = std::function<bool(const LayoutGraph &, const LayoutCancel &, std::vector<QPoint> &)>;
+  LayoutWorker *m_layoutWorker = nullptr;
+  std::vector<int> m_layoutNodes; // 正在布局的图形，与布局图中的节点一一对应
+  int m_layoutAnchor = -1;        // 保持不动的节点，-1表示保持整体的左上角
+  QPoint m_layoutOrigin;          // 保持不动的节点（或整体）原来的左上角
+  quint64 m_layoutRevision = 0;   // 开始布局时的场景版本
+  TreeLayout::Orientation m_treeOrientation = TreeLayout::Orientation::TopDown;
+  LayoutGraph layoutGraph(std::vector<int> &nodes) const; // 要布局的图形和它们之间的连接
+  LayoutGraph subtreeGraph(int root, std::vector<int> &nodes) const; // 从root沿箭头能到达的部分，root是节点0
+  void startLayout(const LayoutFunction &layout, std::vector<int> nodes, LayoutGraph graph, int anchor = -1);
+  void onLayoutFinished(quint64 generation, bool completed);
+  // 把一组图形的外接矩形左上角分别移到topLefts，连接的箭头随之更新，记录为一步历史
+  void moveShapesTo(const std::vector<int> &indices, const std::vector<QPoint> &topLefts);
+  // 同上但不记录历史，targets是transformTargets(indices)
+  void placeShapes(const std::vector<int> &indices, const std::vector<QPoint> &topLefts,
+                   const std::vector<int> &targets);
+
+  // 力导向布局的状态，m_force为空表示没有运行
+  static const int kForceStepBudgetMs = 8; // 每一帧用于推进布局的时间
+  std::unique_ptr<ForceLayout> m_force;
+  std::vector<int> m_forceNodes;                  // 参与布局的图形，与布局中的节点一一对应
+  std::vector<int> m_forceTargets;                // 加上连接的箭头
+  std::vector<ShapeGeometryState> m_forceBefore;  // 开始时的几何状态，停止时与最终状态一起记录
+  QTimer *m_forceTimer = nullptr;
+  void forceTick();
+
+  // 图层顺序：order[k] 是调整后第k层原来的下标，连接关系和选择随之调整
+  void reorderShapes(const std::vector<int> &order);
+  void applyOrder(const std::vector<int> &order);
+  // 增删单个图形，连接中的下标随之调整（不记录历史）
+  void eraseShape(int index);
+  void insertShape(int index, std::unique_ptr<ShapeBase> shape);
   
-  // 历史记录类，记录一步操作
+  // 历史记录类，记录一步操作。记录本身（组合操作中的各步）和其中的容器都从文档的内存池分配
   class HistoryAction {
   public:
+    static void *operator new(std::size_t size) { return ShapeAllocator::allocate(size); }
+    static void operator delete(void *ptr, std::size_t size) { ShapeAllocator::deallocate(ptr, size); }
+
     OperationType type;
     int shapeIndex;      // 操作的图形索引
     
@@ -174,29 +508,55 @@ private:
     QRect oldRect;                        // 调整尺寸前的矩形
     QRect newRect;                        // 调整尺寸后的矩形
     
-    // 额外属性数据（用于属性更改）
-    QColor oldLineColor;
-    QColor newLineColor;
-    int oldLineWidth;
-    int newLineWidth;
+    // 属性更改前后的属性（单个图形）
+    ShapeProperties oldProperties;
+    ShapeProperties newProperties;
+
+    // 共享样式修改
+    ShapeStyleHandle styleHandle;
+    ShapeStyle oldStyle;
+    ShapeStyle newStyle;
     
     // 用于恢复箭头连接
-    std::vector<ArrowConnection> connections;
+    HistoryVector<ArrowConnection> connections;
+
+    // 图层顺序（见 reorderShapes）
+    HistoryVector<int> order;
+
+    // 批量变换前后的几何状态
+    HistoryVector<ShapeGeometryState> geometryBefore;
+    HistoryVector<ShapeGeometryState> geometryAfter;
+
+    // 分组的变化
+    HistoryVector<GroupChange> groupChanges;
+
+    // 组合操作中的各步，按执行顺序存放（此处HistoryAction还不完整，只能存放指针）
+    HistoryVector<std::unique_ptr<HistoryAction>> children;
     
     HistoryAction(OperationType t, int idx) : type(t), shapeIndex(idx) {}
   };
   
   // 撤销和重做堆栈
-  std::stack<HistoryAction> m_undoStack;
-  std::stack<HistoryAction> m_redoStack;
+  // 用vector作为底层容器，历史记录连续存放，不再逐条分配
+  std::stack<HistoryAction, HistoryVector<HistoryAction>> m_undoStack;
+  std::stack<HistoryAction, HistoryVector<HistoryAction>> m_redoStack;
   
-  // 记录操作到历史
+  // 记录操作到历史：批量操作期间记录的各步合并为一步
+  void pushHistory(HistoryAction action);
+  void beginHistoryBatch();
+  void endHistoryBatch();
+  int m_historyBatchDepth = 0;
+  HistoryVector<HistoryAction> m_historyBatch;
+
+  // 执行历史中的一步，并把反向操作追加到inverse中
+  void revertAction(HistoryAction action, std::vector<HistoryAction> &inverse);
+  void replayAction(HistoryAction action, std::vector<HistoryAction> &inverse);
+
   void recordAddShape(int index);
   void recordRemoveShape(int index);
   void recordMoveShape(int index, const QPoint &delta);
   void recordResizeShape(int index, const QRect &oldRect, const QRect &newRect);
-  void recordPropertyChange(int index, const QColor &oldColor, const QColor &newColor, 
-                           int oldWidth, int newWidth);
+  void recordPropertyChange(int index, const ShapeProperties &before); // 修改后的属性取图形当前的属性
   
   // 清空重做堆栈
   void clearRedoStack();
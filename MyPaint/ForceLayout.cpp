@@ -0,0 +1,304 @@
+#include "ForceLayout.h"
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const double kTheta = 0.8;        // 格子边长与距离之比小于它时，整个格子当作一个节点
+    const double kGravity = 0.05;     // 指向整体中心的弱引力系数
+    const double kCooling = 0.95;     // 每一步温度的衰减
+    const double kMinTemperature = 0.5;
+    const double kMinDistance = 0.01; // 距离过小时按这个距离计算，避免除以0
+    const int kMaxDepth = 32;         // 四叉树的最大深度，重合的节点在最深的格子中合并
+
+    // 线程池中的一段计算
+    class RangeTask : public QRunnable
+    {
+    public:
+        RangeTask(const std::function<void(int, int)> &body, int begin, int end, QSemaphore &done)
+            : m_body(body), m_begin(begin), m_end(end), m_done(done)
+        {
+        }
+
+        void run() override
+        {
+            m_body(m_begin, m_end);
+            m_done.release();
+        }
+
+    private:
+        const std::function<void(int, int)> &m_body;
+        int m_begin, m_end;
+        QSemaphore &m_done;
+    };
+}
+
+ForceLayout::ForceLayout(const LayoutGraph &graph, const std::vector<bool> &pinned)
+    : m_sizes(graph.sizes), m_pinned(pinned)
+{
+    const int n = static_cast<int>(graph.sizes.size());
+    m_pinned.resize(n, false);
+    m_x.resize(n);
+    m_y.resize(n);
+    m_fx.assign(n, 0.0);
+    m_fy.assign(n, 0.0);
+    m_moved.assign(n, 0.0);
+    m_neighbors.assign(n, std::vector<int>());
+
+    // 从节点现在的位置出发；重合的节点稍微错开，否则它们之间没有方向可以推开
+    double radius = 0.0;
+    for (int v = 0; v < n; ++v)
+    {
+        QPoint topLeft = v < static_cast<int>(graph.positions.size()) ? graph.positions[v] : QPoint();
+        m_x[v] = topLeft.x() + m_sizes[v].width() / 2.0;
+        m_y[v] = topLeft.y() + m_sizes[v].height() / 2.0;
+        if (!m_pinned[v])
+        {
+            m_x[v] += (v % 7 - 3) * 0.37;
+            m_y[v] += (v % 11 - 5) * 0.29;
+        }
+        radius += std::hypot(m_sizes[v].width(), m_sizes[v].height()) / 2.0;
+    }
+    if (n > 0)
+        m_k = kIdealLength + radius / n;
+    m_temperature = m_k * 2.0;
+
+    for (const auto &edge : graph.edges)
+    {
+        if (edge.first < 0 || edge.first >= n || edge.second < 0 || edge.second >= n || edge.first == edge.second)
+            continue;
+        m_neighbors[edge.first].push_back(edge.second);
+        m_neighbors[edge.second].push_back(edge.first);
+    }
+    m_settled = n < 2;
+}
+
+QPoint ForceLayout::position(int node) const
+{
+    return QPoint(static_cast<int>(std::floor(m_x[node] - m_sizes[node].width() / 2.0 + 0.5)),
+                  static_cast<int>(std::floor(m_y[node] - m_sizes[node].height() / 2.0 + 0.5)));
+}
+
+double ForceLayout::step()
+{
+    const int n = nodeCount();
+    if (m_settled)
+        return 0.0;
+
+    m_centerX = 0.0;
+    m_centerY = 0.0;
+    for (int v = 0; v < n; ++v)
+    {
+        m_centerX += m_x[v];
+        m_centerY += m_y[v];
+    }
+    m_centerX /= n;
+    m_centerY /= n;
+
+    // 建树在当前线程完成，之后受力和移动都按节点分段并行
+    buildTree();
+    parallelFor(n, [this](int begin, int end) { computeForces(begin, end); });
+    parallelFor(n, [this](int begin, int end) { moveNodes(begin, end); });
+
+    double moved = *std::max_element(m_moved.begin(), m_moved.end());
+    m_temperature *= kCooling;
+    if (m_temperature < kMinTemperature || moved < kMinTemperature / 2.0)
+        m_settled = true;
+    return moved;
+}
+
+void ForceLayout::buildTree()
+{
+    const int n = nodeCount();
+    double left = *std::min_element(m_x.begin(), m_x.end());
+    double right = *std::max_element(m_x.begin(), m_x.end());
+    double top = *std::min_element(m_y.begin(), m_y.end());
+    double bottom = *std::max_element(m_y.begin(), m_y.end());
+
+    m_cells.clear();
+    m_cells.reserve(n * 2);
+    Cell root;
+    root.left = left - 1.0;
+    root.top = top - 1.0;
+    root.size = std::max(right - left, bottom - top) + 2.0;
+    m_cells.push_back(root);
+    for (int v = 0; v < n; ++v)
+        insert(v);
+}
+
+int ForceLayout::quadrant(const Cell &cell, double x, double y) const
+{
+    double half = cell.size / 2.0;
+    return (x >= cell.left + half ? 1 : 0) + (y >= cell.top + half ? 2 : 0);
+}
+
+void ForceLayout::insert(int body)
+{
+    const double x = m_x[body];
+    const double y = m_y[body];
+    int c = 0;
+    for (int depth = 0;; ++depth)
+    {
+        // 格子可能在下面新建子格子时移动，只通过下标访问
+        if (m_cells[c].mass == 0.0)
+        {
+            m_cells[c].body = body;
+            m_cells[c].mass = 1.0;
+            m_cells[c].cx = x;
+            m_cells[c].cy = y;
+            return;
+        }
+
+        const bool leaf = m_cells[c].child[0] < 0 && m_cells[c].child[1] < 0 &&
+                          m_cells[c].child[2] < 0 && m_cells[c].child[3] < 0;
+        if (leaf && depth < kMaxDepth)
+        {
+            // 叶子中原来的节点移到子格子中
+            int old = m_cells[c].body;
+            m_cells[c].body = -1;
+            int q = quadrant(m_cells[c], m_x[old], m_y[old]);
+            Cell child;
+            double half = m_cells[c].size / 2.0;
+            child.left = m_cells[c].left + (q & 1 ? half : 0.0);
+            child.top = m_cells[c].top + (q & 2 ? half : 0.0);
+            child.size = half;
+            child.mass = 1.0;
+            child.cx = m_x[old];
+            child.cy = m_y[old];
+            child.body = old;
+            m_cells.push_back(child);
+            m_cells[c].child[q] = static_cast<int>(m_cells.size()) - 1;
+        }
+
+        // 质心加入新节点
+        Cell &cell = m_cells[c];
+        cell.cx = (cell.cx * cell.mass + x) / (cell.mass + 1.0);
+        cell.cy = (cell.cy * cell.mass + y) / (cell.mass + 1.0);
+        cell.mass += 1.0;
+        if (leaf && depth >= kMaxDepth)
+            return; // 与已有节点重合，合并在这个格子中
+
+        int q = quadrant(cell, x, y);
+        if (cell.child[q] < 0)
+        {
+            Cell child;
+            double half = cell.size / 2.0;
+            child.left = cell.left + (q & 1 ? half : 0.0);
+            child.top = cell.top + (q & 2 ? half : 0.0);
+            child.size = half;
+            m_cells.push_back(child);
+            m_cells[c].child[q] = static_cast<int>(m_cells.size()) - 1;
+        }
+        c = m_cells[c].child[q];
+    }
+}
+
+void ForceLayout::computeForces(int begin, int end)
+{
+    const double k2 = m_k * m_k;
+    std::vector<int> stack;
+    stack.reserve(4 * kMaxDepth);
+    for (int v = begin; v < end; ++v)
+    {
+        const double x = m_x[v];
+        const double y = m_y[v];
+        double fx = 0.0;
+        double fy = 0.0;
+
+        // 斥力 k²·m/d：足够远的格子整体计算，否则展开子格子
+        stack.clear();
+        stack.push_back(0);
+        while (!stack.empty())
+        {
+            const Cell &cell = m_cells[stack.back()];
+            stack.pop_back();
+            if (cell.mass == 0.0 || cell.body == v)
+                continue;
+
+            double dx = x - cell.cx;
+            double dy = y - cell.cy;
+            double d2 = dx * dx + dy * dy;
+            bool leaf = cell.child[0] < 0 && cell.child[1] < 0 && cell.child[2] < 0 && cell.child[3] < 0;
+            if (!leaf && cell.size * cell.size >= kTheta * kTheta * d2)
+            {
+                for (int child : cell.child)
+                {
+                    if (child >= 0)
+                        stack.push_back(child);
+                }
+                continue;
+            }
+
+            if (d2 < kMinDistance * kMinDistance)
+            {
+                // 重合时按下标决定方向
+                dx = (v & 1) ? kMinDistance : -kMinDistance;
+                dy = 0.0;
+                d2 = kMinDistance * kMinDistance;
+            }
+            double scale = k2 * cell.mass / d2;
+            fx += dx * scale;
+            fy += dy * scale;
+        }
+
+        // 边的引力 d²/k
+        for (int u : m_neighbors[v])
+        {
+            double dx = m_x[u] - x;
+            double dy = m_y[u] - y;
+            double d = std::sqrt(dx * dx + dy * dy);
+            fx += dx * d / m_k;
+            fy += dy * d / m_k;
+        }
+
+        fx -= kGravity * (x - m_centerX);
+        fy -= kGravity * (y - m_centerY);
+        m_fx[v] = fx;
+        m_fy[v] = fy;
+    }
+}
+
+void ForceLayout::moveNodes(int begin, int end)
+{
+    for (int v = begin; v < end; ++v)
+    {
+        m_moved[v] = 0.0;
+        if (m_pinned[v])
+            continue;
+
+        // 位移不超过当前温度
+        double length = std::sqrt(m_fx[v] * m_fx[v] + m_fy[v] * m_fy[v]);
+        if (length <= 0.0)
+            continue;
+        double distance = std::min(length, m_temperature);
+        m_x[v] += m_fx[v] / length * distance;
+        m_y[v] += m_fy[v] / length * distance;
+        m_moved[v] = distance;
+    }
+}
+
+void ForceLayout::parallelFor(int count, const std::function<void(int, int)> &body)
+{
+    int chunks = std::min(QThread::idealThreadCount(), count / kMinParallelNodes);
+    if (chunks <= 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    // 当前线程处理第一段，其余各段交给线程池
+    QSemaphore done;
+    int chunkSize = (count + chunks - 1) / chunks;
+    int started = 0;
+    for (int begin = chunkSize; begin < count; begin += chunkSize)
+    {
+        QThreadPool::globalInstance()->start(new RangeTask(body, begin, std::min(count, begin + chunkSize), done));
+        ++started;
+    }
+    body(0, std::min(count, chunkSize));
+    done.acquire(started);
+}
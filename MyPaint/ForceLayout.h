@@ -0,0 +1,62 @@
+#ifndef FORCELAYOUT_H
+#define FORCELAYOUT_H
+
+#include "LayoutGraph.h"
+#include <functional>
+#include <vector>
+
+// 网络图的力导向布局（Fruchterman–Reingold）。节点之间互相排斥，边把两端拉近，
+// 每一步的位移不超过当前温度，温度逐步降低直到稳定。
+// 斥力用Barnes–Hut四叉树近似：足够远的一簇节点当作位于质心的一个节点，每一步O(n log n)。
+// 建树之后各节点的受力只读共享数据，分段在线程池中并行计算。
+// 与分层布局和树形布局不同，它是逐步推进的，画布在每一帧取出当前位置显示动画
+class ForceLayout
+{
+public:
+  static const int kIdealLength = 120;      // 边的理想长度（另加两端节点的平均半径）
+  static const int kMinParallelNodes = 256; // 每个线程至少处理的节点数，节点少时不值得并行
+
+  // pinned[i]为true的节点固定不动，但仍然参与受力计算
+  ForceLayout(const LayoutGraph &graph, const std::vector<bool> &pinned);
+
+  // 推进一步，返回这一步中节点的最大位移
+  double step();
+  // 温度降到阈值以下，或位移已经很小
+  bool isSettled() const { return m_settled; }
+  // 节点当前的左上角
+  QPoint position(int node) const;
+  int nodeCount() const { return static_cast<int>(m_x.size()); }
+
+private:
+  // 四叉树的一个格子：正方形范围、其中节点的数量和质心；叶子格子最多存一个节点
+  struct Cell
+  {
+    double left, top, size;
+    double mass = 0.0;
+    double cx = 0.0, cy = 0.0;
+    int child[4] = {-1, -1, -1, -1};
+    int body = -1;
+  };
+
+  void buildTree();
+  void insert(int body);
+  int quadrant(const Cell &cell, double x, double y) const;
+  void computeForces(int begin, int end);
+  void moveNodes(int begin, int end);
+  // 把[0, count)分段，在线程池中并行执行body，全部完成后返回
+  static void parallelFor(int count, const std::function<void(int begin, int end)> &body);
+
+  std::vector<double> m_x, m_y;   // 节点中心
+  std::vector<double> m_fx, m_fy; // 这一步的合力
+  std::vector<double> m_moved;    // 这一步各节点的位移
+  std::vector<QSize> m_sizes;
+  std::vector<bool> m_pinned;
+  std::vector<std::vector<int>> m_neighbors;
+  std::vector<Cell> m_cells;
+  double m_k = kIdealLength;      // 理想距离
+  double m_temperature = 0.0;
+  double m_centerX = 0.0, m_centerY = 0.0; // 所有节点的中心，弱引力把不相连的部分拉在一起
+  bool m_settled = false;
+};
+
+#endif // FORCELAYOUT_H
@@ -0,0 +1,426 @@
+#include "GeometryKernels.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GEOMETRY_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 在x86-64上总是可用；32位x86只在编译器已经启用SSE2时使用
+#if defined(GEOMETRY_KERNELS_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define GEOMETRY_KERNELS_SSE2 1
+#endif
+
+// AVX2 在运行时检测，函数单独按AVX2编译，其余代码仍然可以在旧CPU上运行
+#if defined(GEOMETRY_KERNELS_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define GEOMETRY_KERNELS_AVX2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+#endif
+
+namespace GeometryKernels
+{
+namespace
+{
+const float kToleranceSquared = kSegmentTolerance * kSegmentTolerance;
+const float kMinSegmentLengthSquared = 1e-12f;
+
+bool boundsContain(const BoundsColumns &b, int i, int x, int y)
+{
+    return b.left[i] <= x && b.right[i] >= x && b.top[i] <= y && b.bottom[i] >= y;
+}
+
+// 标量版本的精确判断，也用于SIMD版本处理不足一组的尾部
+bool exactHit(const HitColumns &h, int i, float x, float y)
+{
+    const float dx = x - h.centerX[i];
+    const float dy = y - h.centerY[i];
+    const float lx = h.cosA[i] * dx - h.sinA[i] * dy;
+    const float ly = h.sinA[i] * dx + h.cosA[i] * dy;
+    const float g0 = h.g0[i], g1 = h.g1[i], g2 = h.g2[i], g3 = h.g3[i];
+
+    switch (h.model[i])
+    {
+    case HitBox:
+        return g0 <= lx && lx <= g2 && g1 <= ly && ly <= g3;
+    case HitEllipse:
+        // (lx/a)^2 + (ly/b)^2 <= 1，两边同乘 a^2 b^2 避免除法
+        return lx * lx * (g3 * g3) + ly * ly * (g2 * g2) <= (g2 * g2) * (g3 * g3);
+    case HitSegment:
+    {
+        // 投影落在线段上，且到直线的距离不超过容差：cross^2 / len^2 <= tol^2
+        const float sx = g2 - g0, sy = g3 - g1;
+        const float vx = lx - g0, vy = ly - g1;
+        const float len2 = sx * sx + sy * sy;
+        const float t = vx * sx + vy * sy;
+        const float cross = vx * sy - vy * sx;
+        return len2 > kMinSegmentLengthSquared && t >= 0.0f && t <= len2 &&
+               cross * cross <= kToleranceSquared * len2;
+    }
+    default:
+        return false;
+    }
+}
+
+quint64 rectMaskScalar(const BoundsColumns &b, int begin, int from, int count,
+                       int left, int top, int right, int bottom)
+{
+    quint64 mask = 0;
+    for (int j = from; j < count; ++j)
+    {
+        const int i = begin + j;
+        if (b.left[i] <= right && b.right[i] >= left && b.top[i] <= bottom && b.bottom[i] >= top)
+            mask |= quint64(1) << j;
+    }
+    return mask;
+}
+
+void pointMaskScalar(const BoundsColumns &b, const HitColumns &h, int begin, int from, int count,
+                     int x, int y, quint64 *hitMask, quint64 *maybeMask)
+{
+    const float fx = static_cast<float>(x);
+    const float fy = static_cast<float>(y);
+    for (int j = from; j < count; ++j)
+    {
+        const int i = begin + j;
+        if (!boundsContain(b, i, x, y))
+            continue;
+        if (h.model[i] == HitBounds)
+            *maybeMask |= quint64(1) << j;
+        else if (exactHit(h, i, fx, fy))
+            *hitMask |= quint64(1) << j;
+    }
+}
+
+#ifdef GEOMETRY_KERNELS_SSE2
+quint64 rectMaskSse2(const BoundsColumns &b, int begin, int count,
+                     int left, int top, int right, int bottom)
+{
+    const __m128i qLeft = _mm_set1_epi32(left);
+    const __m128i qTop = _mm_set1_epi32(top);
+    const __m128i qRight = _mm_set1_epi32(right);
+    const __m128i qBottom = _mm_set1_epi32(bottom);
+
+    quint64 mask = 0;
+    int j = 0;
+    for (; j + 4 <= count; j += 4)
+    {
+        const int i = begin + j;
+        const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.left + i));
+        const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.top + i));
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.right + i));
+        const __m128i bt = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.bottom + i));
+        // 只要有一条边在查询矩形外侧就不相交
+        const __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(l, qRight), _mm_cmpgt_epi32(qLeft, r)),
+                                             _mm_or_si128(_mm_cmpgt_epi32(t, qBottom), _mm_cmpgt_epi32(qTop, bt)));
+        const int bits = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+        mask |= quint64(bits) << j;
+    }
+    return mask | rectMaskScalar(b, begin, j, count, left, top, right, bottom);
+}
+
+void pointMaskSse2(const BoundsColumns &b, const HitColumns &h, int begin, int count,
+                   int x, int y, quint64 *hitMask, quint64 *maybeMask)
+{
+    const __m128i px = _mm_set1_epi32(x);
+    const __m128i py = _mm_set1_epi32(y);
+    const __m128 fx = _mm_set1_ps(static_cast<float>(x));
+    const __m128 fy = _mm_set1_ps(static_cast<float>(y));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 tolerance = _mm_set1_ps(kToleranceSquared);
+    const __m128 minLength = _mm_set1_ps(kMinSegmentLengthSquared);
+
+    int j = 0;
+    for (; j + 4 <= count; j += 4)
+    {
+        const int i = begin + j;
+        const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.left + i));
+        const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.top + i));
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.right + i));
+        const __m128i bt = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.bottom + i));
+        const __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(l, px), _mm_cmpgt_epi32(px, r)),
+                                             _mm_or_si128(_mm_cmpgt_epi32(t, py), _mm_cmpgt_epi32(py, bt)));
+        const int inside = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+        if (!inside)
+            continue;
+
+        // 转到局部坐标
+        const __m128 dx = _mm_sub_ps(fx, _mm_loadu_ps(h.centerX + i));
+        const __m128 dy = _mm_sub_ps(fy, _mm_loadu_ps(h.centerY + i));
+        const __m128 c = _mm_loadu_ps(h.cosA + i);
+        const __m128 s = _mm_loadu_ps(h.sinA + i);
+        const __m128 lx = _mm_sub_ps(_mm_mul_ps(c, dx), _mm_mul_ps(s, dy));
+        const __m128 ly = _mm_add_ps(_mm_mul_ps(s, dx), _mm_mul_ps(c, dy));
+        const __m128 g0 = _mm_loadu_ps(h.g0 + i);
+        const __m128 g1 = _mm_loadu_ps(h.g1 + i);
+        const __m128 g2 = _mm_loadu_ps(h.g2 + i);
+        const __m128 g3 = _mm_loadu_ps(h.g3 + i);
+
+        const __m128 box = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(g0, lx), _mm_cmple_ps(lx, g2)),
+                                      _mm_and_ps(_mm_cmple_ps(g1, ly), _mm_cmple_ps(ly, g3)));
+
+        const __m128 a2 = _mm_mul_ps(g2, g2);
+        const __m128 b2 = _mm_mul_ps(g3, g3);
+        const __m128 ellipse = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(lx, lx), b2), _mm_mul_ps(_mm_mul_ps(ly, ly), a2)),
+                                            _mm_mul_ps(a2, b2));
+
+        const __m128 sx = _mm_sub_ps(g2, g0);
+        const __m128 sy = _mm_sub_ps(g3, g1);
+        const __m128 vx = _mm_sub_ps(lx, g0);
+        const __m128 vy = _mm_sub_ps(ly, g1);
+        const __m128 len2 = _mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy));
+        const __m128 proj = _mm_add_ps(_mm_mul_ps(vx, sx), _mm_mul_ps(vy, sy));
+        const __m128 cross = _mm_sub_ps(_mm_mul_ps(vx, sy), _mm_mul_ps(vy, sx));
+        const __m128 segment = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(len2, minLength), _mm_cmpge_ps(proj, zero)),
+                                          _mm_and_ps(_mm_cmple_ps(proj, len2),
+                                                     _mm_cmple_ps(_mm_mul_ps(cross, cross), _mm_mul_ps(tolerance, len2))));
+
+        // 按每个图形的模型选出对应的结果
+        const __m128i model = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h.model + i));
+        const __m128 isBounds = _mm_castsi128_ps(_mm_cmpeq_epi32(model, _mm_set1_epi32(HitBounds)));
+        const __m128 isBox = _mm_castsi128_ps(_mm_cmpeq_epi32(model, _mm_set1_epi32(HitBox)));
+        const __m128 isEllipse = _mm_castsi128_ps(_mm_cmpeq_epi32(model, _mm_set1_epi32(HitEllipse)));
+        const __m128 isSegment = _mm_castsi128_ps(_mm_cmpeq_epi32(model, _mm_set1_epi32(HitSegment)));
+        const __m128 exact = _mm_or_ps(_mm_and_ps(isBox, box),
+                                       _mm_or_ps(_mm_and_ps(isEllipse, ellipse), _mm_and_ps(isSegment, segment)));
+
+        *hitMask |= quint64(inside & _mm_movemask_ps(exact)) << j;
+        *maybeMask |= quint64(inside & _mm_movemask_ps(isBounds)) << j;
+    }
+    pointMaskScalar(b, h, begin, j, count, x, y, hitMask, maybeMask);
+}
+#endif // GEOMETRY_KERNELS_SSE2
+
+#ifdef GEOMETRY_KERNELS_AVX2
+TARGET_AVX2 quint64 rectMaskAvx2(const BoundsColumns &b, int begin, int count,
+                                 int left, int top, int right, int bottom)
+{
+    const __m256i qLeft = _mm256_set1_epi32(left);
+    const __m256i qTop = _mm256_set1_epi32(top);
+    const __m256i qRight = _mm256_set1_epi32(right);
+    const __m256i qBottom = _mm256_set1_epi32(bottom);
+
+    quint64 mask = 0;
+    int j = 0;
+    for (; j + 8 <= count; j += 8)
+    {
+        const int i = begin + j;
+        const __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.left + i));
+        const __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.top + i));
+        const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.right + i));
+        const __m256i bt = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.bottom + i));
+        const __m256i outside = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(l, qRight), _mm256_cmpgt_epi32(qLeft, r)),
+                                                _mm256_or_si256(_mm256_cmpgt_epi32(t, qBottom), _mm256_cmpgt_epi32(qTop, bt)));
+        const int bits = ~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF;
+        mask |= quint64(bits) << j;
+    }
+    return mask | rectMaskScalar(b, begin, j, count, left, top, right, bottom);
+}
+
+TARGET_AVX2 void pointMaskAvx2(const BoundsColumns &b, const HitColumns &h, int begin, int count,
+                               int x, int y, quint64 *hitMask, quint64 *maybeMask)
+{
+    const __m256i px = _mm256_set1_epi32(x);
+    const __m256i py = _mm256_set1_epi32(y);
+    const __m256 fx = _mm256_set1_ps(static_cast<float>(x));
+    const __m256 fy = _mm256_set1_ps(static_cast<float>(y));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 tolerance = _mm256_set1_ps(kToleranceSquared);
+    const __m256 minLength = _mm256_set1_ps(kMinSegmentLengthSquared);
+
+    int j = 0;
+    for (; j + 8 <= count; j += 8)
+    {
+        const int i = begin + j;
+        const __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.left + i));
+        const __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.top + i));
+        const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.right + i));
+        const __m256i bt = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.bottom + i));
+        const __m256i outside = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(l, px), _mm256_cmpgt_epi32(px, r)),
+                                                _mm256_or_si256(_mm256_cmpgt_epi32(t, py), _mm256_cmpgt_epi32(py, bt)));
+        const int inside = ~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF;
+        if (!inside)
+            continue;
+
+        const __m256 dx = _mm256_sub_ps(fx, _mm256_loadu_ps(h.centerX + i));
+        const __m256 dy = _mm256_sub_ps(fy, _mm256_loadu_ps(h.centerY + i));
+        const __m256 c = _mm256_loadu_ps(h.cosA + i);
+        const __m256 s = _mm256_loadu_ps(h.sinA + i);
+        const __m256 lx = _mm256_sub_ps(_mm256_mul_ps(c, dx), _mm256_mul_ps(s, dy));
+        const __m256 ly = _mm256_add_ps(_mm256_mul_ps(s, dx), _mm256_mul_ps(c, dy));
+        const __m256 g0 = _mm256_loadu_ps(h.g0 + i);
+        const __m256 g1 = _mm256_loadu_ps(h.g1 + i);
+        const __m256 g2 = _mm256_loadu_ps(h.g2 + i);
+        const __m256 g3 = _mm256_loadu_ps(h.g3 + i);
+
+        const __m256 box = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(g0, lx, _CMP_LE_OQ), _mm256_cmp_ps(lx, g2, _CMP_LE_OQ)),
+                                         _mm256_and_ps(_mm256_cmp_ps(g1, ly, _CMP_LE_OQ), _mm256_cmp_ps(ly, g3, _CMP_LE_OQ)));
+
+        const __m256 a2 = _mm256_mul_ps(g2, g2);
+        const __m256 b2 = _mm256_mul_ps(g3, g3);
+        const __m256 ellipse = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(lx, lx), b2),
+                                                           _mm256_mul_ps(_mm256_mul_ps(ly, ly), a2)),
+                                             _mm256_mul_ps(a2, b2), _CMP_LE_OQ);
+
+        const __m256 sx = _mm256_sub_ps(g2, g0);
+        const __m256 sy = _mm256_sub_ps(g3, g1);
+        const __m256 vx = _mm256_sub_ps(lx, g0);
+        const __m256 vy = _mm256_sub_ps(ly, g1);
+        const __m256 len2 = _mm256_add_ps(_mm256_mul_ps(sx, sx), _mm256_mul_ps(sy, sy));
+        const __m256 proj = _mm256_add_ps(_mm256_mul_ps(vx, sx), _mm256_mul_ps(vy, sy));
+        const __m256 cross = _mm256_sub_ps(_mm256_mul_ps(vx, sy), _mm256_mul_ps(vy, sx));
+        const __m256 segment = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(len2, minLength, _CMP_GT_OQ),
+                                                           _mm256_cmp_ps(proj, zero, _CMP_GE_OQ)),
+                                             _mm256_and_ps(_mm256_cmp_ps(proj, len2, _CMP_LE_OQ),
+                                                           _mm256_cmp_ps(_mm256_mul_ps(cross, cross),
+                                                                         _mm256_mul_ps(tolerance, len2), _CMP_LE_OQ)));
+
+        const __m256i model = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(h.model + i));
+        const __m256 isBounds = _mm256_castsi256_ps(_mm256_cmpeq_epi32(model, _mm256_set1_epi32(HitBounds)));
+        const __m256 isBox = _mm256_castsi256_ps(_mm256_cmpeq_epi32(model, _mm256_set1_epi32(HitBox)));
+        const __m256 isEllipse = _mm256_castsi256_ps(_mm256_cmpeq_epi32(model, _mm256_set1_epi32(HitEllipse)));
+        const __m256 isSegment = _mm256_castsi256_ps(_mm256_cmpeq_epi32(model, _mm256_set1_epi32(HitSegment)));
+        const __m256 exact = _mm256_or_ps(_mm256_and_ps(isBox, box),
+                                          _mm256_or_ps(_mm256_and_ps(isEllipse, ellipse), _mm256_and_ps(isSegment, segment)));
+
+        *hitMask |= quint64(inside & _mm256_movemask_ps(exact)) << j;
+        *maybeMask |= quint64(inside & _mm256_movemask_ps(isBounds)) << j;
+    }
+    pointMaskScalar(b, h, begin, j, count, x, y, hitMask, maybeMask);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    // 除了CPU支持，还要操作系统保存YMM寄存器（OSXSAVE + XCR0）
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif // GEOMETRY_KERNELS_AVX2
+
+Isa detectIsa()
+{
+#if defined(GEOMETRY_KERNELS_AVX2)
+    if (cpuHasAvx2())
+        return Isa::AVX2;
+#endif
+#if defined(GEOMETRY_KERNELS_SSE2)
+    return Isa::SSE2;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+// 检测一次后缓存；查询可能来自渲染线程，所以用原子变量
+std::atomic<int> &currentIsa()
+{
+    static std::atomic<int> isa(static_cast<int>(detectIsa()));
+    return isa;
+}
+} // namespace
+
+Isa activeIsa()
+{
+    return static_cast<Isa>(currentIsa().load(std::memory_order_relaxed));
+}
+
+const char *isaName(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::AVX2:
+        return "AVX2";
+    case Isa::SSE2:
+        return "SSE2";
+    default:
+        return "Scalar";
+    }
+}
+
+bool isSupported(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::AVX2:
+#if defined(GEOMETRY_KERNELS_AVX2)
+        return cpuHasAvx2();
+#else
+        return false;
+#endif
+    case Isa::SSE2:
+#if defined(GEOMETRY_KERNELS_SSE2)
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return true;
+    }
+}
+
+void setIsa(Isa isa)
+{
+    if (isSupported(isa))
+        currentIsa().store(static_cast<int>(isa), std::memory_order_relaxed);
+}
+
+quint64 rectMask(const BoundsColumns &bounds, int begin, int count,
+                 int left, int top, int right, int bottom)
+{
+    switch (activeIsa())
+    {
+#if defined(GEOMETRY_KERNELS_AVX2)
+    case Isa::AVX2:
+        return rectMaskAvx2(bounds, begin, count, left, top, right, bottom);
+#endif
+#if defined(GEOMETRY_KERNELS_SSE2)
+    case Isa::SSE2:
+        return rectMaskSse2(bounds, begin, count, left, top, right, bottom);
+#endif
+    default:
+        return rectMaskScalar(bounds, begin, 0, count, left, top, right, bottom);
+    }
+}
+
+void pointMask(const BoundsColumns &bounds, const HitColumns &hit, int begin, int count,
+               int x, int y, quint64 *hitMask, quint64 *maybeMask)
+{
+    *hitMask = 0;
+    *maybeMask = 0;
+    switch (activeIsa())
+    {
+#if defined(GEOMETRY_KERNELS_AVX2)
+    case Isa::AVX2:
+        pointMaskAvx2(bounds, hit, begin, count, x, y, hitMask, maybeMask);
+        break;
+#endif
+#if defined(GEOMETRY_KERNELS_SSE2)
+    case Isa::SSE2:
+        pointMaskSse2(bounds, hit, begin, count, x, y, hitMask, maybeMask);
+        break;
+#endif
+    default:
+        pointMaskScalar(bounds, hit, begin, 0, count, x, y, hitMask, maybeMask);
+        break;
+    }
+}
+} // namespace GeometryKernels
@@ -0,0 +1,66 @@
+#ifndef GEOMETRYKERNELS_H
+#define GEOMETRYKERNELS_H
+
+#include <QtGlobal>
+
+// 几何批量查询的计算核心：一次检测一批图形（最多 kBatchSize 个），结果按位返回，
+// 第i位对应这一批中的第i个图形。运行时根据CPU选择AVX2、SSE2或标量实现，三者结果一致。
+namespace GeometryKernels
+{
+const int kBatchSize = 64;
+
+// 点命中检测使用的精确模型
+enum HitModel : qint32
+{
+  HitBounds = 0,  // 没有精确模型，只用绘制范围筛选，之后需要调用contains()
+  HitBox = 1,     // 局部坐标中的矩形 [g0, g2] x [g1, g3]
+  HitEllipse = 2, // 局部坐标中以原点为中心的椭圆，半轴为 g2、g3
+  HitSegment = 3  // 局部坐标中的线段 (g0, g1)-(g2, g3)，距离不超过 kSegmentTolerance 算命中
+};
+const float kSegmentTolerance = 5.0f;
+
+// 绘制范围的四列（整数，含右下边界）
+struct BoundsColumns
+{
+  const int *left;
+  const int *top;
+  const int *right;
+  const int *bottom;
+};
+
+// 点命中所需的局部几何：点先平移到旋转中心，再反向旋转到图形的局部坐标系
+struct HitColumns
+{
+  const float *centerX; // 旋转中心
+  const float *centerY;
+  const float *cosA; // 反向旋转的余弦
+  const float *sinA; // 反向旋转的正弦
+  const float *g0;   // 按 HitModel 解释的几何参数
+  const float *g1;
+  const float *g2;
+  const float *g3;
+  const qint32 *model; // HitModel
+};
+
+// 实现所用的指令集
+enum class Isa
+{
+  Scalar,
+  SSE2,
+  AVX2
+};
+Isa activeIsa();
+const char *isaName(Isa isa);
+bool isSupported(Isa isa);
+void setIsa(Isa isa); // 强制使用某个实现（CPU不支持时忽略），用于对比各实现的结果和速度
+
+// [begin, begin + count) 中绘制范围与查询矩形相交的图形，count 不超过 kBatchSize
+quint64 rectMask(const BoundsColumns &bounds, int begin, int count,
+                 int left, int top, int right, int bottom);
+
+// 点查询：hitMask 为已经精确命中的图形，maybeMask 为绘制范围包含该点、但需要调用contains()确认的图形
+void pointMask(const BoundsColumns &bounds, const HitColumns &hit, int begin, int count,
+               int x, int y, quint64 *hitMask, quint64 *maybeMask);
+} // namespace GeometryKernels
+
+#endif // GEOMETRYKERNELS_H
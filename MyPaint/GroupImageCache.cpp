@@ -0,0 +1,58 @@
+#include "GroupImageCache.h"
+#include "SceneRenderer.h"
+#include "ShapeGroupTree.h"
+#include <QtMath>
+
+void GroupImageCache::beginFrame()
+{
+    ++m_frame;
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (m_frame - it->lastUsed > static_cast<quint64>(kMaxIdleFrames))
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+const QImage *GroupImageCache::image(const RenderScene &scene, int id, double scale)
+{
+    const ShapeGroupTree::Group &group = scene.groups->group(id);
+    Entry &entry = m_entries[id];
+    entry.lastUsed = m_frame;
+    if (entry.revision != group.revision || entry.scale != scale)
+    {
+        // 组刚发生变化（或缩放变化），这一帧先逐个绘制
+        entry.revision = group.revision;
+        entry.scale = scale;
+        entry.firstSeen = m_frame;
+        entry.image = QImage();
+        return nullptr;
+    }
+    if (!entry.image.isNull())
+        return &entry.image;
+    if (entry.firstSeen == m_frame)
+        return nullptr;
+
+    QSize size(qCeil(group.bounds.width() * scale), qCeil(group.bounds.height() * scale));
+    if (size.isEmpty() || static_cast<qint64>(size.width()) * size.height() > kMaxImagePixels)
+        return nullptr;
+
+    // 按完整质量绘制子树中的图形，z序与逐个绘制时相同
+    std::vector<int> members;
+    scene.groups->members(id, members);
+    std::vector<ShapeBase *> groupShapes;
+    groupShapes.reserve(members.size());
+    for (int i : members)
+        groupShapes.push_back(scene.shapes[i]);
+
+    entry.image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    entry.image.fill(Qt::transparent);
+    QPainter painter(&entry.image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setRenderHint(QPainter::TextAntialiasing, true);
+    painter.scale(scale, scale);
+    painter.translate(-group.bounds.topLeft());
+    SceneRenderer::paintShapes(painter, groupShapes, scene.zoomFactor);
+    return &entry.image;
+}
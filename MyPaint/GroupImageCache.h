@@ -0,0 +1,38 @@
+#ifndef GROUPIMAGECACHE_H
+#define GROUPIMAGECACHE_H
+
+#include <QHash>
+#include <QImage>
+
+struct RenderScene;
+
+// 组的图像缓存：设置了cacheImage的组在没有变化时整体绘制成一张图像，之后直接贴图，
+// 不再逐个绘制其中的图形。组的版本号变化后的第一帧仍逐个绘制，连续两帧没有变化才生成图像，
+// 拖动过程中不会每一帧都重新生成。缓存由渲染线程独占使用，本身不做加锁。
+class GroupImageCache
+{
+public:
+  static const int kMaxImagePixels = 2048 * 2048; // 单个组图像的最大像素数，更大的组逐个绘制
+  static const int kMaxIdleFrames = 120;          // 连续这么多帧没有用到的图像被释放
+
+  // 开始新的一帧
+  void beginFrame();
+  // 组id在scale缩放下的图像，还不能使用缓存时返回nullptr，由调用方逐个绘制
+  const QImage *image(const RenderScene &scene, int id, double scale);
+  void clear() { m_entries.clear(); }
+
+private:
+  struct Entry
+  {
+    quint64 revision = 0; // 对应的组版本
+    double scale = 0.0;
+    quint64 firstSeen = 0; // 第一次见到这个版本的帧号
+    quint64 lastUsed = 0;
+    QImage image;
+  };
+
+  QHash<int, Entry> m_entries;
+  quint64 m_frame = 0;
+};
+
+#endif // GROUPIMAGECACHE_H
@@ -0,0 +1,394 @@
+#include "LayeredLayout.h"
+#include <algorithm>
+#include <climits>
+
+namespace
+{
+    // 分层后的图：真实节点在前，虚拟节点在后
+    struct Layering
+    {
+        int realCount = 0;
+        std::vector<int> layer;             // 节点所在的层
+        std::vector<int> width;             // 节点宽度，虚拟节点为0
+        std::vector<std::vector<int>> up;   // 上一层中的相邻节点
+        std::vector<std::vector<int>> down; // 下一层中的相邻节点
+        std::vector<std::vector<int>> rows; // 每层的节点，按当前顺序
+        std::vector<int> order;             // 节点在所在层中的序号
+
+        int addNode(int nodeLayer, int nodeWidth)
+        {
+            layer.push_back(nodeLayer);
+            width.push_back(nodeWidth);
+            up.emplace_back();
+            down.emplace_back();
+            return static_cast<int>(layer.size()) - 1;
+        }
+    };
+
+    // 1. 去环：从没有入边的节点开始深度优先搜索，指向搜索栈中节点的回边反向
+    std::vector<std::pair<int, int>> acyclicEdges(const LayoutGraph &graph)
+    {
+        const int n = static_cast<int>(graph.sizes.size());
+        std::vector<std::vector<int>> out(n);
+        std::vector<int> inDegree(n, 0);
+        for (const auto &edge : graph.edges)
+        {
+            if (edge.first < 0 || edge.first >= n || edge.second < 0 || edge.second >= n || edge.first == edge.second)
+                continue;
+            out[edge.first].push_back(edge.second);
+            ++inDegree[edge.second];
+        }
+
+        std::vector<int> roots;
+        roots.reserve(n);
+        for (int v = 0; v < n; ++v)
+        {
+            if (inDegree[v] == 0)
+                roots.push_back(v);
+        }
+        for (int v = 0; v < n; ++v)
+        {
+            if (inDegree[v] != 0)
+                roots.push_back(v); // 剩下的只在环中，源点都搜索完后再处理
+        }
+
+        std::vector<std::pair<int, int>> result;
+        result.reserve(graph.edges.size());
+        std::vector<char> state(n, 0); // 0未访问，1在搜索栈中，2已完成
+        std::vector<std::pair<int, size_t>> stack;
+        for (int root : roots)
+        {
+            if (state[root])
+                continue;
+            state[root] = 1;
+            stack.emplace_back(root, 0);
+            while (!stack.empty())
+            {
+                int v = stack.back().first;
+                if (stack.back().second == out[v].size())
+                {
+                    state[v] = 2;
+                    stack.pop_back();
+                    continue;
+                }
+                int w = out[v][stack.back().second++];
+                if (state[w] == 1)
+                {
+                    result.emplace_back(w, v);
+                    continue;
+                }
+                result.emplace_back(v, w);
+                if (state[w] == 0)
+                {
+                    state[w] = 1;
+                    stack.emplace_back(w, 0);
+                }
+            }
+        }
+
+        // 重复的边只保留一条
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    // 2. 分层：按拓扑序取最长路径，源点再下移到紧挨着它的后继，减少长边
+    std::vector<int> assignLayers(int n, const std::vector<std::pair<int, int>> &edges)
+    {
+        std::vector<std::vector<int>> out(n);
+        std::vector<int> inDegree(n, 0);
+        for (const auto &edge : edges)
+        {
+            out[edge.first].push_back(edge.second);
+            ++inDegree[edge.second];
+        }
+
+        std::vector<int> topo;
+        topo.reserve(n);
+        for (int v = 0; v < n; ++v)
+        {
+            if (inDegree[v] == 0)
+                topo.push_back(v);
+        }
+        std::vector<int> layer(n, 0);
+        std::vector<int> remaining = inDegree;
+        for (size_t k = 0; k < topo.size(); ++k)
+        {
+            int v = topo[k];
+            for (int w : out[v])
+            {
+                layer[w] = std::max(layer[w], layer[v] + 1);
+                if (--remaining[w] == 0)
+                    topo.push_back(w);
+            }
+        }
+
+        for (auto it = topo.rbegin(); it != topo.rend(); ++it)
+        {
+            int v = *it;
+            if (inDegree[v] != 0 || out[v].empty())
+                continue;
+            int below = INT_MAX;
+            for (int w : out[v])
+                below = std::min(below, layer[w]);
+            layer[v] = below - 1;
+        }
+        return layer;
+    }
+
+    // 跨越多层的边拆成经过虚拟节点的短边
+    void buildLayering(const LayoutGraph &graph, const std::vector<std::pair<int, int>> &edges,
+                       const std::vector<int> &layer, Layering &result)
+    {
+        const int n = static_cast<int>(graph.sizes.size());
+        result.realCount = n;
+        for (int v = 0; v < n; ++v)
+            result.addNode(layer[v], graph.sizes[v].width());
+
+        for (const auto &edge : edges)
+        {
+            int from = edge.first;
+            for (int l = layer[edge.first] + 1; l < layer[edge.second]; ++l)
+            {
+                int dummy = result.addNode(l, 0);
+                result.down[from].push_back(dummy);
+                result.up[dummy].push_back(from);
+                from = dummy;
+            }
+            result.down[from].push_back(edge.second);
+            result.up[edge.second].push_back(from);
+        }
+
+        int layerCount = 0;
+        for (int l : result.layer)
+            layerCount = std::max(layerCount, l + 1);
+        result.rows.assign(layerCount, std::vector<int>());
+        result.order.resize(result.layer.size());
+        for (size_t v = 0; v < result.layer.size(); ++v)
+        {
+            auto &row = result.rows[result.layer[v]];
+            result.order[v] = static_cast<int>(row.size());
+            row.push_back(static_cast<int>(v));
+        }
+    }
+
+    // 相邻两层之间的交叉数：边按上端排序后，数下端序号的逆序对（树状数组）
+    long long crossingsBelow(const Layering &g, int row, std::vector<std::pair<int, int>> &ends, std::vector<int> &tree)
+    {
+        ends.clear();
+        for (int v : g.rows[row])
+        {
+            for (int w : g.down[v])
+                ends.emplace_back(g.order[v], g.order[w]);
+        }
+        std::sort(ends.begin(), ends.end());
+
+        const int size = static_cast<int>(g.rows[row + 1].size());
+        tree.assign(size + 1, 0);
+        long long crossings = 0;
+        for (size_t k = 0; k < ends.size(); ++k)
+        {
+            // 已经加入的边中下端在它右边的个数
+            int notRight = 0;
+            for (int i = ends[k].second + 1; i > 0; i -= i & -i)
+                notRight += tree[i];
+            crossings += static_cast<long long>(k) - notRight;
+            for (int i = ends[k].second + 1; i <= size; i += i & -i)
+                ++tree[i];
+        }
+        return crossings;
+    }
+
+    long long countCrossings(const Layering &g)
+    {
+        std::vector<std::pair<int, int>> ends;
+        std::vector<int> tree;
+        long long total = 0;
+        for (int row = 0; row + 1 < static_cast<int>(g.rows.size()); ++row)
+            total += crossingsBelow(g, row, ends, tree);
+        return total;
+    }
+
+    // 按相邻层的重心给一层排序，没有相邻节点的保持原来的位置
+    void sortByBarycentre(Layering &g, int row, bool useUpper, std::vector<std::pair<double, int>> &keys)
+    {
+        auto &nodes = g.rows[row];
+        keys.clear();
+        for (int v : nodes)
+        {
+            const auto &neighbors = useUpper ? g.up[v] : g.down[v];
+            double key = g.order[v];
+            if (!neighbors.empty())
+            {
+                double sum = 0.0;
+                for (int w : neighbors)
+                    sum += g.order[w];
+                key = sum / neighbors.size();
+            }
+            keys.emplace_back(key, v);
+        }
+        std::stable_sort(keys.begin(), keys.end(),
+                         [](const std::pair<double, int> &a, const std::pair<double, int> &b) { return a.first < b.first; });
+        for (size_t k = 0; k < keys.size(); ++k)
+        {
+            nodes[k] = keys[k].second;
+            g.order[keys[k].second] = static_cast<int>(k);
+        }
+    }
+
+    // 3. 减少交叉：上下交替扫描，连续几轮没有改善就停止，最后恢复交叉最少的顺序
+    bool reduceCrossings(Layering &g, const LayoutCancel &cancel)
+    {
+        long long best = countCrossings(g);
+        std::vector<std::vector<int>> bestRows = g.rows;
+        std::vector<std::pair<double, int>> keys;
+        const int rowCount = static_cast<int>(g.rows.size());
+        int stale = 0;
+        for (int sweep = 0; sweep < LayeredLayout::kMaxSweeps && best > 0 && stale < 3; ++sweep)
+        {
+            if (cancel.load(std::memory_order_relaxed))
+                return false;
+
+            if (sweep % 2 == 0)
+            {
+                for (int row = 1; row < rowCount; ++row)
+                    sortByBarycentre(g, row, true, keys);
+            }
+            else
+            {
+                for (int row = rowCount - 2; row >= 0; --row)
+                    sortByBarycentre(g, row, false, keys);
+            }
+
+            long long crossings = countCrossings(g);
+            if (crossings < best)
+            {
+                best = crossings;
+                bestRows = g.rows;
+                stale = 0;
+            }
+            else
+            {
+                ++stale;
+            }
+        }
+
+        g.rows.swap(bestRows);
+        for (const auto &row : g.rows)
+        {
+            for (size_t k = 0; k < row.size(); ++k)
+                g.order[row[k]] = static_cast<int>(k);
+        }
+        return true;
+    }
+
+    // 同一层相邻两个节点中心之间的最小距离，虚拟节点之间靠得更近
+    int gap(const Layering &g, int a, int b)
+    {
+        int spacing = (a >= g.realCount && b >= g.realCount) ? LayeredLayout::kNodeSpacing / 3 : LayeredLayout::kNodeSpacing;
+        return (g.width[a] + g.width[b] + 1) / 2 + spacing;
+    }
+
+    // 让一层中的节点尽量靠近期望的位置且互不重叠：向右推和向左推各排一次，取平均后仍然满足间距
+    void placeRow(const Layering &g, const std::vector<int> &row, std::vector<double> &center,
+                  std::vector<double> &fromLeft, std::vector<double> &fromRight)
+    {
+        const int count = static_cast<int>(row.size());
+        fromLeft.resize(count);
+        fromRight.resize(count);
+        for (int k = 0; k < count; ++k)
+        {
+            fromLeft[k] = center[row[k]];
+            if (k > 0)
+                fromLeft[k] = std::max(fromLeft[k], fromLeft[k - 1] + gap(g, row[k - 1], row[k]));
+        }
+        for (int k = count - 1; k >= 0; --k)
+        {
+            fromRight[k] = center[row[k]];
+            if (k + 1 < count)
+                fromRight[k] = std::min(fromRight[k], fromRight[k + 1] - gap(g, row[k], row[k + 1]));
+        }
+        for (int k = 0; k < count; ++k)
+            center[row[k]] = (fromLeft[k] + fromRight[k]) / 2.0;
+    }
+
+    // 4. 横坐标：先按顺序紧密排开，再上下交替地让每个节点移向相邻节点的重心
+    std::vector<double> assignCenters(const Layering &g, const LayoutCancel &cancel)
+    {
+        std::vector<double> center(g.layer.size(), 0.0);
+        for (const auto &row : g.rows)
+        {
+            for (size_t k = 1; k < row.size(); ++k)
+                center[row[k]] = center[row[k - 1]] + gap(g, row[k - 1], row[k]);
+        }
+
+        std::vector<double> fromLeft, fromRight;
+        const int rowCount = static_cast<int>(g.rows.size());
+        for (int pass = 0; pass < LayeredLayout::kPlacementPasses; ++pass)
+        {
+            if (cancel.load(std::memory_order_relaxed))
+                break;
+
+            bool downward = pass % 2 == 0;
+            for (int step = 1; step < rowCount; ++step)
+            {
+                int row = downward ? step : rowCount - 1 - step;
+                // 相邻节点都在上一层（或下一层），可以直接改写本层节点的位置
+                for (int v : g.rows[row])
+                {
+                    const auto &neighbors = downward ? g.up[v] : g.down[v];
+                    if (neighbors.empty())
+                        continue;
+                    double sum = 0.0;
+                    for (int w : neighbors)
+                        sum += center[w];
+                    center[v] = sum / neighbors.size();
+                }
+                placeRow(g, g.rows[row], center, fromLeft, fromRight);
+            }
+        }
+        return center;
+    }
+}
+
+bool LayeredLayout::run(const LayoutGraph &graph, const LayoutCancel &cancel, std::vector<QPoint> &positions)
+{
+    const int n = static_cast<int>(graph.sizes.size());
+    positions.assign(n, QPoint());
+    if (n == 0)
+        return true;
+
+    std::vector<std::pair<int, int>> edges = acyclicEdges(graph);
+    std::vector<int> layer = assignLayers(n, edges);
+    Layering g;
+    buildLayering(graph, edges, layer, g);
+    if (cancel.load(std::memory_order_relaxed) || !reduceCrossings(g, cancel))
+        return false;
+    std::vector<double> center = assignCenters(g, cancel);
+    if (cancel.load(std::memory_order_relaxed))
+        return false;
+
+    // 纵坐标：每层的高度取其中最高的节点，节点在本层中垂直居中
+    std::vector<int> rowHeight(g.rows.size(), 0);
+    for (int v = 0; v < n; ++v)
+        rowHeight[layer[v]] = std::max(rowHeight[layer[v]], graph.sizes[v].height());
+    std::vector<int> rowTop(g.rows.size(), 0);
+    for (size_t row = 1; row < g.rows.size(); ++row)
+        rowTop[row] = rowTop[row - 1] + rowHeight[row - 1] + kLayerSpacing;
+
+    double left = 0.0;
+    for (int v = 0; v < n; ++v)
+    {
+        double x = center[v] - graph.sizes[v].width() / 2.0;
+        if (v == 0 || x < left)
+            left = x;
+    }
+    for (int v = 0; v < n; ++v)
+    {
+        const QSize &size = graph.sizes[v];
+        int x = static_cast<int>(center[v] - size.width() / 2.0 - left + 0.5);
+        int y = rowTop[layer[v]] + (rowHeight[layer[v]] - size.height()) / 2;
+        positions[v] = QPoint(x, y);
+    }
+    return true;
+}
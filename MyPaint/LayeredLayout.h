@@ -0,0 +1,23 @@
+#ifndef LAYEREDLAYOUT_H
+#define LAYEREDLAYOUT_H
+
+#include "LayoutGraph.h"
+
+// 流程图等有向图的分层布局（Sugiyama），从上到下排列：
+// 1. 反转深度优先搜索中的回边，去掉环；
+// 2. 按最长路径分层，跨越多层的边拆成经过虚拟节点的短边；
+// 3. 按相邻层的重心上下交替扫描排序，保留交叉最少的顺序；
+// 4. 节点按顺序排开，再逐层向相邻层的重心靠拢。
+class LayeredLayout
+{
+public:
+  static const int kLayerSpacing = 60;    // 相邻两层之间的距离
+  static const int kNodeSpacing = 30;     // 同一层相邻节点之间的距离
+  static const int kMaxSweeps = 24;       // 减少交叉时最多扫描的轮数
+  static const int kPlacementPasses = 8;  // 调整横坐标时上下扫描的轮数
+
+  // 计算各节点左上角的位置，整体的左上角在原点；被取消时返回false
+  static bool run(const LayoutGraph &graph, const LayoutCancel &cancel, std::vector<QPoint> &positions);
+};
+
+#endif // LAYEREDLAYOUT_H
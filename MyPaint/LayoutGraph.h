@@ -0,0 +1,21 @@
+#ifndef LAYOUTGRAPH_H
+#define LAYOUTGRAPH_H
+
+#include <QPoint>
+#include <QSize>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// 自动布局的输入：节点的大小和有向边。节点下标只在布局中使用，由调用方对应回图形
+struct LayoutGraph
+{
+  std::vector<QSize> sizes;               // 各节点外接矩形的大小
+  std::vector<QPoint> positions;          // 各节点现在的左上角（可为空），布局据此保持原来的先后顺序
+  std::vector<std::pair<int, int>> edges; // 有向边（起点，终点）
+};
+
+// 布局在后台线程中计算，调用方置位后布局应尽快返回
+using LayoutCancel = std::atomic<bool>;
+
+#endif // LAYOUTGRAPH_H
@@ -0,0 +1,45 @@
+#include "LayoutWorker.h"
+
+LayoutWorker::LayoutWorker(QObject *parent) : QThread(parent)
+{
+    setObjectName("layoutWorker");
+}
+
+LayoutWorker::~LayoutWorker()
+{
+    cancel();
+}
+
+quint64 LayoutWorker::runJob(Job job)
+{
+    cancel();
+    m_job = std::move(job);
+    m_result.clear();
+    m_cancel.store(false);
+    ++m_generation;
+    start(QThread::LowPriority);
+    return m_generation;
+}
+
+void LayoutWorker::cancel()
+{
+    m_cancel.store(true);
+    wait();
+}
+
+std::vector<QPoint> LayoutWorker::takeResult()
+{
+    // 线程发出信号后就结束了，等待它真正退出再取结果
+    wait();
+    std::vector<QPoint> result;
+    result.swap(m_result);
+    return result;
+}
+
+void LayoutWorker::run()
+{
+    // 编号在启动线程前设置，运行期间不会改变
+    const quint64 generation = m_generation;
+    bool completed = m_job && m_job(m_cancel, m_result);
+    emit layoutFinished(generation, completed && !m_cancel.load());
+}
@@ -0,0 +1,43 @@
+#ifndef LAYOUTWORKER_H
+#define LAYOUTWORKER_H
+
+#include "LayoutGraph.h"
+#include <QThread>
+#include <functional>
+#include <vector>
+
+// 自动布局的后台线程：一次只计算一个布局，开始新的布局前先取消旧的。
+// 计算只使用提交时复制的图，不访问画布中的图形；结果由GUI线程取走后应用
+class LayoutWorker : public QThread
+{
+  Q_OBJECT
+public:
+  // 计算各节点左上角的位置，cancel被置位时尽快返回false
+  using Job = std::function<bool(const LayoutCancel &cancel, std::vector<QPoint> &positions)>;
+
+  explicit LayoutWorker(QObject *parent = nullptr);
+  ~LayoutWorker() override;
+
+  // 取消正在计算的布局并开始新的布局，返回这次布局的编号
+  quint64 runJob(Job job);
+  // 取消正在计算的布局并等待线程结束
+  void cancel();
+  // 最近一次开始的布局的编号
+  quint64 generation() const { return m_generation; }
+  // 取走计算结果，只能在收到layoutFinished之后调用
+  std::vector<QPoint> takeResult();
+
+signals:
+  void layoutFinished(quint64 generation, bool completed); // 在布局线程中发出
+
+protected:
+  void run() override;
+
+private:
+  Job m_job;
+  LayoutCancel m_cancel{false};
+  quint64 m_generation = 0;
+  std::vector<QPoint> m_result;
+};
+
+#endif // LAYOUTWORKER_H
@@ -38,6 +38,8 @@ void PropertyPanel::setDrawingArea(DrawingArea *drawingArea)
                 this, &PropertyPanel::updateGridVisibilityUI);
         connect(m_drawingArea, &DrawingArea::gridSizeChanged,
                 this, &PropertyPanel::updateGridSizeUI);
+        connect(m_drawingArea, &DrawingArea::snapToGridChanged,
+                this, &PropertyPanel::updateSnapToGridUI);
         connect(m_drawingArea, &DrawingArea::pageSizeChanged,
                 this, &PropertyPanel::updatePageSizeUI);
     }
@@ -160,6 +162,11 @@ void PropertyPanel::setupPageStyleTab()
     m_gridSizeSpinBox->setSuffix("px");
     gridLayout->addWidget(m_gridSizeSpinBox, 2, 1);
 
+    // 吸附到网格
+    m_snapToGridCheckBox = new QCheckBox(tr("Snap to Grid"));
+    m_snapToGridCheckBox->setToolTip(tr("Hold Shift to snap to the sub-grid, Alt to move freely (Ctrl+Shift+G)"));
+    gridLayout->addWidget(m_snapToGridCheckBox, 3, 0, 1, 2);
+
     layout->addWidget(m_gridGroup);
 
     // 添加弹性空间
@@ -188,6 +195,10 @@ void PropertyPanel::setupShapeStyleTab()
     opacityLayout->addWidget(m_opacitySpinBox);
     layout->addLayout(opacityLayout);
 
+    // 勾选后样式的修改不只针对选中的图形，而是修改它使用的共享样式
+    m_sharedStyleCheckBox = new QCheckBox(tr("Apply to All Shapes with This Style"));
+    layout->addWidget(m_sharedStyleCheckBox);
+
     // 布局部分
     m_layoutGroup = new QGroupBox(tr("Layout"), m_shapeStyleTab);
     QGridLayout *layoutGroupLayout = new QGridLayout(m_layoutGroup);
@@ -391,12 +402,12 @@ void PropertyPanel::setupShapeStyleTab()
     // lineGroupLayout->addWidget(m_endArrowCombo, 3, 2);
 
     // 连接线类型
-    // lineGroupLayout->addWidget(new QLabel(tr("Connection Type:")), 4, 0);
-    // m_connectionTypeCombo = new QComboBox();
-    // m_connectionTypeCombo->addItem(tr("Straight"));
-    // m_connectionTypeCombo->addItem(tr("Segmented"));
-    // m_connectionTypeCombo->addItem(tr("Curved"));
-    // lineGroupLayout->addWidget(m_connectionTypeCombo, 4, 1, 1, 3);
+    lineGroupLayout->addWidget(new QLabel(tr("Connection Type:")), 4, 0);
+    m_connectionTypeCombo = new QComboBox();
+    m_connectionTypeCombo->addItem(tr("Straight"));
+    m_connectionTypeCombo->addItem(tr("Segmented"));
+    m_connectionTypeCombo->addItem(tr("Curved"));
+    lineGroupLayout->addWidget(m_connectionTypeCombo, 4, 1, 1, 3);
 
     layout->addWidget(m_lineGroup);
     layout->addStretch();
@@ -408,54 +419,56 @@ void PropertyPanel::setupConnections()
     connect(m_widthSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int width)
             {
         if (m_currentShape && m_drawingArea) {
-            QRect rect = m_currentShape->getRect();
-            rect.setWidth(width);
-            m_currentShape->resize(rect);
-            m_drawingArea->update();
+            m_drawingArea->editSelectedGeometry([&](ShapeBase *shape) {
+                QRect rect = shape->getRect();
+                rect.setWidth(width);
+                shape->resize(rect);
+            });
         } });
 
     connect(m_heightSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int height)
             {
         if (m_currentShape && m_drawingArea) {
-            QRect rect = m_currentShape->getRect();
-            rect.setHeight(height);
-            m_currentShape->resize(rect);
-            m_drawingArea->update();
+            m_drawingArea->editSelectedGeometry([&](ShapeBase *shape) {
+                QRect rect = shape->getRect();
+                rect.setHeight(height);
+                shape->resize(rect);
+            });
         } });
 
     // 连接X和Y位置的变化信号
     connect(m_xPosSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int x)
             {
         if (m_currentShape && m_drawingArea) {
-            QRect rect = m_currentShape->getRect();
-            rect.moveLeft(x);
-            m_currentShape->resize(rect);
-            m_drawingArea->update();
+            m_drawingArea->editSelectedGeometry([&](ShapeBase *shape) {
+                QRect rect = shape->getRect();
+                rect.moveLeft(x);
+                shape->resize(rect);
+            });
         } });
 
     connect(m_yPosSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int y)
             {
         if (m_currentShape && m_drawingArea) {
-            QRect rect = m_currentShape->getRect();
-            rect.moveTop(y);
-            m_currentShape->resize(rect);
-            m_drawingArea->update();
+            m_drawingArea->editSelectedGeometry([&](ShapeBase *shape) {
+                QRect rect = shape->getRect();
+                rect.moveTop(y);
+                shape->resize(rect);
+            });
         } });
 
     // 连接不透明度的变化信号
     connect(m_opacitySpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, [this](double opacity)
             {
         if (m_currentShape && m_drawingArea) {
-            m_currentShape->setOpacity(opacity / 100.0); // 将百分比转换为0-1的范围
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) { shape->setOpacity(opacity / 100.0); }); // 将百分比转换为0-1的范围
         } });
 
     // 连接旋转角度的变化信号
     connect(m_rotationSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, [this](double angle)
             {
         if (m_currentShape && m_drawingArea) {
-            m_currentShape->setRotation(angle * (M_PI / 180.0));
-            m_drawingArea->update();
+            m_drawingArea->editSelectedGeometry([&](ShapeBase *shape) { shape->setRotation(angle * (M_PI / 180.0)); });
         } });
 
     // 连接垂直翻转按钮
@@ -463,8 +476,7 @@ void PropertyPanel::setupConnections()
             {
         if (m_currentShape && m_drawingArea) {
             m_rotationSpinBox->setValue(0);  // 设置角度为0
-            m_currentShape->setRotation(0);
-            m_drawingArea->update();
+            m_drawingArea->editSelectedGeometry([](ShapeBase *shape) { shape->setRotation(0); });
         } });
 
     // 连接水平翻转按钮
@@ -472,8 +484,7 @@ void PropertyPanel::setupConnections()
             {
         if (m_currentShape && m_drawingArea) {
             m_rotationSpinBox->setValue(90);  // 设置角度为90
-            m_currentShape->setRotation(90 * (M_PI / 180.0));
-            m_drawingArea->update();
+            m_drawingArea->editSelectedGeometry([](ShapeBase *shape) { shape->setRotation(90 * (M_PI / 180.0)); });
         } });
 
     // 连接向左旋转按钮
@@ -500,8 +511,7 @@ void PropertyPanel::setupConnections()
     connect(m_lineWidthSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, [this](double width)
             {
         if (m_currentShape && m_drawingArea) {
-            m_currentShape->setLineWidth(width);
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) { shape->setLineWidth(width); });
         } });
 
     // 连接填充颜色按钮
@@ -512,8 +522,7 @@ void PropertyPanel::setupConnections()
             m_fillColor = color;
             updateButtonStyle(m_fillColorButton, color);
             if (m_currentShape && m_drawingArea) {
-                m_currentShape->setFillColor(color);
-                m_drawingArea->update();
+                applyStyle([&](ShapeBase *shape) { shape->setFillColor(color); });
             }
         } });
 
@@ -525,8 +534,7 @@ void PropertyPanel::setupConnections()
             m_lineColor = color;
             updateButtonStyle(m_lineColorButton, color);
             if (m_currentShape && m_drawingArea) {
-                m_currentShape->setLineColor(color);
-                m_drawingArea->update();
+                applyStyle([&](ShapeBase *shape) { shape->setLineColor(color); });
             }
         } });
 
@@ -534,24 +542,28 @@ void PropertyPanel::setupConnections()
     connect(m_lineTypeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index)
             {
         if (m_currentShape && m_drawingArea) {
-            m_currentShape->setLineType(static_cast<ShapeBase::LineType>(index));
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) { shape->setLineType(static_cast<ShapeBase::LineType>(index)); });
+        } });
+
+    // 连接线类型下拉框，顺序与ShapeArrow::Routing相同
+    connect(m_connectionTypeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index)
+            {
+        if (m_currentShape && m_drawingArea) {
+            m_drawingArea->setSelectedArrowRouting(static_cast<ShapeArrow::Routing>(index));
         } });
 
     // 连接字体下拉框
     connect(m_fontFamilyCombo, &QComboBox::currentTextChanged, this, [this](const QString &family)
             {
         if (m_currentShape && m_drawingArea) {
-            m_currentShape->setFontFamily(family);
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) { shape->setFontFamily(family); });
         } });
 
     // 连接字体大小
     connect(m_fontSizeSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int size)
             {
         if (m_currentShape && m_drawingArea) {
-            m_currentShape->setFontSize(size);
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) { shape->setFontSize(size); });
         } });
 
     // 连接行高
@@ -559,7 +571,7 @@ void PropertyPanel::setupConnections()
             {
         if (m_currentShape && m_drawingArea && m_currentShape->isTextEditable()) {
             // 设置行高的代码，可能需要在ShapeBase中添加相应方法
-            m_drawingArea->update();
+            m_drawingArea->invalidateScene();
         } }); // 连接水平对齐方式下拉框
     connect(m_hAlignCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index)
             {
@@ -578,29 +590,37 @@ void PropertyPanel::setupConnections()
     connect(m_boldButton, &QToolButton::toggled, this, [this](bool checked)
             {
         if (m_currentShape && m_drawingArea && m_currentShape->isTextEditable()) {
-            m_currentShape->setFontBold(checked);
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) {
+                if (shape->isTextEditable())
+                    shape->setFontBold(checked);
+            });
         } });
 
     connect(m_italicButton, &QToolButton::toggled, this, [this](bool checked)
             {
         if (m_currentShape && m_drawingArea && m_currentShape->isTextEditable()) {
-            m_currentShape->setFontItalic(checked);
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) {
+                if (shape->isTextEditable())
+                    shape->setFontItalic(checked);
+            });
         } });
 
     connect(m_underlineButton, &QToolButton::toggled, this, [this](bool checked)
             {
         if (m_currentShape && m_drawingArea && m_currentShape->isTextEditable()) {
-            m_currentShape->setFontUnderline(checked);
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) {
+                if (shape->isTextEditable())
+                    shape->setFontUnderline(checked);
+            });
         } });
 
     connect(m_strikeoutButton, &QToolButton::toggled, this, [this](bool checked)
             {
         if (m_currentShape && m_drawingArea && m_currentShape->isTextEditable()) {
-            m_currentShape->setFontStrikeOut(checked);
-            m_drawingArea->update();
+            applyStyle([&](ShapeBase *shape) {
+                if (shape->isTextEditable())
+                    shape->setFontStrikeOut(checked);
+            });
         } });
 
     // 连接文字颜色按钮
@@ -611,8 +631,10 @@ void PropertyPanel::setupConnections()
             m_textColor = color;
             updateButtonStyle(m_textColorButton, color);
             if (m_currentShape && m_drawingArea && m_currentShape->isTextEditable()) {
-                m_currentShape->setTextColor(color);
-                m_drawingArea->update();
+                applyStyle([&](ShapeBase *shape) {
+                    if (shape->isTextEditable())
+                        shape->setTextColor(color);
+                });
             }
         } });
 
@@ -699,6 +721,12 @@ void PropertyPanel::setupPageStyleConnections()
             m_gridSizeSpinBox->setEnabled(checked);
         } });
 
+    // 吸附到网格复选框事件
+    connect(m_snapToGridCheckBox, &QCheckBox::toggled, this, [this](bool checked)
+            {
+        if (m_drawingArea)
+            m_drawingArea->setSnapToGrid(checked); });
+
     // 网格大小下拉框事件
     connect(m_gridSizeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index)
             {
@@ -756,14 +784,16 @@ void PropertyPanel::updateForSelectedShape(ShapeBase *shape)
         return;
     }
 
-    m_currentShape = shape;
     m_tabWidget->setCurrentWidget(m_shapeStyleTab);
 
     // 启用所有控件
     m_shapeStyleTab->setEnabled(true);
 
-    // 更新属性面板中的值
+    // 更新属性面板中的值。填入数值会触发各控件的修改信号，此时先不关联图形，
+    // 避免把主选图形的属性写到其他选中的图形上
+    m_currentShape = nullptr;
     updateShapeProperties(shape);
+    m_currentShape = shape;
 }
 
 void PropertyPanel::updateShapeProperties(ShapeBase *shape)
@@ -808,6 +838,11 @@ void PropertyPanel::updateShapeProperties(ShapeBase *shape)
     // 更新线条类型
     m_lineTypeCombo->setCurrentIndex(static_cast<int>(shape->getLineType()));
 
+    // 更新连接线类型，只有箭头可以修改
+    auto *arrow = dynamic_cast<ShapeArrow *>(shape);
+    m_connectionTypeCombo->setEnabled(arrow != nullptr);
+    m_connectionTypeCombo->setCurrentIndex(arrow ? static_cast<int>(arrow->routing()) : 0);
+
     // 更新颜色
     m_lineColor = shape->getLineColor();
     updateButtonStyle(m_lineColorButton, m_lineColor);
@@ -918,6 +953,17 @@ void PropertyPanel::updateButtonStyle(QPushButton *button, const QColor &color)
     button->setToolTip(QString("RGB: %1, %2, %3").arg(color.red()).arg(color.green()).arg(color.blue()));
 }
 
+void PropertyPanel::applyStyle(const std::function<void(ShapeBase *)> &edit)
+{
+    if (!m_drawingArea)
+        return;
+
+    if (m_sharedStyleCheckBox->isChecked())
+        m_drawingArea->restyleSelected(edit);
+    else
+        m_drawingArea->applyToSelection(edit);
+}
+
 void PropertyPanel::updateTextAlignment()
 {
     if (!m_currentShape || !m_drawingArea)
@@ -956,9 +1002,11 @@ void PropertyPanel::updateTextAlignment()
     // 组合对齐方式
     int alignment = hAlign | vAlign;
 
-    // 应用到当前形状
-    m_currentShape->setTextAlignment(alignment);
-    m_drawingArea->update();
+    // 应用到选中的图形，记录为一步
+    applyStyle([&](ShapeBase *shape) {
+        if (shape->isTextEditable())
+            shape->setTextAlignment(alignment);
+    });
 }
 
 // 更新背景颜色UI - 用于外部同步
@@ -984,6 +1032,17 @@ void PropertyPanel::updateGridVisibilityUI(bool visible)
     }
 }
 
+// 更新网格吸附UI - 用于外部同步
+void PropertyPanel::updateSnapToGridUI(bool snap)
+{
+    if (m_snapToGridCheckBox->isChecked() != snap)
+    {
+        m_snapToGridCheckBox->blockSignals(true);
+        m_snapToGridCheckBox->setChecked(snap);
+        m_snapToGridCheckBox->blockSignals(false);
+    }
+}
+
 // 更新网格大小UI - 用于外部同步
 void PropertyPanel::updateGridSizeUI(int size)
 {
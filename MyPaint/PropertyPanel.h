@@ -17,6 +17,7 @@
 #include <QToolButton>
 #include <QCheckBox>
 #include <cmath>
+#include <functional>
 #include "ShapeBase.h"
 
 class DrawingArea;
@@ -35,6 +36,7 @@ public:
     // UI更新方法 - 用于同步外部修改
     void updateBackgroundColorUI(const QColor &color);
     void updateGridVisibilityUI(bool visible);
+    void updateSnapToGridUI(bool snap);
     void updateGridSizeUI(int size);
     void updatePageSizeUI(const QSize &size);
 
@@ -50,6 +52,7 @@ private:
     void updateShapeProperties(ShapeBase *shape);
     void updateButtonStyle(QPushButton *button, const QColor &color);
     void updateTextAlignment(); // 更新文本对齐方式
+    void applyStyle(const std::function<void(ShapeBase *)> &edit); // 修改选中图形的样式，或者整体修改共享的样式
 
     DrawingArea *m_drawingArea;
     ShapeBase *m_currentShape;
@@ -76,11 +79,13 @@ private:
     QCheckBox *m_showGridCheckBox; // 显示网格
     QComboBox *m_gridSizeCombo;    // 网格大小
     QSpinBox *m_gridSizeSpinBox;   // 网格尺寸
+    QCheckBox *m_snapToGridCheckBox; // 吸附到网格
 
     // 图形样式标签页
     QWidget *m_shapeStyleTab;
     QLabel *m_shapeTypeLabel; // 使用标签替代下拉框
     QDoubleSpinBox *m_opacitySpinBox;
+    QCheckBox *m_sharedStyleCheckBox; // 样式修改应用到所有使用同一样式的图形
 
     // 布局部分
     QGroupBox *m_layoutGroup;
@@ -0,0 +1,158 @@
+#include "RenderWorker.h"
+#include <QMutexLocker>
+#include <QPainter>
+#include <QtMath>
+
+bool FrameInfo::satisfies(const FrameInfo &wanted) const
+{
+    if (sceneRevision != wanted.sceneRevision || zoomFactor != wanted.zoomFactor)
+        return false;
+    if (!qFuzzyCompare(devicePixelRatio, wanted.devicePixelRatio))
+        return false;
+    if (quality == SceneRenderer::Quality::Draft && wanted.quality == SceneRenderer::Quality::Full)
+        return false;
+    return contentRect.contains(wanted.contentRect);
+}
+
+void FrameBuffer::publish()
+{
+    // 写好的后台帧成为待取帧，换回来的旧待取帧（或GUI线程已经放下的前台帧）作为下一帧的后台
+    int previous = m_ready.exchange(m_back | kFreshBit, std::memory_order_acq_rel);
+    m_back = previous & kIndexMask;
+}
+
+const RenderedFrame &FrameBuffer::frontFrame()
+{
+    // 有新发布的帧时与前台帧交换，否则继续使用当前的前台帧
+    if (m_ready.load(std::memory_order_acquire) & kFreshBit)
+    {
+        int previous = m_ready.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & kIndexMask;
+    }
+    return m_frames[m_front];
+}
+
+RenderWorker::RenderWorker(QObject *parent) : QThread(parent)
+{
+    setObjectName("renderWorker");
+}
+
+RenderWorker::~RenderWorker()
+{
+    stop();
+}
+
+void RenderWorker::requestFrame(FrameRequest request)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_hasPending)
+    {
+        // 被替换的请求还没处理，它记录的失效区域要带到新请求中
+        request.invalidateAll = request.invalidateAll || m_pending.invalidateAll;
+        request.dirtyDocRects.insert(request.dirtyDocRects.end(),
+                                     m_pending.dirtyDocRects.begin(), m_pending.dirtyDocRects.end());
+    }
+    m_pending = std::move(request);
+    m_hasPending = true;
+    m_wakeUp.wakeOne();
+}
+
+void RenderWorker::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wakeUp.wakeOne();
+    }
+    wait();
+}
+
+void RenderWorker::run()
+{
+    for (;;)
+    {
+        FrameRequest request;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_hasPending && !m_stopping)
+                m_wakeUp.wait(&m_mutex);
+            if (m_stopping)
+                return;
+
+            // 只处理最新的请求，期间提交的请求会排在下一帧
+            request = std::move(m_pending);
+            m_pending = FrameRequest();
+            m_hasPending = false;
+        }
+        renderFrame(request);
+    }
+}
+
+void RenderWorker::renderFrame(const FrameRequest &request)
+{
+    const FrameInfo &info = request.info;
+    if (!request.scene || info.contentRect.isEmpty())
+        return;
+
+    // 1. 根据请求更新图块缓存：缩放变化后全部丢弃，否则只把变化的区域标记为需要重绘
+    double zoom = info.zoomFactor;
+    if (zoom != m_cacheZoom)
+    {
+        m_tileCache.clear();
+        m_cacheZoom = zoom;
+    }
+    else if (request.invalidateAll)
+    {
+        m_tileCache.invalidateAll();
+    }
+    else
+    {
+        for (const QRect &docRect : request.dirtyDocRects)
+        {
+            QRect contentRect(qFloor(docRect.left() * zoom), qFloor(docRect.top() * zoom),
+                              qCeil(docRect.width() * zoom) + 1, qCeil(docRect.height() * zoom) + 1);
+            // 多留两个像素，覆盖抗锯齿的边缘
+            m_tileCache.invalidate(contentRect.adjusted(-2, -2, 2, 2));
+        }
+    }
+    m_tileCache.setDevicePixelRatio(info.devicePixelRatio);
+    m_tileCache.setCapacity(m_tileCapacity.load());
+    m_tileCache.beginFrame();
+    m_groupImages.beginFrame();
+
+    // 2. 把覆盖请求范围的图块合成到后台帧中，后台帧的图像尽量复用
+    RenderedFrame &frame = m_frameBuffer.backFrame();
+    QSize pixelSize(qCeil(info.contentRect.width() * info.devicePixelRatio),
+                    qCeil(info.contentRect.height() * info.devicePixelRatio));
+    if (frame.image.size() != pixelSize)
+        frame.image = QImage(pixelSize, QImage::Format_ARGB32_Premultiplied);
+    frame.image.setDevicePixelRatio(info.devicePixelRatio);
+    frame.info = info;
+
+    const RenderScene &scene = *request.scene;
+    auto renderTile = [this, &scene, &info](QImage &image, const QRect &tileRect)
+    {
+        SceneRenderer::renderTile(image, tileRect, scene, info.quality, &m_groupImages);
+    };
+    bool draft = info.quality == SceneRenderer::Quality::Draft;
+
+    QPainter painter(&frame.image);
+    int left = TileCache::tileIndex(info.contentRect.left());
+    int right = TileCache::tileIndex(info.contentRect.right());
+    int top = TileCache::tileIndex(info.contentRect.top());
+    int bottom = TileCache::tileIndex(info.contentRect.bottom());
+    for (int ty = top; ty <= bottom; ++ty)
+    {
+        for (int tx = left; tx <= right; ++tx)
+        {
+            QPoint tilePos = TileCache::tileRect(tx, ty).topLeft() - info.contentRect.topLeft();
+            painter.drawImage(tilePos, m_tileCache.tile(tx, ty, renderTile, draft));
+        }
+    }
+    painter.end();
+    m_tileCache.evict();
+
+    // 3. 发布完成的帧，通知GUI线程重绘
+    m_frameBuffer.publish();
+    emit frameReady();
+}
@@ -0,0 +1,109 @@
+#ifndef RENDERWORKER_H
+#define RENDERWORKER_H
+
+#include "GroupImageCache.h"
+#include "SceneRenderer.h"
+#include "TileCache.h"
+#include <QImage>
+#include <QMutex>
+#include <QRect>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// 一帧画面对应的视图状态，用于判断已有的帧能否直接显示
+struct FrameInfo
+{
+  QRect contentRect;            // 帧覆盖的范围（缩放后的内容坐标）
+  double zoomFactor = 1.0;      // 缩放因子
+  qreal devicePixelRatio = 1.0; // 设备像素比
+  SceneRenderer::Quality quality = SceneRenderer::Quality::Full;
+  quint64 sceneRevision = 0;    // 场景版本，场景内容每次变化都会增加
+
+  // 本帧能否代替wanted显示：场景和缩放相同、范围覆盖、质量不低于要求
+  bool satisfies(const FrameInfo &wanted) const;
+};
+
+// 一次渲染请求：不可变的场景快照加上需要绘制的视口范围
+struct FrameRequest
+{
+  FrameInfo info;
+  std::shared_ptr<const RenderScene> scene; // 场景快照，提交后不再修改
+  bool invalidateAll = false;               // 自上次请求以来场景整体发生了变化
+  std::vector<QRect> dirtyDocRects;         // 自上次请求以来发生变化的文档区域
+};
+
+// 渲染完成的一帧
+struct RenderedFrame
+{
+  QImage image;
+  FrameInfo info;
+};
+
+// 渲染线程与GUI线程之间的无锁帧交换。
+// 渲染线程写后台帧，写完后与“待取”帧原子交换；GUI线程绘制前把待取帧换成前台帧。
+// 比普通的双缓冲多一块待取帧，GUI线程正在贴图的前台帧不会被渲染线程覆盖，双方都不需要等待。
+class FrameBuffer
+{
+public:
+  RenderedFrame &backFrame() { return m_frames[m_back]; } // 只在渲染线程中使用
+  void publish();                                         // 发布后台帧，只在渲染线程中调用
+  const RenderedFrame &frontFrame();                      // 最新发布的帧，只在GUI线程中调用
+
+private:
+  static const int kIndexMask = 3;
+  static const int kFreshBit = 4; // 待取帧是新发布的、GUI线程还没有取走
+
+  RenderedFrame m_frames[3];
+  std::atomic<int> m_ready{1}; // 待取帧的下标（带kFreshBit标记）
+  int m_front = 0;             // GUI线程持有
+  int m_back = 2;              // 渲染线程持有
+};
+
+// 渲染线程：接收场景快照，在图块缓存的基础上合成整帧画面。
+// GUI线程只负责生成快照和贴图，绘制一帧的耗时不会阻塞输入处理。
+class RenderWorker : public QThread
+{
+  Q_OBJECT
+public:
+  explicit RenderWorker(QObject *parent = nullptr);
+  ~RenderWorker() override;
+
+  // 提交渲染请求；还没开始处理的旧请求会被替换，其中的失效区域合并到新请求中
+  void requestFrame(FrameRequest request);
+
+  // 最近一次渲染完成的帧，只能在GUI线程中调用
+  const RenderedFrame &frontFrame() { return m_frameBuffer.frontFrame(); }
+
+  // 图块缓存容量，下一帧开始生效
+  void setTileCapacity(int capacity) { m_tileCapacity.store(capacity); }
+
+  // 停止线程并等待当前帧完成
+  void stop();
+
+signals:
+  void frameReady(); // 新的一帧已经发布（在渲染线程中发出）
+
+protected:
+  void run() override;
+
+private:
+  void renderFrame(const FrameRequest &request);
+
+  QMutex m_mutex;
+  QWaitCondition m_wakeUp;
+  FrameRequest m_pending;  // 等待处理的最新请求
+  bool m_hasPending = false;
+  bool m_stopping = false;
+  std::atomic<int> m_tileCapacity{128};
+  FrameBuffer m_frameBuffer;
+
+  // 以下成员只在渲染线程中访问
+  TileCache m_tileCache;
+  GroupImageCache m_groupImages; // 设置了缓存的组的图像
+  double m_cacheZoom = 0.0; // 图块缓存对应的缩放因子
+};
+
+#endif // RENDERWORKER_H
@@ -0,0 +1,402 @@
+#include "SceneRenderer.h"
+#include "GroupImageCache.h"
+#include "ShapeArrow.h"
+#include "ShapeDiamond.h"
+#include "ShapeEllipse.h"
+#include "ShapePentagon.h"
+#include "ShapePolygon.h"
+#include "ShapeRect.h"
+#include "ShapeRoundedRect.h"
+#include "ShapeTriangle.h"
+#include <QtMath>
+#include <algorithm>
+
+// 向下取整的整数除法（网格在负坐标区域也要对齐）
+static int floorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// 按种类直接调用具体类的boundingRect，限定名调用是静态绑定的
+static QRect shapeRect(const ShapeBase *shape)
+{
+    switch (shape->kind())
+    {
+    case ShapeBase::Kind::Rect:
+        return static_cast<const ShapeRect *>(shape)->ShapeRect::boundingRect();
+    case ShapeBase::Kind::RoundedRect:
+        return static_cast<const ShapeRoundedRect *>(shape)->ShapeRoundedRect::boundingRect();
+    case ShapeBase::Kind::Ellipse:
+        return static_cast<const ShapeEllipse *>(shape)->ShapeEllipse::boundingRect();
+    case ShapeBase::Kind::Triangle:
+        return static_cast<const ShapeTriangle *>(shape)->ShapeTriangle::boundingRect();
+    case ShapeBase::Kind::Diamond:
+        return static_cast<const ShapeDiamond *>(shape)->ShapeDiamond::boundingRect();
+    case ShapeBase::Kind::Pentagon:
+        return static_cast<const ShapePentagon *>(shape)->ShapePentagon::boundingRect();
+    case ShapeBase::Kind::Polygon:
+        return static_cast<const ShapePolygon *>(shape)->ShapePolygon::boundingRect();
+    case ShapeBase::Kind::Arrow:
+        return static_cast<const ShapeArrow *>(shape)->ShapeArrow::boundingRect();
+    }
+    return shape->boundingRect();
+}
+
+// 绘制图形的基本图元，画笔和画刷已经由调用方设置好
+static void drawPrimitive(QPainter &painter, const ShapeBase *shape, const QRect &rect)
+{
+    switch (shape->kind())
+    {
+    case ShapeBase::Kind::Rect:
+        painter.drawRect(rect);
+        break;
+    case ShapeBase::Kind::Ellipse:
+        painter.drawEllipse(rect);
+        break;
+    default:
+        painter.drawPath(shape->outlinePath()); // 其余图形使用缓存的轮廓
+        break;
+    }
+}
+
+void SceneRenderer::paintScene(QPainter &painter, const QRect &docRect, const RenderScene &scene,
+                               GroupImageCache *groupImages)
+{
+    QRect pageRect(0, 0, scene.pageSize.width(), scene.pageSize.height());
+    QSize scaledPageSize(qRound(scene.pageSize.width() * scene.zoomFactor),
+                         qRound(scene.pageSize.height() * scene.zoomFactor));
+    QRect scaledPageRect(QPoint(0, 0), scaledPageSize);
+    QRect contentArea = painter.clipBoundingRect().toAlignedRect(); // 绘制区域（内容坐标）
+
+    if (scene.infiniteCanvas)
+    {
+        // 无限画布没有页面外的工作区，整个画布使用背景颜色
+        painter.fillRect(painter.clipBoundingRect(), scene.backgroundColor);
+    }
+    else
+    {
+        // 填充工作区背景（页面外区域）为浅灰色，更容易区分页面和工作区
+        painter.fillRect(painter.clipBoundingRect(), QColor(240, 240, 240));
+
+        // 绘制页面背景
+        painter.fillRect(scaledPageRect, scene.backgroundColor); // 使用设置的背景颜色
+    }
+
+    // 绘制页面边框，便于识别页面（打印）边界
+    QPen pageBorderPen(QColor(180, 180, 180), 1);
+    painter.setPen(pageBorderPen);
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(scaledPageRect);
+
+    // 应用缩放变换，用于绘制网格和内容
+    painter.save();
+    painter.scale(scene.zoomFactor, scene.zoomFactor);
+
+    // 画网格，固定页面模式只在页面区域内绘制
+    QRect gridRect = scene.infiniteCanvas ? docRect : (docRect & pageRect);
+    if (scene.gridVisible && !gridRect.isEmpty())
+    {                                                           // 只在网格可见时绘制
+        int gridSize = scene.gridSize;                              // 网格间距
+        int majorGridStep = 5;                                  // 每5格一条粗线
+        QPen thinPen(QColor(200, 200, 200), 1 / scene.zoomFactor);  // 细线浅灰色，保持线宽不变
+        QPen thickPen(QColor(120, 120, 120), 2 / scene.zoomFactor); // 粗线深灰色，保持线宽不变
+
+        // 只绘制可见部分的网格线，线段也只覆盖可见范围
+        int startIdxX = floorDiv(gridRect.left(), gridSize);
+        int startIdxY = floorDiv(gridRect.top(), gridSize);
+        int startX = startIdxX * gridSize;
+        int endX = gridRect.right() + 1;
+        int startY = startIdxY * gridSize;
+        int endY = gridRect.bottom() + 1;
+        int lineTop = gridRect.top();
+        int lineBottom = gridRect.bottom() + 1;
+        int lineLeft = gridRect.left();
+        int lineRight = gridRect.right() + 1;
+
+        // 第一步：绘制细的竖线
+        for (int x = startX, idx = startIdxX; x <= endX; x += gridSize, ++idx)
+        {
+            if (floorDiv(idx, majorGridStep) * majorGridStep != idx) // 只绘制细线
+            {
+                painter.setPen(thinPen);
+                painter.drawLine(x, lineTop, x, lineBottom);
+            }
+        }
+
+        // 第二步：绘制所有横线（粗细都绘制）
+        for (int y = startY, idx = startIdxY; y <= endY; y += gridSize, ++idx)
+        {
+            if (floorDiv(idx, majorGridStep) * majorGridStep == idx)
+            {
+                painter.setPen(thickPen);
+            }
+            else
+            {
+                painter.setPen(thinPen);
+            }
+            painter.drawLine(lineLeft, y, lineRight, y);
+        }
+
+        // 第三步：绘制粗的竖线
+        for (int x = startX, idx = startIdxX; x <= endX; x += gridSize, ++idx)
+        {
+            if (floorDiv(idx, majorGridStep) * majorGridStep == idx) // 只绘制粗线
+            {
+                painter.setPen(thickPen);
+                painter.drawLine(x, lineTop, x, lineBottom);
+            }
+        }
+    }
+
+    // 画图形，跳过完全不在绘制区域内的图形
+    // 在屏幕上不足一个像素的图形不单独绘制，只累计到密度图中
+    std::vector<quint16> density;
+    // 先在几何副表的连续数组中筛出与绘制区域相交的图形，不访问图形对象
+    std::vector<int> candidates;
+    const ShapeGeometryTable *geometry = scene.geometry.get();
+    if (geometry && geometry->size() != static_cast<int>(scene.shapes.size()))
+        geometry = nullptr; // 副表与图形列表对不上时逐个访问图形
+    const ShapeGroupTree *groups = geometry ? scene.groups.get() : nullptr;
+    if (groups)
+    {
+        groups->intersecting(docRect, *geometry, candidates); // 范围不相交的组整体跳过
+    }
+    else if (geometry)
+    {
+        geometry->intersecting(docRect, candidates);
+    }
+    else
+    {
+        for (int i = 0; i < static_cast<int>(scene.shapes.size()); ++i)
+        {
+            if (scene.shapes[i]->paintBounds().intersects(docRect))
+                candidates.push_back(i);
+        }
+    }
+
+    // 使用图像缓存的组：成员在z序上连续，图像画在这些成员原来的位置
+    const bool useGroupImages = groupImages && groups && groups->hasGroups();
+    const double imageScale = scene.zoomFactor * painter.device()->devicePixelRatioF();
+    std::vector<int> drawnGroups;
+
+    std::vector<ShapeBase *> visibleShapes;
+    visibleShapes.reserve(candidates.size());
+    for (int index : candidates)
+    {
+        ShapeBase *shape = scene.shapes[index];
+        if (useGroupImages)
+        {
+            int id = groups->topLevelGroup(index);
+            if (id != ShapeGroupTree::kNoGroup && groups->group(id).cacheImage && groups->isContiguous(id))
+            {
+                if (std::find(drawnGroups.begin(), drawnGroups.end(), id) != drawnGroups.end())
+                    continue;
+                if (const QImage *image = groupImages->image(scene, id, imageScale))
+                {
+                    // 先画完下面的图形，再贴上整个组
+                    paintShapes(painter, visibleShapes, scene.zoomFactor);
+                    visibleShapes.clear();
+                    QRectF target(groups->group(id).bounds.topLeft(),
+                                  QSizeF(image->width() / imageScale, image->height() / imageScale));
+                    painter.setOpacity(1.0);
+                    painter.drawImage(target, *image);
+                    drawnGroups.push_back(id);
+                    continue;
+                }
+            }
+        }
+        double screenSize = geometry ? geometry->extent(index) * scene.zoomFactor
+                                     : shape->screenSize(scene.zoomFactor);
+        if (screenSize < 1.0)
+        {
+            QRect bounds = geometry ? geometry->bounds(index) : shape->paintBounds();
+            if (density.empty())
+                density.assign(static_cast<size_t>(contentArea.width()) * contentArea.height(), 0);
+
+            QPoint center = bounds.center();
+            int x = qFloor(center.x() * scene.zoomFactor) - contentArea.left();
+            int y = qFloor(center.y() * scene.zoomFactor) - contentArea.top();
+            if (x >= 0 && y >= 0 && x < contentArea.width() && y < contentArea.height())
+            {
+                quint16 &count = density[static_cast<size_t>(y) * contentArea.width() + x];
+                if (count < 0xFFFF)
+                    ++count;
+            }
+            continue;
+        }
+
+        visibleShapes.push_back(shape);
+    }
+    paintShapes(painter, visibleShapes, scene.zoomFactor);
+
+    painter.restore();
+
+    // 密度图：一个像素中的图形越多颜色越深
+    if (!density.empty())
+    {
+        QImage densityImage(contentArea.size(), QImage::Format_ARGB32_Premultiplied);
+        densityImage.fill(Qt::transparent);
+        for (int y = 0; y < contentArea.height(); ++y)
+        {
+            QRgb *line = reinterpret_cast<QRgb *>(densityImage.scanLine(y));
+            const quint16 *counts = density.data() + static_cast<size_t>(y) * contentArea.width();
+            for (int x = 0; x < contentArea.width(); ++x)
+            {
+                if (counts[x] == 0)
+                    continue;
+                int alpha = qMin(255, 64 + counts[x] * 48);
+                line[x] = qPremultiply(qRgba(64, 64, 64, alpha));
+            }
+        }
+        painter.drawImage(contentArea.topLeft(), densityImage);
+    }
+}
+
+void SceneRenderer::paintShapes(QPainter &painter, const std::vector<ShapeBase *> &shapes, double zoomFactor)
+{
+    QTransform baseTransform = painter.worldTransform();
+    const QFont baseFont = painter.font(); // 没有设置字体的文字使用的默认字体
+    bool rotated = false;                  // 当前变换是否带着某个图形的旋转
+    const ShapeBase *styleOwner = nullptr; // 当前画笔状态来自哪个图形，样式相同的图形直接沿用
+
+    for (ShapeBase *shape : shapes)
+    {
+        ShapeBase::Kind kind = shape->kind();
+        QRect rect = shapeRect(shape);
+
+        // 箭头走完整的绘制流程（内部会保存并恢复画笔状态），带文字的图形在图元之后直接画文字
+        bool simple = kind != ShapeBase::Kind::Arrow;
+        bool block = std::max(rect.width(), rect.height()) * zoomFactor < ShapeBase::kBlockDetailPixels;
+        if (!simple || block)
+        {
+            if (rotated)
+            {
+                painter.setWorldTransform(baseTransform);
+                rotated = false;
+            }
+            // 实心块按图形自身的不透明度填充，画笔上不能残留批次的不透明度
+            if (styleOwner && styleOwner->style().opacity != 1.0)
+            {
+                painter.setOpacity(1.0);
+                styleOwner = nullptr;
+            }
+            if (!simple)
+            {
+                shape->paint(&painter, false);
+                continue;
+            }
+
+            // 细节层次：与ShapeBase::paintBlock相同，只用线条颜色填充外接矩形
+            QColor color = shape->style().lineColor;
+            color.setAlphaF(shape->style().opacity);
+            painter.fillRect(rect, color);
+            continue;
+        }
+
+        // 种类或样式变化时才重新设置画笔、画刷和不透明度
+        if (!styleOwner || styleOwner->kind() != kind || !sameBatchStyle(*styleOwner, *shape))
+        {
+            applyBatchStyle(painter, *shape);
+            styleOwner = shape;
+        }
+
+        // 旋转直接设置变换矩阵，代替save/restore
+        if (shape->m_rotation != 0.0)
+        {
+            QPoint center = rect.center();
+            QTransform transform;
+            transform.translate(center.x(), center.y());
+            transform.rotate(qRadiansToDegrees(shape->m_rotation));
+            transform.translate(-center.x(), -center.y());
+            painter.setWorldTransform(transform * baseTransform);
+            rotated = true;
+        }
+        else if (rotated)
+        {
+            painter.setWorldTransform(baseTransform);
+            rotated = false;
+        }
+
+        drawPrimitive(painter, shape, rect);
+        if (!shape->m_text.isEmpty())
+        {
+            // 文字紧跟在自己的图形之后绘制，z序不变；文字改变了画笔，下一个图形重新设置
+            paintLabel(painter, *shape, rect, zoomFactor, baseFont);
+            styleOwner = nullptr;
+        }
+    }
+
+    if (rotated)
+        painter.setWorldTransform(baseTransform);
+    painter.setFont(baseFont);
+}
+
+void SceneRenderer::paintLabel(QPainter &painter, ShapeBase &shape, const QRect &rect, double zoomFactor,
+                               const QFont &baseFont)
+{
+    // 与ShapeBase::paint中的文字绘制相同，画笔的变换和不透明度已经由调用方设置好
+    const ShapeStyle &style = shape.style();
+    painter.setPen(QPen(style.textColor.isValid() ? style.textColor : Qt::black));
+    painter.setBrush(Qt::NoBrush);
+    painter.setFont(style.font.family().isEmpty() ? baseFont : style.font);
+
+    QRect textRect = rect.adjusted(5, 5, -5, -5);
+    if (shape.textPixelHeight() * zoomFactor < ShapeBase::kTextDetailPixels)
+        shape.paintTextBars(&painter, textRect);
+    else
+        shape.m_textLayout.draw(&painter, textRect, shape.m_text, painter.font(), style.textAlignment);
+}
+
+bool SceneRenderer::sameBatchStyle(const ShapeBase &a, const ShapeBase &b)
+{
+    // 共享同一项样式的图形不需要逐项比较
+    if (a.m_style == b.m_style)
+        return true;
+    const ShapeStyle &sa = a.style();
+    const ShapeStyle &sb = b.style();
+    return sa.lineColor == sb.lineColor && sa.lineWidth == sb.lineWidth && sa.lineType == sb.lineType &&
+           sa.fillColor == sb.fillColor && sa.opacity == sb.opacity;
+}
+
+void SceneRenderer::applyBatchStyle(QPainter &painter, const ShapeBase &shape)
+{
+    Qt::PenStyle penStyle = Qt::SolidLine;
+    const ShapeStyle &style = shape.style();
+    switch (style.lineType)
+    {
+    case ShapeBase::SolidLine:
+        penStyle = Qt::SolidLine;
+        break;
+    case ShapeBase::DashLine:
+        penStyle = Qt::DashLine;
+        break;
+    case ShapeBase::DotLine:
+        penStyle = Qt::DotLine;
+        break;
+    }
+
+    QPen pen(style.lineColor, style.lineWidth);
+    pen.setStyle(penStyle);
+    painter.setPen(pen);
+    painter.setBrush(style.fillColor);
+    painter.setOpacity(style.opacity);
+}
+
+void SceneRenderer::renderTile(QImage &image, const QRect &tileRect, const RenderScene &scene,
+                               Quality quality, GroupImageCache *groupImages)
+{
+    QPainter painter(&image);
+    // 草稿质量关闭抗锯齿，交互过程中尽快出图
+    bool fullQuality = quality == Quality::Full;
+    painter.setRenderHint(QPainter::Antialiasing, fullQuality);
+    painter.setRenderHint(QPainter::TextAntialiasing, fullQuality);
+    painter.translate(-tileRect.topLeft());
+    painter.setClipRect(tileRect);
+
+    // 图块对应的文档区域，多留一点余量覆盖跨图块的线条
+    double zoom = scene.zoomFactor;
+    QRect tileDocRect(qFloor(tileRect.left() / zoom), qFloor(tileRect.top() / zoom),
+                      qCeil(tileRect.width() / zoom), qCeil(tileRect.height() / zoom));
+    // 组图像按完整质量生成，草稿图块的分辨率不同，不使用缓存
+    paintScene(painter, tileDocRect.adjusted(-2, -2, 2, 2), scene, fullQuality ? groupImages : nullptr);
+}
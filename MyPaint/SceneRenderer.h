@@ -0,0 +1,112 @@
+#ifndef SCENERENDERER_H
+#define SCENERENDERER_H
+
+#include "ShapeBase.h"
+#include "ShapeGeometryTable.h"
+#include "ShapeGroupTree.h"
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QRect>
+#include <QSize>
+#include <memory>
+#include <vector>
+
+class GroupImageCache;
+
+// 快照中按绘制顺序排列的图形副本。每1024个图形为一块，复制时只复制块的指针，
+// 各快照共享未变化的块；修改一个图形时只复制它所在的、仍被其他快照引用的块（写时复制）
+class SceneShapes
+{
+public:
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  ShapeBase *operator[](std::size_t index) const { return (*m_blocks[index >> kBlockShift])[index & kBlockMask].get(); }
+
+  void clear()
+  {
+    m_blocks.clear();
+    m_size = 0;
+  }
+
+  void reserve(std::size_t count) { m_blocks.reserve((count + kBlockMask) >> kBlockShift); }
+
+  void push_back(std::shared_ptr<ShapeBase> shape)
+  {
+    if ((m_size & kBlockMask) == 0)
+    {
+      m_blocks.push_back(std::make_shared<Block>());
+      m_blocks.back()->reserve(kBlockMask + 1);
+    }
+    else if (m_blocks.back().use_count() > 1)
+    {
+      m_blocks.back() = std::make_shared<Block>(*m_blocks.back());
+    }
+    m_blocks.back()->push_back(std::move(shape));
+    ++m_size;
+  }
+
+  void replace(std::size_t index, std::shared_ptr<ShapeBase> shape)
+  {
+    std::shared_ptr<Block> &block = m_blocks[index >> kBlockShift];
+    if (block.use_count() > 1)
+      block = std::make_shared<Block>(*block);
+    (*block)[index & kBlockMask] = std::move(shape);
+  }
+
+private:
+  static const std::size_t kBlockShift = 10;
+  static const std::size_t kBlockMask = (std::size_t(1) << kBlockShift) - 1;
+  using Block = std::vector<std::shared_ptr<ShapeBase>>;
+  std::vector<std::shared_ptr<Block>> m_blocks;
+  std::size_t m_size = 0;
+};
+
+// 渲染场景所需的全部状态。
+// 渲染线程使用的是快照：快照持有图形的副本，创建后不再修改，可以在其他线程中使用。
+struct RenderScene
+{
+  QColor backgroundColor = Qt::white;
+  int gridSize = 20;
+  bool gridVisible = true;
+  QSize pageSize;
+  bool infiniteCanvas = false;
+  double zoomFactor = 1.0;
+  SceneShapes shapes;                                  // 按绘制顺序排列的图形副本
+  std::shared_ptr<const ShapeGeometryTable> geometry;  // 与shapes一一对应的几何副表，用于裁剪
+  std::shared_ptr<const ShapeGroupTree> groups;        // 分组，范围已经计算好，用于整组裁剪
+};
+
+// 场景绘制：背景、网格和图形，不含选中状态
+class SceneRenderer
+{
+public:
+  // 绘制质量：交互过程中使用草稿质量，空闲后再用完整质量重绘
+  enum class Quality
+  {
+    Draft, // 关闭抗锯齿
+    Full   // 完整质量
+  };
+
+  // painter 处于缩放后的内容坐标系，docRect 是需要绘制的文档区域。
+  // groupImages不为空时，设置了缓存的组在没有变化时用缓存的图像绘制
+  static void paintScene(QPainter &painter, const QRect &docRect, const RenderScene &scene,
+                         GroupImageCache *groupImages = nullptr);
+
+  // 把内容坐标中的一个图块绘制到image中
+  static void renderTile(QImage &image, const QRect &tileRect, const RenderScene &scene,
+                         Quality quality, GroupImageCache *groupImages = nullptr);
+
+  // 按z序批量绘制图形：连续的、种类和样式相同的图形只设置一次画笔，
+  // 基本图元按种类直接绘制，带文字的图形紧接着用缓存的排版画文字；只有箭头仍走完整的绘制流程
+  static void paintShapes(QPainter &painter, const std::vector<ShapeBase *> &shapes, double zoomFactor);
+
+private:
+  static bool sameBatchStyle(const ShapeBase &a, const ShapeBase &b); // 线条、填充和不透明度是否相同
+  static void applyBatchStyle(QPainter &painter, const ShapeBase &shape);
+  // 在图形的矩形中画文字（太小时画灰色条），rect是图形的外接矩形
+  static void paintLabel(QPainter &painter, ShapeBase &shape, const QRect &rect, double zoomFactor,
+                         const QFont &baseFont);
+};
+
+#endif // SCENERENDERER_H
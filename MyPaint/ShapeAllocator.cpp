@@ -0,0 +1,274 @@
+#include "ShapeAllocator.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <new>
+
+namespace
+{
+const std::size_t kChunkSize = 64 * 1024;
+const std::size_t kGranularity = 16; // 分级粒度，也保证了小块的对齐
+const std::size_t kMaxBlockSize = 512;
+const int kClassCount = static_cast<int>(kMaxBlockSize / kGranularity);
+
+struct FreeBlock
+{
+    FreeBlock *next;
+};
+
+int classIndex(std::size_t size)
+{
+    return static_cast<int>((size + kGranularity - 1) / kGranularity) - 1;
+}
+
+std::size_t blockSize(int index)
+{
+    return static_cast<std::size_t>(index + 1) * kGranularity;
+}
+
+thread_local ShapeAllocator *t_current = nullptr;
+} // namespace
+
+struct ShapeAllocator::Pool
+{
+    // 大块的开头，所有大块串成双向链表
+    struct alignas(16) Chunk
+    {
+        Pool *pool;
+        Chunk *prev;
+        Chunk *next;
+        int sizeClass;
+        int live; // 已分配出去的小块数
+    };
+
+    // 每个对象前面的头：小块记录所属的大块，直接向系统申请的对象记录所属的内存池
+    struct alignas(16) Header
+    {
+        Chunk *chunk;
+        Pool *pool;
+    };
+
+    QMutex mutex;
+    FreeBlock *freeLists[kClassCount] = {};
+    Chunk *chunks = nullptr;
+    Stats stats;
+    bool orphaned = false; // ShapeAllocator已经析构，最后一个对象释放时销毁
+
+    static Header *header(void *ptr) { return static_cast<Header *>(ptr) - 1; }
+
+    void addChunk(int index)
+    {
+        char *memory = static_cast<char *>(::operator new(kChunkSize));
+        Chunk *chunk = reinterpret_cast<Chunk *>(memory);
+        chunk->pool = this;
+        chunk->prev = nullptr;
+        chunk->next = chunks;
+        chunk->sizeClass = index;
+        chunk->live = 0;
+        if (chunks)
+            chunks->prev = chunk;
+        chunks = chunk;
+
+        // 倒序串成空闲链表，这样分配时按地址从低到高使用
+        const std::size_t stride = sizeof(Header) + blockSize(index);
+        const std::size_t count = (kChunkSize - sizeof(Chunk)) / stride;
+        char *first = memory + sizeof(Chunk);
+        for (std::size_t i = count; i-- > 0;)
+        {
+            Header *h = reinterpret_cast<Header *>(first + i * stride);
+            h->chunk = chunk;
+            h->pool = this;
+            FreeBlock *block = reinterpret_cast<FreeBlock *>(h + 1);
+            block->next = freeLists[index];
+            freeLists[index] = block;
+        }
+
+        ++stats.chunkAllocations;
+        stats.reservedBytes += kChunkSize;
+    }
+
+    void releaseChunk(Chunk *chunk)
+    {
+        ::operator delete(chunk);
+        ++stats.chunkReleases;
+        stats.reservedBytes -= kChunkSize;
+    }
+
+    // 没有存活对象时整体释放，不需要逐个检查空闲链表
+    void releaseAll()
+    {
+        for (Chunk *chunk = chunks; chunk;)
+        {
+            Chunk *next = chunk->next;
+            releaseChunk(chunk);
+            chunk = next;
+        }
+        chunks = nullptr;
+        for (FreeBlock *&freeList : freeLists)
+            freeList = nullptr;
+    }
+
+    // 只归还完全空闲的大块：先把其中的小块从空闲链表中摘掉，再整块释放
+    void trim()
+    {
+        for (FreeBlock *&freeList : freeLists)
+        {
+            FreeBlock *kept = nullptr;
+            for (FreeBlock *block = freeList; block;)
+            {
+                FreeBlock *next = block->next;
+                if (header(block)->chunk->live > 0)
+                {
+                    block->next = kept;
+                    kept = block;
+                }
+                block = next;
+            }
+            freeList = kept;
+        }
+
+        for (Chunk *chunk = chunks; chunk;)
+        {
+            Chunk *next = chunk->next;
+            if (chunk->live == 0)
+            {
+                if (chunk->prev)
+                    chunk->prev->next = chunk->next;
+                else
+                    chunks = chunk->next;
+                if (chunk->next)
+                    chunk->next->prev = chunk->prev;
+                releaseChunk(chunk);
+            }
+            chunk = next;
+        }
+    }
+};
+
+ShapeAllocator::Scope::Scope(ShapeAllocator &pool) : m_previous(t_current)
+{
+    t_current = &pool;
+}
+
+ShapeAllocator::Scope::~Scope()
+{
+    t_current = m_previous;
+}
+
+ShapeAllocator::ShapeAllocator() : m_pool(new Pool)
+{
+}
+
+ShapeAllocator::~ShapeAllocator()
+{
+    bool destroy;
+    {
+        QMutexLocker locker(&m_pool->mutex);
+        destroy = m_pool->stats.liveObjects == 0;
+        if (destroy)
+            m_pool->releaseAll();
+        else
+            m_pool->orphaned = true;
+    }
+    if (destroy)
+        delete m_pool;
+}
+
+ShapeAllocator &ShapeAllocator::current()
+{
+    return t_current ? *t_current : defaultPool();
+}
+
+// 默认内存池不析构：进程退出时仍可能有图形在静态对象中被释放
+ShapeAllocator &ShapeAllocator::defaultPool()
+{
+    static ShapeAllocator *instance = new ShapeAllocator;
+    return *instance;
+}
+
+void *ShapeAllocator::allocate(std::size_t size)
+{
+    Pool &p = *current().m_pool;
+    if (size == 0)
+        size = 1;
+
+    if (size > kMaxBlockSize)
+    {
+        Pool::Header *h = static_cast<Pool::Header *>(::operator new(sizeof(Pool::Header) + size));
+        h->chunk = nullptr;
+        h->pool = &p;
+        QMutexLocker locker(&p.mutex);
+        ++p.stats.allocations;
+        ++p.stats.largeAllocations;
+        ++p.stats.liveObjects;
+        return h + 1;
+    }
+
+    int index = classIndex(size);
+    QMutexLocker locker(&p.mutex);
+    if (!p.freeLists[index])
+        p.addChunk(index);
+
+    FreeBlock *block = p.freeLists[index];
+    p.freeLists[index] = block->next;
+    ++Pool::header(block)->chunk->live;
+
+    ++p.stats.allocations;
+    ++p.stats.liveObjects;
+    return block;
+}
+
+void ShapeAllocator::deallocate(void *ptr, std::size_t)
+{
+    if (!ptr)
+        return;
+
+    Pool::Header *h = Pool::header(ptr);
+    Pool *p = h->pool;
+    bool destroy;
+    {
+        QMutexLocker locker(&p->mutex);
+        if (Pool::Chunk *chunk = h->chunk)
+        {
+            --chunk->live;
+            FreeBlock *block = static_cast<FreeBlock *>(ptr);
+            block->next = p->freeLists[chunk->sizeClass];
+            p->freeLists[chunk->sizeClass] = block;
+        }
+        else
+        {
+            ::operator delete(h);
+        }
+
+        ++p->stats.deallocations;
+        --p->stats.liveObjects;
+        destroy = p->orphaned && p->stats.liveObjects == 0;
+        if (destroy)
+            p->releaseAll();
+    }
+    if (destroy)
+        delete p;
+}
+
+void ShapeAllocator::release()
+{
+    QMutexLocker locker(&m_pool->mutex);
+    if (m_pool->stats.liveObjects == 0)
+        m_pool->releaseAll();
+    else
+        m_pool->trim();
+}
+
+ShapeAllocator::Stats ShapeAllocator::stats() const
+{
+    QMutexLocker locker(&m_pool->mutex);
+    return m_pool->stats;
+}
+
+void ShapeAllocator::resetCounters()
+{
+    QMutexLocker locker(&m_pool->mutex);
+    Stats stats;
+    stats.liveObjects = m_pool->stats.liveObjects;
+    stats.reservedBytes = m_pool->stats.reservedBytes;
+    m_pool->stats = stats;
+}
@@ -0,0 +1,80 @@
+#ifndef SHAPEALLOCATOR_H
+#define SHAPEALLOCATOR_H
+
+#include <QtGlobal>
+#include <cstddef>
+
+// 图形和历史记录的内存池（slab）：按对象大小分级，每一级从64KB的大块中切分固定大小的小块。
+// 载入或粘贴大量图形时不再逐个向系统申请内存，相同大小的图形也集中在连续的内存中。
+// 每个文档（DrawingArea）有自己的内存池，文档中的图形、历史记录和其中的图形副本都从中分配，
+// 清空文档时一次归还全部大块。分配使用当前线程的当前内存池（见 Scope），没有指定时使用
+// 进程共用的默认内存池（剪贴板、渲染快照中的图形副本）。
+// 每个小块前记录所属的大块，释放时不需要知道当前内存池；渲染线程会释放快照中的图形副本，所以内部加锁。
+class ShapeAllocator
+{
+public:
+  // 分配统计，供性能分析使用
+  struct Stats
+  {
+    quint64 allocations = 0;      // 累计分配次数
+    quint64 deallocations = 0;    // 累计释放次数
+    quint64 largeAllocations = 0; // 超过最大分级、直接向系统申请的次数
+    quint64 chunkAllocations = 0; // 累计申请的大块数
+    quint64 chunkReleases = 0;    // 累计归还系统的大块数
+    quint64 liveObjects = 0;      // 当前存活的对象数
+    quint64 reservedBytes = 0;    // 当前占用的大块内存
+  };
+
+  // 把当前线程的当前内存池临时换成pool，离开作用域时恢复
+  class Scope
+  {
+  public:
+    explicit Scope(ShapeAllocator &pool);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    ShapeAllocator *m_previous;
+  };
+
+  // 供容器使用的分配器，同样从当前内存池分配
+  template <typename T>
+  struct Allocator
+  {
+    using value_type = T;
+    Allocator() = default;
+    template <typename U>
+    Allocator(const Allocator<U> &) {}
+    T *allocate(std::size_t n) { return static_cast<T *>(ShapeAllocator::allocate(n * sizeof(T))); }
+    void deallocate(T *ptr, std::size_t n) { ShapeAllocator::deallocate(ptr, n * sizeof(T)); }
+    template <typename U>
+    bool operator==(const Allocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const Allocator<U> &) const { return false; }
+  };
+
+  ShapeAllocator();
+  // 还有存活对象时不能归还大块，内存池在最后一个对象释放时才真正销毁
+  ~ShapeAllocator();
+  ShapeAllocator(const ShapeAllocator &) = delete;
+  ShapeAllocator &operator=(const ShapeAllocator &) = delete;
+
+  static void *allocate(std::size_t size); // 从当前内存池分配
+  static void deallocate(void *ptr, std::size_t size); // 归还到对象所属的内存池
+
+  static ShapeAllocator &current();
+  static ShapeAllocator &defaultPool();
+
+  // 把空闲的大块归还系统。没有存活对象时（清空文档后）不逐块检查，直接释放全部大块
+  void release();
+
+  Stats stats() const;
+  void resetCounters(); // 清零累计计数，当前占用不变
+
+private:
+  struct Pool;
+  Pool *m_pool;
+};
+
+#endif // SHAPEALLOCATOR_H
@@ -1,9 +1,144 @@
 #define _USE_MATH_DEFINES
 #include "ShapeArrow.h"
 #include <QPainter>
+#include <QPainterPath>
+#include <algorithm>
 #include <cmath>
 
-ShapeArrow::ShapeArrow(const QLine &line) : m_line(line) {}
+ShapeArrow::ShapeArrow(const QLine &line) : ShapeBase(Kind::Arrow), m_line(line) {}
+
+static const double kHitTolerance = 5.0; // 点击容差（像素）
+
+// 点到线段的距离不超过容差，投影落在线段之外时不算命中。
+// 与几何副表中的线段模型相同，全部用平方比较，不需要开方
+static bool nearSegment(const QPointF &p, const QPointF &p1, const QPointF &p2, double tolerance)
+{
+  // 计算线段向量
+  QPointF line = p2 - p1;
+  double lengthSquared = line.x() * line.x() + line.y() * line.y();
+  if (lengthSquared < 1e-12)
+    return false; // 线段太短
+
+  // 投影长度乘以线段长度，检查投影是否在线段范围内
+  QPointF toPoint = p - p1;
+  double projection = toPoint.x() * line.x() + toPoint.y() * line.y();
+  if (projection < 0 || projection > lengthSquared)
+    return false;
+
+  // 叉积是垂直距离乘以线段长度
+  double cross = toPoint.x() * line.y() - toPoint.y() * line.x();
+  return cross * cross <= tolerance * tolerance * lengthSquared;
+}
+
+// 折线在拐点外侧的一小块不在任何一段的投影范围内，单独按到拐点的距离判断
+static bool nearPoint(const QPointF &p, const QPointF &vertex, double tolerance)
+{
+  QPointF diff = p - vertex;
+  return diff.x() * diff.x() + diff.y() * diff.y() <= tolerance * tolerance;
+}
+
+void ShapeArrow::setRouting(Routing routing)
+{
+  if (routing == m_routing)
+    return;
+  m_routing = routing;
+  m_route.clear();
+  m_routeCorridor = QRect();
+  m_customControls = false;
+}
+
+QPoint ShapeArrow::controlPoint(int which) const
+{
+  QPoint end = which == 0 ? m_line.p1() : m_line.p2();
+  if (m_customControls)
+    return end + m_controlOffset[which];
+
+  // 自动放置：沿两端距离较大的方向引出一半的距离，形成S形
+  QPoint delta = m_line.p2() - m_line.p1();
+  QPoint offset = std::abs(delta.x()) >= std::abs(delta.y()) ? QPoint(delta.x() / 2, 0) : QPoint(0, delta.y() / 2);
+  return which == 0 ? end + offset : end - offset;
+}
+
+void ShapeArrow::setControlPoint(int which, const QPoint &pos)
+{
+  if (!m_customControls)
+  {
+    // 第一次拖动时把两个自动放置的控制点都固定下来
+    m_controlOffset[0] = controlPoint(0) - m_line.p1();
+    m_controlOffset[1] = controlPoint(1) - m_line.p2();
+    m_customControls = true;
+  }
+  m_controlOffset[which] = pos - (which == 0 ? m_line.p1() : m_line.p2());
+}
+
+const ShapeArrow::Flattened &ShapeArrow::flattened() const
+{
+  const QPoint key[4] = {m_line.p1(), controlPoint(0), controlPoint(1), m_line.p2()};
+  if (!m_flattened.points.empty() && std::equal(key, key + 4, m_flattened.key))
+    return m_flattened;
+
+  std::copy(key, key + 4, m_flattened.key);
+  QPointF p0(key[0]), c1(key[1]), c2(key[2]), p3(key[3]);
+
+  // 段数按控制多边形的长度估计，短曲线至少8段，长曲线不超过64段
+  QPointF legs[3] = {c1 - p0, c2 - c1, p3 - c2};
+  double length = 0;
+  for (const QPointF &leg : legs)
+    length += std::hypot(leg.x(), leg.y());
+  int segments = std::max(8, std::min(64, static_cast<int>(length / 8)));
+
+  m_flattened.points.resize(segments + 1);
+  m_flattened.bounds.resize(segments);
+  for (int i = 0; i <= segments; ++i)
+  {
+    double t = static_cast<double>(i) / segments;
+    double u = 1 - t;
+    m_flattened.points[i] = p0 * (u * u * u) + c1 * (3 * u * u * t) + c2 * (3 * u * t * t) + p3 * (t * t * t);
+  }
+  for (int i = 0; i < segments; ++i)
+  {
+    m_flattened.bounds[i] = QRectF(m_flattened.points[i], m_flattened.points[i + 1])
+                                .normalized()
+                                .adjusted(-kHitTolerance, -kHitTolerance, kHitTolerance, kHitTolerance);
+  }
+  return m_flattened;
+}
+
+void ShapeArrow::setRoute(std::vector<QPoint> route, const QRect &corridor)
+{
+  // 找不到路径时缓存简单折线，走廊中的图形变化之前不再重复搜索
+  m_route = route.size() >= 2 ? std::move(route) : elbowRoute();
+  m_routeCorridor = corridor;
+}
+
+bool ShapeArrow::routeValid() const
+{
+  return m_route.size() >= 2 && m_route.front() == m_line.p1() && m_route.back() == m_line.p2();
+}
+
+std::vector<QPoint> ShapeArrow::elbowRoute() const
+{
+  QPoint p1 = m_line.p1();
+  QPoint p2 = m_line.p2();
+  if (p1.x() == p2.x() || p1.y() == p2.y())
+    return {p1, p2};
+  int middle = (p1.x() + p2.x()) / 2;
+  return {p1, QPoint(middle, p1.y()), QPoint(middle, p2.y()), p2};
+}
+
+std::vector<QPoint> ShapeArrow::points() const
+{
+  if (m_routing == Routing::Straight)
+    return {m_line.p1(), m_line.p2()};
+  if (m_routing == Routing::Curved)
+  {
+    std::vector<QPoint> result;
+    for (const QPointF &pt : flattened().points)
+      result.push_back(pt.toPoint());
+    return result;
+  }
+  return routeValid() ? m_route : elbowRoute();
+}
 
 void ShapeArrow::paintShape(QPainter *painter)
 {
@@ -12,7 +147,7 @@ void ShapeArrow::paintShape(QPainter *painter)
 
   // 根据线条类型设置不同的画笔样式
   Qt::PenStyle penStyle = Qt::SolidLine;
-  switch (m_lineType)
+  switch (style().lineType)
   {
   case LineType::SolidLine:
     penStyle = Qt::SolidLine;
@@ -26,20 +161,44 @@ void ShapeArrow::paintShape(QPainter *painter)
   }
 
   // 设置画笔属性
-  QPen pen(m_lineColor, m_lineWidth);
+  QPen pen(style().lineColor, style().lineWidth);
   pen.setStyle(penStyle);
   painter->setPen(pen);
-  painter->setBrush(m_fillColor);
+  painter->setBrush(style().fillColor);
 
   // 绘制箭头线
-  painter->drawLine(m_line);
-
-  // 计算箭头角度
-  double angle = atan2(m_line.y2() - m_line.y1(), m_line.x2() - m_line.x1());
+  std::vector<QPoint> route = points();
+  if (m_routing == Routing::Straight)
+  {
+    painter->drawLine(m_line);
+  }
+  else if (m_routing == Routing::Orthogonal)
+  {
+    painter->drawPolyline(route.data(), static_cast<int>(route.size()));
+  }
+  else
+  {
+    QPainterPath path(m_line.p1());
+    path.cubicTo(controlPoint(0), controlPoint(1), m_line.p2());
+    painter->save();
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPath(path);
+    painter->restore();
+  }
 
   // 箭头大小
   const int arrowSize = 10;
 
+  // 缩放很小时箭头头部只有一两个像素，直接省略
+  if (arrowSize * painterScale(painter) < kArrowHeadDetailPixels)
+    return;
+
+  // 计算箭头角度：沿最后一段线的方向，曲线取终点处的切线（终点减去第二个控制点）
+  QPoint from = route[route.size() - 2];
+  if (m_routing == Routing::Curved && controlPoint(1) != m_line.p2())
+    from = controlPoint(1);
+  double angle = atan2(m_line.y2() - from.y(), m_line.x2() - from.x());
+
   // 计算箭头点
   QPoint arrowP1 = m_line.p2() - QPoint(arrowSize * cos(angle + M_PI / 6),
                                         arrowSize * sin(angle + M_PI / 6));
@@ -51,85 +210,84 @@ void ShapeArrow::paintShape(QPainter *painter)
   painter->drawLine(m_line.p2(), arrowP2);
 }
 
+void ShapeArrow::paintBlock(QPainter *painter)
+{
+  // 用一像素宽的细线代替实心块，保留箭头的走向
+  QColor color = style().lineColor;
+  color.setAlphaF(style().opacity);
+  QPen pen(color, 0);
+  painter->setPen(pen);
+  std::vector<QPoint> route = points();
+  painter->drawPolyline(route.data(), static_cast<int>(route.size()));
+}
+
 bool ShapeArrow::contains(const QPoint &pt) const
 {
+  QPointF p(pt);
+
   // 考虑旋转后的点击检测
-  if (m_rotation == 0.0)
+  if (m_rotation != 0.0)
   {
-    // 计算点到线段的距离
-    QPointF p1(m_line.p1());
-    QPointF p2(m_line.p2());
-    QPointF p(pt);
-
-    // 计算线段向量
-    QPointF line = p2 - p1;
-    double lineLength = sqrt(line.x() * line.x() + line.y() * line.y());
-    if (lineLength < 1e-6)
-      return false; // 线段太短
-
-    // 计算点到线段的投影
-    QPointF lineNormalized = line / lineLength;
-    QPointF toPoint = p - p1;
-    double projection =
-        toPoint.x() * lineNormalized.x() + toPoint.y() * lineNormalized.y();
-
-    // 检查投影是否在线段范围内
-    if (projection < 0 || projection > lineLength)
-      return false;
-
-    // 计算点到线段的垂直距离
-    QPointF projectionPoint = p1 + lineNormalized * projection;
-    QPointF diff = p - projectionPoint;
-    double distance = sqrt(diff.x() * diff.x() + diff.y() * diff.y());
-
-    // 如果距离小于阈值，则认为点击在线段上
-    return distance <= 5.0; // 5像素的点击容差
+    // 将点转换到箭头的局部坐标系
+    QPoint center = boundingRect().center();
+    QPoint localPt = pt - center;
+
+    // 反向旋转点
+    double cosAngle = cos(-m_rotation);
+    double sinAngle = sin(-m_rotation);
+    QPoint rotatedPt(localPt.x() * cosAngle - localPt.y() * sinAngle,
+                     localPt.x() * sinAngle + localPt.y() * cosAngle);
+
+    // 将点移回原坐标系
+    p = rotatedPt + center;
   }
 
-  // 将点转换到箭头的局部坐标系
-  QPoint center = boundingRect().center();
-  QPoint localPt = pt - center;
-
-  // 反向旋转点
-  double cosAngle = cos(-m_rotation);
-  double sinAngle = sin(-m_rotation);
-  QPoint rotatedPt(localPt.x() * cosAngle - localPt.y() * sinAngle,
-                   localPt.x() * sinAngle + localPt.y() * cosAngle);
-
-  // 将点移回原坐标系
-  rotatedPt += center;
-
-  // 使用未旋转的检测方法
-  QPointF p1(m_line.p1());
-  QPointF p2(m_line.p2());
-  QPointF p(rotatedPt);
-
-  // 计算线段向量
-  QPointF line = p2 - p1;
-  double lineLength = sqrt(line.x() * line.x() + line.y() * line.y());
-  if (lineLength < 1e-6)
-    return false; // 线段太短
-
-  // 计算点到线段的投影
-  QPointF lineNormalized = line / lineLength;
-  QPointF toPoint = p - p1;
-  double projection =
-      toPoint.x() * lineNormalized.x() + toPoint.y() * lineNormalized.y();
-
-  // 检查投影是否在线段范围内
-  if (projection < 0 || projection > lineLength)
+  // 曲线用缓存的折线，先用每一段的范围排除
+  if (m_routing == Routing::Curved)
+  {
+    const Flattened &curve = flattened();
+    for (size_t i = 0; i < curve.bounds.size(); ++i)
+    {
+      if (!curve.bounds[i].contains(p))
+        continue;
+      if (nearSegment(p, curve.points[i], curve.points[i + 1], kHitTolerance) ||
+          (i > 0 && nearPoint(p, curve.points[i], kHitTolerance)))
+        return true;
+    }
     return false;
+  }
 
-  // 计算点到线段的垂直距离
-  QPointF projectionPoint = p1 + lineNormalized * projection;
-  QPointF diff = p - projectionPoint;
-  double distance = sqrt(diff.x() * diff.x() + diff.y() * diff.y());
+  // 距离任何一段线不超过5像素就认为点击在线上
+  std::vector<QPoint> route = points();
+  for (size_t i = 0; i + 1 < route.size(); ++i)
+  {
+    if (nearSegment(p, route[i], route[i + 1], kHitTolerance) ||
+        (i > 0 && nearPoint(p, route[i], kHitTolerance)))
+      return true;
+  }
+  return false;
+}
 
-  // 如果距离小于阈值，则认为点击在线段上
-  return distance <= 5.0; // 5像素的点击容差
+void ShapeArrow::moveBy(const QPoint &delta)
+{
+  // 整体平移时路径形状不变，一起平移
+  bool valid = routeValid();
+  m_line.translate(delta);
+  if (valid)
+  {
+    for (QPoint &pt : m_route)
+      pt += delta;
+    m_routeCorridor.translate(delta);
+  }
 }
 
-void ShapeArrow::moveBy(const QPoint &delta) { m_line.translate(delta); }
+QPolygonF ShapeArrow::sceneOutline() const
+{
+    QPolygonF polygon;
+    for (const QPoint &pt : points())
+        polygon << QPointF(pt);
+    return polygon;
+}
 
 void ShapeArrow::resize(const QRect &newRect)
 {
@@ -138,7 +296,20 @@ void ShapeArrow::resize(const QRect &newRect)
 
 QRect ShapeArrow::boundingRect() const
 {
-  return QRect(m_line.p1(), m_line.p2()).normalized().adjusted(-5, -5, 5, 5);
+  if (m_routing == Routing::Straight)
+    return QRect(m_line.p1(), m_line.p2()).normalized().adjusted(-5, -5, 5, 5);
+
+  std::vector<QPoint> route = points();
+  int left = route.front().x(), right = left;
+  int top = route.front().y(), bottom = top;
+  for (const QPoint &pt : route)
+  {
+    left = std::min(left, pt.x());
+    right = std::max(right, pt.x());
+    top = std::min(top, pt.y());
+    bottom = std::max(bottom, pt.y());
+  }
+  return QRect(QPoint(left, top), QPoint(right, bottom)).adjusted(-5, -5, 5, 5);
 }
 
 // 获取起点和终点的锚点
@@ -166,9 +337,36 @@ std::vector<ShapeBase::Handle> ShapeArrow::getHandles() const
                            rotateSize, rotateSize),
                      Handle::Rotate, 2});
 
+  // 曲线的两个控制点
+  if (m_routing == Routing::Curved)
+  {
+    int controlSize = 8;
+    for (int which = 0; which < 2; ++which)
+    {
+      QPoint control = controlPoint(which);
+      handles.push_back({QRect(control.x() - controlSize / 2, control.y() - controlSize / 2,
+                               controlSize, controlSize),
+                         Handle::Control, kFirstControlHandle + which});
+    }
+  }
+
   return handles;
 }
 
+void ShapeArrow::paintSelection(QPainter *painter, bool showHandles)
+{
+  ShapeBase::paintSelection(painter, showHandles);
+  if (!showHandles || m_routing != Routing::Curved)
+    return;
+
+  // 控制柄：端点到对应控制点的细线
+  painter->save();
+  painter->setPen(QPen(Qt::blue, 0, Qt::DotLine));
+  painter->drawLine(m_line.p1(), controlPoint(0));
+  painter->drawLine(m_line.p2(), controlPoint(1));
+  painter->restore();
+}
+
 bool ShapeArrow::needPlusHandles() const { return false; }
 
 void ShapeArrow::rotate(double angle)
@@ -182,11 +380,13 @@ std::unique_ptr<ShapeBase> ShapeArrow::clone() const
   auto clone = std::make_unique<ShapeArrow>(m_line);
   clone->setText(m_text);
   clone->setRotation(m_rotation);
-  clone->setLineColor(m_lineColor);
-  clone->setLineWidth(m_lineWidth);
-  clone->setFillColor(m_fillColor);
-  clone->setLineType(m_lineType);
-  clone->setOpacity(m_opacity);
-  clone->setTextColor(m_textColor);
+  clone->setStyle(m_style);
+  clone->setGroupId(m_groupId);
+  clone->m_routing = m_routing;
+  clone->m_route = m_route;
+  clone->m_routeCorridor = m_routeCorridor;
+  clone->m_customControls = m_customControls;
+  clone->m_controlOffset[0] = m_controlOffset[0];
+  clone->m_controlOffset[1] = m_controlOffset[1];
   return clone;
 }
\ No newline at end of file
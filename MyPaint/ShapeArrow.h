@@ -2,17 +2,29 @@
 
 #include "ShapeBase.h"
 #include <QLine>
+#include <vector>
 
 class ShapeArrow : public ShapeBase
 {
 public:
+    // 连接线的走向：直线、正交折线、三次贝塞尔曲线
+    enum class Routing
+    {
+        Straight,
+        Orthogonal,
+        Curved
+    };
+
     ShapeArrow(const QLine &line);
     void paintShape(QPainter *painter) override;
+    void paintBlock(QPainter *painter) override;           // 很小时只画一条细线
     bool contains(const QPoint &pt) const override;
     void moveBy(const QPoint &delta) override;
     void resize(const QRect &newRect) override;
     QRect boundingRect() const override;
+    QPolygonF sceneOutline() const override;               // 两个端点，或者展开后的折线
     std::vector<Handle> getHandles() const override;
+    void paintSelection(QPainter *painter, bool showHandles = true) override; // 曲线还要画出控制柄
     bool needPlusHandles() const override;
     bool isTextEditable() const override { return false; } // 箭头不支持文本编辑
     void rotate(double angle) override;                    // 实现旋转方法
@@ -22,6 +34,22 @@ public:
     const QLine &getLine() const { return m_line; }
     void setP1(const QPoint &p1) { m_line.setP1(p1); }
     void setP2(const QPoint &p2) { m_line.setP2(p2); }
+
+    // 布线。折线的路径由DrawingArea避开其他图形计算后缓存在箭头上，
+    // 端点变化后、重新布线之前先用不避让的简单折线代替
+    Routing routing() const { return m_routing; }
+    void setRouting(Routing routing);
+    bool isRouted() const { return m_routing == Routing::Orthogonal; }
+    void setRoute(std::vector<QPoint> route, const QRect &corridor);
+    const QRect &routeCorridor() const { return m_routeCorridor; } // 其中的图形变化时需要重新布线
+    bool routeValid() const; // 缓存的路径与两端一致
+    std::vector<QPoint> points() const;                            // 实际绘制的折线（曲线为展开后的折线），包括两端
+
+    // 曲线的两个控制点，which为0时靠近起点，为1时靠近终点。没有拖动过时按两端的位置
+    // 自动放置；拖动后保存为相对各自端点的偏移，端点移动时曲线的形状不变
+    static const int kFirstControlHandle = 3; // getHandles()中第一个控制点的序号
+    QPoint controlPoint(int which) const;
+    void setControlPoint(int which, const QPoint &pos);
     
     // 更新连接点位置
     void updateConnection(bool isStartPoint, const QPoint &delta) {
@@ -43,9 +71,16 @@ public:
         obj["y1"] = m_line.y1();
         obj["x2"] = m_line.x2();
         obj["y2"] = m_line.y2();
-        obj["rotation"] = m_rotation;          // 保存旋转角度
-        obj["lineColor"] = m_lineColor.name(); // 保存线条颜色
-        obj["lineWidth"] = m_lineWidth;        // 保存线条粗细
+        obj["rotation"] = m_rotation; // 保存旋转角度
+        if (m_routing != Routing::Straight)
+            obj["routing"] = m_routing == Routing::Orthogonal ? "orthogonal" : "curved";
+        if (m_customControls)
+        {
+            obj["cx1"] = m_controlOffset[0].x();
+            obj["cy1"] = m_controlOffset[0].y();
+            obj["cx2"] = m_controlOffset[1].x();
+            obj["cy2"] = m_controlOffset[1].y();
+        }
         return obj;
     }
 
@@ -58,16 +93,39 @@ public:
         {
             m_rotation = obj["rotation"].toDouble();
         }
-        if (obj.contains("lineColor"))
+        QString routing = obj["routing"].toString();
+        setRouting(routing == "orthogonal" ? Routing::Orthogonal
+                   : routing == "curved"   ? Routing::Curved
+                                           : Routing::Straight);
+        m_customControls = obj.contains("cx1");
+        if (m_customControls)
         {
-            m_lineColor = QColor(obj["lineColor"].toString());
-        }
-        if (obj.contains("lineWidth"))
-        {
-            m_lineWidth = obj["lineWidth"].toInt();
+            m_controlOffset[0] = QPoint(obj["cx1"].toInt(), obj["cy1"].toInt());
+            m_controlOffset[1] = QPoint(obj["cx2"].toInt(), obj["cy2"].toInt());
         }
+        // 兼容旧文件中保存在箭头上的线条颜色和粗细
+        readStyleJson(obj);
     }
 
 private:
     QLine m_line;
+    Routing m_routing = Routing::Straight;
+    std::vector<QPoint> m_route; // 缓存的路径，两端与m_line不一致时已经过期
+    QRect m_routeCorridor;
+
+    bool m_customControls = false; // 控制点是否被拖动过
+    QPoint m_controlOffset[2];     // 拖动过的控制点相对各自端点的偏移
+
+    // 曲线展开成的折线和每一段外扩点击容差后的范围。端点或控制点变化后重新计算，
+    // 点击检测先用范围排除大部分线段，与直线的代价相当
+    struct Flattened
+    {
+        QPoint key[4]; // 计算时的端点和控制点
+        std::vector<QPointF> points;
+        std::vector<QRectF> bounds;
+    };
+    mutable Flattened m_flattened;
+    const Flattened &flattened() const;
+
+    std::vector<QPoint> elbowRoute() const; // 没有路径时的简单折线
 };
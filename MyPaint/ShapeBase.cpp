@@ -1,4 +1,7 @@
 #include "ShapeBase.h"
+#include <QStringList>
+#include <QTransform>
+#include <algorithm>
 #include <cmath>
 
 #ifndef M_PI
@@ -10,11 +13,24 @@ void ShapeBase::paint(QPainter *painter, bool selected)
   if (!painter)
     return;
 
+  double scale = painterScale(painter);
+
+  // 图形在屏幕上太小时只画一个实心块，省去路径、描边和文字
+  if (screenSize(scale) < kBlockDetailPixels)
+  {
+    paintBlock(painter);
+    if (selected)
+    {
+      paintSelection(painter);
+    }
+    return;
+  }
+
   // 保存当前变换状态
   painter->save();
 
   // 设置不透明度
-  painter->setOpacity(m_opacity);
+  painter->setOpacity(style().opacity);
 
   // 设置旋转中心点和旋转角度
   QRect rect = boundingRect();
@@ -29,17 +45,27 @@ void ShapeBase::paint(QPainter *painter, bool selected)
   // 2. 如果图形有文本，绘制文本
   if (!m_text.isEmpty())
   {
-    painter->setPen(QPen(m_textColor.isValid() ? m_textColor : Qt::black)); // 使用文本颜色
+    const ShapeStyle &style = this->style();
+    painter->setPen(QPen(style.textColor.isValid() ? style.textColor : Qt::black)); // 使用文本颜色
     painter->setBrush(Qt::NoBrush);                                         // 文本不需要填充
 
     // 设置字体
-    if (m_font.family() != "")
+    if (style.font.family() != "")
     {
-      painter->setFont(m_font);
+      painter->setFont(style.font);
     }
 
     QRect textRect = boundingRect().adjusted(5, 5, -5, -5); // 留出边距
-    painter->drawText(textRect, m_textAlignment, m_text);
+    if (textPixelHeight() * scale < kTextDetailPixels)
+    {
+      // 文字小到无法阅读，不做文字排版，只画灰色条
+      paintTextBars(painter, textRect);
+    }
+    else
+    {
+      // 使用缓存的排版结果（自动换行，放不下时省略），只有文字区域大小变化时才重新排版
+      m_textLayout.draw(painter, textRect, m_text, painter->font(), style.textAlignment);
+    }
   }
 
   // 恢复变换状态
@@ -48,60 +74,324 @@ void ShapeBase::paint(QPainter *painter, bool selected)
   // 3. 如果被选中，绘制选中状态
   if (selected)
   {
-    // 绘制虚线框，考虑旋转
-    QRect rect = boundingRect();
+    paintSelection(painter);
+  }
+}
+
+void ShapeBase::paintSelection(QPainter *painter, bool showHandles)
+{
+  if (!painter)
+    return;
+
+  // 绘制虚线框，考虑旋转
+  QRect rect = boundingRect();
+  QPoint center = rect.center();
+  
+  // 保存绘图状态
+  painter->save();
+  
+  // 设置旋转
+  painter->translate(center);
+  painter->rotate(m_rotation * 180.0 / M_PI); // 转换为角度
+  painter->translate(-center);
+  
+  // 绘制旋转后的虚线框
+  painter->setPen(QPen(Qt::blue, 1, Qt::DashLine));
+  painter->setBrush(Qt::NoBrush);
+  painter->drawRect(rect);
+  
+  // 恢复绘图状态
+  painter->restore();
+
+  if (!showHandles)
+    return;
+
+  // 绘制所有锚点
+  for (const auto &handle : getHandles())
+  {
+    if (handle.type == Handle::Scale)
+    {
+      // 绘制缩放锚点（白色填充的蓝色边框方块）
+      painter->setBrush(Qt::white);
+      painter->setPen(QPen(Qt::blue));
+      painter->drawRect(handle.rect);
+    }
+    else if (handle.type == Handle::Arrow)
+    {
+      // 绘制箭头锚点（灰色加号）
+      painter->setPen(QPen(Qt::gray, 2));
+      painter->setBrush(Qt::NoBrush);
+      QPoint center = handle.rect.center();
+      painter->drawLine(center.x() - 5, center.y(), center.x() + 5,
+                        center.y());
+      painter->drawLine(center.x(), center.y() - 5, center.x(),
+                        center.y() + 5);
+    }
+    else if (handle.type == Handle::Rotate)
+    {
+      // 绘制旋转锚点（圆形）
+      painter->setPen(QPen(Qt::blue));
+      painter->setBrush(Qt::white);
+      painter->drawEllipse(handle.rect);
+      // 绘制旋转指示线
+      QPoint center = boundingRect().center();
+      QPoint handleCenter = handle.rect.center();
+      painter->drawLine(center, handleCenter);
+    }
+    else if (handle.type == Handle::Control)
+    {
+      // 绘制曲线控制点（实心小圆点）
+      painter->setPen(QPen(Qt::blue));
+      painter->setBrush(Qt::blue);
+      painter->drawEllipse(handle.rect);
+    }
+  }
+}
+
+double ShapeBase::painterScale(const QPainter *painter)
+{
+  // 取变换矩阵行列式的平方根，旋转时也能得到正确的缩放比例
+  return std::sqrt(std::abs(painter->worldTransform().determinant()));
+}
+
+double ShapeBase::screenSize(double scale) const
+{
+  QRect rect = boundingRect();
+  return std::max(rect.width(), rect.height()) * scale;
+}
+
+void ShapeBase::paintBlock(QPainter *painter)
+{
+  // 用线条颜色填充，保证在白色背景上也能看出图形的位置
+  QColor color = style().lineColor;
+  color.setAlphaF(style().opacity);
+  painter->fillRect(boundingRect(), color);
+}
+
+double ShapeBase::textPixelHeight() const
+{
+  const QFont &font = style().font;
+  if (font.pixelSize() > 0)
+    return font.pixelSize();
+  if (font.pointSizeF() > 0)
+    return font.pointSizeF() * 96.0 / 72.0;
+  return 12.0;
+}
+
+void ShapeBase::paintTextBars(QPainter *painter, const QRect &textRect) const
+{
+  const QStringList lines = m_text.split('\n');
+  const int alignment = style().textAlignment;
+  double lineHeight = textPixelHeight();
+  double barHeight = lineHeight * 0.6;
+  double charWidth = lineHeight * 0.55; // 平均字符宽度的粗略估计
+  double blockHeight = lines.size() * lineHeight;
+
+  // 按文字的垂直对齐方式确定第一行的位置
+  double top = textRect.top() + (textRect.height() - blockHeight) / 2.0;
+  if (alignment & Qt::AlignTop)
+    top = textRect.top();
+  else if (alignment & Qt::AlignBottom)
+    top = textRect.bottom() - blockHeight;
+
+  painter->setPen(Qt::NoPen);
+  painter->setBrush(QColor(160, 160, 160));
+  for (int i = 0; i < lines.size(); ++i)
+  {
+    double width = std::min<double>(textRect.width(), lines[i].size() * charWidth);
+    if (width <= 0)
+      continue;
+
+    // 按文字的水平对齐方式确定灰条的位置
+    double left = textRect.left() + (textRect.width() - width) / 2.0;
+    if (alignment & Qt::AlignLeft)
+      left = textRect.left();
+    else if (alignment & Qt::AlignRight)
+      left = textRect.right() - width;
+
+    double y = top + i * lineHeight + (lineHeight - barHeight) / 2.0;
+    painter->drawRect(QRectF(left, y, width, barHeight));
+  }
+}
+
+void ShapeBase::setStyle(const ShapeStyleHandle &handle)
+{
+  if (!handle || handle == m_style)
+    return;
+  m_style = handle;
+  m_textLayout.invalidate();
+}
+
+void ShapeBase::setStyle(const ShapeStyle &style)
+{
+  if (style == m_style->style)
+    return;
+  setStyle(ShapeStyleTable::instance().intern(style));
+}
+
+void ShapeBase::detachStyle()
+{
+  m_style = ShapeStyleTable::detached(m_style);
+}
+
+void ShapeBase::readStyleJson(const QJsonObject &obj)
+{
+  ShapeStyle style = m_style->style;
+  style.readJson(obj);
+  setStyle(style);
+}
+
+QRect ShapeBase::paintBounds() const
+{
+  QRect rect = boundingRect();
+  if (m_rotation != 0.0)
+  {
+    // 旋转后的图形一定落在以中心为圆心、半对角线为半径的正方形内
     QPoint center = rect.center();
-    
-    // 保存绘图状态
-    painter->save();
-    
-    // 设置旋转
-    painter->translate(center);
-    painter->rotate(m_rotation * 180.0 / M_PI); // 转换为角度
-    painter->translate(-center);
-    
-    // 绘制旋转后的虚线框
-    painter->setPen(QPen(Qt::blue, 1, Qt::DashLine));
-    painter->setBrush(Qt::NoBrush);
-    painter->drawRect(rect);
-    
-    // 恢复绘图状态
-    painter->restore();
+    int radius = static_cast<int>(std::ceil(std::hypot(rect.width(), rect.height()) / 2.0));
+    rect = QRect(center.x() - radius, center.y() - radius, radius * 2, radius * 2);
+  }
+  int margin = style().lineWidth + 1; // 线宽和抗锯齿的余量
+  return rect.adjusted(-margin, -margin, margin, margin);
+}
 
-    // 绘制所有锚点
-    for (const auto &handle : getHandles())
+const QPainterPath &ShapeBase::outlinePath() const
+{
+  QRect rect = boundingRect();
+  if (!m_outline.valid || m_outline.rect != rect)
+  {
+    m_outline.path = buildOutline();
+    m_outline.polygon = m_outline.path.toFillPolygon();
+    m_outline.lengths.assign(1, 0.0);
+    for (int i = 1; i < m_outline.polygon.size(); ++i)
     {
-      if (handle.type == Handle::Scale)
-      {
-        // 绘制缩放锚点（白色填充的蓝色边框方块）
-        painter->setBrush(Qt::white);
-        painter->setPen(QPen(Qt::blue));
-        painter->drawRect(handle.rect);
-      }
-      else if (handle.type == Handle::Arrow)
-      {
-        // 绘制箭头锚点（灰色加号）
-        painter->setPen(QPen(Qt::gray, 2));
-        painter->setBrush(Qt::NoBrush);
-        QPoint center = handle.rect.center();
-        painter->drawLine(center.x() - 5, center.y(), center.x() + 5,
-                          center.y());
-        painter->drawLine(center.x(), center.y() - 5, center.x(),
-                          center.y() + 5);
-      }
-      else if (handle.type == Handle::Rotate)
-      {
-        // 绘制旋转锚点（圆形）
-        painter->setPen(QPen(Qt::blue));
-        painter->setBrush(Qt::white);
-        painter->drawEllipse(handle.rect);
-        // 绘制旋转指示线
-        QPoint center = boundingRect().center();
-        QPoint handleCenter = handle.rect.center();
-        painter->drawLine(center, handleCenter);
-      }
+      QPointF edge = m_outline.polygon[i] - m_outline.polygon[i - 1];
+      m_outline.lengths.push_back(m_outline.lengths.back() + std::hypot(edge.x(), edge.y()));
     }
+    m_outline.rect = rect;
+    m_outline.valid = true;
   }
+  return m_outline.path;
+}
+
+QPolygonF ShapeBase::sceneOutline() const
+{
+  outlinePath(); // 确保轮廓是最新的
+  if (m_rotation == 0.0)
+    return m_outline.polygon;
+
+  // 与绘制时相同，绕外接矩形中心旋转
+  QPointF center = boundingRect().center();
+  QTransform transform;
+  transform.translate(center.x(), center.y());
+  transform.rotate(m_rotation * 180.0 / M_PI);
+  transform.translate(-center.x(), -center.y());
+  return transform.map(m_outline.polygon);
+}
+
+double ShapeBase::outlineParameter(const QPoint &scenePos) const
+{
+  outlinePath(); // 确保轮廓是最新的
+  const QPolygonF &polygon = m_outline.polygon;
+  double total = m_outline.lengths.empty() ? 0.0 : m_outline.lengths.back();
+  if (polygon.size() < 2 || total <= 0.0)
+    return 0.0;
+
+  // 在未旋转的坐标中求交：把点绕外接矩形中心反向旋转
+  QPointF center = boundingRect().center();
+  QPointF offset = QPointF(scenePos) - center;
+  if (m_rotation != 0.0)
+  {
+    double c = cos(-m_rotation), s = sin(-m_rotation);
+    offset = QPointF(offset.x() * c - offset.y() * s, offset.x() * s + offset.y() * c);
+  }
+  if (offset.isNull())
+    return 0.0;
+
+  // 射线 center + t * offset 与每条边求交，取离scenePos最近的交点（t最接近1），凹多边形也能粘在鼠标附近
+  double bestDistance = -1.0;
+  double best = 0.0;
+  for (int i = 1; i < polygon.size(); ++i)
+  {
+    QPointF a = polygon[i - 1] - center;
+    QPointF edge = polygon[i] - polygon[i - 1];
+    double denominator = offset.x() * edge.y() - offset.y() * edge.x();
+    if (std::abs(denominator) < 1e-9)
+      continue; // 与射线平行
+    double t = (a.x() * edge.y() - a.y() * edge.x()) / denominator;
+    double u = (a.x() * offset.y() - a.y() * offset.x()) / denominator;
+    if (t <= 0.0 || u < 0.0 || u > 1.0)
+      continue;
+    double distance = std::abs(t - 1.0);
+    if (bestDistance < 0.0 || distance < bestDistance)
+    {
+      bestDistance = distance;
+      best = (m_outline.lengths[i - 1] + u * (m_outline.lengths[i] - m_outline.lengths[i - 1])) / total;
+    }
+  }
+  return best;
+}
+
+QPoint ShapeBase::outlinePoint(double parameter) const
+{
+  outlinePath(); // 确保轮廓是最新的
+  const QPolygonF &polygon = m_outline.polygon;
+  if (polygon.isEmpty())
+    return boundingRect().center();
+
+  // 在累计长度中二分查找所在的边
+  double target = std::max(0.0, std::min(1.0, parameter)) * m_outline.lengths.back();
+  auto it = std::lower_bound(m_outline.lengths.begin(), m_outline.lengths.end(), target);
+  int i = std::max(1, static_cast<int>(it - m_outline.lengths.begin()));
+  QPointF point = polygon.last();
+  if (i < polygon.size())
+  {
+    double edgeLength = m_outline.lengths[i] - m_outline.lengths[i - 1];
+    double u = edgeLength > 0.0 ? (target - m_outline.lengths[i - 1]) / edgeLength : 0.0;
+    point = polygon[i - 1] + (polygon[i] - polygon[i - 1]) * u;
+  }
+
+  if (m_rotation != 0.0)
+  {
+    QPointF center = boundingRect().center();
+    QPointF offset = point - center;
+    double c = cos(m_rotation), s = sin(m_rotation);
+    point = center + QPointF(offset.x() * c - offset.y() * s, offset.x() * s + offset.y() * c);
+  }
+  return point.toPoint();
+}
+
+QPainterPath ShapeBase::buildOutline() const
+{
+  QPainterPath path;
+  path.addRect(boundingRect());
+  return path;
+}
+
+bool ShapeBase::outlineContains(const QPoint &pt) const
+{
+  // 外接矩形（已考虑旋转）之外的点不可能在图形内
+  if (!paintBounds().contains(pt))
+    return false;
+
+  outlinePath(); // 确保轮廓是最新的
+  QPointF localPt = pt;
+  if (m_rotation != 0.0)
+  {
+    // 旋转角度不变时复用正余弦，把点反向旋转到图形的局部坐标系
+    if (m_outline.rotation != m_rotation)
+    {
+      m_outline.rotation = m_rotation;
+      m_outline.cosAngle = cos(-m_rotation);
+      m_outline.sinAngle = sin(-m_rotation);
+    }
+    QPointF center = boundingRect().center();
+    QPointF offset = localPt - center;
+    localPt = QPointF(offset.x() * m_outline.cosAngle - offset.y() * m_outline.sinAngle,
+                      offset.x() * m_outline.sinAngle + offset.y() * m_outline.cosAngle) +
+              center;
+  }
+  return m_outline.polygon.containsPoint(localPt, Qt::OddEvenFill);
 }
 
 bool ShapeBase::handleAnchorInteraction(const QPoint &mousePos,
@@ -134,7 +424,7 @@ bool ShapeBase::handleAnchorInteraction(const QPoint &mousePos,
   }
 
   // 计算新的矩形区域
-  QRect newRect = calculateNewRect(mousePos, lastMousePos);
+  QRect newRect = calculateNewRect(boundingRect(), mousePos - lastMousePos);
   if (newRect.isEmpty())
     return false;
 
@@ -143,48 +433,78 @@ bool ShapeBase::handleAnchorInteraction(const QPoint &mousePos,
   return true;
 }
 
-QRect ShapeBase::calculateNewRect(const QPoint &mousePos,
-                                  const QPoint &lastMousePos) const
+bool ShapeBase::resizeFrom(const QRect &origin, const QPoint &delta, int gridStep)
 {
-  QRect currentRect = boundingRect();
-  QPoint delta = mousePos - lastMousePos;
-  QRect newRect = currentRect;
+  const auto &handles = getHandles();
+  if (m_selectedHandleIndex < 0 || m_selectedHandleIndex >= static_cast<int>(handles.size()) ||
+      handles[m_selectedHandleIndex].type != Handle::Scale)
+    return false;
 
-  // 根据选中的锚点类型和位置计算新的矩形
+  QRect newRect = calculateNewRect(origin, delta, gridStep);
+  if (newRect.isEmpty() || newRect == boundingRect())
+    return false;
+
+  resize(newRect);
+  return true;
+}
+
+int ShapeBase::snapToStep(int value, int step)
+{
+  return static_cast<int>(std::floor(value / static_cast<double>(step) + 0.5)) * step;
+}
+
+QRect ShapeBase::calculateNewRect(const QRect &rect, const QPoint &delta, int gridStep) const
+{
+  QRect newRect = rect;
+  bool moveLeft = false, moveTop = false, moveRight = false, moveBottom = false;
+
+  // 根据选中的锚点类型和位置确定移动的边
   switch (m_selectedHandleIndex)
   {
   case 0: // 左上
-    newRect.setTopLeft(newRect.topLeft() + delta);
+    moveLeft = moveTop = true;
     break;
   case 1: // 上中
-    newRect.setTop(newRect.top() + delta.y());
+    moveTop = true;
     break;
   case 2: // 右上
-    newRect.setTopRight(newRect.topRight() + delta);
+    moveRight = moveTop = true;
     break;
   case 3: // 左中
-    newRect.setLeft(newRect.left() + delta.x());
+    moveLeft = true;
     break;
   case 4: // 右中
-    newRect.setRight(newRect.right() + delta.x());
+    moveRight = true;
     break;
   case 5: // 左下
-    newRect.setBottomLeft(newRect.bottomLeft() + delta);
+    moveLeft = moveBottom = true;
     break;
   case 6: // 下中
-    newRect.setBottom(newRect.bottom() + delta.y());
+    moveBottom = true;
     break;
   case 7: // 右下
-    newRect.setBottomRight(newRect.bottomRight() + delta);
+    moveRight = moveBottom = true;
     break;
   default:
     return QRect();
   }
 
+  // 右边和下边按right()+1、bottom()+1吸附，使宽高也是网格的整数倍
+  auto place = [gridStep](int value)
+  { return gridStep > 0 ? snapToStep(value, gridStep) : value; };
+  if (moveLeft)
+    newRect.setLeft(place(rect.left() + delta.x()));
+  if (moveTop)
+    newRect.setTop(place(rect.top() + delta.y()));
+  if (moveRight)
+    newRect.setRight(place(rect.right() + 1 + delta.x()) - 1);
+  if (moveBottom)
+    newRect.setBottom(place(rect.bottom() + 1 + delta.y()) - 1);
+
   // 确保矩形不会翻转
   if (newRect.width() < 1 || newRect.height() < 1)
   {
-    return currentRect;
+    return boundingRect();
   }
 
   return newRect;
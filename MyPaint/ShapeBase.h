@@ -1,16 +1,42 @@
 #pragma once
 #include <QJsonObject>
 #include <QPainter>
+#include <QPainterPath>
 #include <QPoint>
+#include <QPolygonF>
 #include <QRect>
 #include <memory>
 #include <vector>
 #include <QJsonObject>
 #include <memory>
 #include <QColor>
+#include "ShapeAllocator.h"
+#include "ShapeStyle.h"
+#include "ShapeTextLayout.h"
 
 class ShapeArrow; // 前置声明
 
+// 轮廓缓存：复制图形时不复制缓存，副本第一次使用时重新构建
+struct ShapeOutlineCache
+{
+  ShapeOutlineCache() = default;
+  ShapeOutlineCache(const ShapeOutlineCache &) {}
+  ShapeOutlineCache &operator=(const ShapeOutlineCache &)
+  {
+    valid = false;
+    return *this;
+  }
+
+  bool valid = false;
+  QRect rect;             // 构建轮廓时的外接矩形，外接矩形变化后轮廓失效
+  QPainterPath path;      // 未旋转的轮廓路径
+  QPolygonF polygon;      // 展平后的轮廓，用于点击检测
+  std::vector<double> lengths; // 轮廓多边形从起点到各顶点的累计长度，用于连接线粘附
+  double rotation = 0.0;  // 下面的正余弦对应的旋转角度
+  double cosAngle = 1.0;  // 反向旋转的余弦
+  double sinAngle = 0.0;  // 反向旋转的正弦
+};
+
 // 1. 先在外部声明 Handle
 struct ShapeHandle
 {
@@ -20,7 +46,8 @@ struct ShapeHandle
     Scale,
     Arrow,
     ArrowAnchor,
-    Rotate // 旋转锚点类型
+    Rotate, // 旋转锚点类型
+    Control // 曲线控制点
   } type;
   int direction;
 };
@@ -28,8 +55,28 @@ struct ShapeHandle
 class ShapeBase
 {
 public:
+  // 图形种类，批量绘制时按种类直接调用具体类的函数，不经过虚函数
+  enum class Kind
+  {
+    Rect,
+    RoundedRect,
+    Ellipse,
+    Triangle,
+    Diamond,
+    Pentagon,
+    Polygon,
+    Arrow
+  };
+
+  explicit ShapeBase(Kind kind) : m_style(ShapeStyleTable::instance().defaultStyle()), m_kind(kind) {}
   virtual ~ShapeBase() {}
 
+  // 图形从内存池分配；析构函数是虚函数，释放时传入的是实际图形类的大小
+  static void *operator new(std::size_t size) { return ShapeAllocator::allocate(size); }
+  static void operator delete(void *ptr, std::size_t size) { ShapeAllocator::deallocate(ptr, size); }
+
+  Kind kind() const { return m_kind; }
+
   // 纯虚函数，子类必须实现
   virtual void paintShape(QPainter *painter) = 0; // 只绘制图形本身
   virtual bool contains(const QPoint &pt) const = 0;
@@ -43,11 +90,36 @@ public:
   virtual QRect getRect() const { return boundingRect(); }  // 获取矩形区域
   virtual void setRect(const QRect &rect) { resize(rect); } // 设置矩形区域
 
+  // 绘制时可能覆盖的区域（考虑旋转和线宽），用于视口裁剪
+  virtual QRect paintBounds() const;
+
+  // 未旋转的轮廓路径，第一次使用时构建，外接矩形变化后重新构建
+  const QPainterPath &outlinePath() const;
+  // 文档坐标中的轮廓多边形（已旋转），用于框选判断
+  virtual QPolygonF sceneOutline() const;
+
+  // 连接线粘附在轮廓上的位置，用沿轮廓的周长比例（0到1）表示，
+  // 图形移动、缩放、旋转后仍然落在轮廓上对应的地方
+  double outlineParameter(const QPoint &scenePos) const; // 从中心指向scenePos的射线与轮廓的交点
+  QPoint outlinePoint(double parameter) const;           // 比例对应的轮廓上的点（文档坐标）
+
   // 统一用 ShapeHandle
   using Handle = ShapeHandle;
 
   // 在基类中实现的共同功能
   void paint(QPainter *painter, bool selected = false);
+  // 只绘制选中状态（虚线框和锚点），用于在缓存的图形之上叠加；多选时showHandles为false，只画虚线框
+  virtual void paintSelection(QPainter *painter, bool showHandles = true);
+
+  // 细节层次（LOD）：根据画笔当前的缩放比例决定绘制的精细程度
+  // 图形在屏幕上小于 kBlockDetailPixels 时只画实心块，
+  // 文字高度小于 kTextDetailPixels 时用灰色条代替，箭头头部小于 kArrowHeadDetailPixels 时省略
+  static const int kBlockDetailPixels = 4;
+  static const int kTextDetailPixels = 5;
+  static const int kArrowHeadDetailPixels = 3;
+  static double painterScale(const QPainter *painter); // 画笔世界变换的缩放比例
+  double screenSize(double scale) const;              // 图形在屏幕上的最大边长（像素）
+  virtual void paintBlock(QPainter *painter);         // 图形很小时的简化绘制
 
   // 默认实现八个缩放锚点，子类可以重写
   virtual bool needPlusHandles() const { return true; }
@@ -67,9 +139,21 @@ public:
   virtual double getRotation() const { return m_rotation; }      // 获取当前旋转角度
   virtual void setRotation(double angle) { m_rotation = angle; } // 设置旋转角度
 
+  // 固定的图形在力导向布局中保持原位，其他图形围绕它排布
+  bool isPinned() const { return m_pinned; }
+  void setPinned(bool pinned) { m_pinned = pinned; }
+
+  // 所属的组（见 ShapeGroupTree），-1表示不属于任何组。与样式一样由画布保存在文件中
+  int groupId() const { return m_groupId; }
+  void setGroupId(int id) { m_groupId = id; }
+
   // 处理锚点交互
   bool handleAnchorInteraction(const QPoint &mousePos,
                                const QPoint &lastMousePos);
+  // 从拖动开始时的矩形origin按总位移delta缩放，不会累积取整误差。
+  // gridStep大于0时被拖动的边吸附到网格上
+  bool resizeFrom(const QRect &origin, const QPoint &delta, int gridStep = 0);
+  static int snapToStep(int value, int step); // 取整到最近的网格线
   bool isHandleSelected() const { return m_selectedHandleIndex != -1; }
   void clearHandleSelection() { m_selectedHandleIndex = -1; }
   int getSelectedHandleIndex() const { return m_selectedHandleIndex; }
@@ -80,7 +164,11 @@ public:
   {
     return true;
   } // 默认所有图形都可编辑文本，除了箭头
-  virtual void setText(const QString &text) { m_text = text; }
+  virtual void setText(const QString &text)
+  {
+    m_text = text;
+    m_textLayout.invalidate();
+  }
   virtual QString getText() const { return m_text; }
   virtual bool isEditing() const { return m_isEditing; }
   virtual void setEditing(bool editing) { m_isEditing = editing; }
@@ -95,25 +183,9 @@ public:
     obj["width"] = rect.width();
     obj["height"] = rect.height();
     obj["text"] = m_text;
-    obj["lineColor"] = m_lineColor.name();
-    obj["lineWidth"] = m_lineWidth;
-    obj["lineType"] = static_cast<int>(m_lineType); // 保存线条类型
-    obj["fillColor"] = m_fillColor.name();
-    obj["opacity"] = m_opacity;
-
-    // 保存字体和文本相关属性
-    if (!m_text.isEmpty())
-    {
-      obj["textColor"] = m_textColor.name();
-      obj["fontFamily"] = m_font.family();
-      obj["fontSize"] = m_font.pointSize();
-      obj["textAlignment"] = m_textAlignment;
-      obj["fontBold"] = m_font.bold();
-      obj["fontItalic"] = m_font.italic();
-      obj["fontUnderline"] = m_font.underline();
-      obj["fontStrikeOut"] = m_font.strikeOut();
-    }
-
+    if (m_pinned)
+      obj["pinned"] = true;
+    // 样式保存在文件的样式表中（见 DrawingArea::saveToFile），这里不逐个图形保存
     return obj;
   }
 
@@ -128,83 +200,11 @@ public:
     if (obj.contains("text"))
     {
       m_text = obj["text"].toString();
+      m_textLayout.invalidate();
     }
-    if (obj.contains("lineColor"))
-    {
-      m_lineColor = QColor(obj["lineColor"].toString());
-    }
-    if (obj.contains("lineWidth"))
-    {
-      m_lineWidth = obj["lineWidth"].toInt();
-    }
-    if (obj.contains("lineType"))
-    {
-      m_lineType = static_cast<LineType>(obj["lineType"].toInt());
-    }
-    if (obj.contains("fillColor"))
-    {
-      m_fillColor = QColor(obj["fillColor"].toString());
-    }
-
-    if (obj.contains("opacity"))
-    {
-      m_opacity = obj["opacity"].toDouble();
-    }
-
-    // 加载字体和文本相关属性
-    if (obj.contains("textColor"))
-    {
-      m_textColor = QColor(obj["textColor"].toString());
-    }
-
-    QFont font = m_font;
-    bool fontChanged = false;
-
-    if (obj.contains("fontFamily"))
-    {
-      font.setFamily(obj["fontFamily"].toString());
-      fontChanged = true;
-    }
-
-    if (obj.contains("fontSize"))
-    {
-      font.setPointSize(obj["fontSize"].toInt());
-      fontChanged = true;
-    }
-
-    if (obj.contains("fontBold"))
-    {
-      font.setBold(obj["fontBold"].toBool());
-      fontChanged = true;
-    }
-
-    if (obj.contains("fontItalic"))
-    {
-      font.setItalic(obj["fontItalic"].toBool());
-      fontChanged = true;
-    }
-
-    if (obj.contains("fontUnderline"))
-    {
-      font.setUnderline(obj["fontUnderline"].toBool());
-      fontChanged = true;
-    }
-
-    if (obj.contains("fontStrikeOut"))
-    {
-      font.setStrikeOut(obj["fontStrikeOut"].toBool());
-      fontChanged = true;
-    }
-
-    if (fontChanged)
-    {
-      m_font = font;
-    }
-
-    if (obj.contains("textAlignment"))
-    {
-      m_textAlignment = obj["textAlignment"].toInt();
-    }
+    m_pinned = obj["pinned"].toBool();
+    // 兼容旧文件中逐个图形保存的样式
+    readStyleJson(obj);
   }
 
   // 线条类型枚举
@@ -215,95 +215,156 @@ public:
     DotLine = 2    // 点线
   };
 
+  // 共享样式：图形只持有样式表中一项的句柄，修改样式时换成另一项
+  const ShapeStyle &style() const { return m_style->style; }
+  const ShapeStyleHandle &styleHandle() const { return m_style; }
+  void setStyle(const ShapeStyleHandle &handle);
+  void setStyle(const ShapeStyle &style); // 在样式表中查找或新建内容相同的一项
+  void detachStyle();                     // 持有样式的独立副本（交给渲染线程的副本使用）
+
   // 线条样式相关方法
-  virtual void setLineColor(const QColor &color) { m_lineColor = color; }
-  virtual QColor getLineColor() const { return m_lineColor; }
-  virtual void setLineWidth(int width) { m_lineWidth = width; }
-  virtual int getLineWidth() const { return m_lineWidth; }
-  virtual void setLineType(LineType type) { m_lineType = type; }
-  virtual LineType getLineType() const { return m_lineType; }
+  virtual void setLineColor(const QColor &color)
+  {
+    ShapeStyle style = m_style->style;
+    style.lineColor = color;
+    setStyle(style);
+  }
+  virtual QColor getLineColor() const { return style().lineColor; }
+  virtual void setLineWidth(int width)
+  {
+    ShapeStyle style = m_style->style;
+    style.lineWidth = width;
+    setStyle(style);
+  }
+  virtual int getLineWidth() const { return style().lineWidth; }
+  virtual void setLineType(LineType type)
+  {
+    ShapeStyle style = m_style->style;
+    style.lineType = type;
+    setStyle(style);
+  }
+  virtual LineType getLineType() const { return static_cast<LineType>(style().lineType); }
 
   // 填充颜色相关方法
-  virtual void setFillColor(const QColor &color) { m_fillColor = color; }
-  virtual QColor getFillColor() const { return m_fillColor; }
+  virtual void setFillColor(const QColor &color)
+  {
+    ShapeStyle style = m_style->style;
+    style.fillColor = color;
+    setStyle(style);
+  }
+  virtual QColor getFillColor() const { return style().fillColor; }
 
   // 不透明度相关方法
-  virtual void setOpacity(double opacity) { m_opacity = opacity; }
-  virtual double getOpacity() const { return m_opacity; }
+  virtual void setOpacity(double opacity)
+  {
+    ShapeStyle style = m_style->style;
+    style.opacity = opacity;
+    setStyle(style);
+  }
+  virtual double getOpacity() const { return style().opacity; }
 
   // 文本样式相关方法
-  virtual void setTextColor(const QColor &color) { m_textColor = color; }
-  virtual QColor getTextColor() const { return m_textColor; }
-  virtual void setFont(const QFont &font) { m_font = font; }
-  virtual QFont getFont() const { return m_font; }
+  virtual void setTextColor(const QColor &color)
+  {
+    ShapeStyle style = m_style->style;
+    style.textColor = color;
+    setStyle(style);
+  }
+  virtual QColor getTextColor() const { return style().textColor; }
+  virtual void setFont(const QFont &font)
+  {
+    ShapeStyle style = m_style->style;
+    style.font = font;
+    setStyle(style);
+  }
+  virtual QFont getFont() const { return style().font; }
   virtual void setFontSize(int size)
   {
-    QFont font = m_font;
-    font.setPointSize(size);
-    m_font = font;
+    ShapeStyle style = m_style->style;
+    style.font.setPointSize(size);
+    setStyle(style);
   }
-  virtual int getFontSize() const { return m_font.pointSize(); }
+  virtual int getFontSize() const { return style().font.pointSize(); }
   virtual void setFontFamily(const QString &family)
   {
-    QFont font = m_font;
-    font.setFamily(family);
-    m_font = font;
+    ShapeStyle style = m_style->style;
+    style.font.setFamily(family);
+    setStyle(style);
+  }
+  virtual QString getFontFamily() const { return style().font.family(); }
+  virtual void setTextAlignment(int alignment)
+  {
+    ShapeStyle style = m_style->style;
+    style.textAlignment = alignment;
+    setStyle(style);
   }
-  virtual QString getFontFamily() const { return m_font.family(); }
-  virtual void setTextAlignment(int alignment) { m_textAlignment = alignment; }
-  virtual int getTextAlignment() const { return m_textAlignment; }
+  virtual int getTextAlignment() const { return style().textAlignment; }
 
   // 字体样式相关方法
   virtual void setFontBold(bool bold)
   {
-    QFont font = m_font;
-    font.setBold(bold);
-    m_font = font;
+    ShapeStyle style = m_style->style;
+    style.font.setBold(bold);
+    setStyle(style);
   }
-  virtual bool isFontBold() const { return m_font.bold(); }
+  virtual bool isFontBold() const { return style().font.bold(); }
 
   virtual void setFontItalic(bool italic)
   {
-    QFont font = m_font;
-    font.setItalic(italic);
-    m_font = font;
+    ShapeStyle style = m_style->style;
+    style.font.setItalic(italic);
+    setStyle(style);
   }
-  virtual bool isFontItalic() const { return m_font.italic(); }
+  virtual bool isFontItalic() const { return style().font.italic(); }
 
   virtual void setFontUnderline(bool underline)
   {
-    QFont font = m_font;
-    font.setUnderline(underline);
-    m_font = font;
+    ShapeStyle style = m_style->style;
+    style.font.setUnderline(underline);
+    setStyle(style);
   }
-  virtual bool isFontUnderline() const { return m_font.underline(); }
+  virtual bool isFontUnderline() const { return style().font.underline(); }
 
   virtual void setFontStrikeOut(bool strikeOut)
   {
-    QFont font = m_font;
-    font.setStrikeOut(strikeOut);
-    m_font = font;
+    ShapeStyle style = m_style->style;
+    style.font.setStrikeOut(strikeOut);
+    setStyle(style);
   }
-  virtual bool isFontStrikeOut() const { return m_font.strikeOut(); }
+  virtual bool isFontStrikeOut() const { return style().font.strikeOut(); }
 
 protected:
-  // 计算新的矩形区域
-  QRect calculateNewRect(const QPoint &mousePos,
-                         const QPoint &lastMousePos) const;
+  // 构建未旋转的轮廓路径，默认为外接矩形
+  virtual QPainterPath buildOutline() const;
+  // 外接矩形以外的几何参数（如圆角半径）变化后调用
+  void invalidateOutline() { m_outline.valid = false; }
+  // 精确点击检测：先用外接矩形快速排除，再用展平的轮廓判断
+  bool outlineContains(const QPoint &pt) const;
+
+  // 文字的大致像素高度（不需要精确，只用于细节层次判断）
+  double textPixelHeight() const;
+  // 文字太小时用灰色条表示文字的位置和长度
+  void paintTextBars(QPainter *painter, const QRect &textRect) const;
+
+  // 读取json中出现的样式字段
+  void readStyleJson(const QJsonObject &obj);
+
+  // 计算新的矩形区域：rect中选中锚点对应的边移动delta，gridStep大于0时吸附到网格
+  QRect calculateNewRect(const QRect &rect, const QPoint &delta, int gridStep = 0) const;
 
   // 文本相关属性
   QString m_text;
   bool m_isEditing = false;
   double m_rotation = 0.0;               // 旋转角度（弧度）
-  QColor m_lineColor = Qt::black;        // 线条颜色
-  QColor m_fillColor = Qt::white;        // 填充颜色
-  QColor m_textColor = Qt::black;        // 文本颜色
-  QFont m_font;                          // 字体
-  int m_textAlignment = Qt::AlignCenter; // 文本对齐方式
-  int m_lineWidth = 1;                   // 线条粗细
-  LineType m_lineType = SolidLine;       // 线条类型，默认为实线
-  double m_opacity = 1.0;                // 不透明度（0.0-1.0）
+  bool m_pinned = false;                 // 力导向布局中固定不动
+  int m_groupId = -1;                    // 所属的组
+  ShapeStyleHandle m_style;              // 共享样式
+  ShapeTextLayout m_textLayout;          // 文字排版缓存，文字、字体、对齐方式变化时失效
 
 private:
+  friend class SceneRenderer; // 批量绘制时直接读取样式，避免逐个调用虚函数
+
+  Kind m_kind;                    // 图形种类
   int m_selectedHandleIndex = -1; // 当前选中的锚点索引
+  mutable ShapeOutlineCache m_outline; // 轮廓缓存
 };
\ No newline at end of file
@@ -8,27 +8,25 @@
 #define M_PI 3.14159265358979323846
 #endif
 
-ShapeDiamond::ShapeDiamond(const QRect &rect) : m_rect(rect) {}
+ShapeDiamond::ShapeDiamond(const QRect &rect) : ShapeBase(Kind::Diamond), m_rect(rect) {}
+
+// 未旋转的四个顶点
+QPolygonF ShapeDiamond::localPolygon() const
+{
+    QRectF rect = m_rect;
+    QPointF center = m_rect.center();
+    QPolygonF polygon;
+    polygon << QPointF(center.x(), rect.top());                  // 上方顶点
+    polygon << QPointF(rect.left() + rect.width(), center.y());  // 右侧顶点
+    polygon << QPointF(center.x(), rect.top() + rect.height());  // 下方顶点
+    polygon << QPointF(rect.left(), center.y());                 // 左侧顶点
+    return polygon;
+}
 
 QPolygon ShapeDiamond::getPolygon() const
 {
-    QPolygon polygon;
-    QRect rect = m_rect;
-    int w = rect.width();
-    int h = rect.height();
-    int x = rect.left();
-    int y = rect.top();
-    QPoint center = rect.center();
-    
-    // 计算菱形的四个顶点
-    // 上方顶点
-    polygon << QPoint(center.x(), y);
-    // 右侧顶点
-    polygon << QPoint(x + w, center.y());
-    // 下方顶点
-    polygon << QPoint(center.x(), y + h);
-    // 左侧顶点
-    polygon << QPoint(x, center.y());
+    QPolygon polygon = localPolygon().toPolygon();
+    QPoint center = m_rect.center();
     
     // 如果有旋转，应用旋转
     if (m_rotation != 0.0) {
@@ -42,11 +40,19 @@ QPolygon ShapeDiamond::getPolygon() const
     return polygon;
 }
 
+QPainterPath ShapeDiamond::buildOutline() const
+{
+    QPainterPath path;
+    path.addPolygon(localPolygon());
+    path.closeSubpath();
+    return path;
+}
+
 void ShapeDiamond::paintShape(QPainter *painter)
 {
     // 根据线条类型设置不同的画笔样式
     Qt::PenStyle penStyle = Qt::SolidLine;
-    switch (m_lineType)
+    switch (style().lineType)
     {
     case LineType::SolidLine:
         penStyle = Qt::SolidLine;
@@ -59,18 +65,18 @@ void ShapeDiamond::paintShape(QPainter *painter)
         break;
     }
 
-    QPen pen(m_lineColor, m_lineWidth);
+    QPen pen(style().lineColor, style().lineWidth);
     pen.setStyle(penStyle);
     painter->setPen(pen);
-    painter->setBrush(m_fillColor);
+    painter->setBrush(style().fillColor);
     
-    // 绘制菱形
-    painter->drawPolygon(getPolygon());
+    // 绘制缓存的轮廓，旋转由基类的画笔变换处理
+    painter->drawPath(outlinePath());
 }
 
 bool ShapeDiamond::contains(const QPoint &pt) const
 {
-    return getPolygon().containsPoint(pt, Qt::OddEvenFill);
+    return outlineContains(pt);
 }
 
 void ShapeDiamond::moveBy(const QPoint &delta) 
@@ -165,18 +171,8 @@ std::unique_ptr<ShapeBase> ShapeDiamond::clone() const
     auto clone = std::make_unique<ShapeDiamond>(m_rect);
     clone->setText(m_text);
     clone->setRotation(m_rotation);
-    clone->setLineColor(m_lineColor);
-    clone->setLineWidth(m_lineWidth);
-    clone->setFillColor(m_fillColor);
-    clone->setLineType(m_lineType);
-    clone->setOpacity(m_opacity);
-    clone->setFontFamily(m_font.family());
-    clone->setFontSize(m_font.pointSize());
-    clone->setFontBold(m_font.bold());
-    clone->setFontItalic(m_font.italic());
-    clone->setFontUnderline(m_font.underline());
-    clone->setFontStrikeOut(m_font.strikeOut());
-    clone->setTextColor(m_textColor);
-    clone->setTextAlignment(m_textAlignment);
+    clone->setStyle(m_style);
+    clone->setPinned(m_pinned);
+    clone->setGroupId(m_groupId);
     return clone;
 } 
\ No newline at end of file
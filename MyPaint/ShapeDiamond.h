@@ -1,6 +1,7 @@
 #pragma once
 #include "ShapeBase.h"
 #include <QPolygon>
+#include <QPolygonF>
 
 class ShapeDiamond : public ShapeBase
 {
@@ -34,7 +35,11 @@ public:
         }
     }
 
+protected:
+    QPainterPath buildOutline() const override; // 菱形轮廓
+
 private:
     QRect m_rect;
+    QPolygonF localPolygon() const; // 未旋转的菱形顶点
     QPolygon getPolygon() const; // 计算菱形的多边形点
 };
\ No newline at end of file
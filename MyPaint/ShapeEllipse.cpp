@@ -2,13 +2,13 @@
 #include <QPainter>
 #include <cmath>
 
-ShapeEllipse::ShapeEllipse(const QRect &rect) : m_rect(rect) {}
+ShapeEllipse::ShapeEllipse(const QRect &rect) : ShapeBase(Kind::Ellipse), m_rect(rect) {}
 
 void ShapeEllipse::paintShape(QPainter *painter)
 {
   // 根据线条类型设置不同的画笔样式
   Qt::PenStyle penStyle = Qt::SolidLine;
-  switch (m_lineType)
+  switch (style().lineType)
   {
   case LineType::SolidLine:
     penStyle = Qt::SolidLine;
@@ -21,10 +21,10 @@ void ShapeEllipse::paintShape(QPainter *painter)
     break;
   }
 
-  QPen pen(m_lineColor, m_lineWidth);
+  QPen pen(style().lineColor, style().lineWidth);
   pen.setStyle(penStyle);
   painter->setPen(pen);
-  painter->setBrush(m_fillColor);
+  painter->setBrush(style().fillColor);
   painter->drawEllipse(m_rect);
 }
 
@@ -136,19 +136,9 @@ std::unique_ptr<ShapeBase> ShapeEllipse::clone() const
   auto clone = std::make_unique<ShapeEllipse>(m_rect);
   clone->setText(m_text);
   clone->setRotation(m_rotation);
-  clone->setLineColor(m_lineColor);
-  clone->setLineWidth(m_lineWidth);
-  clone->setFillColor(m_fillColor);
-  clone->setLineType(m_lineType);
-  clone->setOpacity(m_opacity);
-  clone->setFontFamily(m_font.family());
-  clone->setFontSize(m_font.pointSize());
-  clone->setFontBold(m_font.bold());
-  clone->setFontItalic(m_font.italic());
-  clone->setFontUnderline(m_font.underline());
-  clone->setFontStrikeOut(m_font.strikeOut());
-  clone->setTextColor(m_textColor);
-  clone->setTextAlignment(m_textAlignment);
+  clone->setStyle(m_style);
+  clone->setPinned(m_pinned);
+  clone->setGroupId(m_groupId);
   return clone;
 }
 
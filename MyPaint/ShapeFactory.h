@@ -6,6 +6,7 @@
 #include "ShapeEllipse.h"
 #include "ShapeRect.h"
 #include "ShapePentagon.h"
+#include "ShapePolygon.h"
 #include "ShapeTriangle.h"
 #include "ShapeDiamond.h"
 #include "ShapeRoundedRect.h"
@@ -42,6 +43,20 @@ public:
   {
     return std::unique_ptr<ShapeBase>(new ShapeRoundedRect(rect));
   }
+  // 默认为内接于rect的六边形；rect为空时创建空多边形，由fromJson读取顶点
+  static std::unique_ptr<ShapeBase> createPolygon(const QRect &rect)
+  {
+    QPolygon polygon;
+    if (!rect.isEmpty())
+    {
+      int w = rect.width();
+      int h = rect.height();
+      polygon << QPoint(rect.left() + w / 4, rect.top()) << QPoint(rect.left() + w * 3 / 4, rect.top())
+              << QPoint(rect.left() + w, rect.top() + h / 2) << QPoint(rect.left() + w * 3 / 4, rect.top() + h)
+              << QPoint(rect.left() + w / 4, rect.top() + h) << QPoint(rect.left(), rect.top() + h / 2);
+    }
+    return std::unique_ptr<ShapeBase>(new ShapePolygon(polygon));
+  }
 };
 
 #endif // SHAPEFACTORY_H
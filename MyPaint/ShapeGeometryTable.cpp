@@ -0,0 +1,248 @@
+#include "ShapeGeometryTable.h"
+#include "ShapeArrow.h"
+#include <algorithm>
+#include <cmath>
+
+// 最低的置位位的序号
+static int lowestBit(quint64 mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#else
+    int bit = 0;
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+void ShapeGeometryTable::clear()
+{
+    m_left.clear();
+    m_top.clear();
+    m_right.clear();
+    m_bottom.clear();
+    m_extent.clear();
+    m_rotation.clear();
+    m_kind.clear();
+    m_flags.clear();
+    m_centerX.clear();
+    m_centerY.clear();
+    m_cos.clear();
+    m_sin.clear();
+    m_g0.clear();
+    m_g1.clear();
+    m_g2.clear();
+    m_g3.clear();
+    m_hitModel.clear();
+}
+
+void ShapeGeometryTable::rebuild(const std::vector<std::unique_ptr<ShapeBase>> &shapes)
+{
+    size_t count = shapes.size();
+    m_left.resize(count);
+    m_top.resize(count);
+    m_right.resize(count);
+    m_bottom.resize(count);
+    m_extent.resize(count);
+    m_rotation.resize(count);
+    m_kind.resize(count);
+    m_flags.resize(count);
+    m_centerX.resize(count);
+    m_centerY.resize(count);
+    m_cos.resize(count);
+    m_sin.resize(count);
+    m_g0.resize(count);
+    m_g1.resize(count);
+    m_g2.resize(count);
+    m_g3.resize(count);
+    m_hitModel.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        store(i, *shapes[i]);
+}
+
+void ShapeGeometryTable::update(int index, const ShapeBase &shape)
+{
+    if (index >= 0 && index < size())
+        store(static_cast<size_t>(index), shape);
+}
+
+void ShapeGeometryTable::store(size_t index, const ShapeBase &shape)
+{
+    QRect bounds = shape.paintBounds();
+    QRect rect = shape.boundingRect();
+    m_left[index] = bounds.left();
+    m_top[index] = bounds.top();
+    m_right[index] = bounds.right();
+    m_bottom[index] = bounds.bottom();
+    m_extent[index] = static_cast<float>(std::max(rect.width(), rect.height()));
+    m_rotation[index] = static_cast<float>(shape.getRotation());
+    m_kind[index] = static_cast<quint8>(shape.kind());
+
+    quint8 flags = 0;
+    if (!shape.getText().isEmpty())
+        flags |= HasText;
+    if (shape.getRotation() != 0.0)
+        flags |= Rotated;
+    m_flags[index] = flags;
+
+    storeHitModel(index, shape);
+}
+
+void ShapeGeometryTable::storeHitModel(size_t index, const ShapeBase &shape)
+{
+    // 与各图形的contains()一致：点绕外接矩形中心反向旋转后，在未旋转的几何中判断
+    QRect rect = shape.boundingRect();
+    QPoint center = rect.center();
+    double rotation = shape.getRotation();
+    m_centerX[index] = static_cast<float>(center.x());
+    m_centerY[index] = static_cast<float>(center.y());
+    m_cos[index] = static_cast<float>(std::cos(-rotation));
+    m_sin[index] = static_cast<float>(std::sin(-rotation));
+
+    float g0 = 0.0f, g1 = 0.0f, g2 = 0.0f, g3 = 0.0f;
+    qint32 model = GeometryKernels::HitBounds;
+    switch (shape.kind())
+    {
+    case ShapeBase::Kind::Rect:
+        model = GeometryKernels::HitBox;
+        g0 = static_cast<float>(rect.left() - center.x());
+        g1 = static_cast<float>(rect.top() - center.y());
+        g2 = static_cast<float>(rect.right() - center.x());
+        g3 = static_cast<float>(rect.bottom() - center.y());
+        break;
+    case ShapeBase::Kind::Ellipse:
+        model = GeometryKernels::HitEllipse;
+        g2 = rect.width() / 2.0f;
+        g3 = rect.height() / 2.0f;
+        break;
+    case ShapeBase::Kind::Arrow:
+    {
+        // 折线和曲线由contains()逐段判断
+        const ShapeArrow &arrow = static_cast<const ShapeArrow &>(shape);
+        if (arrow.routing() != ShapeArrow::Routing::Straight)
+            break;
+        const QLine &line = arrow.getLine();
+        model = GeometryKernels::HitSegment;
+        g0 = static_cast<float>(line.x1() - center.x());
+        g1 = static_cast<float>(line.y1() - center.y());
+        g2 = static_cast<float>(line.x2() - center.x());
+        g3 = static_cast<float>(line.y2() - center.y());
+        break;
+    }
+    default:
+        // 其余图形的轮廓不规则，由contains()判断
+        break;
+    }
+    m_g0[index] = g0;
+    m_g1[index] = g1;
+    m_g2[index] = g2;
+    m_g3[index] = g3;
+    m_hitModel[index] = model;
+}
+
+GeometryKernels::BoundsColumns ShapeGeometryTable::boundsColumns() const
+{
+    return {m_left.data(), m_top.data(), m_right.data(), m_bottom.data()};
+}
+
+GeometryKernels::HitColumns ShapeGeometryTable::hitColumns() const
+{
+    return {m_centerX.data(), m_centerY.data(), m_cos.data(), m_sin.data(),
+            m_g0.data(), m_g1.data(), m_g2.data(), m_g3.data(), m_hitModel.data()};
+}
+
+QRect ShapeGeometryTable::bounds(int index) const
+{
+    return QRect(QPoint(m_left[index], m_top[index]), QPoint(m_right[index], m_bottom[index]));
+}
+
+void ShapeGeometryTable::intersecting(const QRect &rect, std::vector<int> &result) const
+{
+    intersecting(rect, 0, size(), result);
+}
+
+void ShapeGeometryTable::intersecting(const QRect &rect, int first, int end, std::vector<int> &result) const
+{
+    if (rect.isEmpty())
+        return;
+
+    const GeometryKernels::BoundsColumns columns = boundsColumns();
+    const int count = std::min(end, size());
+    for (int begin = std::max(first, 0); begin < count; begin += GeometryKernels::kBatchSize)
+    {
+        int batch = std::min(GeometryKernels::kBatchSize, count - begin);
+        quint64 mask = GeometryKernels::rectMask(columns, begin, batch,
+                                                 rect.left(), rect.top(), rect.right(), rect.bottom());
+        for (; mask; mask &= mask - 1)
+            result.push_back(begin + lowestBit(mask));
+    }
+}
+
+void ShapeGeometryTable::contained(const QRect &rect, std::vector<int> &result) const
+{
+    if (rect.isEmpty())
+        return;
+
+    // 先批量筛出相交的图形，再在同一批中比较四条边
+    const GeometryKernels::BoundsColumns columns = boundsColumns();
+    const int count = size();
+    for (int begin = 0; begin < count; begin += GeometryKernels::kBatchSize)
+    {
+        int batch = std::min(GeometryKernels::kBatchSize, count - begin);
+        quint64 mask = GeometryKernels::rectMask(columns, begin, batch,
+                                                 rect.left(), rect.top(), rect.right(), rect.bottom());
+        for (; mask; mask &= mask - 1)
+        {
+            int i = begin + lowestBit(mask);
+            if (m_left[i] >= rect.left() && m_top[i] >= rect.top() &&
+                m_right[i] <= rect.right() && m_bottom[i] <= rect.bottom())
+                result.push_back(i);
+        }
+    }
+}
+
+void ShapeGeometryTable::containing(const QPoint &pt, std::vector<int> &result) const
+{
+    intersecting(QRect(pt, QSize(1, 1)), result);
+}
+
+void ShapeGeometryTable::hitCandidates(const QPoint &pt, std::vector<HitCandidate> &result) const
+{
+    hitCandidates(pt, 0, size(), result);
+}
+
+void ShapeGeometryTable::hitCandidates(const QPoint &pt, int first, int end, std::vector<HitCandidate> &result) const
+{
+    const GeometryKernels::BoundsColumns bounds = boundsColumns();
+    const GeometryKernels::HitColumns hit = hitColumns();
+    const int count = std::min(end, size());
+    for (int begin = std::max(first, 0); begin < count; begin += GeometryKernels::kBatchSize)
+    {
+        int batch = std::min(GeometryKernels::kBatchSize, count - begin);
+        quint64 hitMask = 0;
+        quint64 maybeMask = 0;
+        GeometryKernels::pointMask(bounds, hit, begin, batch, pt.x(), pt.y(), &hitMask, &maybeMask);
+        // 两个掩码互不相交，合并后按下标顺序输出
+        for (quint64 mask = hitMask | maybeMask; mask; mask &= mask - 1)
+        {
+            int bit = lowestBit(mask);
+            result.push_back({begin + bit, ((hitMask >> bit) & 1) != 0});
+        }
+    }
+}
+
+QRect ShapeGeometryTable::unitedBounds() const
+{
+    if (m_left.empty())
+        return QRect();
+
+    int left = *std::min_element(m_left.begin(), m_left.end());
+    int top = *std::min_element(m_top.begin(), m_top.end());
+    int right = *std::max_element(m_right.begin(), m_right.end());
+    int bottom = *std::max_element(m_bottom.begin(), m_bottom.end());
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
@@ -0,0 +1,89 @@
+#ifndef SHAPEGEOMETRYTABLE_H
+#define SHAPEGEOMETRYTABLE_H
+
+#include "GeometryKernels.h"
+#include "ShapeBase.h"
+#include <QPoint>
+#include <QRect>
+#include <memory>
+#include <vector>
+
+// 图形几何信息的结构数组（SoA）副表，下标与画布上的图形列表一一对应。
+// 扫描全部图形（视口裁剪、点击检测的预筛选、吸附、内容范围）时只访问这几段连续的数组，
+// 不需要逐个访问堆上的图形对象；精确判断再交给筛选出来的少数图形。
+// 区域和点的查询由 GeometryKernels 按批次向量化完成。
+class ShapeGeometryTable
+{
+public:
+  // 点查询的候选图形
+  struct HitCandidate
+  {
+    int index;
+    bool exact; // 已经精确命中，不需要再调用contains()
+  };
+
+  // 图形的附加标记
+  enum Flag : quint8
+  {
+    HasText = 1, // 图形带有文字
+    Rotated = 2  // 图形有旋转
+  };
+
+  int size() const { return static_cast<int>(m_left.size()); }
+  void clear();
+
+  // 重新读取全部图形
+  void rebuild(const std::vector<std::unique_ptr<ShapeBase>> &shapes);
+  // 重新读取一个图形（图形的几何或样式变化后调用）
+  void update(int index, const ShapeBase &shape);
+
+  QRect bounds(int index) const; // 绘制范围（包含旋转和线宽）
+  float extent(int index) const { return m_extent[index]; } // 外接矩形的最大边长
+  float rotation(int index) const { return m_rotation[index]; }
+  ShapeBase::Kind kind(int index) const { return static_cast<ShapeBase::Kind>(m_kind[index]); }
+  quint8 flags(int index) const { return m_flags[index]; }
+
+  // 绘制范围与rect相交的图形，按z序从下到上追加到result中
+  void intersecting(const QRect &rect, std::vector<int> &result) const;
+  // 只检查下标在 [begin, end) 中的图形
+  void intersecting(const QRect &rect, int begin, int end, std::vector<int> &result) const;
+  // 绘制范围完全落在rect内的图形，按z序从下到上追加到result中
+  void contained(const QRect &rect, std::vector<int> &result) const;
+  // 绘制范围包含pt的图形，按z序从下到上追加到result中
+  void containing(const QPoint &pt, std::vector<int> &result) const;
+  // 可能被pt点中的图形，按z序从下到上追加到result中。矩形、椭圆和箭头直接在表中精确判断，
+  // 其余图形只经过绘制范围筛选，exact为false，需要调用图形的contains()确认
+  void hitCandidates(const QPoint &pt, std::vector<HitCandidate> &result) const;
+  void hitCandidates(const QPoint &pt, int begin, int end, std::vector<HitCandidate> &result) const;
+  // 所有图形绘制范围的并集
+  QRect unitedBounds() const;
+
+private:
+  void store(size_t index, const ShapeBase &shape);
+  void storeHitModel(size_t index, const ShapeBase &shape);
+  GeometryKernels::BoundsColumns boundsColumns() const;
+  GeometryKernels::HitColumns hitColumns() const;
+
+  // 绘制范围的四条边（QRect的left/top/right/bottom，含右下边界）
+  std::vector<int> m_left;
+  std::vector<int> m_top;
+  std::vector<int> m_right;
+  std::vector<int> m_bottom;
+  std::vector<float> m_extent;   // 外接矩形的最大边长，用于细节层次判断
+  std::vector<float> m_rotation; // 旋转角度（弧度）
+  std::vector<quint8> m_kind;    // ShapeBase::Kind
+  std::vector<quint8> m_flags;   // Flag 的组合
+
+  // 点命中的精确模型（见 GeometryKernels::HitModel）：旋转中心、反向旋转和局部几何参数
+  std::vector<float> m_centerX;
+  std::vector<float> m_centerY;
+  std::vector<float> m_cos;
+  std::vector<float> m_sin;
+  std::vector<float> m_g0;
+  std::vector<float> m_g1;
+  std::vector<float> m_g2;
+  std::vector<float> m_g3;
+  std::vector<qint32> m_hitModel;
+};
+
+#endif // SHAPEGEOMETRYTABLE_H
@@ -0,0 +1,239 @@
+#include "ShapeGroupTree.h"
+#include <algorithm>
+#include <utility>
+
+void ShapeGroupTree::clear()
+{
+    m_groups.clear();
+    m_groupOf.clear();
+    m_roots.clear();
+}
+
+int ShapeGroupTree::createGroup()
+{
+    Group group;
+    group.revision = ++m_revision;
+    m_groups.push_back(group);
+    return groupCount() - 1;
+}
+
+void ShapeGroupTree::rebuild(const std::vector<std::unique_ptr<ShapeBase>> &shapes, const ShapeGeometryTable &geometry)
+{
+    const int count = static_cast<int>(shapes.size());
+    const int groupTotal = groupCount();
+    m_groupOf.assign(count, kNoGroup);
+    m_roots.clear();
+    for (Group &group : m_groups)
+    {
+        group.groups.clear();
+        group.shapes.clear();
+        group.dirty = true;
+        group.revision = ++m_revision;
+        if (!isValid(group.parent))
+            group.parent = kNoGroup;
+    }
+
+    // 断开父子关系中的环（只可能来自损坏的文件）：向上走的步数超过组的总数说明进入了环
+    for (int id = 0; id < groupTotal; ++id)
+    {
+        int p = id;
+        for (int steps = 0; p != kNoGroup && steps <= groupTotal; ++steps)
+            p = m_groups[p].parent;
+        if (p != kNoGroup)
+            m_groups[id].parent = kNoGroup;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        int id = shapes[i]->groupId();
+        if (isValid(id))
+        {
+            m_groupOf[i] = id;
+            m_groups[id].shapes.push_back(i);
+        }
+    }
+
+    // 子树中有图形的组才进入树中，撤销分组后留下的空组不参与查询
+    std::vector<char> live(groupTotal, 0);
+    for (int id = 0; id < groupTotal; ++id)
+    {
+        if (m_groups[id].shapes.empty())
+            continue;
+        for (int p = id; p != kNoGroup && !live[p]; p = m_groups[p].parent)
+            live[p] = 1;
+    }
+    for (int id = 0; id < groupTotal; ++id)
+    {
+        if (!live[id])
+            continue;
+        if (m_groups[id].parent == kNoGroup)
+            m_roots.push_back(id);
+        else
+            m_groups[m_groups[id].parent].groups.push_back(id);
+    }
+
+    updateBounds(geometry);
+}
+
+void ShapeGroupTree::markDirty(int id)
+{
+    // 父组已经标记过时，它的祖先也都已经标记过
+    for (; id != kNoGroup && !m_groups[id].dirty; id = m_groups[id].parent)
+    {
+        m_groups[id].dirty = true;
+        m_groups[id].revision = ++m_revision;
+    }
+}
+
+void ShapeGroupTree::shapeChanged(int index)
+{
+    if (index >= 0 && index < static_cast<int>(m_groupOf.size()) && m_groupOf[index] != kNoGroup)
+        markDirty(m_groupOf[index]);
+}
+
+bool ShapeGroupTree::boundsValid() const
+{
+    for (int root : m_roots)
+    {
+        if (m_groups[root].dirty)
+            return false;
+    }
+    return true;
+}
+
+void ShapeGroupTree::updateBounds(const ShapeGeometryTable &geometry)
+{
+    // 后序遍历：子组先于父组计算，没有标记的子组直接使用缓存的范围
+    std::vector<std::pair<int, bool>> stack; // 组、子组是否已经入栈
+    for (int root : m_roots)
+    {
+        if (m_groups[root].dirty)
+            stack.emplace_back(root, false);
+    }
+    while (!stack.empty())
+    {
+        int id = stack.back().first;
+        if (!stack.back().second)
+        {
+            stack.back().second = true;
+            for (int child : m_groups[id].groups)
+            {
+                if (m_groups[child].dirty)
+                    stack.emplace_back(child, false);
+            }
+            continue;
+        }
+        stack.pop_back();
+
+        Group &group = m_groups[id];
+        group.bounds = QRect();
+        group.shapeCount = static_cast<int>(group.shapes.size());
+        group.firstShape = group.shapes.empty() ? -1 : group.shapes.front();
+        group.lastShape = group.shapes.empty() ? -1 : group.shapes.back();
+        for (int i : group.shapes)
+        {
+            if (i < geometry.size())
+                group.bounds |= geometry.bounds(i);
+        }
+        for (int child : group.groups)
+        {
+            const Group &sub = m_groups[child];
+            group.bounds |= sub.bounds;
+            group.shapeCount += sub.shapeCount;
+            if (group.firstShape < 0 || sub.firstShape < group.firstShape)
+                group.firstShape = sub.firstShape;
+            group.lastShape = std::max(group.lastShape, sub.lastShape);
+        }
+        group.dirty = false;
+    }
+}
+
+int ShapeGroupTree::groupOf(int index) const
+{
+    return index >= 0 && index < static_cast<int>(m_groupOf.size()) ? m_groupOf[index] : kNoGroup;
+}
+
+int ShapeGroupTree::topLevelGroup(int index) const
+{
+    int id = groupOf(index);
+    while (id != kNoGroup && m_groups[id].parent != kNoGroup)
+        id = m_groups[id].parent;
+    return id;
+}
+
+void ShapeGroupTree::members(int id, std::vector<int> &result) const
+{
+    size_t start = result.size();
+    std::vector<int> stack(1, id);
+    while (!stack.empty())
+    {
+        const Group &group = m_groups[stack.back()];
+        stack.pop_back();
+        result.insert(result.end(), group.shapes.begin(), group.shapes.end());
+        stack.insert(stack.end(), group.groups.begin(), group.groups.end());
+    }
+    std::sort(result.begin() + start, result.end());
+}
+
+void ShapeGroupTree::remainingRanges(const QRect &rect, int count, std::vector<std::pair<int, int>> &ranges) const
+{
+    // 跳过的组：范围不相交，子树中的图形在z序上连续，并且足够多。
+    // 不满足条件的组继续检查子组，其中的图形留给几何副表判断
+    std::vector<std::pair<int, int>> skipped;
+    std::vector<int> stack(m_roots);
+    while (!stack.empty())
+    {
+        int id = stack.back();
+        stack.pop_back();
+        const Group &group = m_groups[id];
+        if (!group.bounds.intersects(rect) && group.shapeCount >= kMinSkippedShapes && isContiguous(id))
+            skipped.emplace_back(group.firstShape, group.lastShape + 1);
+        else
+            stack.insert(stack.end(), group.groups.begin(), group.groups.end());
+    }
+    std::sort(skipped.begin(), skipped.end());
+
+    // 不同组的连续区间互不重叠
+    int begin = 0;
+    for (const auto &range : skipped)
+    {
+        if (range.first > begin)
+            ranges.emplace_back(begin, range.first);
+        begin = range.second;
+    }
+    if (begin < count)
+        ranges.emplace_back(begin, count);
+}
+
+void ShapeGroupTree::intersecting(const QRect &rect, const ShapeGeometryTable &geometry,
+                                  std::vector<int> &result) const
+{
+    if (m_roots.empty())
+    {
+        geometry.intersecting(rect, result);
+        return;
+    }
+    if (rect.isEmpty())
+        return;
+
+    std::vector<std::pair<int, int>> ranges;
+    remainingRanges(rect, geometry.size(), ranges);
+    for (const auto &range : ranges)
+        geometry.intersecting(rect, range.first, range.second, result);
+}
+
+void ShapeGroupTree::hitCandidates(const QPoint &pt, const ShapeGeometryTable &geometry,
+                                   std::vector<ShapeGeometryTable::HitCandidate> &result) const
+{
+    if (m_roots.empty())
+    {
+        geometry.hitCandidates(pt, result);
+        return;
+    }
+
+    // 几何副表给出的精确命中标记原样保留
+    std::vector<std::pair<int, int>> ranges;
+    remainingRanges(QRect(pt, QSize(1, 1)), geometry.size(), ranges);
+    for (const auto &range : ranges)
+        geometry.hitCandidates(pt, range.first, range.second, result);
+}
@@ -0,0 +1,84 @@
+#ifndef SHAPEGROUPTREE_H
+#define SHAPEGROUPTREE_H
+
+#include "ShapeBase.h"
+#include "ShapeGeometryTable.h"
+#include <QRect>
+#include <memory>
+#include <vector>
+
+// 图形的分组：组可以嵌套，构成一棵场景树，图形是树的叶子。
+// 图形所属的组记录在图形上（ShapeBase::groupId），图形增删和调整顺序时不需要修改这里；
+// 这里保存组之间的父子关系，各组的成员列表和绘制范围按几何副表生成并缓存。
+// 组的范围包含整棵子树。查询仍由几何副表按批次完成，范围不相交、且在z序上连续的组
+// 整段跳过，不再检查其中的图形。
+// 与几何副表一样，渲染快照与画布共享同一份，修改前如果仍被快照引用就先复制一份
+class ShapeGroupTree
+{
+public:
+  static const int kNoGroup = -1;
+  static const int kMinSkippedShapes = 16; // 少于这么多图形的组不单独跳过，免得把批次切得太碎
+
+  struct Group
+  {
+    int parent = kNoGroup;
+    bool cacheImage = false; // 未修改时用缓存的图像绘制整个组
+
+    // 以下由rebuild生成
+    std::vector<int> groups; // 非空的子组
+    std::vector<int> shapes; // 直接属于这个组的图形，升序
+    QRect bounds;            // 子树中所有图形绘制范围的并集
+    int firstShape = -1;     // 子树中z序最低和最高的图形
+    int lastShape = -1;
+    int shapeCount = 0;      // 子树中的图形数
+    quint64 revision = 0;    // 子树中的图形每次变化都会增加
+    bool dirty = true;       // 范围需要重新计算；子组需要重新计算时父组一定也需要
+  };
+
+  void clear(); // 删除所有组，版本计数保留，之前的版本号不会再次出现
+  int createGroup();
+  int groupCount() const { return static_cast<int>(m_groups.size()); }
+  bool isValid(int id) const { return id >= 0 && id < groupCount(); }
+  const Group &group(int id) const { return m_groups[id]; }
+  // 修改父子关系后需要调用rebuild
+  void setParent(int id, int parent) { m_groups[id].parent = parent; }
+  void setCacheImage(int id, bool cache) { m_groups[id].cacheImage = cache; }
+
+  // 按图形的组号重新生成成员列表，并重新计算所有组的范围
+  void rebuild(const std::vector<std::unique_ptr<ShapeBase>> &shapes, const ShapeGeometryTable &geometry);
+  // 图形的几何变化后调用，所属的各组在下次updateBounds时重新计算范围
+  void shapeChanged(int index);
+  bool boundsValid() const;
+  // 只重新计算标记过的组，没有变化的子树整体跳过
+  void updateBounds(const ShapeGeometryTable &geometry);
+
+  bool hasGroups() const { return !m_roots.empty(); } // 至少有一个非空的组
+  const std::vector<int> &roots() const { return m_roots; }
+  int groupOf(int index) const;       // 图形直接所属的组
+  int topLevelGroup(int index) const; // 图形所属的最外层组，不属于任何组时为kNoGroup
+  void members(int id, std::vector<int> &result) const; // 子树中的图形，升序
+  // 子树中的图形在z序上是连续的，整个组可以用一张图像代替
+  bool isContiguous(int id) const
+  {
+    const Group &g = m_groups[id];
+    return g.shapeCount > 0 && g.lastShape - g.firstShape + 1 == g.shapeCount;
+  }
+
+  // 与ShapeGeometryTable的同名查询结果相同，按z序从下到上追加到result中。
+  // 跳过的组之间的各段交给几何副表批量检查
+  void intersecting(const QRect &rect, const ShapeGeometryTable &geometry, std::vector<int> &result) const;
+  void hitCandidates(const QPoint &pt, const ShapeGeometryTable &geometry,
+                     std::vector<ShapeGeometryTable::HitCandidate> &result) const;
+
+private:
+  void markDirty(int id);
+  // 需要检查的下标区间 [first, second)：去掉范围与rect不相交的连续组之后剩下的各段，升序
+  void remainingRanges(const QRect &rect, int count, std::vector<std::pair<int, int>> &ranges) const;
+
+  std::vector<Group> m_groups;
+  std::vector<int> m_groupOf;   // 图形下标 -> 直接所属的组
+  std::vector<int> m_roots;     // 非空的顶层组
+  quint64 m_revision = 0;
+};
+
+#endif // SHAPEGROUPTREE_H
@@ -1,5 +1,6 @@
 #include "ShapeLibraryWidget.h"
 #include "DrawingArea.h"
+#include "ShapeRegistry.h"
 #include <QDrag>
 #include <QMimeData>
 #include <QDebug>
@@ -47,15 +48,10 @@ ShapeLibraryWidget::~ShapeLibraryWidget() {}
 
 void ShapeLibraryWidget::initShapeItems()
 {
-  // 添加基本图形
-  addShapeItem(tr("Rectangle"), "rect");
-  addShapeItem(tr("Rounded Rect"), "roundedrect");
-  addShapeItem(tr("Ellipse"), "ellipse");
-  addShapeItem(tr("Triangle"), "triangle");
-  addShapeItem(tr("Diamond"), "diamond");
-  addShapeItem(tr("Pentagon"), "pentagon");
-  // addShapeItem("Polygon", "polygon");
-  addShapeItem(tr("Arrow"), "arrow");
+  // 按注册顺序添加所有图形类型
+  const ShapeRegistry &registry = ShapeRegistry::instance();
+  for (const ShapeTypeInfo &info : registry.types())
+    addShapeItem(tr(info.displayName), info.name, registry.icon(info));
 }
 
 QString ShapeLibraryWidget::getCurrentShapeType() const
@@ -90,18 +86,12 @@ void ShapeLibraryWidget::startDrag(const QListWidgetItem *item)
 }
 
 void ShapeLibraryWidget::addShapeItem(const QString &name,
-                                      const QString &type)
+                                      const QString &type, const QIcon &icon)
 {
   QListWidgetItem *item = new QListWidgetItem(""); // 使用空文本，完全依赖工具提示
   item->setData(Qt::UserRole, type);
   item->setData(Qt::DisplayRole, name); // 保存显示名称为数据
 
-  // 尝试不同的图标路径
-  QString iconPath = ":/" + (QString("icons/") + type) + ".png";
-  QIcon icon(iconPath);
-  qDebug() << "Try to load icon:" << iconPath << (icon.isNull() ? "Failed" : "Success");
-
-  // 如果图标不为空，则设置
   item->setIcon(icon);
 
   // 确保图标足够大
@@ -1,6 +1,7 @@
 #ifndef SHAPELIBRARYWIDGET_H
 #define SHAPELIBRARYWIDGET_H
 
+#include <QIcon>
 #include <QListWidget>
 #include <QVBoxLayout>
 #include <QWidget>
@@ -31,7 +32,7 @@ private:
   class DrawingArea *m_drawingArea;
 
   // 添加一个图形项到列表
-  void addShapeItem(const QString &name, const QString &type);
+  void addShapeItem(const QString &name, const QString &type, const QIcon &icon);
 };
 
 #endif // SHAPELIBRARYWIDGET_H
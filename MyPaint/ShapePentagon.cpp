@@ -8,45 +8,39 @@
 #define M_PI 3.14159265358979323846
 #endif
 
-ShapePentagon::ShapePentagon(const QRect &rect) : m_rect(rect) {}
+ShapePentagon::ShapePentagon(const QRect &rect) : ShapeBase(Kind::Pentagon), m_rect(rect) {}
 
-QPolygon ShapePentagon::getPolygon() const
+// 未旋转的五个顶点
+QPolygonF ShapePentagon::localPolygon() const
 {
-    QPolygon polygon;
-    QRect rect = m_rect;
-    int w = rect.width();
-    int h = rect.height();
-    int x = rect.left();
-    int y = rect.top();
-    QPoint center = rect.center();
+    QPolygonF polygon;
+    QRectF rect = m_rect;
+    QPointF center = m_rect.center();
     
     // 计算五边形的五个顶点
     const int numPoints = 5;
     for (int i = 0; i < numPoints; ++i) {
         // 从顶部顶点开始，顺时针计算
         double angle = i * 2 * M_PI / numPoints - M_PI / 2; // 从顶部开始
-        double px = center.x() + (w / 2.0) * cos(angle);
-        double py = center.y() + (h / 2.0) * sin(angle);
-        polygon << QPoint(px, py);
+        polygon << QPointF(center.x() + (rect.width() / 2.0) * cos(angle),
+                           center.y() + (rect.height() / 2.0) * sin(angle));
     }
-    
-    // 如果有旋转，应用旋转
-    if (m_rotation != 0.0) {
-        QTransform transform;
-        transform.translate(center.x(), center.y());
-        transform.rotate(m_rotation * 180.0 / M_PI); // 转换为角度
-        transform.translate(-center.x(), -center.y());
-        polygon = transform.map(polygon);
-    }
-    
     return polygon;
 }
 
+QPainterPath ShapePentagon::buildOutline() const
+{
+    QPainterPath path;
+    path.addPolygon(localPolygon());
+    path.closeSubpath();
+    return path;
+}
+
 void ShapePentagon::paintShape(QPainter *painter)
 {
     // 根据线条类型设置不同的画笔样式
     Qt::PenStyle penStyle = Qt::SolidLine;
-    switch (m_lineType)
+    switch (style().lineType)
     {
     case LineType::SolidLine:
         penStyle = Qt::SolidLine;
@@ -59,18 +53,18 @@ void ShapePentagon::paintShape(QPainter *painter)
         break;
     }
 
-    QPen pen(m_lineColor, m_lineWidth);
+    QPen pen(style().lineColor, style().lineWidth);
     pen.setStyle(penStyle);
     painter->setPen(pen);
-    painter->setBrush(m_fillColor);
+    painter->setBrush(style().fillColor);
     
-    // 绘制五边形
-    painter->drawPolygon(getPolygon());
+    // 绘制缓存的轮廓，旋转由基类的画笔变换处理
+    painter->drawPath(outlinePath());
 }
 
 bool ShapePentagon::contains(const QPoint &pt) const
 {
-    return getPolygon().containsPoint(pt, Qt::OddEvenFill);
+    return outlineContains(pt);
 }
 
 void ShapePentagon::moveBy(const QPoint &delta) 
@@ -180,18 +174,8 @@ std::unique_ptr<ShapeBase> ShapePentagon::clone() const
     auto clone = std::make_unique<ShapePentagon>(m_rect);
     clone->setText(m_text);
     clone->setRotation(m_rotation);
-    clone->setLineColor(m_lineColor);
-    clone->setLineWidth(m_lineWidth);
-    clone->setFillColor(m_fillColor);
-    clone->setLineType(m_lineType);
-    clone->setOpacity(m_opacity);
-    clone->setFontFamily(m_font.family());
-    clone->setFontSize(m_font.pointSize());
-    clone->setFontBold(m_font.bold());
-    clone->setFontItalic(m_font.italic());
-    clone->setFontUnderline(m_font.underline());
-    clone->setFontStrikeOut(m_font.strikeOut());
-    clone->setTextColor(m_textColor);
-    clone->setTextAlignment(m_textAlignment);
+    clone->setStyle(m_style);
+    clone->setPinned(m_pinned);
+    clone->setGroupId(m_groupId);
     return clone;
 } 
\ No newline at end of file
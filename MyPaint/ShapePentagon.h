@@ -1,6 +1,7 @@
 #pragma once
 #include "ShapeBase.h"
 #include <QPolygon>
+#include <QPolygonF>
 
 class ShapePentagon : public ShapeBase
 {
@@ -34,7 +35,10 @@ public:
     }
   }
 
+protected:
+  QPainterPath buildOutline() const override; // 五边形轮廓
+
 private:
   QRect m_rect;
-  QPolygon getPolygon() const; // 计算五边形的多边形点
+  QPolygonF localPolygon() const; // 未旋转的五边形顶点
 }; 
\ No newline at end of file
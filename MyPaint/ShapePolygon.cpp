@@ -2,7 +2,7 @@
 #include <QPainter>
 #include <cmath>
 
-ShapePolygon::ShapePolygon(const QPolygon &polygon) : m_polygon(polygon) {}
+ShapePolygon::ShapePolygon(const QPolygon &polygon) : ShapeBase(Kind::Polygon), m_polygon(polygon) {}
 
 void ShapePolygon::paintShape(QPainter *painter)
 {
@@ -11,7 +11,7 @@ void ShapePolygon::paintShape(QPainter *painter)
 
   // 根据线条类型设置不同的画笔样式
   Qt::PenStyle penStyle = Qt::SolidLine;
-  switch (m_lineType)
+  switch (style().lineType)
   {
   case LineType::SolidLine:
     penStyle = Qt::SolidLine;
@@ -24,36 +24,17 @@ void ShapePolygon::paintShape(QPainter *painter)
     break;
   }
 
-  QPen pen(m_lineColor, m_lineWidth);
+  QPen pen(style().lineColor, style().lineWidth);
   pen.setStyle(penStyle);
   painter->setPen(pen);
-  painter->setBrush(m_fillColor);
-  painter->drawPolygon(m_polygon);
+  painter->setBrush(style().fillColor);
+  painter->drawPath(outlinePath());
 }
 
 bool ShapePolygon::contains(const QPoint &pt) const
 {
-  // 考虑旋转后的点击检测
-  if (m_rotation == 0.0)
-  {
-    return m_polygon.containsPoint(pt, Qt::OddEvenFill);
-  }
-
-  // 将点转换到多边形的局部坐标系
-  QPoint center = boundingRect().center();
-  QPoint localPt = pt - center;
-
-  // 反向旋转点
-  double cosAngle = cos(-m_rotation);
-  double sinAngle = sin(-m_rotation);
-  QPoint rotatedPt(localPt.x() * cosAngle - localPt.y() * sinAngle,
-                   localPt.x() * sinAngle + localPt.y() * cosAngle);
-
-  // 将点移回原坐标系
-  rotatedPt += center;
-
-  // 检查点是否在未旋转的多边形内
-  return m_polygon.containsPoint(rotatedPt, Qt::OddEvenFill);
+  // 外接矩形预筛选后用缓存的轮廓检测，旋转时把点反向旋转到局部坐标系
+  return outlineContains(pt);
 }
 
 void ShapePolygon::moveBy(const QPoint &delta) { m_polygon.translate(delta); }
@@ -76,6 +57,7 @@ void ShapePolygon::resize(const QRect &newRect)
     newPolygon << QPoint(newX, newY);
   }
   m_polygon = newPolygon;
+  invalidateOutline();
 }
 
 QRect ShapePolygon::boundingRect() const { return m_polygon.boundingRect(); }
@@ -96,9 +78,22 @@ void ShapePolygon::rotate(double angle)
 
   // 应用旋转变换到多边形
   m_polygon = transform.map(m_polygon);
+  invalidateOutline();
+}
+
+QPainterPath ShapePolygon::buildOutline() const
+{
+  QPainterPath path;
+  path.addPolygon(QPolygonF(m_polygon));
+  path.closeSubpath();
+  return path;
 }
 
 std::unique_ptr<ShapeBase> ShapePolygon::clone() const
 {
-  return std::make_unique<ShapePolygon>(m_polygon);
+  auto clone = std::make_unique<ShapePolygon>(m_polygon);
+  clone->setStyle(m_style);
+  clone->setPinned(m_pinned);
+  clone->setGroupId(m_groupId);
+  return clone;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define SHAPEPOLYGON_H
 
 #include "ShapeBase.h"
+#include <QJsonArray>
 #include <QPolygon>
 
 class ShapePolygon : public ShapeBase
@@ -22,11 +23,29 @@ public:
     QJsonObject obj = ShapeBase::toJson();
     obj["type"] = "polygon";
     obj["rotation"] = m_rotation; // 保存旋转角度
+
+    // 保存顶点，x/y/width/height只描述外接矩形
+    QJsonArray points;
+    for (const QPoint &pt : m_polygon)
+      points.append(QJsonArray{pt.x(), pt.y()});
+    obj["points"] = points;
     return obj;
   }
 
   void fromJson(const QJsonObject &obj) override
   {
+    // 先读取顶点，基类再按外接矩形调整大小
+    if (obj.contains("points"))
+    {
+      QPolygon polygon;
+      for (const QJsonValue &value : obj["points"].toArray())
+      {
+        QJsonArray pt = value.toArray();
+        polygon << QPoint(pt.at(0).toInt(), pt.at(1).toInt());
+      }
+      m_polygon = polygon;
+      invalidateOutline();
+    }
     ShapeBase::fromJson(obj);
     if (obj.contains("rotation"))
     {
@@ -34,6 +53,9 @@ public:
     }
   }
 
+protected:
+  QPainterPath buildOutline() const override; // 多边形轮廓
+
 private:
   QPolygon m_polygon;
 };
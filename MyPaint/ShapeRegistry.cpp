@@ -0,0 +1,112 @@
+#include "ShapeRegistry.h"
+#include "ShapeFactory.h"
+#include <QFile>
+#include <QPainter>
+#include <QPixmap>
+#include <cmath>
+
+ShapeRegistry &ShapeRegistry::instance()
+{
+  static ShapeRegistry registry;
+  return registry;
+}
+
+ShapeRegistry::ShapeRegistry()
+{
+  // 图形库中的顺序与注册顺序相同
+  const QSize boxSize(80, 60);
+  add("rect", QT_TRANSLATE_NOOP("ShapeLibraryWidget", "Rectangle"), boxSize,
+      [](const QRect &rect) { return ShapeFactory::createRect(rect); });
+  add("roundedrect", QT_TRANSLATE_NOOP("ShapeLibraryWidget", "Rounded Rect"), boxSize,
+      [](const QRect &rect) { return ShapeFactory::createRoundedRect(rect); });
+  add("ellipse", QT_TRANSLATE_NOOP("ShapeLibraryWidget", "Ellipse"), boxSize,
+      [](const QRect &rect) { return ShapeFactory::createEllipse(rect); });
+  add("triangle", QT_TRANSLATE_NOOP("ShapeLibraryWidget", "Triangle"), boxSize,
+      [](const QRect &rect) { return ShapeFactory::createTriangle(rect); });
+  add("diamond", QT_TRANSLATE_NOOP("ShapeLibraryWidget", "Diamond"), boxSize,
+      [](const QRect &rect) { return ShapeFactory::createDiamond(rect); });
+  add("pentagon", QT_TRANSLATE_NOOP("ShapeLibraryWidget", "Pentagon"), boxSize,
+      [](const QRect &rect) { return ShapeFactory::createPentagon(rect); });
+  add("polygon", QT_TRANSLATE_NOOP("ShapeLibraryWidget", "Polygon"), boxSize,
+      [](const QRect &rect) { return ShapeFactory::createPolygon(rect); });
+  // 箭头是横穿矩形中间的一条线
+  add("arrow", QT_TRANSLATE_NOOP("ShapeLibraryWidget", "Arrow"), QSize(80, 0),
+      [](const QRect &rect)
+      {
+        int y = rect.top() + rect.height() / 2;
+        return ShapeFactory::createArrow(QLine(rect.left(), y, rect.left() + rect.width(), y));
+      });
+}
+
+void ShapeRegistry::add(const QString &name, const char *displayName, const QSize &defaultSize,
+                        std::function<std::unique_ptr<ShapeBase>(const QRect &rect)> create)
+{
+  ShapeTypeInfo info;
+  info.id = static_cast<int>(m_types.size());
+  info.name = name;
+  info.displayName = displayName;
+  info.iconPath = ":/icons/" + name + ".png";
+  info.defaultSize = defaultSize;
+  info.create = std::move(create);
+  m_ids.insert(name, info.id);
+  m_types.push_back(std::move(info));
+}
+
+const ShapeTypeInfo *ShapeRegistry::find(const QString &name) const
+{
+  return type(typeId(name));
+}
+
+const ShapeTypeInfo *ShapeRegistry::type(int id) const
+{
+  if (id < 0 || id >= static_cast<int>(m_types.size()))
+    return nullptr;
+  return &m_types[id];
+}
+
+int ShapeRegistry::typeId(const QString &name) const
+{
+  return m_ids.value(name, -1);
+}
+
+std::unique_ptr<ShapeBase> ShapeRegistry::createDefault(const QString &name, const QPoint &center) const
+{
+  const ShapeTypeInfo *info = find(name);
+  if (!info)
+    return nullptr;
+
+  QSize size = info->defaultSize;
+  QRect rect(center.x() - size.width() / 2, center.y() - size.height() / 2, size.width(), size.height());
+  return info->create(rect);
+}
+
+std::unique_ptr<ShapeBase> ShapeRegistry::fromJson(const QJsonObject &obj) const
+{
+  const ShapeTypeInfo *info = find(obj["type"].toString());
+  if (!info)
+    return nullptr;
+
+  std::unique_ptr<ShapeBase> shape = info->create(QRect());
+  if (shape)
+    shape->fromJson(obj);
+  return shape;
+}
+
+QIcon ShapeRegistry::icon(const ShapeTypeInfo &info) const
+{
+  if (QFile::exists(info.iconPath))
+    return QIcon(info.iconPath);
+
+  // 没有图标文件时用图形本身画一个
+  const int size = 40;
+  QPixmap pixmap(size, size);
+  pixmap.fill(Qt::transparent);
+  std::unique_ptr<ShapeBase> shape = info.create(QRect(4, 8, size - 8, size - 16));
+  if (shape)
+  {
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+    shape->paint(&painter);
+  }
+  return QIcon(pixmap);
+}
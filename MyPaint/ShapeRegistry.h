@@ -0,0 +1,54 @@
+#ifndef SHAPEREGISTRY_H
+#define SHAPEREGISTRY_H
+
+#include "ShapeBase.h"
+#include <QHash>
+#include <QIcon>
+#include <QJsonObject>
+#include <QString>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// 一种图形类型的注册信息
+struct ShapeTypeInfo
+{
+  int id = -1;              // 类型ID，即注册顺序
+  QString name;             // 文件和拖放数据中使用的类型名
+  const char *displayName;  // 图形库中显示的名称（在 ShapeLibraryWidget 中翻译）
+  QString iconPath;         // 图形库图标，文件不存在时用图形本身绘制一个
+  QSize defaultSize;        // 拖放到画布上时的默认大小
+  // 在rect中创建图形；载入文件时传入空矩形，之后由fromJson读取内容
+  std::function<std::unique_ptr<ShapeBase>(const QRect &rect)> create;
+};
+
+// 图形类型注册表：类型名到创建函数、图标和默认几何的映射。
+// 图形库、拖放和载入文件都通过这里创建图形，增加一种图形只需要在构造函数中注册一次。
+// 类型名只在注册时散列一次，按名称或ID查找都是常数时间。
+class ShapeRegistry
+{
+public:
+  static ShapeRegistry &instance();
+
+  const std::vector<ShapeTypeInfo> &types() const { return m_types; } // 按注册顺序
+  const ShapeTypeInfo *find(const QString &name) const;
+  const ShapeTypeInfo *type(int id) const;
+  int typeId(const QString &name) const; // 未注册时返回-1
+
+  // 以center为中心、按默认大小创建图形
+  std::unique_ptr<ShapeBase> createDefault(const QString &name, const QPoint &center) const;
+  // 按json中的"type"创建图形并读取内容，类型未注册时返回空
+  std::unique_ptr<ShapeBase> fromJson(const QJsonObject &obj) const;
+  // 图形库中使用的图标
+  QIcon icon(const ShapeTypeInfo &info) const;
+
+private:
+  ShapeRegistry();
+  void add(const QString &name, const char *displayName, const QSize &defaultSize,
+           std::function<std::unique_ptr<ShapeBase>(const QRect &rect)> create);
+
+  std::vector<ShapeTypeInfo> m_types;
+  QHash<QString, int> m_ids;
+};
+
+#endif // SHAPEREGISTRY_H
@@ -2,12 +2,12 @@
 #include <cmath>
 
 ShapeRoundedRect::ShapeRoundedRect(const QRect &rect, qreal xRadius, qreal yRadius)
-    : m_rect(rect), m_xRadius(xRadius), m_yRadius(yRadius) {}
+    : ShapeBase(Kind::RoundedRect), m_rect(rect), m_xRadius(xRadius), m_yRadius(yRadius) {}
 
 void ShapeRoundedRect::paintShape(QPainter *painter)
 {
   Qt::PenStyle penStyle = Qt::SolidLine;
-  switch (m_lineType)
+  switch (style().lineType)
   {
   case LineType::SolidLine:
     penStyle = Qt::SolidLine;
@@ -20,35 +20,26 @@ void ShapeRoundedRect::paintShape(QPainter *painter)
     break;
   }
 
-  QPen pen(m_lineColor, m_lineWidth);
+  QPen pen(style().lineColor, style().lineWidth);
   pen.setStyle(penStyle);
   painter->setPen(pen);
-  painter->setBrush(m_fillColor);
+  painter->setBrush(style().fillColor);
   
-  // 使用drawRoundedRect代替drawRect
-  painter->drawRoundedRect(m_rect, m_xRadius, m_yRadius);
+  // 绘制缓存的圆角轮廓，旋转由基类的画笔变换处理
+  painter->drawPath(outlinePath());
 }
 
 bool ShapeRoundedRect::contains(const QPoint &pt) const
 {
-  if (m_rotation == 0.0)
-  {
-    // 对于圆角矩形，我们仍然使用普通矩形的包含检测
-    // 这是一个简化的实现，实际上应该考虑圆角部分
-    return m_rect.contains(pt);
-  }
-
-  QPoint center = m_rect.center();
-  QPoint localPt = pt - center;
-
-  double cosAngle = cos(-m_rotation);
-  double sinAngle = sin(-m_rotation);
-  QPoint rotatedPt(localPt.x() * cosAngle - localPt.y() * sinAngle,
-                   localPt.x() * sinAngle + localPt.y() * cosAngle);
-
-  rotatedPt += center;
+  // 使用展平的圆角轮廓检测，圆角外侧的点不算在图形内
+  return outlineContains(pt);
+}
 
-  return m_rect.contains(rotatedPt);
+QPainterPath ShapeRoundedRect::buildOutline() const
+{
+  QPainterPath path;
+  path.addRoundedRect(QRectF(m_rect), m_xRadius, m_yRadius);
+  return path;
 }
 
 void ShapeRoundedRect::moveBy(const QPoint &delta)
@@ -129,18 +120,8 @@ std::unique_ptr<ShapeBase> ShapeRoundedRect::clone() const
   auto clone = std::make_unique<ShapeRoundedRect>(m_rect, m_xRadius, m_yRadius);
   clone->setText(m_text);
   clone->setRotation(m_rotation);
-  clone->setLineColor(m_lineColor);
-  clone->setLineWidth(m_lineWidth);
-  clone->setFillColor(m_fillColor);
-  clone->setLineType(m_lineType);
-  clone->setOpacity(m_opacity);
-  clone->setFontFamily(m_font.family());
-  clone->setFontSize(m_font.pointSize());
-  clone->setFontBold(m_font.bold());
-  clone->setFontItalic(m_font.italic());
-  clone->setFontUnderline(m_font.underline());
-  clone->setFontStrikeOut(m_font.strikeOut());
-  clone->setTextColor(m_textColor);
-  clone->setTextAlignment(m_textAlignment);
+  clone->setStyle(m_style);
+  clone->setPinned(m_pinned);
+  clone->setGroupId(m_groupId);
   return clone;
 }
@@ -16,8 +16,16 @@ public:
   std::unique_ptr<ShapeBase> clone() const override;
 
   // 圆角半径设置和获取
-  void setRadiusX(qreal radius) { m_xRadius = radius; }
-  void setRadiusY(qreal radius) { m_yRadius = radius; }
+  void setRadiusX(qreal radius)
+  {
+    m_xRadius = radius;
+    invalidateOutline();
+  }
+  void setRadiusY(qreal radius)
+  {
+    m_yRadius = radius;
+    invalidateOutline();
+  }
   qreal radiusX() const { return m_xRadius; }
   qreal radiusY() const { return m_yRadius; }
 
@@ -41,8 +49,12 @@ public:
       m_xRadius = obj["xRadius"].toDouble();
     if (obj.contains("yRadius"))
       m_yRadius = obj["yRadius"].toDouble();
+    invalidateOutline();
   }
 
+protected:
+  QPainterPath buildOutline() const override; // 带圆角的轮廓
+
 private:
   QRect m_rect;
   qreal m_xRadius;  // x方向圆角半径
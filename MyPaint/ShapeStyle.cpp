@@ -0,0 +1,146 @@
+#include "ShapeStyle.h"
+#include <algorithm>
+
+bool ShapeStyle::operator==(const ShapeStyle &other) const
+{
+  return lineColor == other.lineColor && fillColor == other.fillColor && textColor == other.textColor &&
+         textAlignment == other.textAlignment && lineWidth == other.lineWidth &&
+         lineType == other.lineType && opacity == other.opacity && font == other.font;
+}
+
+QJsonObject ShapeStyle::toJson() const
+{
+  QJsonObject obj;
+  obj["lineColor"] = lineColor.name();
+  obj["lineWidth"] = lineWidth;
+  obj["lineType"] = lineType;
+  obj["fillColor"] = fillColor.name();
+  obj["opacity"] = opacity;
+  obj["textColor"] = textColor.name();
+  obj["fontFamily"] = font.family();
+  obj["fontSize"] = font.pointSize();
+  obj["textAlignment"] = textAlignment;
+  obj["fontBold"] = font.bold();
+  obj["fontItalic"] = font.italic();
+  obj["fontUnderline"] = font.underline();
+  obj["fontStrikeOut"] = font.strikeOut();
+  return obj;
+}
+
+void ShapeStyle::readJson(const QJsonObject &obj)
+{
+  if (obj.contains("lineColor"))
+    lineColor = QColor(obj["lineColor"].toString());
+  if (obj.contains("lineWidth"))
+    lineWidth = obj["lineWidth"].toInt();
+  if (obj.contains("lineType"))
+    lineType = obj["lineType"].toInt();
+  if (obj.contains("fillColor"))
+    fillColor = QColor(obj["fillColor"].toString());
+  if (obj.contains("opacity"))
+    opacity = obj["opacity"].toDouble();
+  if (obj.contains("textColor"))
+    textColor = QColor(obj["textColor"].toString());
+  if (obj.contains("fontFamily"))
+    font.setFamily(obj["fontFamily"].toString());
+  if (obj.contains("fontSize"))
+    font.setPointSize(obj["fontSize"].toInt());
+  if (obj.contains("fontBold"))
+    font.setBold(obj["fontBold"].toBool());
+  if (obj.contains("fontItalic"))
+    font.setItalic(obj["fontItalic"].toBool());
+  if (obj.contains("fontUnderline"))
+    font.setUnderline(obj["fontUnderline"].toBool());
+  if (obj.contains("fontStrikeOut"))
+    font.setStrikeOut(obj["fontStrikeOut"].toBool());
+  if (obj.contains("textAlignment"))
+    textAlignment = obj["textAlignment"].toInt();
+}
+
+uint qHash(const ShapeStyle &style, uint seed)
+{
+  // 字体只取最常变化的几项参与散列，完整比较交给operator==
+  seed = qHash(style.lineColor.rgba(), seed) ^ (qHash(style.fillColor.rgba(), seed) << 1);
+  seed ^= qHash(style.textColor.rgba(), seed) + static_cast<uint>(style.lineWidth) * 31u +
+          static_cast<uint>(style.lineType) * 131u + static_cast<uint>(style.textAlignment) * 7u;
+  seed ^= qHash(style.opacity, seed) ^ qHash(style.font.family(), seed) ^
+          static_cast<uint>(style.font.pointSize());
+  return seed;
+}
+
+ShapeStyleTable::ShapeStyleTable()
+{
+  m_default = intern(ShapeStyle());
+}
+
+ShapeStyleTable &ShapeStyleTable::instance()
+{
+  static ShapeStyleTable table;
+  return table;
+}
+
+ShapeStyleHandle ShapeStyleTable::defaultStyle()
+{
+  return m_default;
+}
+
+ShapeStyleHandle ShapeStyleTable::intern(const ShapeStyle &style)
+{
+  auto it = m_entries.find(style);
+  if (it != m_entries.end())
+  {
+    if (ShapeStyleHandle handle = it.value().lock())
+      return handle;
+  }
+
+  ShapeStyleHandle handle = std::make_shared<ShapeStyleEntry>();
+  handle->style = style;
+  m_entries.insert(style, handle);
+
+  if (m_entries.size() > m_purgeThreshold)
+  {
+    purge();
+    m_purgeThreshold = std::max(64, m_entries.size() * 2);
+  }
+  return handle;
+}
+
+void ShapeStyleTable::restyle(const ShapeStyleHandle &handle, const ShapeStyle &style)
+{
+  if (!handle || handle->style == style)
+    return;
+
+  // 旧内容的表项指向这一项时移除，之后新建的同样内容的样式不会再合并到这一项上
+  auto it = m_entries.find(handle->style);
+  if (it != m_entries.end() && it.value().lock() == handle)
+    m_entries.erase(it);
+
+  handle->style = style;
+
+  // 新内容已经有其他项时保留原来的项，两项内容相同但互不影响
+  auto existing = m_entries.find(style);
+  if (existing == m_entries.end() || existing.value().expired())
+    m_entries.insert(style, handle);
+}
+
+ShapeStyleHandle ShapeStyleTable::detached(const ShapeStyleHandle &handle)
+{
+  return std::make_shared<ShapeStyleEntry>(*handle);
+}
+
+int ShapeStyleTable::size()
+{
+  purge();
+  return m_entries.size();
+}
+
+void ShapeStyleTable::purge()
+{
+  for (auto it = m_entries.begin(); it != m_entries.end();)
+  {
+    if (it.value().expired())
+      it = m_entries.erase(it);
+    else
+      ++it;
+  }
+}
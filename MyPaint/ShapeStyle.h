@@ -0,0 +1,62 @@
+#pragma once
+#include <QColor>
+#include <QFont>
+#include <QHash>
+#include <QJsonObject>
+#include <memory>
+
+// 图形的样式：线条、填充、文字和不透明度
+struct ShapeStyle
+{
+  QColor lineColor = Qt::black;        // 线条颜色
+  QColor fillColor = Qt::white;        // 填充颜色
+  QColor textColor = Qt::black;        // 文本颜色
+  QFont font;                          // 字体
+  int textAlignment = Qt::AlignCenter; // 文本对齐方式
+  int lineWidth = 1;                   // 线条粗细
+  int lineType = 0;                    // 线条类型（ShapeBase::LineType）
+  double opacity = 1.0;                // 不透明度（0.0-1.0）
+
+  bool operator==(const ShapeStyle &other) const;
+  bool operator!=(const ShapeStyle &other) const { return !(*this == other); }
+
+  QJsonObject toJson() const;
+  // 只覆盖obj中出现的字段；旧文件中逐个图形保存的样式使用同样的字段名
+  void readJson(const QJsonObject &obj);
+};
+
+uint qHash(const ShapeStyle &style, uint seed = 0);
+
+// 样式表中的一项，多个图形共享同一项
+struct ShapeStyleEntry
+{
+  ShapeStyle style;
+};
+using ShapeStyleHandle = std::shared_ptr<ShapeStyleEntry>;
+
+// 样式表（享元）：内容相同的样式只保存一份，图形只持有引用计数的句柄，
+// 不再被任何图形引用的样式自动释放。修改一项样式（restyle）即修改了所有引用它的图形。
+// 只在界面线程中使用；交给渲染线程的图形副本通过 detached() 持有独立的一份，不受之后修改的影响。
+class ShapeStyleTable
+{
+public:
+  static ShapeStyleTable &instance();
+
+  ShapeStyleHandle defaultStyle();
+  // 返回内容相同的样式，没有就新建一项
+  ShapeStyleHandle intern(const ShapeStyle &style);
+  // 修改一项样式，所有引用它的图形随之改变，不需要逐个访问图形
+  void restyle(const ShapeStyleHandle &handle, const ShapeStyle &style);
+  // 独立的副本，不登记在表中
+  static ShapeStyleHandle detached(const ShapeStyleHandle &handle);
+
+  int size(); // 仍被引用的样式个数
+
+private:
+  ShapeStyleTable();
+  void purge(); // 删除已经没有图形引用的项
+
+  QHash<ShapeStyle, std::weak_ptr<ShapeStyleEntry>> m_entries;
+  ShapeStyleHandle m_default;
+  int m_purgeThreshold = 64; // 表项超过这个数量时清理一次
+};
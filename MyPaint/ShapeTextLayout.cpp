@@ -0,0 +1,91 @@
+#include "ShapeTextLayout.h"
+#include <QFontMetricsF>
+#include <QTextOption>
+
+void ShapeTextLayout::draw(QPainter *painter, const QRect &textRect, const QString &text,
+                           const QFont &font, int alignment)
+{
+  if (!painter || text.isEmpty() || textRect.width() <= 0 || textRect.height() <= 0)
+    return;
+
+  // 图形移动时文字区域只是平移，不需要重新排版；共享样式被整体修改时字体或对齐方式会变化
+  if (!m_valid || m_size != textRect.size() || m_alignment != alignment || m_font != font)
+    build(textRect.size(), text, font, alignment);
+
+  // 按垂直对齐方式确定第一行的位置，水平对齐已经在排版时处理
+  qreal top = (textRect.height() - m_textHeight) / 2.0;
+  if (m_alignment & Qt::AlignTop)
+    top = 0.0;
+  else if (m_alignment & Qt::AlignBottom)
+    top = textRect.height() - m_textHeight;
+
+  QPointF origin(textRect.left(), textRect.top() + top);
+  for (int i = 0; i < m_lineCount; ++i)
+    m_layout->lineAt(i).draw(painter, origin);
+}
+
+void ShapeTextLayout::build(const QSize &size, const QString &text, const QFont &font, int alignment)
+{
+  m_size = size;
+  m_alignment = alignment;
+  m_font = font;
+  m_valid = true;
+
+  // 手动换行用行分隔符表示，这样换行和自动折行都由QTextLayout处理
+  QString display = text;
+  display.replace(QLatin1Char('\n'), QChar::LineSeparator);
+
+  QTextOption option(alignment & Qt::AlignHorizontal_Mask);
+  option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere); // 中文没有空格，需要允许在任意位置折行
+
+  m_layout.reset(new QTextLayout(display, font));
+  m_layout->setTextOption(option);
+  m_layout->setCacheEnabled(true);
+
+  bool overflow = false;
+  m_lineCount = layoutLines(size, &overflow);
+  if (!overflow)
+    return;
+
+  // 放不下时把最后一行换成带省略号的文字，再排一次版
+  int lastStart = m_lineCount > 0 ? m_layout->lineAt(m_lineCount - 1).textStart() : 0;
+  QString rest = display.mid(lastStart);
+  rest.replace(QChar::LineSeparator, QLatin1Char(' '));
+  QFontMetricsF metrics(font);
+  QString elided = display.left(lastStart) + metrics.elidedText(rest, Qt::ElideRight, size.width());
+
+  m_layout.reset(new QTextLayout(elided, font));
+  m_layout->setTextOption(option);
+  m_layout->setCacheEnabled(true);
+  m_lineCount = layoutLines(size, &overflow);
+}
+
+int ShapeTextLayout::layoutLines(const QSize &size, bool *overflow)
+{
+  *overflow = false;
+  int count = 0;
+  qreal y = 0.0;
+
+  m_layout->beginLayout();
+  for (;;)
+  {
+    QTextLine line = m_layout->createLine();
+    if (!line.isValid())
+      break;
+
+    line.setLineWidth(size.width());
+    // 至少保留一行；之后超出高度的行不再显示
+    if (count > 0 && y + line.height() > size.height())
+    {
+      *overflow = true;
+      break;
+    }
+    line.setPosition(QPointF(0.0, y));
+    y += line.height();
+    ++count;
+  }
+  m_layout->endLayout();
+
+  m_textHeight = y;
+  return count;
+}
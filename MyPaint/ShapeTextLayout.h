@@ -0,0 +1,41 @@
+#pragma once
+#include <QFont>
+#include <QPainter>
+#include <QRect>
+#include <QString>
+#include <QTextLayout>
+#include <memory>
+
+// 图形文字的排版缓存。
+// 换行、省略和每行的字形排版只在文字、字体、对齐方式或文字区域大小变化时计算一次，
+// 之后每次绘制直接复用排好的行。复制图形时缓存不会被复制，副本在第一次绘制时重新排版。
+class ShapeTextLayout
+{
+public:
+  ShapeTextLayout() = default;
+  ShapeTextLayout(const ShapeTextLayout &) {}
+  ShapeTextLayout &operator=(const ShapeTextLayout &)
+  {
+    invalidate();
+    return *this;
+  }
+
+  // 文字、字体或对齐方式变化后调用
+  void invalidate() { m_valid = false; }
+
+  // 在textRect中绘制文字，使用painter当前的画笔颜色
+  void draw(QPainter *painter, const QRect &textRect, const QString &text,
+            const QFont &font, int alignment);
+
+private:
+  void build(const QSize &size, const QString &text, const QFont &font, int alignment);
+  int layoutLines(const QSize &size, bool *overflow); // 排版并返回放得下的行数
+
+  std::unique_ptr<QTextLayout> m_layout;
+  bool m_valid = false;
+  QSize m_size;             // 排版时文字区域的大小
+  int m_lineCount = 0;      // 放得下的行数
+  qreal m_textHeight = 0.0; // 这些行的总高度
+  int m_alignment = 0;      // 排版时的对齐方式
+  QFont m_font;             // 排版时的字体
+};
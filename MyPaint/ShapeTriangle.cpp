@@ -8,25 +8,23 @@
 #define M_PI 3.14159265358979323846
 #endif
 
-ShapeTriangle::ShapeTriangle(const QRect &rect) : m_rect(rect) {}
+ShapeTriangle::ShapeTriangle(const QRect &rect) : ShapeBase(Kind::Triangle), m_rect(rect) {}
+
+// 未旋转的三个顶点（等腰三角形，顶点在上方）
+QPolygonF ShapeTriangle::localPolygon() const
+{
+    QRectF rect = m_rect;
+    QPolygonF polygon;
+    polygon << QPointF(m_rect.center().x(), rect.top()); // 顶点位于上方中点
+    polygon << QPointF(rect.left(), rect.top() + rect.height()); // 左下角
+    polygon << QPointF(rect.left() + rect.width(), rect.top() + rect.height()); // 右下角
+    return polygon;
+}
 
 QPolygon ShapeTriangle::getPolygon() const
 {
-    QPolygon polygon;
-    QRect rect = m_rect;
-    int w = rect.width();
-    int h = rect.height();
-    int x = rect.left();
-    int y = rect.top();
-    QPoint center = rect.center();
-    
-    // 计算三角形的三个顶点（默认为等腰三角形，顶点在上方）
-    // 顶点位于上方中点
-    polygon << QPoint(center.x(), y);
-    // 左下角
-    polygon << QPoint(x, y + h);
-    // 右下角
-    polygon << QPoint(x + w, y + h);
+    QPolygon polygon = localPolygon().toPolygon();
+    QPoint center = m_rect.center();
     
     // 如果有旋转，应用旋转
     if (m_rotation != 0.0) {
@@ -40,11 +38,19 @@ QPolygon ShapeTriangle::getPolygon() const
     return polygon;
 }
 
+QPainterPath ShapeTriangle::buildOutline() const
+{
+    QPainterPath path;
+    path.addPolygon(localPolygon());
+    path.closeSubpath();
+    return path;
+}
+
 void ShapeTriangle::paintShape(QPainter *painter)
 {
     // 根据线条类型设置不同的画笔样式
     Qt::PenStyle penStyle = Qt::SolidLine;
-    switch (m_lineType)
+    switch (style().lineType)
     {
     case LineType::SolidLine:
         penStyle = Qt::SolidLine;
@@ -57,18 +63,18 @@ void ShapeTriangle::paintShape(QPainter *painter)
         break;
     }
 
-    QPen pen(m_lineColor, m_lineWidth);
+    QPen pen(style().lineColor, style().lineWidth);
     pen.setStyle(penStyle);
     painter->setPen(pen);
-    painter->setBrush(m_fillColor);
+    painter->setBrush(style().fillColor);
     
-    // 绘制三角形
-    painter->drawPolygon(getPolygon());
+    // 绘制缓存的轮廓，旋转由基类的画笔变换处理
+    painter->drawPath(outlinePath());
 }
 
 bool ShapeTriangle::contains(const QPoint &pt) const
 {
-    return getPolygon().containsPoint(pt, Qt::OddEvenFill);
+    return outlineContains(pt);
 }
 
 void ShapeTriangle::moveBy(const QPoint &delta) 
@@ -166,18 +172,8 @@ std::unique_ptr<ShapeBase> ShapeTriangle::clone() const
     auto clone = std::make_unique<ShapeTriangle>(m_rect);
     clone->setText(m_text);
     clone->setRotation(m_rotation);
-    clone->setLineColor(m_lineColor);
-    clone->setLineWidth(m_lineWidth);
-    clone->setFillColor(m_fillColor);
-    clone->setLineType(m_lineType);
-    clone->setOpacity(m_opacity);
-    clone->setFontFamily(m_font.family());
-    clone->setFontSize(m_font.pointSize());
-    clone->setFontBold(m_font.bold());
-    clone->setFontItalic(m_font.italic());
-    clone->setFontUnderline(m_font.underline());
-    clone->setFontStrikeOut(m_font.strikeOut());
-    clone->setTextColor(m_textColor);
-    clone->setTextAlignment(m_textAlignment);
+    clone->setStyle(m_style);
+    clone->setPinned(m_pinned);
+    clone->setGroupId(m_groupId);
     return clone;
 } 
\ No newline at end of file
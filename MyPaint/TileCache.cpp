@@ -0,0 +1,120 @@
+#include "TileCache.h"
+#include <QtMath>
+#include <algorithm>
+#include <vector>
+
+TileCache::TileCache(int capacity) : m_capacity(qMax(1, capacity))
+{
+}
+
+void TileCache::setCapacity(int capacity)
+{
+    m_capacity = qMax(1, capacity);
+}
+
+void TileCache::clear()
+{
+    m_tiles.clear();
+}
+
+void TileCache::setDevicePixelRatio(qreal ratio)
+{
+    if (!qFuzzyCompare(m_devicePixelRatio, ratio))
+    {
+        m_devicePixelRatio = ratio;
+        clear(); // 图像分辨率变了，已有图块都不能再用
+    }
+}
+
+void TileCache::invalidate(const QRect &contentRect)
+{
+    if (contentRect.isEmpty())
+        return;
+
+    if (m_tiles.isEmpty())
+        return;
+
+    int left = tileIndex(contentRect.left());
+    int right = tileIndex(contentRect.right());
+    int top = tileIndex(contentRect.top());
+    int bottom = tileIndex(contentRect.bottom());
+
+    // 只有已分配的图块需要标记，未分配的图块下次取用时自然会绘制
+    for (int ty = top; ty <= bottom; ++ty)
+    {
+        for (int tx = left; tx <= right; ++tx)
+        {
+            auto it = m_tiles.find(tileKey(tx, ty));
+            if (it != m_tiles.end())
+                it->dirty = true;
+        }
+    }
+}
+
+void TileCache::invalidateAll()
+{
+    for (auto it = m_tiles.begin(); it != m_tiles.end(); ++it)
+        it->dirty = true;
+}
+
+const QImage &TileCache::tile(int tx, int ty, const RenderFunc &render, bool draft)
+{
+    Tile &tile = m_tiles[tileKey(tx, ty)];
+    tile.lastUsed = m_frame;
+
+    if (!tile.dirty && (draft || !tile.draft))
+    {
+        ++m_stats.hits;
+        return tile.image;
+    }
+
+    // 重绘时复用已有图像，避免频繁分配；草稿只用一半分辨率
+    qreal ratio = draft ? m_devicePixelRatio * 0.5 : m_devicePixelRatio;
+    QSize pixelSize(qCeil(kTileSize * ratio), qCeil(kTileSize * ratio));
+    if (tile.image.size() != pixelSize)
+    {
+        tile.image = QImage(pixelSize, QImage::Format_ARGB32_Premultiplied);
+        tile.image.setDevicePixelRatio(ratio);
+    }
+
+    render(tile.image, tileRect(tx, ty));
+    tile.dirty = false;
+    tile.draft = draft;
+    ++m_stats.renders;
+    return tile.image;
+}
+
+void TileCache::evict()
+{
+    int excess = m_tiles.size() - m_capacity;
+    if (excess <= 0)
+        return;
+
+    // 按最近使用的帧号排序，淘汰最久没用的图块
+    std::vector<std::pair<quint64, quint64>> usage; // (lastUsed, key)
+    usage.reserve(m_tiles.size());
+    for (auto it = m_tiles.constBegin(); it != m_tiles.constEnd(); ++it)
+    {
+        if (it->lastUsed != m_frame)
+            usage.emplace_back(it->lastUsed, it.key());
+    }
+
+    excess = qMin(excess, static_cast<int>(usage.size()));
+    std::partial_sort(usage.begin(), usage.begin() + excess, usage.end());
+    for (int i = 0; i < excess; ++i)
+    {
+        m_tiles.remove(usage[i].second);
+        ++m_stats.evictions;
+    }
+}
+
+int TileCache::tileIndex(int contentPos)
+{
+    // 向下取整的整数除法，保证负坐标也落在正确的图块中
+    return contentPos >= 0 ? contentPos / kTileSize : -((-contentPos + kTileSize - 1) / kTileSize);
+}
+
+QRect TileCache::tileRect(int tx, int ty)
+{
+    return QRect(tx * kTileSize, ty * kTileSize, kTileSize, kTileSize);
+}
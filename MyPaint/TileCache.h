@@ -0,0 +1,83 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <functional>
+
+// 画布分块缓存：把缩放后的画布内容切成固定大小的图块，
+// 只为视口经过的位置分配图块，超过容量时按最近最少使用淘汰。
+// 图块坐标以缩放后的内容像素为单位，缩放变化时需要整体清空。
+// 缓存由渲染线程独占使用，本身不做加锁。
+class TileCache
+{
+public:
+  static const int kTileSize = 256; // 图块边长（逻辑像素）
+
+  struct Tile
+  {
+    QImage image;         // 图块内容
+    quint64 lastUsed = 0; // 最近一次使用的帧号，用于LRU淘汰
+    bool dirty = true;    // 内容是否需要重新绘制
+    bool draft = false;   // 是否为交互过程中绘制的草稿（半分辨率、无抗锯齿）
+  };
+
+  // 缓存统计，用于性能分析
+  struct Stats
+  {
+    quint64 hits = 0;      // 直接复用的图块数
+    quint64 renders = 0;   // 重新绘制的图块数
+    quint64 evictions = 0; // 被淘汰的图块数
+  };
+
+  // 绘制图块的回调：参数为目标图像和图块在内容坐标中的矩形
+  using RenderFunc = std::function<void(QImage &image, const QRect &tileRect)>;
+
+  explicit TileCache(int capacity = 128);
+
+  void setCapacity(int capacity);
+  int capacity() const { return m_capacity; }
+  int tileCount() const { return m_tiles.size(); }
+
+  // 缩放或设备像素比变化时清空所有图块
+  void clear();
+  void setDevicePixelRatio(qreal ratio);
+  qreal devicePixelRatio() const { return m_devicePixelRatio; }
+
+  // 把与内容矩形相交的图块标记为需要重绘
+  void invalidate(const QRect &contentRect);
+  void invalidateAll();
+
+  // 开始新的一帧，之后取用的图块都记为本帧使用
+  void beginFrame() { ++m_frame; }
+
+  // 取得覆盖指定位置的图块，必要时分配并调用render重绘
+  // draft 为 true 时按一半分辨率分配图像，供草稿绘制使用；
+  // 要求完整质量时，之前画成草稿的图块也会重绘
+  const QImage &tile(int tx, int ty, const RenderFunc &render, bool draft = false);
+
+  // 淘汰超出容量的图块，本帧用到的图块不会被淘汰
+  void evict();
+
+  const Stats &stats() const { return m_stats; }
+
+  // 内容坐标与图块坐标的换算（负坐标向下取整）
+  static int tileIndex(int contentPos);
+  static QRect tileRect(int tx, int ty);
+
+private:
+  static quint64 tileKey(int tx, int ty)
+  {
+    return (static_cast<quint64>(static_cast<quint32>(tx)) << 32) | static_cast<quint32>(ty);
+  }
+
+  QHash<quint64, Tile> m_tiles;
+  int m_capacity;
+  quint64 m_frame = 0;
+  qreal m_devicePixelRatio = 1.0;
+  Stats m_stats;
+};
+
+#endif // TILECACHE_H
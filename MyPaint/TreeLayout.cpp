@@ -0,0 +1,330 @@
+#include "TreeLayout.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // 生成树和Buchheim算法的中间量，都按节点下标存放
+    struct Tree
+    {
+        std::vector<int> parent;
+        std::vector<std::vector<int>> children;
+        std::vector<int> number;  // 在兄弟中的序号
+        std::vector<int> depth;
+        std::vector<int> breadth; // 沿兄弟排列方向的大小
+        std::vector<int> roots;
+        std::vector<double> prelim;
+        std::vector<double> mod;
+        std::vector<double> shift;
+        std::vector<double> change;
+        std::vector<int> thread;   // 轮廓上没有子节点时指向下一层的轮廓节点
+        std::vector<int> ancestor; // 右轮廓节点所属的、与当前子树相邻的最左祖先
+
+        int nextLeft(int v) const { return children[v].empty() ? thread[v] : children[v].front(); }
+        int nextRight(int v) const { return children[v].empty() ? thread[v] : children[v].back(); }
+        int leftSibling(int v) const
+        {
+            return parent[v] < 0 || number[v] == 0 ? -1 : children[parent[v]][number[v] - 1];
+        }
+        // 相邻两个节点中心之间的最小距离
+        double distance(int a, int b) const { return (breadth[a] + breadth[b]) / 2.0 + TreeLayout::kSiblingSpacing; }
+    };
+
+    // 广度优先搜索取生成树：先从入度为0的节点出发，剩下的（环中的）节点再依次作为根
+    void buildTree(const LayoutGraph &graph, bool topDown, Tree &t)
+    {
+        const int n = static_cast<int>(graph.sizes.size());
+        std::vector<std::vector<int>> out(n);
+        std::vector<int> inDegree(n, 0);
+        for (const auto &edge : graph.edges)
+        {
+            if (edge.first < 0 || edge.first >= n || edge.second < 0 || edge.second >= n || edge.first == edge.second)
+                continue;
+            out[edge.first].push_back(edge.second);
+            ++inDegree[edge.second];
+        }
+
+        // 兄弟之间按原来中心的先后排序（中心坐标的两倍，避免取整）
+        std::vector<long long> key(n);
+        for (int v = 0; v < n; ++v)
+        {
+            if (graph.positions.size() != graph.sizes.size())
+                key[v] = v;
+            else if (topDown)
+                key[v] = 2LL * graph.positions[v].x() + graph.sizes[v].width();
+            else
+                key[v] = 2LL * graph.positions[v].y() + graph.sizes[v].height();
+        }
+        auto byKey = [&key](int a, int b) { return key[a] < key[b]; };
+        for (auto &targets : out)
+            std::stable_sort(targets.begin(), targets.end(), byKey);
+        std::vector<int> candidates(n);
+        for (int v = 0; v < n; ++v)
+            candidates[v] = v;
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [&](int a, int b) { return (inDegree[a] == 0) > (inDegree[b] == 0) ||
+                                                    ((inDegree[a] == 0) == (inDegree[b] == 0) && key[a] < key[b]); });
+
+        t.parent.assign(n, -1);
+        t.children.assign(n, std::vector<int>());
+        t.number.assign(n, 0);
+        t.depth.assign(n, 0);
+        std::vector<char> visited(n, 0);
+        std::vector<int> queue;
+        queue.reserve(n);
+        for (int root : candidates)
+        {
+            if (visited[root])
+                continue;
+            visited[root] = 1;
+            t.roots.push_back(root);
+            queue.push_back(root);
+            for (size_t k = queue.size() - 1; k < queue.size(); ++k)
+            {
+                int v = queue[k];
+                for (int w : out[v])
+                {
+                    if (visited[w])
+                        continue;
+                    visited[w] = 1;
+                    t.parent[w] = v;
+                    t.number[w] = static_cast<int>(t.children[v].size());
+                    t.children[v].push_back(w);
+                    t.depth[w] = t.depth[v] + 1;
+                    queue.push_back(w);
+                }
+            }
+        }
+
+        t.breadth.resize(n);
+        for (int v = 0; v < n; ++v)
+            t.breadth[v] = topDown ? graph.sizes[v].width() : graph.sizes[v].height();
+        t.prelim.assign(n, 0.0);
+        t.mod.assign(n, 0.0);
+        t.shift.assign(n, 0.0);
+        t.change.assign(n, 0.0);
+        t.thread.assign(n, -1);
+        t.ancestor.resize(n);
+        for (int v = 0; v < n; ++v)
+            t.ancestor[v] = v;
+    }
+
+    // 把以wp为根的子树右移shift，wm与wp之间的子树在executeShifts中平均分配这段距离
+    void moveSubtree(Tree &t, int wm, int wp, double shift)
+    {
+        int subtrees = t.number[wp] - t.number[wm];
+        if (subtrees > 0)
+        {
+            t.change[wp] -= shift / subtrees;
+            t.change[wm] += shift / subtrees;
+        }
+        t.shift[wp] += shift;
+        t.prelim[wp] += shift;
+        t.mod[wp] += shift;
+    }
+
+    void executeShifts(Tree &t, int v)
+    {
+        double shift = 0.0;
+        double change = 0.0;
+        const auto &kids = t.children[v];
+        for (auto it = kids.rbegin(); it != kids.rend(); ++it)
+        {
+            int w = *it;
+            t.prelim[w] += shift;
+            t.mod[w] += shift;
+            change += t.change[w];
+            shift += t.shift[w] + change;
+        }
+    }
+
+    // 沿v的左轮廓和左边各兄弟子树的右轮廓逐层比较，重叠时把v的子树推开
+    void apportion(Tree &t, int v, int &defaultAncestor)
+    {
+        int w = t.leftSibling(v);
+        if (w < 0)
+            return;
+
+        int vip = v;
+        int vop = v;
+        int vim = w;
+        int vom = t.children[t.parent[v]].front();
+        double sip = t.mod[vip];
+        double sop = t.mod[vop];
+        double sim = t.mod[vim];
+        double som = t.mod[vom];
+        while (t.nextRight(vim) >= 0 && t.nextLeft(vip) >= 0)
+        {
+            vim = t.nextRight(vim);
+            vip = t.nextLeft(vip);
+            vom = t.nextLeft(vom);
+            vop = t.nextRight(vop);
+            t.ancestor[vop] = v;
+            double shift = (t.prelim[vim] + sim) - (t.prelim[vip] + sip) + t.distance(vim, vip);
+            if (shift > 0.0)
+            {
+                int a = t.parent[t.ancestor[vim]] == t.parent[v] ? t.ancestor[vim] : defaultAncestor;
+                moveSubtree(t, a, v, shift);
+                sip += shift;
+                sop += shift;
+            }
+            sim += t.mod[vim];
+            sip += t.mod[vip];
+            som += t.mod[vom];
+            sop += t.mod[vop];
+        }
+
+        // 较短的一边用线索接到较长一边的下一层轮廓上
+        if (t.nextRight(vim) >= 0 && t.nextRight(vop) < 0)
+        {
+            t.thread[vop] = t.nextRight(vim);
+            t.mod[vop] += sim - sop;
+        }
+        if (t.nextLeft(vip) >= 0 && t.nextLeft(vom) < 0)
+        {
+            t.thread[vom] = t.nextLeft(vip);
+            t.mod[vom] += sip - som;
+            defaultAncestor = v;
+        }
+    }
+
+    // 自底向上计算每个节点相对父节点的初步位置。用显式的栈，很深的树也不会栈溢出
+    bool firstWalk(Tree &t, int root, const LayoutCancel &cancel)
+    {
+        struct Frame
+        {
+            int v;
+            size_t next;         // 下一个要处理的子节点
+            int defaultAncestor;
+        };
+        std::vector<Frame> stack;
+        stack.push_back({root, 0, -1});
+        size_t steps = 0;
+        while (!stack.empty())
+        {
+            if ((++steps & 4095) == 0 && cancel.load(std::memory_order_relaxed))
+                return false;
+
+            Frame &frame = stack.back();
+            int v = frame.v;
+            const auto &kids = t.children[v];
+            if (frame.next < kids.size())
+            {
+                if (frame.next == 0)
+                    frame.defaultAncestor = kids.front();
+                int w = kids[frame.next++];
+                stack.push_back({w, 0, -1});
+                continue;
+            }
+
+            int left = t.leftSibling(v);
+            if (kids.empty())
+            {
+                t.prelim[v] = left >= 0 ? t.prelim[left] + t.distance(left, v) : 0.0;
+            }
+            else
+            {
+                executeShifts(t, v);
+                double mid = (t.prelim[kids.front()] + t.prelim[kids.back()]) / 2.0;
+                if (left >= 0)
+                {
+                    t.prelim[v] = t.prelim[left] + t.distance(left, v);
+                    t.mod[v] = t.prelim[v] - mid;
+                }
+                else
+                {
+                    t.prelim[v] = mid;
+                }
+            }
+
+            // 子树完成后立即与左边的兄弟子树分开，下一个兄弟的位置依赖这次调整
+            stack.pop_back();
+            if (!stack.empty())
+                apportion(t, v, stack.back().defaultAncestor);
+        }
+        return true;
+    }
+
+    // 自顶向下累加mod得到最终位置，顺便收集这棵树的节点
+    void secondWalk(const Tree &t, int root, std::vector<double> &center, std::vector<int> &nodes)
+    {
+        std::vector<std::pair<int, double>> stack;
+        stack.emplace_back(root, 0.0);
+        while (!stack.empty())
+        {
+            int v = stack.back().first;
+            double m = stack.back().second;
+            stack.pop_back();
+            center[v] = t.prelim[v] + m;
+            nodes.push_back(v);
+            for (int w : t.children[v])
+                stack.emplace_back(w, m + t.mod[v]);
+        }
+    }
+
+    int roundToInt(double value)
+    {
+        return static_cast<int>(std::floor(value + 0.5));
+    }
+}
+
+bool TreeLayout::run(const LayoutGraph &graph, Orientation orientation, const LayoutCancel &cancel,
+                     std::vector<QPoint> &positions)
+{
+    const int n = static_cast<int>(graph.sizes.size());
+    positions.assign(n, QPoint());
+    if (n == 0)
+        return true;
+
+    const bool topDown = orientation == Orientation::TopDown;
+    Tree t;
+    buildTree(graph, topDown, t);
+
+    // 每一层的厚度取这一层中最大的节点，各棵树的同一层对齐
+    std::vector<int> levelSize;
+    for (int v = 0; v < n; ++v)
+    {
+        int size = topDown ? graph.sizes[v].height() : graph.sizes[v].width();
+        if (t.depth[v] >= static_cast<int>(levelSize.size()))
+            levelSize.resize(t.depth[v] + 1, 0);
+        levelSize[t.depth[v]] = std::max(levelSize[t.depth[v]], size);
+    }
+    std::vector<int> levelStart(levelSize.size(), 0);
+    for (size_t d = 1; d < levelSize.size(); ++d)
+        levelStart[d] = levelStart[d - 1] + levelSize[d - 1] + kLevelSpacing;
+
+    // 森林中的树依次排开
+    std::vector<double> center(n, 0.0);
+    std::vector<int> nodes;
+    double cursor = 0.0;
+    for (int root : t.roots)
+    {
+        if (!firstWalk(t, root, cancel))
+            return false;
+        nodes.clear();
+        secondWalk(t, root, center, nodes);
+
+        double low = center[root] - t.breadth[root] / 2.0;
+        double high = center[root] + t.breadth[root] / 2.0;
+        for (int v : nodes)
+        {
+            low = std::min(low, center[v] - t.breadth[v] / 2.0);
+            high = std::max(high, center[v] + t.breadth[v] / 2.0);
+        }
+        for (int v : nodes)
+            center[v] += cursor - low;
+        cursor += high - low + kTreeSpacing;
+    }
+
+    for (int v = 0; v < n; ++v)
+    {
+        const QSize &size = graph.sizes[v];
+        int start = roundToInt(center[v] - t.breadth[v] / 2.0);
+        int level = t.depth[v];
+        if (topDown)
+            positions[v] = QPoint(start, levelStart[level] + (levelSize[level] - size.height()) / 2);
+        else
+            positions[v] = QPoint(levelStart[level] + (levelSize[level] - size.width()) / 2, start);
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef TREELAYOUT_H
+#define TREELAYOUT_H
+
+#include "LayoutGraph.h"
+
+// 组织结构图等树形图的整齐树布局（Reingold–Tilford，按Buchheim等人的线性时间版本实现）。
+// 子树自底向上合并，沿左右轮廓把右边的子树推开到刚好不重叠，中间的子树平均分配多出的空间；
+// 节点间距按各自外接矩形的大小计算。图中有多个父节点或有环时，按广度优先搜索取一棵生成树
+class TreeLayout
+{
+public:
+  enum class Orientation
+  {
+    TopDown,  // 根在上，子节点向下展开
+    LeftRight // 根在左，子节点向右展开
+  };
+
+  static const int kLevelSpacing = 50;   // 父子两层之间的距离
+  static const int kSiblingSpacing = 20; // 同一层相邻节点之间的距离
+  static const int kTreeSpacing = 40;    // 森林中相邻两棵树之间的距离
+
+  // 计算各节点左上角的位置，整体的左上角在原点；被取消时返回false。
+  // 入度为0的节点是根，同一父节点的子节点按原来的位置排序
+  static bool run(const LayoutGraph &graph, Orientation orientation, const LayoutCancel &cancel,
+                  std::vector<QPoint> &positions);
+};
+
+#endif // TREELAYOUT_H
@@ -0,0 +1,263 @@
+#include "GeometryKernels.h"
+#include "ShapeAllocator.h"
+#include "ShapeArrow.h"
+#include "ShapeDiamond.h"
+#include "ShapeEllipse.h"
+#include "ShapeGeometryTable.h"
+#include "ShapeRect.h"
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+// 几何副表查询的性能测试：
+// 1. 矩形查询（视口裁剪）和点查询（点击检测），分别用 AVX2、SSE2 和标量实现的批量查询，
+//    与逐个访问图形（paintBounds()、contains()）的做法对比；
+// 2. 整个文档的视口裁剪，按每千个图形的微秒数给出；
+// 3. 建立图形和复制、销毁一份文档时内存池的分配统计。
+// 用法：GeometryBenchmark [图形数量]，默认一百万个图形
+namespace
+{
+const int kDefaultShapeCount = 1000000;
+const int kDocumentSize = 200000;     // 图形分布在这么大的正方形文档中
+const QSize kViewportSize(1600, 1000); // 矩形查询的大小，相当于一个视口
+const int kRectQueries = 200;
+const int kPointQueries = 2000;
+const int kScanPointQueries = 20; // 逐个调用contains()很慢，只测少量的点
+
+// 矩形、椭圆、菱形和箭头各占四分之一，八分之一的图形有旋转。
+// 矩形、椭圆和箭头在表中有精确的点命中模型，菱形需要调用contains()确认
+std::vector<std::unique_ptr<ShapeBase>> makeShapes(int count)
+{
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<int> position(0, kDocumentSize);
+    std::uniform_int_distribution<int> extent(20, 200);
+    std::uniform_int_distribution<int> kind(0, 3);
+    std::uniform_int_distribution<int> rotated(0, 7);
+
+    std::vector<std::unique_ptr<ShapeBase>> shapes;
+    shapes.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        QRect rect(position(random), position(random), extent(random), extent(random));
+        std::unique_ptr<ShapeBase> shape;
+        switch (kind(random))
+        {
+        case 0:
+            shape = std::make_unique<ShapeRect>(rect);
+            break;
+        case 1:
+            shape = std::make_unique<ShapeEllipse>(rect);
+            break;
+        case 2:
+            shape = std::make_unique<ShapeDiamond>(rect);
+            break;
+        default:
+            shape = std::make_unique<ShapeArrow>(QLine(rect.topLeft(), rect.bottomRight()));
+            break;
+        }
+        if (shape->kind() != ShapeBase::Kind::Arrow && rotated(random) == 0)
+            shape->setRotation(0.5);
+        shapes.push_back(std::move(shape));
+    }
+    return shapes;
+}
+
+// 执行function，返回用时（微秒）
+template <typename Function>
+double measure(Function function)
+{
+    QElapsedTimer timer;
+    timer.start();
+    function();
+    return timer.nsecsElapsed() / 1000.0;
+}
+
+struct Queries
+{
+    std::vector<QRect> rects;
+    std::vector<QPoint> points;
+};
+
+Queries makeQueries()
+{
+    std::mt19937 random(54321);
+    std::uniform_int_distribution<int> position(0, kDocumentSize);
+    Queries queries;
+    for (int k = 0; k < kRectQueries; ++k)
+        queries.rects.push_back(QRect(QPoint(position(random), position(random)), kViewportSize));
+    for (int k = 0; k < kPointQueries; ++k)
+        queries.points.push_back(QPoint(position(random), position(random)));
+    return queries;
+}
+
+void printRow(const char *name, double microseconds, int queries, int shapeCount, long long hits)
+{
+    double perQuery = microseconds / queries;
+    std::printf("  %-22s %12.2f us/query %10.3f us/1000 shapes   hits %lld\n", name, perQuery,
+                perQuery / (shapeCount / 1000.0), hits);
+}
+
+void printStats(const char *title, const ShapeAllocator::Stats &stats)
+{
+    std::printf("%s: %llu allocations (%llu large), %llu deallocations, %llu live, "
+                "%llu chunks allocated, %llu released, %.1f MB reserved\n",
+                title, static_cast<unsigned long long>(stats.allocations),
+                static_cast<unsigned long long>(stats.largeAllocations),
+                static_cast<unsigned long long>(stats.deallocations),
+                static_cast<unsigned long long>(stats.liveObjects),
+                static_cast<unsigned long long>(stats.chunkAllocations),
+                static_cast<unsigned long long>(stats.chunkReleases), stats.reservedBytes / (1024.0 * 1024.0));
+}
+
+// 把所有图形复制到一个单独的内存池（相当于一个文档）中，再全部销毁并整体释放
+void benchmarkCloneTeardown(const std::vector<std::unique_ptr<ShapeBase>> &shapes)
+{
+    ShapeAllocator document;
+    std::vector<std::unique_ptr<ShapeBase>> clones;
+    clones.reserve(shapes.size());
+    double cloneTime = measure([&]()
+                               {
+        ShapeAllocator::Scope scope(document);
+        for (const auto &shape : shapes)
+            clones.push_back(shape->clone()); });
+    std::printf("clone: %.1f ms\n", cloneTime / 1000.0);
+    printStats("  after clone", document.stats());
+
+    double teardownTime = measure([&]()
+                                  {
+        clones.clear();
+        document.release(); });
+    std::printf("teardown: %.1f ms\n", teardownTime / 1000.0);
+    printStats("  after teardown", document.stats());
+}
+
+const GeometryKernels::Isa kIsas[] = {GeometryKernels::Isa::AVX2, GeometryKernels::Isa::SSE2,
+                                      GeometryKernels::Isa::Scalar};
+
+// 矩形查询：副表的批量查询与逐个比较paintBounds()
+void benchmarkRects(const std::vector<std::unique_ptr<ShapeBase>> &shapes, const ShapeGeometryTable &table,
+                    const std::vector<QRect> &rects, const char *title)
+{
+    const int count = static_cast<int>(shapes.size());
+    const int queries = static_cast<int>(rects.size());
+    std::printf("%s (%d queries)\n", title, queries);
+
+    std::vector<int> result;
+    for (GeometryKernels::Isa isa : kIsas)
+    {
+        if (!GeometryKernels::isSupported(isa))
+        {
+            std::printf("  %-22s not supported\n", GeometryKernels::isaName(isa));
+            continue;
+        }
+        GeometryKernels::setIsa(isa);
+        long long hits = 0;
+        double time = measure([&]()
+                              {
+            for (const QRect &rect : rects)
+            {
+                result.clear();
+                table.intersecting(rect, result);
+                hits += static_cast<long long>(result.size());
+            } });
+        printRow(GeometryKernels::isaName(isa), time, queries, count, hits);
+    }
+
+    long long hits = 0;
+    double time = measure([&]()
+                          {
+        for (const QRect &rect : rects)
+        {
+            for (const auto &shape : shapes)
+                hits += shape->paintBounds().intersects(rect) ? 1 : 0;
+        } });
+    printRow("paintBounds() scan", time, queries, count, hits);
+}
+
+// 点查询：副表筛选（只有没有精确模型的候选才调用contains()）与逐个调用contains()
+void benchmarkPoints(const std::vector<std::unique_ptr<ShapeBase>> &shapes, const ShapeGeometryTable &table,
+                     const std::vector<QPoint> &points)
+{
+    const int count = static_cast<int>(shapes.size());
+    const int queries = static_cast<int>(points.size());
+    std::printf("point queries (%d queries)\n", queries);
+
+    std::vector<ShapeGeometryTable::HitCandidate> candidates;
+    for (GeometryKernels::Isa isa : kIsas)
+    {
+        if (!GeometryKernels::isSupported(isa))
+        {
+            std::printf("  %-22s not supported\n", GeometryKernels::isaName(isa));
+            continue;
+        }
+        GeometryKernels::setIsa(isa);
+        long long hits = 0;
+        double time = measure([&]()
+                              {
+            for (const QPoint &pt : points)
+            {
+                candidates.clear();
+                table.hitCandidates(pt, candidates);
+                for (const auto &candidate : candidates)
+                    hits += (candidate.exact || shapes[candidate.index]->contains(pt)) ? 1 : 0;
+            } });
+        printRow(GeometryKernels::isaName(isa), time, queries, count, hits);
+    }
+
+    // 逐个调用contains()，只测前kScanPointQueries个点，命中数不能直接与上面比较
+    const int scanQueries = std::min(queries, kScanPointQueries);
+    long long hits = 0;
+    double time = measure([&]()
+                          {
+        for (int k = 0; k < scanQueries; ++k)
+        {
+            for (const auto &shape : shapes)
+                hits += shape->contains(points[k]) ? 1 : 0;
+        } });
+    printRow("contains() scan", time, scanQueries, count, hits);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // 图形的默认样式含有字体，需要QGuiApplication；不需要显示窗口
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    int count = argc > 1 ? std::atoi(argv[1]) : kDefaultShapeCount;
+    if (count <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [shape count]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("building %d shapes...\n", count);
+    ShapeAllocator::defaultPool().resetCounters();
+    std::vector<std::unique_ptr<ShapeBase>> shapes = makeShapes(count);
+    printStats("  after build", ShapeAllocator::defaultPool().stats());
+    benchmarkCloneTeardown(shapes);
+
+    ShapeGeometryTable table;
+    double rebuildTime = measure([&]() { table.rebuild(shapes); });
+    std::printf("geometry table rebuild: %.1f ms\n", rebuildTime / 1000.0);
+
+    const GeometryKernels::Isa defaultIsa = GeometryKernels::activeIsa();
+    std::printf("default kernels: %s\n\n", GeometryKernels::isaName(defaultIsa));
+
+    Queries queries = makeQueries();
+    benchmarkRects(shapes, table, queries.rects, "viewport culling");
+    std::printf("\n");
+    // 整个文档作为一次查询：所有图形都在结果中
+    benchmarkRects(shapes, table, std::vector<QRect>(1, table.unitedBounds()), "whole document");
+    std::printf("\n");
+    benchmarkPoints(shapes, table, queries.points);
+
+    GeometryKernels::setIsa(defaultIsa);
+    return 0;
+}
@@ -8,7 +8,6 @@
 #include <QFileDialog>
 #include <QMenuBar>
 #include <QMessageBox>
-#include <QScrollArea>
 #include <QToolBar>
 #include <QSpinBox>
 #include <QLabel>
@@ -53,12 +52,9 @@ MainWindow::MainWindow(QWidget *parent)
   createMenus();
   setupToolBar();
 
-  // 创建绘图区
-  m_drawingArea = new DrawingArea(nullptr);
-  QScrollArea *scrollArea = new QScrollArea(ui->drawingArea);
-  scrollArea->setWidget(m_drawingArea);
-  scrollArea->setWidgetResizable(true);
-  ui->verticalLayoutDrawingArea->addWidget(scrollArea);
+  // 创建绘图区（DrawingArea自身就是滚动视口，只绘制可见区域）
+  m_drawingArea = new DrawingArea(ui->drawingArea);
+  ui->verticalLayoutDrawingArea->addWidget(m_drawingArea);
 
   // 创建图形库
   m_shapeLibrary = new ShapeLibraryWidget(this);
@@ -130,6 +126,12 @@ MainWindow::MainWindow(QWidget *parent)
                                                      : tr("Show Grid"));
           });
 
+  // 网格吸附快捷键
+  QShortcut *snapToGridShortcut = new QShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_G), this);
+  connect(snapToGridShortcut, &QShortcut::activated, this,
+          [this]()
+          { m_drawingArea->setSnapToGrid(!m_drawingArea->isSnapToGrid()); });
+
   // 连接页面大小按钮
   connect(ui->actionA3, &QAction::triggered, this,
           [this]()
@@ -141,6 +143,10 @@ MainWindow::MainWindow(QWidget *parent)
           [this]()
           { m_drawingArea->setPageSize(QSize(750, 1050)); });
 
+  // 连接无限画布按钮
+  connect(ui->actionInfiniteCanvas, &QAction::toggled, m_drawingArea, &DrawingArea::setInfiniteCanvas);
+  connect(m_drawingArea, &DrawingArea::infiniteCanvasChanged, ui->actionInfiniteCanvas, &QAction::setChecked);
+
   // 添加缩放快捷键
   QShortcut *zoomInShortcut = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_Plus), this);
   connect(zoomInShortcut, &QShortcut::activated, this, &MainWindow::onZoomIn);
@@ -224,6 +230,30 @@ void MainWindow::createMenus()
   actionMoveToBottom =
       arrangeMenu->addAction(tr("Send to Back"), this, &MainWindow::onMoveToBottom,
                              QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_Down));
+
+  // 分组：组可以嵌套，选中组中的任一图形即选中整个组
+  arrangeMenu->addSeparator();
+  arrangeMenu->addAction(tr("Group"), this, [this]() { m_drawingArea->groupSelection(); },
+                         QKeySequence(Qt::CTRL + Qt::Key_G));
+  arrangeMenu->addAction(tr("Ungroup"), this, [this]() { m_drawingArea->ungroupSelection(); },
+                         QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_U));
+
+  // 自动布局：选中两个以上的图形时只排列选中的图形
+  arrangeMenu->addSeparator();
+  arrangeMenu->addAction(tr("Layered Layout"), this, [this]() { m_drawingArea->layoutLayered(); },
+                         QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_L));
+  arrangeMenu->addAction(tr("Tree Layout (Top to Bottom)"), this,
+                         [this]() { m_drawingArea->layoutTree(TreeLayout::Orientation::TopDown); });
+  arrangeMenu->addAction(tr("Tree Layout (Left to Right)"), this,
+                         [this]() { m_drawingArea->layoutTree(TreeLayout::Orientation::LeftRight); });
+  arrangeMenu->addAction(tr("Re-layout Subtree"), this, [this]() { m_drawingArea->layoutSubtree(); });
+  // 力导向布局逐帧显示，再次选择时停止
+  arrangeMenu->addAction(tr("Force-Directed Layout"), this, [this]()
+                         {
+    if (m_drawingArea->isForceLayoutRunning())
+      m_drawingArea->stopForceLayout();
+    else
+      m_drawingArea->startForceLayout(); });
 }
 
 void MainWindow::setupToolBar()